@@ -5,16 +5,119 @@
 #define _AES256_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 #define AES256_KEY_SIZE     32
+#define AES256_BLOCK_SIZE   16
+#define AES256_ROUNDS       14
+#define AES256_ROUND_KEYS   240
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief AES256 encryption context.
+ * 
+ * @note The context holds the expanded key-schedule so that the
+ * key expansion is performed once per key rather than once per
+ * block. It contains sensitive data and shall be wiped with
+ * aes256_wipe(aes256_ctx*) after use.
+ * 
+ * @note The key-schedule is kept in bit-sliced form, each of the
+ * 15 round keys occupies eight 64-bit words. When AES-NI is in use,
+ * the first 240 bytes hold the standard round keys instead.
+ */
+typedef struct
+{
+    uint64_t skey[8 * (AES256_ROUNDS + 1)];
+    bool aesni;
+} aes256_ctx;
+
+/**
+ * @brief Enables or disables the AES-NI accelerated engine.
+ * 
+ * @note The accelerated engine is enabled by default and is only
+ * used if the CPU supports it. The setting is process-wide and
+ * applies to contexts initialised after the call: contexts already
+ * in use keep their engine. It is updated atomically, so it can be
+ * called while other threads encrypt, but those threads may still
+ * pick either engine for contexts they initialise concurrently.
+ * Disabling it forces the portable bit-sliced engine, which is
+ * mainly useful for testing.
+ * 
+ * @param enable Whether or not to use the accelerated engine
+ * @return true if the accelerated engine will be used
+ * @return false otherwise
+ */
+bool aes256_use_hardware(bool enable);
+
+/**
+ * @brief Checks whether or not the AES-NI accelerated engine
+ * is in use.
+ * 
+ * @return true if the accelerated engine is in use
+ * @return false otherwise
+ */
+bool aes256_hardware_enabled(void);
+
+/**
+ * @brief Initialises an AES256 context by expanding the key.
+ * 
+ * @param ctx The context to be initialised
+ * @param key The encryption key, 32 bytes
+ */
+void aes256_init(aes256_ctx *ctx, const uint8_t *key);
+
+/**
+ * @brief Encrypts a single block using an initialised context.
+ * 
+ * @note It is acceptable for {@code out} and {@code in} to overlap.
+ * 
+ * @param out The output ciphertext block, 16 bytes
+ * @param in The input plaintext block, 16 bytes
+ * @param ctx The initialised AES256 context
+ */
+void aes256_encrypt_block(uint8_t *out,
+                          const uint8_t *in,
+                          const aes256_ctx *ctx);
+
+/**
+ * @brief Encrypts a number of consecutive blocks using an
+ * initialised context.
+ * 
+ * @note The blocks are processed four at a time by the constant-time
+ * bit-sliced engine, so callers should batch as many blocks as
+ * possible into a single call.
+ * 
+ * @note It is acceptable for {@code out} and {@code in} to overlap.
+ * 
+ * @param out The output ciphertext blocks, 16 * num_blocks bytes
+ * @param in The input plaintext blocks, 16 * num_blocks bytes
+ * @param num_blocks The number of 16-byte blocks
+ * @param ctx The initialised AES256 context
+ */
+void aes256_encrypt_blocks(uint8_t *out,
+                           const uint8_t *in,
+                           size_t num_blocks,
+                           const aes256_ctx *ctx);
+
+/**
+ * @brief Wipes the key-schedule held by an AES256 context.
+ * 
+ * @param ctx The context to be wiped
+ */
+void aes256_wipe(aes256_ctx *ctx);
+
 /**
  * @brief Bit-sliced implementation of AES256 encryption engine.
  * 
+ * @note This method expands the key on every call, use
+ * aes256_init(aes256_ctx*, const uint8_t*) and
+ * aes256_encrypt_block(uint8_t*, const uint8_t*, const aes256_ctx*)
+ * when encrypting more than one block with the same key.
+ * 
  * @param out The output ciphertext block, 16 bytes
  * @param in The input plaintext block, 16 bytes
  * @param key The encryption key, 32 bytes
@@ -0,0 +1,85 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#ifndef _AES256_NI_H
+#define _AES256_NI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define AES256_NI_ROUND_KEYS_SIZE   240
+#define GHASH_CLMUL_TABLE_SIZE      64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Checks whether or not the CPU supports AES-NI and
+ * PCLMULQDQ instructions.
+ *
+ * @note The CPUID query is performed only once, the result
+ * is cached.
+ *
+ * @return true if both AES-NI and PCLMULQDQ are supported
+ * @return false otherwise, or if the target is not x86
+ */
+bool aes256_ni_available(void);
+
+/**
+ * @brief Expands a 256-bit key into 15 AES-NI round keys.
+ *
+ * @param rk The output round keys, 240 bytes
+ * @param key The encryption key, 32 bytes
+ */
+void aes256_ni_expand_key(uint8_t *rk, const uint8_t *key);
+
+/**
+ * @brief Encrypts a number of consecutive blocks using AES-NI.
+ *
+ * @note Eight blocks are processed in parallel to keep the
+ * AES pipeline busy. It is acceptable for {@code out} and
+ * {@code in} to overlap.
+ *
+ * @param out The output blocks, 16 * num_blocks bytes
+ * @param in The input blocks, 16 * num_blocks bytes
+ * @param num_blocks The number of blocks
+ * @param rk The round keys, 240 bytes
+ */
+void aes256_ni_encrypt_blocks(uint8_t *out,
+                              const uint8_t *in,
+                              size_t num_blocks,
+                              const uint8_t *rk);
+
+/**
+ * @brief Precomputes the powers H, H^2, H^3 and H^4 of the GHASH
+ * subkey for the PCLMULQDQ engine.
+ *
+ * @param table The output table, 64 bytes
+ * @param H The hash subkey, 16 bytes
+ */
+void ghash_clmul_init(uint8_t *table, const uint8_t *H);
+
+/**
+ * @brief Absorbs {@code len} bytes into the GHASH accumulator
+ * using PCLMULQDQ, zero-padding the last partial block.
+ *
+ * @note Four blocks are multiplied by H^4, H^3, H^2 and H, and
+ * the products are reduced once (aggregated reduction).
+ *
+ * @param accum The GHASH accumulator, 16 bytes
+ * @param table The table from ghash_clmul_init(uint8_t*, const uint8_t*)
+ * @param x The input buffer
+ * @param len The length of the input in bytes
+ */
+void ghash_clmul(uint8_t *accum,
+                 const uint8_t *table,
+                 const uint8_t *x,
+                 size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
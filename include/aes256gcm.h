@@ -5,16 +5,78 @@
 #define _AES256_GCM_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include "aes256.h"
+#include "aes256_ni.h"
 
 #define AES256GCM_KEY_SIZE      32
 #define AES256GCM_NONCE_SIZE    12
 #define AES256GCM_TAG_SIZE      16
 
+/**
+ * @brief The maximum size in bytes of a message, 2^32 - 2 blocks,
+ * beyond which the 32-bit counter would wrap around.
+ */
+#define AES256GCM_MAX_MSG_SIZE  ((((uint64_t)1) << 36) - 32)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief A power of the hash subkey, split into the words needed
+ * by the Karatsuba multiplication of the portable GHASH engine.
+ */
+typedef struct
+{
+    uint64_t h0, h1, h2;
+    uint64_t h0r, h1r, h2r;
+} ghash_power;
+
+/**
+ * @brief GHASH key, the hash subkey H and the table of its powers,
+ * either for the PCLMULQDQ engine or the portable engine.
+ */
+typedef struct
+{
+    uint8_t H[16];
+    uint8_t table[GHASH_CLMUL_TABLE_SIZE];
+    ghash_power powers[4];
+    bool clmul;
+} ghash_key;
+
+/**
+ * @brief AES-256 GCM incremental context.
+ * 
+ * @note Encryption is aes256gcm_init, any number of calls to
+ * aes256gcm_encrypt_update and aes256gcm_encrypt_final. Decryption
+ * is two-pass, so that no unauthenticated plaintext is released:
+ * aes256gcm_init, the whole ciphertext through aes256gcm_authenticate
+ * and aes256gcm_verify, then the ciphertext again through
+ * aes256gcm_decrypt_update. The updates accept any length, as long
+ * as the message stays within AES256GCM_MAX_MSG_SIZE bytes.
+ * 
+ * @note The context contains sensitive data and shall be wiped
+ * with aes256gcm_wipe(aes256gcm_ctx*) after use.
+ */
+typedef struct
+{
+    aes256_ctx ctx;
+    ghash_key gk;
+    uint8_t J[16];
+    uint8_t T[16];
+    uint8_t accum[16];
+    uint8_t pending[16];
+    uint8_t stream[16];
+    size_t pending_len;
+    size_t stream_pos;
+    uint32_t index;
+    uint64_t aad_len;
+    uint64_t msg_len;
+    bool verified;
+} aes256gcm_ctx;
+
 /**
  * @brief AES-256 GCM with 16-byte tag encrypt method.
  * 
@@ -26,7 +88,8 @@ extern "C" {
  * @param aad_len The size of the AAD in bytes
  * @param nonce The pointer to the nonce, 12 bytes
  * @param key The pointer to the encryption key, 32 bytes
- * @return 0 on success, non-zero otherwise
+ * @return 0 on success, non-zero otherwise, e.g. if the message
+ *         exceeds AES256GCM_MAX_MSG_SIZE bytes
  */
 int32_t aes256gcm_encrypt(uint8_t* c,
                           size_t *c_len,
@@ -59,6 +122,169 @@ int32_t aes256gcm_decrypt(uint8_t *msg,
                           const uint8_t *nonce,
                           const uint8_t *key);
 
+/**
+ * @brief Initialises an incremental AES-256 GCM context and
+ * absorbs the AAD.
+ * 
+ * @param gcm The context
+ * @param aad The pointer to the AAD
+ * @param aad_len The size of the AAD in bytes
+ * @param nonce The pointer to the nonce, 12 bytes
+ * @param key The pointer to the encryption key, 32 bytes
+ */
+void aes256gcm_init(aes256gcm_ctx *gcm,
+                    const uint8_t *aad,
+                    size_t aad_len,
+                    const uint8_t *nonce,
+                    const uint8_t *key);
+
+/**
+ * @brief Encrypts the next {@code len} bytes of the message.
+ * 
+ * @param gcm The context
+ * @param c The pointer to the output ciphertext, len bytes
+ * @param msg The pointer to the input plaintext
+ * @param len The size of the input in bytes
+ * @return 0 on success, non-zero if the message would exceed
+ *         AES256GCM_MAX_MSG_SIZE bytes
+ */
+int32_t aes256gcm_encrypt_update(aes256gcm_ctx *gcm,
+                                 uint8_t *c,
+                                 const uint8_t *msg,
+                                 size_t len);
+
+/**
+ * @brief Completes an encryption and wipes the context.
+ * 
+ * @param gcm The context
+ * @param tag The pointer to the output tag, 16 bytes
+ */
+void aes256gcm_encrypt_final(aes256gcm_ctx *gcm, uint8_t *tag);
+
+/**
+ * @brief Absorbs the next {@code len} bytes of the ciphertext,
+ * tag excluded, during the first pass of a decryption.
+ * 
+ * @param gcm The context
+ * @param c The pointer to the input ciphertext
+ * @param len The size of the input in bytes
+ * @return 0 on success, non-zero if the message would exceed
+ *         AES256GCM_MAX_MSG_SIZE bytes
+ */
+int32_t aes256gcm_authenticate(aes256gcm_ctx *gcm,
+                               const uint8_t *c,
+                               size_t len);
+
+/**
+ * @brief Completes the first pass of a decryption by comparing the
+ * tag, and rewinds the context for the second pass.
+ * 
+ * @param gcm The context
+ * @param tag The pointer to the input tag, 16 bytes
+ * @return 0 if the tag matches, non-zero otherwise
+ */
+int32_t aes256gcm_verify(aes256gcm_ctx *gcm, const uint8_t *tag);
+
+/**
+ * @brief Decrypts the next {@code len} bytes of the ciphertext
+ * during the second pass of a decryption.
+ * 
+ * @note The ciphertext must be the one given to the first pass,
+ * only then is the output authenticated.
+ * 
+ * @param gcm The context
+ * @param msg The pointer to the output plaintext, len bytes
+ * @param c The pointer to the input ciphertext
+ * @param len The size of the input in bytes
+ * @return 0 on success, non-zero if the tag has not been verified
+ *         or if the message would exceed AES256GCM_MAX_MSG_SIZE
+ *         bytes
+ */
+int32_t aes256gcm_decrypt_update(aes256gcm_ctx *gcm,
+                                 uint8_t *msg,
+                                 const uint8_t *c,
+                                 size_t len);
+
+/**
+ * @brief Skips the next {@code len} bytes of the ciphertext during
+ * the second pass of a decryption, so that a part of the message
+ * can be decrypted on its own.
+ * 
+ * @param gcm The context
+ * @param len The number of bytes to skip
+ * @return 0 on success, non-zero if the tag has not been verified
+ *         or if the message would exceed AES256GCM_MAX_MSG_SIZE
+ *         bytes
+ */
+int32_t aes256gcm_decrypt_skip(aes256gcm_ctx *gcm, size_t len);
+
+/**
+ * @brief Wipes an incremental AES-256 GCM context.
+ * 
+ * @param gcm The context
+ */
+void aes256gcm_wipe(aes256gcm_ctx *gcm);
+
+struct bdap_thread_pool;
+
+/**
+ * @brief AES-256 GCM with 16-byte tag encrypt method, spreading
+ * the message across the threads of a pool.
+ * 
+ * @note The message is split into segments which are run through
+ * counter mode and hashed independently, the partial GHASHes are
+ * then combined with the powers of the hash subkey. The output is
+ * identical to the one of aes256gcm_encrypt.
+ * 
+ * @param c The pointer to the output ciphertext
+ * @param c_len The pointer to the ciphertext size in bytes
+ * @param msg The pointer to the input plaintext message
+ * @param msg_len The size of the plaintext message in bytes
+ * @param aad The pointer to the AAD
+ * @param aad_len The size of the AAD in bytes
+ * @param nonce The pointer to the nonce, 12 bytes
+ * @param key The pointer to the encryption key, 32 bytes
+ * @param pool The thread pool, or NULL
+ * @return 0 on success, non-zero otherwise
+ */
+int32_t aes256gcm_encrypt_parallel(uint8_t* c,
+                                   size_t *c_len,
+                                   const uint8_t* msg,
+                                   size_t msg_len,
+                                   const uint8_t* aad,
+                                   size_t aad_len,
+                                   const uint8_t* nonce,
+                                   const uint8_t* key,
+                                   struct bdap_thread_pool *pool);
+
+/**
+ * @brief AES-256 GCM with 16-byte tag decrypt method, spreading
+ * the ciphertext across the threads of a pool.
+ * 
+ * @note The tag is verified in a first parallel pass, the message
+ * is decrypted in a second one only if it matches.
+ * 
+ * @param msg The pointer to the output plaintext message
+ * @param msg_len The pointer to the plaintext size in bytes
+ * @param c The pointer to the input ciphertext
+ * @param c_len The size of ciphertext in bytes
+ * @param aad The pointer to the AAD
+ * @param aad_len The size of the AAD in bytes
+ * @param nonce The pointer to the nonce, 12 bytes
+ * @param key The pointer to the encryption key, 32 bytes
+ * @param pool The thread pool, or NULL
+ * @return 0 on success, non-zero otherwise
+ */
+int32_t aes256gcm_decrypt_parallel(uint8_t *msg,
+                                   size_t *msg_len,
+                                   const uint8_t *c,
+                                   size_t c_len,
+                                   const uint8_t *aad,
+                                   size_t aad_len,
+                                   const uint8_t *nonce,
+                                   const uint8_t *key,
+                                   struct bdap_thread_pool *pool);
+
 #ifdef __cplusplus
 }
 #endif
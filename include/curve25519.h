@@ -6,6 +6,8 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
+#include "fe.h"
 
 #define CURVE25519_POINT_SIZE           32
 #define CURVE25519_SCALAR_SIZE          32
@@ -16,6 +18,84 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Performs curve25519 Diffie-Hellman exchange between point p and
+ * scalar n, leaving the result in projective (X:Z) form.
+ * 
+ * @note [n].p = X/Z, the division is left to the caller so that several
+ * results can be normalised with a single inversion, see
+ * fe_batch_inv(fe*, const fe*, size_t).
+ * 
+ * @param x The X coordinate of the scalar multiplication output
+ * @param z The Z coordinate of the scalar multiplication output
+ * @param n The scalar value, 32 bytes
+ * @param p The curve25519 point, 32 bytes
+ * @return true on success
+ * @return false on failure, e.g invalid point
+ */
+bool curve25519_dh_projective(fe x, fe z, const uint8_t *n, const uint8_t *p);
+
+/**
+ * @brief Enables or disables the AVX2 accelerated ladders.
+ * 
+ * @note The accelerated engine is enabled by default and is only
+ * used if the CPU supports it. Disabling it forces the scalar
+ * ladder, which is mainly useful for testing.
+ * 
+ * @param enable Whether or not to use the accelerated engine
+ * @return true if the accelerated engine will be used
+ * @return false otherwise
+ */
+bool curve25519_use_hardware(bool enable);
+
+/**
+ * @brief Checks whether or not the AVX2 accelerated ladders
+ * are in use.
+ * 
+ * @return true if the accelerated engine is in use
+ * @return false otherwise
+ */
+bool curve25519_hardware_enabled(void);
+
+/**
+ * @brief Performs four curve25519 Diffie-Hellman exchanges between the
+ * points p[0], ..., p[3] and the same scalar n, leaving the results in
+ * projective (X:Z) form.
+ * 
+ * @note The four Montgomery ladders run in lockstep on AVX2 when it is
+ * available, and one after another otherwise.
+ * 
+ * @param x The X coordinates of the outputs, 4 field elements
+ * @param z The Z coordinates of the outputs, 4 field elements
+ * @param n The scalar value, 32 bytes
+ * @param p The four curve25519 points, 32 bytes each
+ * @return true on success
+ * @return false on failure, e.g one of the points is invalid
+ */
+bool curve25519_dh_x4(fe *x, fe *z, const uint8_t *n, const uint8_t *const *p);
+
+/**
+ * @brief Performs curve25519 Diffie-Hellman exchanges between the points
+ * p[0], ..., p[num - 1] and the same scalar n, leaving the results in
+ * projective (X:Z) form.
+ * 
+ * @note The points are processed four at a time with
+ * curve25519_dh_x4(fe*, fe*, const uint8_t*, const uint8_t* const*).
+ * 
+ * @param x The X coordinates of the outputs, num field elements
+ * @param z The Z coordinates of the outputs, num field elements
+ * @param n The scalar value, 32 bytes
+ * @param p The curve25519 points, 32 bytes each
+ * @param num The number of points
+ * @return true on success
+ * @return false on failure, e.g one of the points is invalid
+ */
+bool curve25519_dh_batch(fe *x,
+                         fe *z,
+                         const uint8_t *n,
+                         const uint8_t *const *p,
+                         size_t num);
+
 /**
  * @brief Performs curve25519 Diffie-Hellman exchange between point p and scalar n.
  * 
@@ -49,6 +129,22 @@ bool curve25519_public_key_from_private_key(uint8_t *q, const uint8_t *n);
  */
 bool curve25519_random_keypair(uint8_t* public_key, uint8_t* private_key);
 
+struct bdap_rng;
+
+/**
+ * @brief Creates a curve25519 random key-pair with a random number
+ * generator context.
+ * 
+ * @param public_key Output public-key array, 32 bytes
+ * @param private_key Output private-key array, 32 bytes
+ * @param rng The generator, or NULL for bdap_randombytes
+ * @return true on success
+ * @return false on failure, e.g. invalid key-pair
+ */
+bool curve25519_random_keypair_with_rng(uint8_t* public_key,
+                                        uint8_t* private_key,
+                                        const struct bdap_rng* rng);
+
 #ifdef __cplusplus
 }
 #endif
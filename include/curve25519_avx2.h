@@ -0,0 +1,52 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#ifndef _CURVE25519_AVX2_H
+#define _CURVE25519_AVX2_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CURVE25519_AVX2_FE_SIZE     32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Checks whether or not the CPU and the operating system
+ * support AVX2 instructions.
+ *
+ * @note The CPUID query is performed only once, the result
+ * is cached.
+ *
+ * @return true if AVX2 is supported
+ * @return false otherwise, or if the target is not x86-64
+ */
+bool curve25519_avx2_available(void);
+
+/**
+ * @brief Runs four curve25519 Montgomery ladders in lockstep, one per
+ * AVX2 lane, sharing the same scalar.
+ *
+ * @note The scalar must already be clamped and the points validated,
+ * see curve25519_dh_x4(fe*, fe*, const uint8_t*, const uint8_t* const*).
+ * The outputs are fully reduced and little-endian, so that they can be
+ * loaded with fe_frombytes(fe, const uint8_t*) whatever the field
+ * element representation.
+ *
+ * @param x The output X coordinates, 4 * 32 bytes
+ * @param z The output Z coordinates, 4 * 32 bytes
+ * @param e The clamped scalar, 32 bytes
+ * @param p The four curve25519 points, 32 bytes each
+ */
+void curve25519_avx2_ladder_x4(uint8_t *x,
+                               uint8_t *z,
+                               const uint8_t *e,
+                               const uint8_t *const *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#ifndef _DRBG_RAND_H
+#define _DRBG_RAND_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DRBG_BUFFER_SIZE        1024
+#define DRBG_RESEED_INTERVAL    4096
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialises the buffered random number generator.
+ * 
+ * @note This is a no-op method, only a place-holder: every thread
+ * seeds its generator from the OS on first use.
+ * 
+ * @param seed the pointer to the seed
+ * @param seed_size the size of the seed in bytes
+ */
+void drbg_randominit(const uint8_t* seed, size_t seed_size);
+
+/**
+ * @brief Randomly generates a block of {@code buf_size} bytes
+ * using the calling thread's buffered random number generator.
+ * 
+ * @note Every thread owns an AES-256-CTR generator with fast key
+ * erasure: each refill encrypts a zero block under the current
+ * key, the first 32 bytes of which replace the key and the next
+ * DRBG_BUFFER_SIZE bytes are handed out, and wiped, as requested.
+ * The generator is seeded from os_randombytes(uint8_t*, size_t) on
+ * first use, after a fork() and every DRBG_RESEED_INTERVAL refills,
+ * so that the OS is only asked once in a while.
+ * 
+ * @param buf The pointer to the generated random block
+ * @param buf_size The length of the random block in bytes
+ */
+void drbg_randombytes(uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief Forces the calling thread's generator to be seeded again
+ * from the OS on its next use.
+ */
+void drbg_reseed(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
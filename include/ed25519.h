@@ -5,6 +5,7 @@
 #define _ED25519_H
 
 #include <stdint.h>
+#include "fe.h"
 
 #define ED25519_PRIVATE_KEY_SEED_SIZE   32
 #define ED25519_PRIVATE_KEY_SIZE        64
@@ -36,6 +37,20 @@ void ed25519_seeded_keypair(uint8_t* pk,
  */
 void ed25519_keypair(uint8_t* pk, uint8_t* sk);
 
+struct bdap_rng;
+
+/**
+ * @brief Randomly generates an Ed25519 public/private key-pair with
+ * a random number generator context.
+ *
+ * @param pk the pointer to the output public-key, 32 bytes
+ * @param sk the pointer to the output private-key, 64 bytes
+ * @param rng the generator, or NULL for bdap_randombytes
+ */
+void ed25519_keypair_with_rng(uint8_t* pk,
+                              uint8_t* sk,
+                              const struct bdap_rng* rng);
+
 /**
  * @brief Creates a Ed25519 public-key from a private-key seed.
  * 
@@ -45,6 +60,23 @@ void ed25519_keypair(uint8_t* pk, uint8_t* sk);
 void ed25519_public_key_from_private_key_seed(uint8_t *p,
                                               const uint8_t *s);
 
+/**
+ * @brief Converts Ed25519 public-key to a projective Curve25519
+ * u-coordinate (X:Z), i.e. u = (1 + y)/(1 - y) = X/Z.
+ * 
+ * @note The division is left to the caller so that several keys
+ * can be normalised with a single inversion, see
+ * fe_batch_inv(fe*, const fe*, size_t).
+ * 
+ * @param x the output X coordinate
+ * @param z the output Z coordinate, never zero on success
+ * @param ed25519_pk the input Ed25519 public-key
+ * @return 0 on success, non-zero otherwise
+ */
+int32_t ed25519_to_curve25519_public_key_projective(fe x,
+                                                    fe z,
+                                                    const uint8_t *ed25519_pk);
+
 /**
  * @brief Converts Ed25519 public-key to Curve25519 public-key.
  * 
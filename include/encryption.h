@@ -4,8 +4,10 @@
 #ifndef _ENCRYPTION_H
 #define _ENCRYPTION_H
 
+#include <iosfwd>
 #include <string>
 #include <vector>
+#include "encryption_core.h"
 
 typedef std::vector<uint8_t> CharVector;
 typedef std::vector<CharVector> vCharVector;
@@ -36,13 +38,90 @@ size_t BDAPExpectedDecryptedSize(const CharVector& vchCipherText);
  * @param vchData The input data to be encrypted
  * @param vchCipherText The output ciphertext
  * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nThreads The number of threads, 0 for the number of processors
  * @return true on success
  * @return false on failure
  */
 bool EncryptBDAPData(const vCharVector& vchPubKeys,
                      const CharVector& vchData,
                      CharVector& vchCipherText,
-                     std::string& strErrorMessage);
+                     std::string& strErrorMessage,
+                     const uint32_t nThreads = 1);
+
+/**
+ * @brief Encrypts a piece of data using BDAP for a set of recipient's public-keys,
+ * with the segmented v2 layout whose ranges can be decrypted on their own.
+ * 
+ * @param vchPubKeys The set of recipients Ed25519 public-keys, 32 bytes each
+ * @param vchData The input data to be encrypted
+ * @param vchCipherText The output ciphertext
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nSegmentSize The segment size in bytes, a power of two from 1 KiB to 16 MiB
+ * @param nThreads The number of threads, 0 for the number of processors
+ * @return true on success
+ * @return false on failure
+ */
+bool EncryptBDAPDataV2(const vCharVector& vchPubKeys,
+                       const CharVector& vchData,
+                       CharVector& vchCipherText,
+                       std::string& strErrorMessage,
+                       const size_t nSegmentSize = BDAP_V2_SEGMENT_SIZE,
+                       const uint32_t nThreads = 1);
+
+/**
+ * @brief A set of recipients whose Ed25519 public-keys are validated and converted
+ * to Curve25519 once, so that encrypting many messages to the same group only costs
+ * the Diffie-Hellman exchanges.
+ */
+class BDAPRecipientSet
+{
+public:
+    /**
+     * @brief Validates and converts the recipients' public-keys.
+     * 
+     * @param vchPubKeys The set of recipients Ed25519 public-keys, 32 bytes each
+     */
+    explicit BDAPRecipientSet(const vCharVector& vchPubKeys);
+
+    /**
+     * @brief Checks whether or not all the public-keys were converted successfully.
+     * 
+     * @param strErrorMessage The string containing error-message in the event of failure
+     * @return true if the set is usable
+     * @return false otherwise
+     */
+    bool IsValid(std::string& strErrorMessage) const;
+
+    /**
+     * @brief Returns the number of recipients in the set.
+     */
+    uint16_t Size() const;
+
+private:
+    friend bool EncryptBDAPData(const BDAPRecipientSet&, const CharVector&,
+                                CharVector&, std::string&, const uint32_t);
+
+    std::vector<bdap_recipient> vRecipients;
+    bool fValid;
+    std::string strInitErrorMessage;
+};
+
+/**
+ * @brief Encrypts a piece of data using BDAP for a prepared set of recipients.
+ * 
+ * @param recipientSet The prepared set of recipients
+ * @param vchData The input data to be encrypted
+ * @param vchCipherText The output ciphertext
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nThreads The number of threads, 0 for the number of processors
+ * @return true on success
+ * @return false on failure
+ */
+bool EncryptBDAPData(const BDAPRecipientSet& recipientSet,
+                     const CharVector& vchData,
+                     CharVector& vchCipherText,
+                     std::string& strErrorMessage,
+                     const uint32_t nThreads = 1);
 
 /**
  * @brief Decrypts a piece of BDAP encrypted ciphertext using a Ed25519 private-key seed.
@@ -51,12 +130,206 @@ bool EncryptBDAPData(const vCharVector& vchPubKeys,
  * @param vchCipherText The input BDAP ciphertext
  * @param vchData The decrypted output
  * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nThreads The number of threads, 0 for the number of processors
  * @return true on success
  * @return false on failure
  */
 bool DecryptBDAPData(const CharVector& vchPrivKeySeed,
                      const CharVector& vchCipherText,
                      CharVector& vchData,
-                     std::string& strErrorMessage);
+                     std::string& strErrorMessage,
+                     const uint32_t nThreads = 1);
+
+/**
+ * @brief Encrypts a stream using BDAP for a set of recipient's public-keys.
+ * 
+ * @note The data is read and encrypted chunk by chunk, so that the memory used
+ * does not depend on the size of the data. The output is the same ciphertext as
+ * the one of EncryptBDAPData. It fails once the data exceeds
+ * AES256GCM_MAX_MSG_SIZE bytes, leaving the output without a tag.
+ * 
+ * @param vchPubKeys The set of recipients Ed25519 public-keys, 32 bytes each
+ * @param input The data to be encrypted, read until its end
+ * @param output The output ciphertext
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nChunkSize The size of the chunks in bytes
+ * @return true on success
+ * @return false on failure
+ */
+bool EncryptBDAPStream(const vCharVector& vchPubKeys,
+                       std::istream& input,
+                       std::ostream& output,
+                       std::string& strErrorMessage,
+                       const size_t nChunkSize = 65536);
+
+/**
+ * @brief Decrypts a BDAP ciphertext stream using a Ed25519 private-key seed.
+ * 
+ * @note The input must be seekable: it is read twice, first to check the tag and
+ * then to decrypt, so that nothing is written to the output unless the whole
+ * ciphertext is authentic. The memory used does not depend on the size of the data.
+ * 
+ * @param vchPrivKeySeed The Ed25519 private-key seed, 32 bytes
+ * @param input The input BDAP ciphertext, from its current position to its end
+ * @param output The decrypted output
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nChunkSize The size of the chunks in bytes
+ * @return true on success
+ * @return false on failure
+ */
+bool DecryptBDAPStream(const CharVector& vchPrivKeySeed,
+                       std::istream& input,
+                       std::ostream& output,
+                       std::string& strErrorMessage,
+                       const size_t nChunkSize = 65536);
+
+/**
+ * @brief Decrypts a batch of BDAP ciphertexts using a Ed25519 private-key seed.
+ * 
+ * @note The keys are derived from the private-key seed once, and the
+ * ciphertexts are spread across a work-stealing thread pool.
+ * 
+ * @param vchPrivKeySeed The Ed25519 private-key seed, 32 bytes
+ * @param vchCipherTexts The input BDAP ciphertexts
+ * @param vchData The decrypted outputs, one per ciphertext, empty on failure
+ * @param vStatus The status codes, one per ciphertext, see encryption_error.h
+ * @param strErrorMessage The string containing the last error-message in the event of failure
+ * @param nThreads The number of threads, 0 for the number of processors
+ * @return true if all the ciphertexts were decrypted
+ * @return false on failure
+ */
+bool DecryptBDAPBatch(const CharVector& vchPrivKeySeed,
+                      const vCharVector& vchCipherTexts,
+                      vCharVector& vchData,
+                      std::vector<uint16_t>& vStatus,
+                      std::string& strErrorMessage,
+                      const uint32_t nThreads = 0);
+
+/**
+ * @brief Decrypts BDAP ciphertexts for one Ed25519 identity.
+ * 
+ * @note The keys derived from the private-key seed are computed once in the
+ * constructor, locked in memory and wiped by the destructor, which makes this
+ * class much faster than DecryptBDAPData when scanning many ciphertexts.
+ */
+class BDAPDecryptor
+{
+public:
+    /**
+     * @brief Derives the decryption keys from an Ed25519 private-key seed.
+     * 
+     * @param vchPrivKeySeed The Ed25519 private-key seed, 32 bytes
+     */
+    explicit BDAPDecryptor(const CharVector& vchPrivKeySeed);
+    ~BDAPDecryptor();
+
+    BDAPDecryptor(const BDAPDecryptor&) = delete;
+    BDAPDecryptor& operator=(const BDAPDecryptor&) = delete;
+
+    /**
+     * @brief Checks whether or not the decryption keys were derived successfully.
+     * 
+     * @param strErrorMessage The string containing error-message in the event of failure
+     * @return true if the keys are usable
+     * @return false otherwise
+     */
+    bool IsValid(std::string& strErrorMessage) const;
+
+    /**
+     * @brief Decrypts a piece of BDAP encrypted ciphertext.
+     * 
+     * @param vchCipherText The input BDAP ciphertext
+     * @param vchData The decrypted output
+     * @param strErrorMessage The string containing error-message in the event of failure
+     * @return true on success
+     * @return false on failure
+     */
+    bool Decrypt(const CharVector& vchCipherText,
+                 CharVector& vchData,
+                 std::string& strErrorMessage) const;
+
+    /**
+     * @brief Decrypts a range of the data of a BDAP v2 ciphertext, authenticating
+     * and decrypting only the segments it overlaps.
+     * 
+     * @param vchCipherText The input BDAP v2 ciphertext
+     * @param nOffset The offset of the range in the data
+     * @param nLength The length of the range in bytes
+     * @param vchData The decrypted range
+     * @param strErrorMessage The string containing error-message in the event of failure
+     * @return true on success
+     * @return false on failure
+     */
+    bool DecryptRange(const CharVector& vchCipherText,
+                      const size_t nOffset,
+                      const size_t nLength,
+                      CharVector& vchData,
+                      std::string& strErrorMessage) const;
+
+private:
+    bdap_decrypt_key key;
+    bool fValid;
+    std::string strInitErrorMessage;
+};
+
+/**
+ * @brief Decrypts BDAP ciphertexts addressed to any of several Ed25519 identities.
+ * 
+ * @note The keys of every identity are derived once, locked in memory and wiped by
+ * the destructor. The fingerprints are indexed in a hash table, so that finding the
+ * identity a ciphertext is addressed to costs one pass over its header whatever the
+ * number of identities.
+ */
+class BDAPKeyring
+{
+public:
+    /**
+     * @brief Creates an empty keyring.
+     * 
+     * @param nCapacity The maximum number of identities
+     */
+    explicit BDAPKeyring(const size_t nCapacity);
+    ~BDAPKeyring();
+
+    BDAPKeyring(const BDAPKeyring&) = delete;
+    BDAPKeyring& operator=(const BDAPKeyring&) = delete;
+
+    /**
+     * @brief Derives the decryption keys of an identity and adds them to the keyring.
+     * 
+     * @param vchPrivKeySeed The Ed25519 private-key seed, 32 bytes
+     * @param strErrorMessage The string containing error-message in the event of failure
+     * @return true on success
+     * @return false on failure
+     */
+    bool AddKey(const CharVector& vchPrivKeySeed, std::string& strErrorMessage);
+
+    /**
+     * @brief Returns the number of identities in the keyring.
+     */
+    size_t Size() const;
+
+    /**
+     * @brief Decrypts a piece of BDAP encrypted ciphertext with whichever identity
+     * it is addressed to.
+     * 
+     * @param vchCipherText The input BDAP ciphertext
+     * @param vchData The decrypted output
+     * @param nIdentity The position of the identity in the order of AddKey, or Size()
+     *                  if none is a recipient
+     * @param strErrorMessage The string containing error-message in the event of failure
+     * @return true on success
+     * @return false on failure
+     */
+    bool Decrypt(const CharVector& vchCipherText,
+                 CharVector& vchData,
+                 size_t& nIdentity,
+                 std::string& strErrorMessage) const;
+
+private:
+    std::vector<bdap_decrypt_key> vKeys;
+    std::vector<uint32_t> vIndex;
+    bdap_keyring keyring;
+};
 
 #endif // _ENCRYPTION_H
@@ -7,11 +7,93 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "ed25519.h"
+#include "curve25519.h"
+#include "aes256gcm.h"
+#include "thread.h"
+
+#define BDAP_FINGERPRINT_SIZE   7
+#define BDAP_BATCH_SIZE         32
+#define BDAP_PARALLEL_GCM_THRESHOLD (1024 * 1024)
+
+#define BDAP_V2_PREAMBLE_SIZE       4
+#define BDAP_V2_SEGMENT_SIZE        (64 * 1024)
+#define BDAP_V2_MIN_SEGMENT_SIZE    1024
+#define BDAP_V2_MAX_SEGMENT_SIZE    (16 * 1024 * 1024)
+
+#define BDAP_KEYRING_INDEX_SIZE(capacity) (2 * (capacity))
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief A BDAP recipient prepared for encryption, i.e. the
+ * fingerprint and the Curve25519 public-key derived from the
+ * recipient's Ed25519 public-key.
+ */
+typedef struct
+{
+    uint8_t fingerprint[BDAP_FINGERPRINT_SIZE];
+    uint8_t curve25519_pk[CURVE25519_PUBLIC_KEY_SIZE];
+} bdap_recipient;
+
+/**
+ * @brief A set of prepared BDAP recipients.
+ * 
+ * @note Validating and converting an Ed25519 public-key costs a
+ * point decompression, a subgroup check and a field inversion.
+ * A set that receives many messages should be prepared once with
+ * bdap_recipient_set_init(bdap_recipient_set*, bdap_recipient*,
+ * const uint16_t, const uint8_t**, const char**).
+ */
+typedef struct
+{
+    const bdap_recipient *recipients;
+    uint16_t num_recipients;
+} bdap_recipient_set;
+
+/**
+ * @brief BDAP decryption key, the keys derived from an Ed25519
+ * private-key seed that are needed to decrypt a ciphertext.
+ * 
+ * @note Deriving these keys costs a SHA-512 hash, an Ed25519
+ * scalar multiplication, another SHA-512 hash and a Curve25519
+ * scalar multiplication. A long-lived identity should derive them
+ * once with bdap_decrypt_key_init(bdap_decrypt_key*, const uint8_t*,
+ * const char**) and reuse them for every ciphertext.
+ */
+typedef struct
+{
+    uint8_t ed25519_pk[ED25519_PUBLIC_KEY_SIZE];
+    uint8_t curve25519_sk[CURVE25519_PRIVATE_KEY_SIZE];
+    uint8_t curve25519_pk[CURVE25519_PUBLIC_KEY_SIZE];
+    bool locked;
+} bdap_decrypt_key;
+
+/**
+ * @brief A keyring of BDAP decryption keys, with an index of their
+ * fingerprints, to decrypt ciphertexts addressed to any of several
+ * identities.
+ * 
+ * @note The keys and the index are provided by the caller, see
+ * bdap_keyring_init(bdap_keyring*, bdap_decrypt_key*, uint32_t*,
+ * const size_t). The index is an open-addressing hash table of
+ * BDAP_KEYRING_INDEX_SIZE(capacity) entries, each holding one plus
+ * the position of a key, or zero if it is empty. The storage of
+ * the keys is locked in memory as a whole by the first addition and
+ * unlocked by bdap_keyring_wipe(bdap_keyring*).
+ */
+typedef struct
+{
+    bdap_decrypt_key *keys;
+    uint32_t *index;
+    size_t capacity;
+    size_t num_keys;
+    size_t index_size;
+    bool locked;
+} bdap_keyring;
+
 /**
  * @brief Evaluate the validity of a ciphertext 
  * 
@@ -58,6 +140,11 @@ size_t bdap_decrypted_size(const uint8_t *ciphertext,
  * @note The size of the ciphertext can be obtained from
  * bdap_ciphertext_size(const uint16_t, const size_t) function.
  * 
+ * @note The | f_i | c_i | pairs are sorted by fingerprint, which
+ * is flagged by the most significant bit of U, so that decryption
+ * finds the recipient's pair with a binary search. Curve25519
+ * ignores that bit, and headers without it are scanned linearly.
+ * 
  * @note The caller of this method does not need to allocate
  * and deallocate memory for error messages. This method returns
  * a pointer to a pre-defined string. The parameter {@code
@@ -83,6 +170,152 @@ bool bdap_encrypt(uint8_t* ciphertext,
                   const size_t plaintext_size,
                   const char** error_message);
 
+struct bdap_rng;
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a group of recipients, drawing the ephemeral
+ * keypair and the secret from a random number generator context.
+ * 
+ * @note See bdap_encrypt(uint8_t*, const uint16_t, const uint8_t**,
+ * const uint8_t*, const size_t, const char**). Threads that each
+ * own a generator can encrypt concurrently without any lock.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param rng the random number generator, or NULL for
+ *            bdap_randombytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_with_rng(uint8_t* ciphertext,
+                           const uint16_t num_recipients,
+                           const uint8_t** ed25519_public_key,
+                           const uint8_t* plaintext,
+                           const size_t plaintext_size,
+                           const struct bdap_rng* rng,
+                           const char** error_message);
+
+/**
+ * @brief Prepares a set of recipients for repeated encryption.
+ * 
+ * @note The caller provides the storage for {@code num_recipients}
+ * prepared recipients, which must outlive the set.
+ * 
+ * @param set the output recipient set
+ * @param recipients the storage for the prepared recipients
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false if any of the public-keys is invalid
+ */
+bool bdap_recipient_set_init(bdap_recipient_set* set,
+                             bdap_recipient* recipients,
+                             const uint16_t num_recipients,
+                             const uint8_t** ed25519_public_key,
+                             const char** error_message);
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a prepared set of recipients.
+ * 
+ * @note The ciphertext is identical in format to the one
+ * produced by bdap_encrypt(uint8_t*, const uint16_t,
+ * const uint8_t**, const uint8_t*, const size_t, const char**),
+ * its size can be obtained from bdap_ciphertext_size(const
+ * uint16_t, const size_t) function.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param set the prepared recipient set
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_to_set(uint8_t* ciphertext,
+                         const bdap_recipient_set* set,
+                         const uint8_t* plaintext,
+                         const size_t plaintext_size,
+                         const char** error_message);
+
+struct bdap_thread_pool;
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a group of recipients, spreading the recipients
+ * across the threads of a pool.
+ * 
+ * @note The recipients are split in batches whose | f_i | c_i |
+ * pairs have fixed offsets in the ciphertext, the batches are run
+ * on the threads of the pool, see thread_pool.h, or by the calling
+ * thread if it is NULL. The ciphertext is identical in format to
+ * the one produced by bdap_encrypt(uint8_t*, const uint16_t,
+ * const uint8_t**, const uint8_t*, const size_t, const char**).
+ * 
+ * @note The AES-256-GCM payload is also split across the threads
+ * when it is at least bdap_get_parallel_gcm_threshold() bytes.
+ * 
+ * @note If several public-keys are invalid, the error reported is
+ * the one of the first, regardless of the number of threads. On
+ * error the whole ciphertext is wiped.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_parallel(uint8_t* ciphertext,
+                           const uint16_t num_recipients,
+                           const uint8_t** ed25519_public_key,
+                           const uint8_t* plaintext,
+                           const size_t plaintext_size,
+                           struct bdap_thread_pool* pool,
+                           const char** error_message);
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a prepared set of recipients, spreading the
+ * recipients across the threads of a pool.
+ * 
+ * @note See bdap_encrypt_parallel(uint8_t*, const uint16_t,
+ * const uint8_t**, const uint8_t*, const size_t,
+ * struct bdap_thread_pool*, const char**).
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param set the prepared recipient set
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_to_set_parallel(uint8_t* ciphertext,
+                                  const bdap_recipient_set* set,
+                                  const uint8_t* plaintext,
+                                  const size_t plaintext_size,
+                                  struct bdap_thread_pool* pool,
+                                  const char** error_message);
+
 /**
  * @brief Performs BDAP end-to-end decryption on a piece of
  * ciphertext.
@@ -101,6 +334,17 @@ bool bdap_encrypt(uint8_t* ciphertext,
  * error_message} can also be NULL, which means that the caller
  * doesn't want any error messages.
  * 
+ * @note The keys derived from the private-key and the scratch
+ * state are kept in slots of the secure arena, see
+ * crypto_secure_alloc(), so that no memory is locked per call.
+ * The private-key seed is never locked in place: when no slot can
+ * be taken, the decryption fails with
+ * BDAP_MEMORY_PROTECTION_FAILED.
+ * 
+ * @note When decrypting many ciphertexts with the same private-key,
+ * use bdap_decrypt_with_key(uint8_t*, const bdap_decrypt_key*,
+ * const uint8_t*, const size_t, const char**) instead.
+ * 
  * @param plaintext the output plaintext pointer 
  * @param plaintext_size the output plaintext size in bytes
  * @param ed25519_private_key_seed the pointer to the decryption
@@ -118,6 +362,888 @@ bool bdap_decrypt(uint8_t* plaintext,
                   const size_t ciphertext_size,
                   const char** error_message);
 
+/**
+ * @brief Derives a BDAP decryption key from an Ed25519
+ * private-key seed.
+ * 
+ * @note The decryption key is locked in memory until it is
+ * released by bdap_decrypt_key_wipe(bdap_decrypt_key*), which
+ * must be called even if this method fails.
+ * 
+ * @param key the output decryption key
+ * @param ed25519_private_key_seed the pointer to the decryption
+ *                                 private-key seed
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt_key_init(bdap_decrypt_key* key,
+                           const uint8_t* ed25519_private_key_seed,
+                           const char** error_message);
+
+/**
+ * @brief Wipes and unlocks a BDAP decryption key.
+ * 
+ * @param key the decryption key
+ */
+void bdap_decrypt_key_wipe(bdap_decrypt_key* key);
+
+/**
+ * @brief Performs BDAP end-to-end decryption on a piece of
+ * ciphertext using a precomputed decryption key.
+ * 
+ * @note Only a single Curve25519 Diffie-Hellman exchange is
+ * performed per ciphertext, see bdap_decrypt(uint8_t*,
+ * const uint8_t*, const uint8_t*, const size_t, const char**)
+ * for the remaining notes.
+ * 
+ * @param plaintext the output plaintext pointer
+ * @param key the decryption key
+ * @param ciphertext the input ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt_with_key(uint8_t* plaintext,
+                           const bdap_decrypt_key* key,
+                           const uint8_t* ciphertext,
+                           const size_t ciphertext_size,
+                           const char** error_message);
+
+/**
+ * @brief Performs BDAP end-to-end decryption on a piece of
+ * ciphertext using a precomputed decryption key, spreading the
+ * payload across the threads of a pool.
+ * 
+ * @note The AES-256-GCM payload is only split across the threads
+ * when it is at least bdap_get_parallel_gcm_threshold() bytes,
+ * smaller payloads are decrypted by the calling thread.
+ * 
+ * @param plaintext the output plaintext pointer
+ * @param key the decryption key
+ * @param ciphertext the input ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt_with_key_parallel(uint8_t* plaintext,
+                                    const bdap_decrypt_key* key,
+                                    const uint8_t* ciphertext,
+                                    const size_t ciphertext_size,
+                                    struct bdap_thread_pool* pool,
+                                    const char** error_message);
+
+/**
+ * @brief Sets the payload size from which the functions given a
+ * thread pool split AES-256-GCM across its threads.
+ * 
+ * @note The default is BDAP_PARALLEL_GCM_THRESHOLD bytes. The
+ * output does not depend on the threshold.
+ * 
+ * @param threshold the threshold in bytes
+ */
+void bdap_set_parallel_gcm_threshold(const size_t threshold);
+
+/**
+ * @brief Returns the payload size from which AES-256-GCM is split
+ * across the threads of a pool.
+ * 
+ * @return the threshold in bytes
+ */
+size_t bdap_get_parallel_gcm_threshold(void);
+
+/**
+ * @brief Sets whether or not the recipient's pair is looked up in
+ * constant time during decryption.
+ * 
+ * @note By default the pairs of a sorted header are binary searched,
+ * and the pairs of other headers are scanned up to the first match,
+ * see fingerprint.h, so that the time taken depends on the position
+ * of the recipient in the header. In constant time, every pair of
+ * every header is compared and read, and the matching secret is
+ * selected with masks.
+ * 
+ * @param enable whether or not to look up in constant time
+ */
+void bdap_set_constant_time_lookup(const bool enable);
+
+/**
+ * @brief Returns whether or not the recipient's pair is looked up
+ * in constant time during decryption.
+ * 
+ * @return true if the lookup is constant time
+ */
+bool bdap_get_constant_time_lookup(void);
+
+/**
+ * @brief Performs BDAP end-to-end decryption on a batch of
+ * ciphertexts using a precomputed decryption key.
+ * 
+ * @note The ciphertexts are spread across the threads of the
+ * pool, see thread_pool.h, or decrypted by the calling thread
+ * if it is NULL. Each plaintext buffer must hold
+ * bdap_decrypted_size(const uint8_t*, const size_t) bytes.
+ * 
+ * @note The status of each ciphertext is one of the error codes
+ * of encryption_error.h, BDAP_SUCCESS if it was decrypted. The
+ * corresponding message is bdap_error_message[status[i]].
+ * 
+ * @param plaintexts the output plaintext pointers
+ * @param status the output status codes
+ * @param key the decryption key
+ * @param ciphertexts the input ciphertext pointers
+ * @param ciphertext_sizes the ciphertext sizes in bytes
+ * @param num_ciphertexts the number of ciphertexts
+ * @param pool the thread pool, or NULL
+ * @return true if all the ciphertexts were decrypted
+ * @return false otherwise
+ */
+bool bdap_decrypt_batch(uint8_t** plaintexts,
+                        uint16_t* status,
+                        const bdap_decrypt_key* key,
+                        const uint8_t* const* ciphertexts,
+                        const size_t* ciphertext_sizes,
+                        const size_t num_ciphertexts,
+                        struct bdap_thread_pool* pool);
+
+/**
+ * @brief A BDAP streaming encryption context.
+ * 
+ * @note The header is written by bdap_encrypt_stream_init, the
+ * payload is then encrypted chunk by chunk and the 16-byte tag
+ * written last. Concatenated, the outputs form the same ciphertext
+ * as bdap_encrypt(uint8_t*, const uint16_t, const uint8_t**,
+ * const uint8_t*, const size_t, const char**).
+ */
+typedef struct
+{
+    aes256gcm_ctx gcm;
+} bdap_encrypt_stream;
+
+/**
+ * @brief A BDAP streaming decryption context.
+ * 
+ * @note Decryption is two-pass so that no unauthenticated plaintext
+ * is ever released: the payload is first run through
+ * bdap_decrypt_stream_authenticate and the tag checked with
+ * bdap_decrypt_stream_verify, then the payload is read again and
+ * decrypted with bdap_decrypt_stream_update.
+ */
+typedef struct
+{
+    aes256gcm_ctx gcm;
+} bdap_decrypt_stream;
+
+/**
+ * @brief Returns the size of the header of a ciphertext, i.e. the
+ * offset of the payload.
+ * 
+ * @note Only the first two bytes of the ciphertext are read.
+ * 
+ * @param ciphertext the ciphertext
+ * @return the header size in bytes
+ */
+size_t bdap_header_size(const uint8_t* ciphertext);
+
+/**
+ * @brief Starts a streaming encryption for a group of recipients
+ * and writes the header.
+ * 
+ * @param stream the output streaming context
+ * @param header the output header, bdap_ciphertext_size(const
+ *               uint16_t, const size_t) - AES256GCM_TAG_SIZE bytes
+ *               for an empty plaintext
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_stream_init(bdap_encrypt_stream* stream,
+                              uint8_t* header,
+                              const uint16_t num_recipients,
+                              const uint8_t** ed25519_public_key,
+                              const char** error_message);
+
+/**
+ * @brief Starts a streaming encryption for a prepared set of
+ * recipients and writes the header.
+ * 
+ * @param stream the output streaming context
+ * @param header the output header
+ * @param set the prepared recipient set
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_stream_init_to_set(bdap_encrypt_stream* stream,
+                                     uint8_t* header,
+                                     const bdap_recipient_set* set,
+                                     const char** error_message);
+
+/**
+ * @brief Encrypts the next chunk of the plaintext.
+ * 
+ * @param stream the streaming context
+ * @param ciphertext the output ciphertext chunk, plaintext_size bytes
+ * @param plaintext the input plaintext chunk
+ * @param plaintext_size the chunk size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false if the payload would exceed AES256GCM_MAX_MSG_SIZE
+ *         bytes
+ */
+bool bdap_encrypt_stream_update(bdap_encrypt_stream* stream,
+                                uint8_t* ciphertext,
+                                const uint8_t* plaintext,
+                                const size_t plaintext_size,
+                                const char** error_message);
+
+/**
+ * @brief Completes a streaming encryption, writes the tag and
+ * wipes the context.
+ * 
+ * @param stream the streaming context
+ * @param tag the output tag, AES256GCM_TAG_SIZE bytes
+ */
+void bdap_encrypt_stream_final(bdap_encrypt_stream* stream,
+                               uint8_t* tag);
+
+/**
+ * @brief Starts a streaming decryption from the header of a
+ * ciphertext.
+ * 
+ * @param stream the output streaming context
+ * @param key the decryption key
+ * @param header the header of the ciphertext,
+ *               bdap_header_size(const uint8_t*) bytes
+ * @param ciphertext_size the size of the whole ciphertext in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt_stream_init(bdap_decrypt_stream* stream,
+                              const bdap_decrypt_key* key,
+                              const uint8_t* header,
+                              const size_t ciphertext_size,
+                              const char** error_message);
+
+/**
+ * @brief Authenticates the next chunk of the payload, tag excluded,
+ * during the first pass.
+ * 
+ * @param stream the streaming context
+ * @param ciphertext the input payload chunk
+ * @param ciphertext_size the chunk size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false if the payload would exceed AES256GCM_MAX_MSG_SIZE
+ *         bytes
+ */
+bool bdap_decrypt_stream_authenticate(bdap_decrypt_stream* stream,
+                                      const uint8_t* ciphertext,
+                                      const size_t ciphertext_size,
+                                      const char** error_message);
+
+/**
+ * @brief Completes the first pass by checking the tag.
+ * 
+ * @param stream the streaming context
+ * @param tag the input tag, AES256GCM_TAG_SIZE bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true if the payload is authentic
+ * @return false otherwise
+ */
+bool bdap_decrypt_stream_verify(bdap_decrypt_stream* stream,
+                                const uint8_t* tag,
+                                const char** error_message);
+
+/**
+ * @brief Decrypts the next chunk of the payload during the second
+ * pass.
+ * 
+ * @param stream the streaming context
+ * @param plaintext the output plaintext chunk, ciphertext_size bytes
+ * @param ciphertext the input payload chunk
+ * @param ciphertext_size the chunk size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false if the tag has not been verified
+ */
+bool bdap_decrypt_stream_update(bdap_decrypt_stream* stream,
+                                uint8_t* plaintext,
+                                const uint8_t* ciphertext,
+                                const size_t ciphertext_size,
+                                const char** error_message);
+
+/**
+ * @brief Wipes a streaming decryption context.
+ * 
+ * @param stream the streaming context
+ */
+void bdap_decrypt_stream_wipe(bdap_decrypt_stream* stream);
+
+/**
+ * @brief Computes the size in bytes of a v2 ciphertext for a
+ * given number of recipients, plaintext size and segment size.
+ * 
+ * @note The v2 layout is
+ *   00 00 | 02 | log2(S) | N | U | f_i | c_i | ... | P_0 | T_0 | ...
+ * where the recipient header is the one of the v1 layout, and the
+ * payload is split into segments P_j of S bytes, the last one being
+ * shorter unless the plaintext size is a multiple of S. An empty
+ * plaintext is a single empty segment. The two zero bytes cannot
+ * start a v1 ciphertext, whose number of recipients is positive.
+ * 
+ * @param num_recipients the number of recipients
+ * @param plaintext_size the plaintext size in bytes
+ * @param segment_size the segment size in bytes
+ * @return BDAP v2 ciphertext size
+ */
+size_t bdap_ciphertext_size_v2(const uint16_t num_recipients,
+                               const size_t plaintext_size,
+                               const size_t segment_size);
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a group of recipients, using the segmented v2
+ * layout.
+ * 
+ * @note Each segment is encrypted with AES-256-GCM under the key
+ * derived from the secret s, and a nonce made of the first 7 bytes
+ * of the derived nonce, the 32-bit big-endian segment index and a
+ * byte set to 1 for the last segment only, 0 otherwise. The first
+ * four bytes of the ciphertext are the AAD of every segment.
+ * Dropping, reordering or truncating segments is thus detected,
+ * while every segment can be authenticated and decrypted alone,
+ * see bdap_decrypt_range(uint8_t*, const bdap_decrypt_key*,
+ * const uint8_t*, const size_t, const size_t, const size_t,
+ * struct bdap_thread_pool*, const char**).
+ * 
+ * @note The size of the ciphertext can be obtained from
+ * bdap_ciphertext_size_v2(const uint16_t, const size_t,
+ * const size_t) function. bdap_decrypt and the functions based
+ * on it accept both layouts, the streaming functions only v1.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param segment_size the segment size in bytes, a power of two
+ *                     between BDAP_V2_MIN_SEGMENT_SIZE and
+ *                     BDAP_V2_MAX_SEGMENT_SIZE
+ * @param pool the thread pool the recipients and the segments are
+ *             spread across, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_v2(uint8_t* ciphertext,
+                     const uint16_t num_recipients,
+                     const uint8_t** ed25519_public_key,
+                     const uint8_t* plaintext,
+                     const size_t plaintext_size,
+                     const size_t segment_size,
+                     struct bdap_thread_pool* pool,
+                     const char** error_message);
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a prepared set of recipients, using the segmented
+ * v2 layout.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param set the prepared recipient set
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param segment_size the segment size in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_to_set_v2(uint8_t* ciphertext,
+                            const bdap_recipient_set* set,
+                            const uint8_t* plaintext,
+                            const size_t plaintext_size,
+                            const size_t segment_size,
+                            struct bdap_thread_pool* pool,
+                            const char** error_message);
+
+/**
+ * @brief Decrypts the bytes [offset, offset + length) of the
+ * plaintext of a v2 ciphertext.
+ * 
+ * @note Only the segments overlapping the range are decrypted, each
+ * one on its own, spread across the threads of the pool if any. The
+ * last segment is always authenticated as well, so that a truncated
+ * ciphertext is rejected even for ranges, empty ones included, that
+ * lie before the cut. Nothing is released unless all of them are
+ * authentic: on failure the output is wiped.
+ * 
+ * @param plaintext the output plaintext pointer, length bytes
+ * @param key the decryption key
+ * @param ciphertext the input v2 ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param offset the offset of the range in the plaintext
+ * @param length the length of the range in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt_range(uint8_t* plaintext,
+                        const bdap_decrypt_key* key,
+                        const uint8_t* ciphertext,
+                        const size_t ciphertext_size,
+                        const size_t offset,
+                        const size_t length,
+                        struct bdap_thread_pool* pool,
+                        const char** error_message);
+
+/**
+ * @brief Initialises an empty keyring over caller-provided storage.
+ * 
+ * @param keyring the keyring
+ * @param keys the storage of the keys, capacity entries
+ * @param index the storage of the index,
+ *              BDAP_KEYRING_INDEX_SIZE(capacity) entries
+ * @param capacity the maximum number of keys, below UINT32_MAX
+ */
+void bdap_keyring_init(bdap_keyring* keyring,
+                       bdap_decrypt_key* keys,
+                       uint32_t* index,
+                       const size_t capacity);
+
+/**
+ * @brief Derives the decryption key of an identity and adds it to
+ * a keyring, at position keyring->num_keys.
+ * 
+ * @param keyring the keyring
+ * @param ed25519_private_key_seed the Ed25519 private-key seed
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_keyring_add(bdap_keyring* keyring,
+                      const uint8_t* ed25519_private_key_seed,
+                      const char** error_message);
+
+/**
+ * @brief Decrypts a v1 or v2 ciphertext with whichever key of a
+ * keyring it is addressed to.
+ * 
+ * @note The fingerprints of the header are looked up in the index
+ * in a single pass, so that the cost does not grow with the number
+ * of keys, and only the matching identity performs a Curve25519
+ * Diffie-Hellman exchange. The lookup leaks which pair matched, as
+ * the non constant-time lookup of bdap_decrypt_with_key(uint8_t*,
+ * const bdap_decrypt_key*, const uint8_t*, const size_t,
+ * const char**) does.
+ * 
+ * @param plaintext the output plaintext pointer
+ * @param identity the position of the key that was used, or
+ *                 keyring->num_keys if none matches. May be NULL
+ * @param keyring the keyring
+ * @param ciphertext the input ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_keyring_decrypt(uint8_t* plaintext,
+                          size_t* identity,
+                          const bdap_keyring* keyring,
+                          const uint8_t* ciphertext,
+                          const size_t ciphertext_size,
+                          const char** error_message);
+
+/**
+ * @brief Wipes and unlocks the keys of a keyring and empties it.
+ * 
+ * @param keyring the keyring
+ */
+void bdap_keyring_wipe(bdap_keyring* keyring);
+
+/**
+ * @brief A view of the header of a v1 or v2 ciphertext, parsed in
+ * place: the pointers refer to the caller's buffer, which must
+ * outlive the view.
+ * 
+ * @note Bit 255 of the ephemeral public-key U flags a header whose
+ * pairs are sorted by fingerprint, see sorted.
+ */
+typedef struct
+{
+    const uint8_t *ciphertext;
+    uint8_t version;
+    uint16_t num_recipients;
+    const uint8_t *ephemeral_public_key;
+    const uint8_t *slots;
+    bool sorted;
+    size_t payload_offset;
+    size_t payload_size;
+} bdap_header_view;
+
+/**
+ * @brief Parses the header of a ciphertext in place.
+ * 
+ * @note The whole ciphertext is validated, as by
+ * bdap_validate_ciphertext(const uint8_t*, const size_t,
+ * const char**), but no cryptography is performed.
+ * 
+ * @param view the output view
+ * @param ciphertext the ciphertext
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_header_view_init(bdap_header_view* view,
+                           const uint8_t* ciphertext,
+                           const size_t ciphertext_size,
+                           const char** error_message);
+
+/**
+ * @brief Returns the fingerprint of a recipient of a header.
+ * 
+ * @param view the header view
+ * @param index the position of the recipient's pair
+ * @return the fingerprint, BDAP_FINGERPRINT_SIZE bytes, or NULL if
+ * index is not below view->num_recipients
+ */
+const uint8_t* bdap_header_view_fingerprint(const bdap_header_view* view,
+                                            const uint16_t index);
+
+/**
+ * @brief Checks whether or not a header lists a fingerprint, i.e.
+ * whether a ciphertext may be addressed to an identity, without
+ * any cryptography.
+ * 
+ * @note The fingerprint is the first BDAP_FINGERPRINT_SIZE bytes
+ * of the Ed25519 public-key, which may be passed as is. Sorted
+ * headers are binary searched, others are scanned.
+ * 
+ * @param view the header view
+ * @param fingerprint the fingerprint
+ * @return true if a pair has that fingerprint
+ * @return false otherwise
+ */
+bool bdap_has_recipient(const bdap_header_view* view,
+                        const uint8_t* fingerprint);
+
+/**
+ * @brief A sealed message, what the sender of a ciphertext keeps to
+ * add recipients to it later: the ephemeral keypair and the secret
+ * s that the payload key is derived from.
+ * 
+ * @note Whoever holds it can read the payload, it is locked in
+ * memory and must be released by bdap_sealed_message_wipe(
+ * bdap_sealed_message*).
+ */
+typedef struct
+{
+    uint8_t ephemeral_pk[CURVE25519_PUBLIC_KEY_SIZE];
+    uint8_t ephemeral_sk[CURVE25519_PRIVATE_KEY_SIZE];
+    uint8_t secret[32];
+    bool locked;
+} bdap_sealed_message;
+
+/**
+ * @brief Performs BDAP end-to-end encryption like bdap_encrypt(
+ * uint8_t*, const uint16_t, const uint8_t**, const uint8_t*,
+ * const size_t, const char**), and keeps a sealed message to add
+ * recipients to the ciphertext later.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param sealed the output sealed message
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_sealed(uint8_t* ciphertext,
+                         bdap_sealed_message* sealed,
+                         const uint16_t num_recipients,
+                         const uint8_t** ed25519_public_key,
+                         const uint8_t* plaintext,
+                         const size_t plaintext_size,
+                         const char** error_message);
+
+/**
+ * @brief Performs BDAP end-to-end encryption with the v2 layout
+ * like bdap_encrypt_v2(uint8_t*, const uint16_t, const uint8_t**,
+ * const uint8_t*, const size_t, const size_t,
+ * struct bdap_thread_pool*, const char**), and keeps a sealed
+ * message to add recipients to the ciphertext later.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param sealed the output sealed message
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param segment_size the segment size in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_v2_sealed(uint8_t* ciphertext,
+                            bdap_sealed_message* sealed,
+                            const uint16_t num_recipients,
+                            const uint8_t** ed25519_public_key,
+                            const uint8_t* plaintext,
+                            const size_t plaintext_size,
+                            const size_t segment_size,
+                            struct bdap_thread_pool* pool,
+                            const char** error_message);
+
+/**
+ * @brief Wipes and unlocks a sealed message.
+ * 
+ * @param sealed the sealed message
+ */
+void bdap_sealed_message_wipe(bdap_sealed_message* sealed);
+
+/**
+ * @brief Returns the size of the header written by
+ * bdap_add_recipients(uint8_t*, const bdap_sealed_message*,
+ * const bdap_header_view*, const uint16_t, const uint8_t**,
+ * const char**).
+ * 
+ * @param view the view of the header of the ciphertext
+ * @param num_recipients the number of recipients to add
+ * @return the header size in bytes
+ */
+size_t bdap_added_header_size(const bdap_header_view* view,
+                              const uint16_t num_recipients);
+
+/**
+ * @brief Writes the header of a ciphertext with more recipients:
+ * the ciphertext addressed to them as well is the new header
+ * followed by the payload of the original, unchanged, i.e. its
+ * view->payload_size bytes at view->payload_offset.
+ * 
+ * @note Only the new recipients cost Diffie-Hellman exchanges, the
+ * existing pairs are copied and merged with the new ones so that
+ * a sorted header stays sorted. The payload is neither read nor
+ * re-encrypted.
+ * 
+ * @note The header must not overlap the ciphertext of the view.
+ * 
+ * @param header the output header pointer, see
+ *               bdap_added_header_size(const bdap_header_view*,
+ *               const uint16_t)
+ * @param sealed the sealed message kept when encrypting
+ * @param view the view of the header of the ciphertext
+ * @param num_recipients the number of recipients to add
+ * @param ed25519_public_key the pointer to an array of the added
+ *                           recipient's public-keys
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_add_recipients(uint8_t* header,
+                         const bdap_sealed_message* sealed,
+                         const bdap_header_view* view,
+                         const uint16_t num_recipients,
+                         const uint8_t** ed25519_public_key,
+                         const char** error_message);
+
+struct bdap_header_producer;
+
+/**
+ * @brief A bounded pool of ready-made BDAP headers for a prepared
+ * set of recipients, refilled in the background by a header
+ * producer.
+ * 
+ * @note Everything in a header but the payload is independent of
+ * the message: the ephemeral keypair, the secret s, the pairs and
+ * the payload key and nonce. A pooled header moves the ephemeral
+ * keypair and the Diffie-Hellman exchanges off the request path.
+ * 
+ * @note The entries, i.e. each payload key and nonce followed by
+ * its header, live in caller-provided storage, which is locked in
+ * memory. An entry is wiped as soon as it is taken, so that every
+ * header encrypts exactly one message.
+ */
+typedef struct bdap_header_pool
+{
+    const bdap_recipient_set *set;
+    uint8_t *storage;
+    size_t capacity;
+    size_t entry_size;
+    size_t head;
+    size_t count;
+    uint16_t error_code;
+    bool locked;
+    struct bdap_header_producer *producer;
+    struct bdap_header_pool *next;
+} bdap_header_pool;
+
+/**
+ * @brief A background thread that keeps the header pools registered
+ * to it filled, the emptiest one first.
+ * 
+ * @note The producer draws the secrets of the headers from its own
+ * thread, with its random number generator context if it has one
+ * and with bdap_randombytes(uint8_t*, size_t) otherwise.
+ */
+typedef struct bdap_header_producer
+{
+    bdap_thread thread;
+    bdap_mutex lock;
+    bdap_cond wake;
+    bdap_cond idle;
+    bdap_header_pool *pools;
+    bdap_header_pool *current;
+    const struct bdap_rng *rng;
+    bool shutdown;
+} bdap_header_producer;
+
+/**
+ * @brief Initialises a header producer and starts its thread.
+ * 
+ * @param producer the header producer
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_header_producer_init(bdap_header_producer* producer);
+
+/**
+ * @brief Initialises a header producer with a random number
+ * generator context and starts its thread.
+ * 
+ * @note The generator is used by the producer's thread only, it
+ * must outlive the producer.
+ * 
+ * @param producer the header producer
+ * @param rng the random number generator, or NULL
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_header_producer_init_with_rng(bdap_header_producer* producer,
+                                        const struct bdap_rng* rng);
+
+/**
+ * @brief Stops the thread of a header producer, wipes the pools
+ * still registered to it and releases its resources.
+ * 
+ * @param producer the header producer
+ */
+void bdap_header_producer_destroy(bdap_header_producer* producer);
+
+/**
+ * @brief Returns the size of the storage of a header pool.
+ * 
+ * @param num_recipients the number of recipients of the set
+ * @param capacity the maximum number of ready headers
+ * @return the storage size in bytes
+ */
+size_t bdap_header_pool_storage_size(const uint16_t num_recipients,
+                                     const size_t capacity);
+
+/**
+ * @brief Initialises a header pool for a prepared set of
+ * recipients, locks its storage in memory and registers it to a
+ * header producer, which starts filling it.
+ * 
+ * @note The set and the storage must outlive the pool, which must
+ * be released by bdap_header_pool_wipe(bdap_header_pool*) even if
+ * this method fails. The storage need not be page-aligned: the
+ * wipe leaves locked whatever else is locked on its first and last
+ * pages.
+ * 
+ * @param pool the header pool
+ * @param producer the header producer
+ * @param set the prepared set of recipients
+ * @param storage the storage, see bdap_header_pool_storage_size(
+ *                const uint16_t, const size_t)
+ * @param capacity the maximum number of ready headers, at least 1
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_header_pool_init(bdap_header_pool* pool,
+                           bdap_header_producer* producer,
+                           const bdap_recipient_set* set,
+                           uint8_t* storage,
+                           const size_t capacity,
+                           const char** error_message);
+
+/**
+ * @brief Returns the number of ready headers of a pool.
+ * 
+ * @param pool the header pool
+ * @return the number of ready headers
+ */
+size_t bdap_header_pool_available(bdap_header_pool* pool);
+
+/**
+ * @brief Unregisters a header pool from its producer, then wipes
+ * and unlocks its storage.
+ * 
+ * @param pool the header pool
+ */
+void bdap_header_pool_wipe(bdap_header_pool* pool);
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for the set of recipients of a header pool.
+ * 
+ * @note A ready header is taken from the pool, so that only the
+ * payload is encrypted on the caller's thread. If the pool is
+ * empty, the header is computed as by bdap_encrypt_to_set(
+ * uint8_t*, const bdap_recipient_set*, const uint8_t*,
+ * const size_t, const char**), whose ciphertext size applies.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param pool the header pool
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_with_pool(uint8_t* ciphertext,
+                            bdap_header_pool* pool,
+                            const uint8_t* plaintext,
+                            const size_t plaintext_size,
+                            const char** error_message);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,14 @@
 #define BDAP_NO_VALID_RECIPIENT                     12
 #define BDAP_MEMORY_PROTECTION_FAILED               13
 #define BDAP_INVALID_CIPHERTEXT                     14
+#define BDAP_STREAM_IO_FAILED                       15
+#define BDAP_INVALID_SEGMENT_SIZE                   16
+#define BDAP_INVALID_RANGE                          17
+#define BDAP_KEYRING_FULL                           18
+#define BDAP_SEALED_MESSAGE_MISMATCH                19
+#define BDAP_TOO_MANY_RECIPIENTS                    20
+#define BDAP_INVALID_HEADER_POOL                    21
+#define BDAP_MESSAGE_TOO_LONG                       22
 
 #ifdef __cplusplus
 extern "C" {
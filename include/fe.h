@@ -6,11 +6,32 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief On 64-bit targets with 128-bit integer support the radix-2^51
+ * representation is used, unless FE_USE_25_5 is defined.
+ */
+#if defined(__SIZEOF_INT128__) && !defined(FE_USE_25_5)
+#define FE_51
+#endif
+
+#ifdef FE_51
+/**
+ * @brief fe represents a field element in the field of Z(2^255-19).
+ * 
+ * A field element h is represented as an array of five 64-bit unsigned
+ * integers { h[0], h[1], ..., h[4] } where
+ * h[0] + 2^51 h[1] + 2^102 h[2] + 2^153 h[3] + 2^204 h[4].
+ * 
+ * Reference: SUPERCOP amd64-51-30k implementation of ed25519
+ */
+typedef uint64_t fe[5];
+#else
 /**
  * @brief fe represents a field element in the field of Z(2^255-19).
  * 
@@ -21,6 +42,7 @@ extern "C" {
  * Reference: SUPERCOP reference implementation of x25519
  */
 typedef int32_t fe[10];
+#endif
 
 /**
  * @brief Zeros a field element h.
@@ -134,6 +156,21 @@ void fe_pow_2e252m3(fe x, const fe z);
  */
 void fe_inv(fe x, const fe z);
 
+/**
+ * @brief Inverts {@code n} field elements with a single inversion
+ * (Montgomery's trick).
+ * 
+ * @note Costs one fe_inv(fe, const fe) plus 3(n - 1) multiplications.
+ * Zero elements are mapped to zero, as with fe_inv(fe, const fe),
+ * without affecting the other elements. The arrays x and z must
+ * not overlap.
+ * 
+ * @param x The output of inversion, n field elements
+ * @param z The field elements to be inverted, n field elements
+ * @param n The number of field elements
+ */
+void fe_batch_inv(fe *x, const fe *z, size_t n);
+
 /**
  * @brief Negate a field element v.
  * 
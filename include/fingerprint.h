@@ -0,0 +1,69 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#ifndef _FINGERPRINT_H
+#define _FINGERPRINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FINGERPRINT_MIN_STRIDE      8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Enables or disables the SIMD fingerprint scanners.
+ *
+ * @note The scanners are enabled by default, AVX2 is used if the
+ * CPU supports it, SSE2 otherwise on x86-64. Disabling them forces
+ * the portable 64-bit scanner, which is mainly useful for testing.
+ *
+ * @param enable Whether or not to use the SIMD scanners
+ * @return true if a SIMD scanner will be used
+ * @return false otherwise
+ */
+bool fingerprint_use_hardware(bool enable);
+
+/**
+ * @brief Checks whether or not a SIMD fingerprint scanner is in use.
+ *
+ * @return true if a SIMD scanner is in use
+ * @return false otherwise
+ */
+bool fingerprint_hardware_enabled(void);
+
+/**
+ * @brief Finds the first slot starting with a 7-byte fingerprint in
+ * a table of slots laid out {@code stride} bytes apart.
+ *
+ * @note Eight bytes are loaded from the start of every slot, hence
+ * the stride must be at least FINGERPRINT_MIN_STRIDE bytes. Several
+ * slots are compared per iteration.
+ *
+ * @note In constant time, every slot is compared and the first
+ * match is selected without branches, so that the running time and
+ * the memory accesses only depend on the number of slots.
+ * Otherwise the scan stops at the first match.
+ *
+ * @param slots The table of slots
+ * @param num_slots The number of slots
+ * @param stride The distance between two slots in bytes
+ * @param fingerprint The fingerprint, 7 bytes
+ * @param constant_time Whether or not to scan every slot
+ * @return the index of the first matching slot, or num_slots if
+ * there is none
+ */
+size_t fingerprint_find(const uint8_t *slots,
+                        size_t num_slots,
+                        size_t stride,
+                        const uint8_t *fingerprint,
+                        bool constant_time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
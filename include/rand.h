@@ -15,8 +15,8 @@ extern "C" {
  * @brief A function pointer for initialising a random number generator.
  * 
  * @note By default, this function pointer points to
- * os_randominit(const uint8_t, size_t) method, but it can be
- * overwritten with use_shake256_rand() method.
+ * drbg_randominit(const uint8_t, size_t) method, but it can be
+ * overwritten with use_shake256_rand() or use_os_rand() methods.
  *
  * @param seed the pointer to the seed
  * @param seed_size the size of the seed in bytes
@@ -28,14 +28,54 @@ extern void (*bdap_randominit) (const uint8_t* seed, size_t seed_size);
  * {@code buf_size} bytes.
  * 
  * @note By default, this function pointer points to
- * os_randombytes(uint8_t, size_t) method, but it can be overwritten
- * with use_shake256_rand() method.
+ * drbg_randombytes(uint8_t, size_t) method, a per-thread generator
+ * seeded from the OS, but it can be overwritten with
+ * use_shake256_rand() or use_os_rand() methods.
+ * 
+ * @note The pointer and the state of the SHAKE256-based generator
+ * are shared by the whole process, threads that need their own
+ * generator should use a bdap_rng instead.
  * 
  * @param buf The pointer to the generated random block
  * @param buf_size The length of the random block in bytes
  */
 extern void (*bdap_randombytes)(uint8_t *buf, size_t buf_size);
 
+/**
+ * @brief A callback generating a random block of {@code buf_size}
+ * bytes from the state pointed to by {@code ctx}.
+ * 
+ * @param ctx The user pointer of the generator
+ * @param buf The pointer to the generated random block
+ * @param buf_size The length of the random block in bytes
+ */
+typedef void (*bdap_rng_func)(void *ctx, uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief A random number generator context, i.e. a callback and
+ * its user pointer.
+ * 
+ * @note Unlike the function pointers above, a context is not
+ * shared by the whole process: a thread that owns its generator
+ * draws from it without any lock. The methods taking a context
+ * fall back to bdap_randombytes when it is NULL.
+ */
+typedef struct bdap_rng
+{
+    bdap_rng_func randombytes;
+    void *ctx;
+} bdap_rng;
+
+/**
+ * @brief Generates a random block of {@code buf_size} bytes with
+ * a random number generator context.
+ * 
+ * @param rng The generator, or NULL for bdap_randombytes
+ * @param buf The pointer to the generated random block
+ * @param buf_size The length of the random block in bytes
+ */
+void bdap_rng_randombytes(const bdap_rng *rng, uint8_t *buf, size_t buf_size);
+
 /**
  * @brief Sets up the function pointers above to use SHAKE256-based
  * random number generator.
@@ -52,6 +92,12 @@ void use_shake256_rand();
  */
 void use_os_rand();
 
+/**
+ * @brief Sets up the function pointers above to use the buffered
+ * per-thread random number generator, the default.
+ */
+void use_drbg_rand();
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,6 +6,13 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief The rate of SHAKE-256, i.e. the number of bytes absorbed
+ * or squeezed per Keccak-f[1600] permutation.
+ */
+#define SHAKE256_RATE       136
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,6 +32,72 @@ int32_t shake256(uint8_t* out,
                  const uint8_t *in,
                  size_t in_len);
 
+/**
+ * @brief The state of an incremental SHAKE-256 computation, so that
+ * an input made of several pieces needs no concatenation buffer.
+ * 
+ * @note The state is absorbed into with shake256_absorb, then
+ * finalized once with shake256_finalize and squeezed from with
+ * shake256_squeeze, any number of times each. Absorbing pieces and
+ * squeezing pieces gives the same output as shake256 on the whole.
+ * 
+ * @note The state holds a function of the input, it should be wiped
+ * with shake256_wipe when the input is secret.
+ */
+typedef struct
+{
+    uint64_t lanes[25];
+    size_t offset;
+    bool squeezing;
+} shake256_ctx;
+
+/**
+ * @brief Initialises an incremental SHAKE-256 computation.
+ * 
+ * @param ctx the state
+ */
+void shake256_init(shake256_ctx* ctx);
+
+/**
+ * @brief Absorbs a piece of input.
+ * 
+ * @param ctx the state
+ * @param in the input buffer
+ * @param in_len the length of input buffer in bytes
+ * @return 0 on success, non-zero if the state is already finalized
+ */
+int32_t shake256_absorb(shake256_ctx* ctx,
+                        const uint8_t* in,
+                        size_t in_len);
+
+/**
+ * @brief Pads the input absorbed so far, after which the state can
+ * only be squeezed from.
+ * 
+ * @param ctx the state
+ * @return 0 on success, non-zero if the state is already finalized
+ */
+int32_t shake256_finalize(shake256_ctx* ctx);
+
+/**
+ * @brief Squeezes the next {@code out_len} bytes of output.
+ * 
+ * @param ctx the state
+ * @param out the output buffer
+ * @param out_len the expected output length in bytes
+ * @return 0 on success, non-zero if the state is not finalized
+ */
+int32_t shake256_squeeze(shake256_ctx* ctx,
+                         uint8_t* out,
+                         size_t out_len);
+
+/**
+ * @brief Wipes the state of an incremental SHAKE-256 computation.
+ * 
+ * @param ctx the state
+ */
+void shake256_wipe(shake256_ctx* ctx);
+
 #ifdef __cplusplus
 }
 #endif
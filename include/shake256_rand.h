@@ -7,12 +7,61 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#define SHAKE256_RNG_BUFFER_SIZE    4096
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief Initialises the SHAKE256-based random number generator.
+ * @brief The state of a SHAKE256-based random number generator,
+ * i.e. a block of output of which the last {@code bytes_available}
+ * bytes have not been handed out yet.
+ * 
+ * @note A state must not be used by several threads at once, each
+ * thread can own one without any lock, see bdap_rng.
+ */
+typedef struct
+{
+    uint8_t buffer[SHAKE256_RNG_BUFFER_SIZE];
+    size_t bytes_available;
+} shake256_rng;
+
+/**
+ * @brief Initialises a SHAKE256-based random number generator.
+ * 
+ * @param rng the generator
+ * @param seed the pointer to the seed
+ * @param seed_size the size of the seed in bytes
+ */
+void shake256_rng_init(shake256_rng* rng,
+                       const uint8_t* seed,
+                       size_t seed_size);
+
+/**
+ * @brief Randomly generates a block of {@code buf_size} bytes with
+ * a SHAKE256-based random number generator.
+ * 
+ * @note The signature is the one of bdap_rng_func, so that a
+ * bdap_rng can point at the generator.
+ * 
+ * @param ctx the generator, a shake256_rng
+ * @param buf The pointer to the generated random block
+ * @param buf_size The length of the random block in bytes
+ */
+void shake256_rng_randombytes(void* ctx, uint8_t* buf, size_t buf_size);
+
+/**
+ * @brief Wipes the state of a SHAKE256-based random number
+ * generator.
+ * 
+ * @param rng the generator
+ */
+void shake256_rng_wipe(shake256_rng* rng);
+
+/**
+ * @brief Initialises the process-global SHAKE256-based random
+ * number generator.
  * 
  * @param seed the pointer to the seed
  * @param seed_size the size of the seed in bytes
@@ -0,0 +1,152 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#ifndef _THREAD_H
+#define _THREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief The entry point of a thread.
+ */
+typedef void (*bdap_thread_func)(void *arg);
+
+/**
+ * @brief A thread of execution.
+ *
+ * @note The structure is passed to the new thread, it must stay
+ * valid until bdap_thread_join(bdap_thread*) returns.
+ */
+typedef struct
+{
+#if defined(_WIN32)
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    bdap_thread_func func;
+    void *arg;
+} bdap_thread;
+
+#if defined(_WIN32)
+typedef CRITICAL_SECTION bdap_mutex;
+typedef CONDITION_VARIABLE bdap_cond;
+#else
+typedef pthread_mutex_t bdap_mutex;
+typedef pthread_cond_t bdap_cond;
+#endif
+
+/**
+ * @brief Starts a new thread running func(arg).
+ *
+ * @param thread The thread
+ * @param func The entry point
+ * @param arg The argument passed to the entry point
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_thread_create(bdap_thread *thread, bdap_thread_func func, void *arg);
+
+/**
+ * @brief Waits for a thread to terminate.
+ *
+ * @param thread The thread
+ */
+void bdap_thread_join(bdap_thread *thread);
+
+/**
+ * @brief Initialises a mutex.
+ *
+ * @param mutex The mutex
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_mutex_init(bdap_mutex *mutex);
+
+/**
+ * @brief Destroys a mutex, which must not be locked.
+ *
+ * @param mutex The mutex
+ */
+void bdap_mutex_destroy(bdap_mutex *mutex);
+
+/**
+ * @brief Locks a mutex.
+ *
+ * @param mutex The mutex
+ */
+void bdap_mutex_lock(bdap_mutex *mutex);
+
+/**
+ * @brief Unlocks a mutex.
+ *
+ * @param mutex The mutex
+ */
+void bdap_mutex_unlock(bdap_mutex *mutex);
+
+/**
+ * @brief Initialises a condition variable.
+ *
+ * @param cond The condition variable
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_cond_init(bdap_cond *cond);
+
+/**
+ * @brief Destroys a condition variable, which must not be
+ * waited upon.
+ *
+ * @param cond The condition variable
+ */
+void bdap_cond_destroy(bdap_cond *cond);
+
+/**
+ * @brief Atomically unlocks the mutex and waits for the condition
+ * variable to be signalled, the mutex is locked again on return.
+ *
+ * @note Spurious wake-ups may occur, the caller must re-check
+ * its predicate.
+ *
+ * @param cond The condition variable
+ * @param mutex The mutex, locked by the caller
+ */
+void bdap_cond_wait(bdap_cond *cond, bdap_mutex *mutex);
+
+/**
+ * @brief Wakes up one thread waiting on the condition variable.
+ *
+ * @param cond The condition variable
+ */
+void bdap_cond_signal(bdap_cond *cond);
+
+/**
+ * @brief Wakes up all threads waiting on the condition variable.
+ *
+ * @param cond The condition variable
+ */
+void bdap_cond_broadcast(bdap_cond *cond);
+
+/**
+ * @brief Returns the number of online logical processors.
+ *
+ * @return the number of processors, at least 1
+ */
+uint32_t bdap_num_cpus(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
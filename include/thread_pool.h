@@ -0,0 +1,112 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "thread.h"
+
+#define BDAP_THREAD_POOL_MAX_THREADS    64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A task of a parallel loop, called once for every index.
+ *
+ * @param ctx The context passed to bdap_thread_pool_run
+ * @param index The index of the task
+ */
+typedef void (*bdap_task_func)(void *ctx, size_t index);
+
+struct bdap_thread_pool;
+
+/**
+ * @brief A worker of the pool, owning a range [begin, end) of task
+ * indices. Idle workers steal the upper half of the largest range.
+ */
+typedef struct
+{
+    bdap_thread thread;
+    struct bdap_thread_pool *pool;
+    bdap_mutex lock;
+    size_t begin;
+    size_t end;
+} bdap_pool_worker;
+
+/**
+ * @brief A fixed-size work-stealing thread pool.
+ *
+ * @note The calling thread of bdap_thread_pool_run takes part as
+ * the first worker, so that a pool of n threads starts n - 1 threads.
+ * All the storage is held by the structure itself.
+ */
+typedef struct bdap_thread_pool
+{
+    bdap_pool_worker workers[BDAP_THREAD_POOL_MAX_THREADS];
+    uint32_t num_threads;
+    bdap_mutex run_lock;
+    bdap_mutex lock;
+    bdap_cond wake;
+    bdap_cond done;
+    uint64_t generation;
+    uint32_t active;
+    bool shutdown;
+    bdap_task_func func;
+    void *ctx;
+} bdap_thread_pool;
+
+/**
+ * @brief Initialises a thread pool and starts its threads.
+ *
+ * @param pool The thread pool
+ * @param num_threads The number of threads, including the caller of
+ *                    bdap_thread_pool_run, 0 for the number of
+ *                    processors. It is capped to
+ *                    BDAP_THREAD_POOL_MAX_THREADS.
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_thread_pool_init(bdap_thread_pool *pool, uint32_t num_threads);
+
+/**
+ * @brief Stops the threads of a pool and releases its resources.
+ *
+ * @param pool The thread pool
+ */
+void bdap_thread_pool_destroy(bdap_thread_pool *pool);
+
+/**
+ * @brief Returns the number of threads of a pool.
+ *
+ * @param pool The thread pool
+ * @return the number of threads, including the caller
+ */
+uint32_t bdap_thread_pool_size(const bdap_thread_pool *pool);
+
+/**
+ * @brief Calls func(ctx, i) for i = 0, ..., num_tasks - 1 across the
+ * threads of the pool, and returns once all calls have completed.
+ *
+ * @note Concurrent calls on the same pool are serialised. A task must
+ * not call bdap_thread_pool_run on its own pool.
+ *
+ * @param pool The thread pool
+ * @param num_tasks The number of tasks
+ * @param func The task function
+ * @param ctx The context passed to every task
+ */
+void bdap_thread_pool_run(bdap_thread_pool *pool,
+                          size_t num_tasks,
+                          bdap_task_func func,
+                          void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
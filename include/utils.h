@@ -13,6 +13,12 @@
 extern "C" {
 #endif
 
+/**
+ * @brief The maximum number of pages locked at a time by
+ * crypto_mlock(void* const, const size_t).
+ */
+#define CRYPTO_MLOCK_MAX_PAGES      4096
+
 /**
  * @brief Locks a block of memory at address given by
  * {@code addr}, of {@code size} bytes for storing
@@ -20,6 +26,9 @@ extern "C" {
  * 
  * @note On Linux system, this method also prevents
  * the block of memory from being included in coredump.
+ * Locks are counted per page, so that blocks sharing a page
+ * are locked and unlocked independently: a page stays locked
+ * until every block locked on it is unlocked.
  * 
  * @param addr The address to be locked
  * @param size The number of bytes to lock
@@ -34,7 +43,8 @@ bool crypto_mlock(void* const addr, const size_t size);
  *
  * @note The block of memory to be unlocked shall be
  * locked by crypto_mlock(void* const, const size_t)
- * in the first place.
+ * in the first place. Only the pages no other locked block
+ * shares are unlocked.
  * 
  * @param addr The address to be unlocked
  * @param size The number of bytes to lock
@@ -51,6 +61,80 @@ bool crypto_munlock(void* const addr, const size_t size);
  */
 void crypto_memzero(void const* ptr, const size_t size);
 
+/**
+ * @brief Zeroes a block of memory with word-sized stores.
+ * 
+ * @note Unlike crypto_memzero(void const*, const size_t), the
+ * block must be aligned on 8 bytes, so that it is wiped eight
+ * bytes per store. The slots of the secure arena are.
+ * 
+ * @param ptr the pointer of memory location to be zeroed
+ * @param size the size of the memory block in bytes
+ */
+void crypto_memzero_aligned(void* ptr, const size_t size);
+
+/**
+ * @brief The size in bytes of a slot of the secure arena.
+ */
+#define CRYPTO_SECURE_SLOT_SIZE     512
+
+/**
+ * @brief The number of slots the secure arena maps and locks at a
+ * time.
+ */
+#define CRYPTO_SECURE_CHUNK_SLOTS   64
+
+/**
+ * @brief The maximum number of slots of the secure arena, enough
+ * for a decryption, which takes three slots, on each of many times
+ * BDAP_THREAD_POOL_MAX_THREADS threads.
+ */
+#define CRYPTO_SECURE_MAX_SLOTS     2048
+
+/**
+ * @brief Sets up the secure arena, a pool of memory for key
+ * material and scratch state that is locked once for the
+ * lifetime of the process.
+ * 
+ * @note The arena grows by chunks of CRYPTO_SECURE_CHUNK_SLOTS
+ * slots, up to CRYPTO_SECURE_MAX_SLOTS, each mapped between two
+ * inaccessible guard pages, locked in memory and, on Linux,
+ * excluded from coredumps. Chunks are never given back, so the
+ * system calls only happen when the number of slots in use
+ * reaches a new high. The first chunk is set up on the first
+ * call to this method or to crypto_secure_alloc(), so calling
+ * this method at startup keeps the system calls out of the first
+ * message. Later calls return the outcome of the first one.
+ * 
+ * @note Memory locks are not inherited across fork(), the arena of
+ * a child process is only guarded and excluded from coredumps.
+ * 
+ * @return true if the arena is available
+ * @return false otherwise, e.g. when the locked memory limit is
+ * too low, in which case crypto_secure_alloc() returns NULL
+ */
+bool crypto_secure_init(void);
+
+/**
+ * @brief Takes a slot of CRYPTO_SECURE_SLOT_SIZE bytes from the
+ * secure arena, without any system call unless the arena has to
+ * grow.
+ * 
+ * @note The slot is zeroed and aligned on 8 bytes. It must be
+ * given back with crypto_secure_free(void*).
+ * 
+ * @return the slot, or NULL if the arena is unavailable or all
+ * of its slots are taken and it cannot grow any further
+ */
+void* crypto_secure_alloc(void);
+
+/**
+ * @brief Wipes a slot of the secure arena and gives it back.
+ * 
+ * @param slot the slot returned by crypto_secure_alloc(), or NULL
+ */
+void crypto_secure_free(void* slot);
+
 /**
  * @brief A constant-time method to check whether or not
  * two memory blocks are equal.
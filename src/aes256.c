@@ -3,8 +3,23 @@
 
 #include <string.h>
 #include "aes256.h"
+#include "aes256_ni.h"
 #include "utils.h"
 
+/* The engine switch may be flipped while other threads initialise
+ * contexts: it is accessed atomically. Each context captures the
+ * engine once, in aes256_init, so nothing else has to be ordered. */
+#if defined(__GNUC__) || defined(__clang__)
+static int32_t hardware_enabled = 1;
+#define HARDWARE_ENABLED_LOAD() __atomic_load_n(&hardware_enabled, __ATOMIC_RELAXED)
+#define HARDWARE_ENABLED_STORE(v) __atomic_store_n(&hardware_enabled, (v), __ATOMIC_RELAXED)
+#else
+/* Aligned 32-bit volatile accesses are atomic on the MSVC targets */
+static volatile int32_t hardware_enabled = 1;
+#define HARDWARE_ENABLED_LOAD() (hardware_enabled)
+#define HARDWARE_ENABLED_STORE(v) (hardware_enabled = (v))
+#endif
+
 static uint8_t mult(uint8_t c, uint8_t d)
 {
     int32_t i;
@@ -156,7 +171,7 @@ static uint8_t inv_byte_sub(uint8_t c)
     return inv(c);
 }
 
-void expand_key(uint8_t *expanded, const uint8_t *key)
+static void expand_key(uint8_t *expanded, const uint8_t *key)
 {
     int32_t idx;
     uint8_t t[4];
@@ -203,76 +218,570 @@ void expand_key(uint8_t *expanded, const uint8_t *key)
     }
 }
 
-void aes256_bitslice_encrypt(uint8_t *out,
-                             const uint8_t *in,
-                             const uint8_t *key)
+/**
+ * Constant-time bit-sliced AES engine.
+ * 
+ * The engine processes four blocks in parallel, spread over eight
+ * 64-bit words: word q[i] holds bit i of every byte of the four
+ * blocks. The S-box is evaluated as a boolean circuit, hence there
+ * are no secret-dependent table lookups or branches.
+ * 
+ * Reference: Thomas Pornin, BearSSL aes_ct64 implementation, and
+ * Joan Boyar and Rene Peralta, "A depth-16 circuit for the AES S-box"
+ */
+
+/**
+ * @brief Applies the AES S-box on the bit-sliced state.
+ * 
+ * @param q The bit-sliced state, 8 words
+ */
+static void bitslice_sbox(uint64_t *q)
 {
-    uint8_t expanded[240];
-    uint8_t state[16];
-    uint8_t new_state[16];
-    uint8_t a[4];
-    int32_t idx, round;
+    uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+    uint64_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+    uint64_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+    uint64_t y20, y21;
+    uint64_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+    uint64_t z10, z11, z12, z13, z14, z15, z16, z17;
+    uint64_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+    uint64_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    uint64_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+    uint64_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    uint64_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+    uint64_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    uint64_t t60, t61, t62, t63, t64, t65, t66, t67;
+    uint64_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+
+    /* Top linear transformation */
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9  = x0 ^ x3;
+    y8  = x0 ^ x5;
+    t0  = x1 ^ x2;
+    y1  = t0 ^ x7;
+    y4  = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2  = y1 ^ x0;
+    y5  = y1 ^ x6;
+    y3  = y5 ^ y8;
+    t1  = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6  = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7  = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+
+    /* Non-linear section */
+    t2  = y12 & y15;
+    t3  = y3 & y6;
+    t4  = t3 ^ t2;
+    t5  = y4 & x7;
+    t6  = t5 ^ t2;
+    t7  = y13 & y16;
+    t8  = y5 & y1;
+    t9  = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0  = t44 & y15;
+    z1  = t37 & y6;
+    z2  = t33 & x7;
+    z3  = t43 & y16;
+    z4  = t40 & y1;
+    z5  = t29 & y7;
+    z6  = t42 & y11;
+    z7  = t45 & y17;
+    z8  = t41 & y10;
+    z9  = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+
+    /* Bottom linear transformation */
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    s0  = t59 ^ t63;
+    s6  = t56 ^ ~t62;
+    s7  = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    s3  = t53 ^ t66;
+    s4  = t51 ^ t66;
+    s5  = t47 ^ t65;
+    s1  = t64 ^ ~s3;
+    s2  = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
 
-    expand_key(expanded, key);
+#define SWAPN(cl, ch, s, x, y)                                     \
+    do {                                                           \
+        uint64_t a_, b_;                                           \
+        a_ = (x);                                                  \
+        b_ = (y);                                                  \
+        (x) = (a_ & (uint64_t)(cl)) | ((b_ & (uint64_t)(cl)) << (s)); \
+        (y) = ((a_ & (uint64_t)(ch)) >> (s)) | (b_ & (uint64_t)(ch)); \
+    } while (0)
+
+#define SWAP2(x, y) SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, x, y)
+#define SWAP4(x, y) SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, x, y)
+#define SWAP8(x, y) SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, x, y)
+
+/**
+ * @brief Transposes the state between the byte and the bit-sliced
+ * representation. The transformation is an involution.
+ * 
+ * @param q The state, 8 words
+ */
+static void ortho(uint64_t *q)
+{
+    SWAP2(q[0], q[1]);
+    SWAP2(q[2], q[3]);
+    SWAP2(q[4], q[5]);
+    SWAP2(q[6], q[7]);
+
+    SWAP4(q[0], q[2]);
+    SWAP4(q[1], q[3]);
+    SWAP4(q[4], q[6]);
+    SWAP4(q[5], q[7]);
+
+    SWAP8(q[0], q[4]);
+    SWAP8(q[1], q[5]);
+    SWAP8(q[2], q[6]);
+    SWAP8(q[3], q[7]);
+}
 
-    for (idx = 0; idx < 4; ++idx)
+/**
+ * @brief Spreads a block, given as four little-endian 32-bit words,
+ * over two state words prior to ortho(uint64_t*).
+ */
+static void interleave_in(uint64_t *q0, uint64_t *q1, const uint32_t *w)
+{
+    uint64_t x0, x1, x2, x3;
+
+    x0 = w[0];
+    x1 = w[1];
+    x2 = w[2];
+    x3 = w[3];
+    x0 |= (x0 << 16);
+    x1 |= (x1 << 16);
+    x2 |= (x2 << 16);
+    x3 |= (x3 << 16);
+    x0 &= 0x0000FFFF0000FFFFULL;
+    x1 &= 0x0000FFFF0000FFFFULL;
+    x2 &= 0x0000FFFF0000FFFFULL;
+    x3 &= 0x0000FFFF0000FFFFULL;
+    x0 |= (x0 << 8);
+    x1 |= (x1 << 8);
+    x2 |= (x2 << 8);
+    x3 |= (x3 << 8);
+    x0 &= 0x00FF00FF00FF00FFULL;
+    x1 &= 0x00FF00FF00FF00FFULL;
+    x2 &= 0x00FF00FF00FF00FFULL;
+    x3 &= 0x00FF00FF00FF00FFULL;
+    *q0 = x0 | (x2 << 8);
+    *q1 = x1 | (x3 << 8);
+}
+
+/**
+ * @brief The inverse of interleave_in(uint64_t*, uint64_t*, const uint32_t*).
+ */
+static void interleave_out(uint32_t *w, uint64_t q0, uint64_t q1)
+{
+    uint64_t x0, x1, x2, x3;
+
+    x0 = q0 & 0x00FF00FF00FF00FFULL;
+    x1 = q1 & 0x00FF00FF00FF00FFULL;
+    x2 = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+    x3 = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+    x0 |= (x0 >> 8);
+    x1 |= (x1 >> 8);
+    x2 |= (x2 >> 8);
+    x3 |= (x3 >> 8);
+    x0 &= 0x0000FFFF0000FFFFULL;
+    x1 &= 0x0000FFFF0000FFFFULL;
+    x2 &= 0x0000FFFF0000FFFFULL;
+    x3 &= 0x0000FFFF0000FFFFULL;
+    w[0] = (uint32_t)x0 | (uint32_t)(x0 >> 16);
+    w[1] = (uint32_t)x1 | (uint32_t)(x1 >> 16);
+    w[2] = (uint32_t)x2 | (uint32_t)(x2 >> 16);
+    w[3] = (uint32_t)x3 | (uint32_t)(x3 >> 16);
+}
+
+static inline uint32_t little_endian_load32(const uint8_t *x)
+{
+    return (uint32_t)x[0]
+        | ((uint32_t)x[1] << 8)
+        | ((uint32_t)x[2] << 16)
+        | ((uint32_t)x[3] << 24);
+}
+
+static inline void little_endian_store32(uint8_t *x, uint32_t u)
+{
+    x[0] = u & 0xFF; u >>= 8;
+    x[1] = u & 0xFF; u >>= 8;
+    x[2] = u & 0xFF; u >>= 8;
+    x[3] = u & 0xFF;
+}
+
+/**
+ * @brief Applies the S-box on each byte of a 32-bit word.
+ */
+static uint32_t sub_word(uint32_t x)
+{
+    uint64_t q[8];
+
+    memset(q, 0, sizeof(q));
+    q[0] = x;
+    ortho(q);
+    bitslice_sbox(q);
+    ortho(q);
+    x = (uint32_t)q[0];
+    crypto_memzero(q, sizeof(q));
+
+    return x;
+}
+
+/**
+ * @brief Expands a 256-bit key into 15 bit-sliced round keys.
+ * 
+ * @note Each round key is replicated across the four parallel
+ * blocks, hence it occupies 8 words.
+ * 
+ * @param skey The output bit-sliced key-schedule, 120 words
+ * @param key The encryption key, 32 bytes
+ */
+static void bitslice_expand_key(uint64_t *skey, const uint8_t *key)
+{
+    static const uint8_t round_constant[7] = {
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40
+    };
+    uint32_t w[4 * (AES256_ROUNDS + 1)];
+    uint32_t rk[16];
+    uint32_t tmp;
+    int32_t i, j, k;
+
+    for (i = 0; i < 8; ++i)
     {
-        state[     idx] = in[4*idx]     ^ expanded[      idx];
-        state[ 4 + idx] = in[4*idx + 1] ^ expanded[ 60 + idx];
-        state[ 8 + idx] = in[4*idx + 2] ^ expanded[120 + idx];
-        state[12 + idx] = in[4*idx + 3] ^ expanded[180 + idx];
+        w[i] = little_endian_load32(key + 4*i);
     }
 
-    for (round = 0; round < 14; ++round)
+    tmp = w[7];
+    for (i = 8, j = 0, k = 0; i < 4 * (AES256_ROUNDS + 1); ++i)
     {
-        for (idx = 0; idx < 4; ++idx) 
+        if (j == 0)
         {
-            new_state[4*idx    ] = byte_sub(state[4*idx    ]);
-            new_state[4*idx + 1] = byte_sub(state[4*idx + 1]);
-            new_state[4*idx + 2] = byte_sub(state[4*idx + 2]);
-            new_state[4*idx + 3] = byte_sub(state[4*idx + 3]);
+            tmp = (tmp << 24) | (tmp >> 8);
+            tmp = sub_word(tmp) ^ round_constant[k];
         }
-        for (idx = 0; idx < 4; ++idx) 
+        else if (j == 4)
         {
-            state[4*idx    ] = new_state[4*idx + idx];
-            state[4*idx + 1] = new_state[4*idx + ((1 + idx) & 3)];
-            state[4*idx + 2] = new_state[4*idx + ((2 + idx) & 3)];
-            state[4*idx + 3] = new_state[4*idx + ((3 + idx) & 3)];
+            tmp = sub_word(tmp);
         }
-        if (round < 13) 
+        tmp ^= w[i - 8];
+        w[i] = tmp;
+        if (++j == 8)
         {
-            for (idx = 0; idx < 4; ++idx)
-            {
-                a[0] = state[     idx];
-                a[1] = state[ 4 + idx];
-                a[2] = state[ 8 + idx];
-                a[3] = state[12 + idx];
-                state[     idx] = dbl(a[0] ^ a[1]) ^ a[1] ^ a[2] ^ a[3];
-                state[ 4 + idx] = dbl(a[1] ^ a[2]) ^ a[2] ^ a[3] ^ a[0];
-                state[ 8 + idx] = dbl(a[2] ^ a[3]) ^ a[3] ^ a[0] ^ a[1];
-                state[12 + idx] = dbl(a[3] ^ a[0]) ^ a[0] ^ a[1] ^ a[2];
-            }
+            j = 0;
+            ++k;
         }
-        for (idx = 0; idx < 4; ++idx)
+    }
+
+    for (i = 0; i <= AES256_ROUNDS; ++i)
+    {
+        for (j = 0; j < 4; ++j)
         {
-            state[4*idx    ] ^= expanded[60*idx + (4 * round + 4)];
-            state[4*idx + 1] ^= expanded[60*idx + (4 * round + 5)];
-            state[4*idx + 2] ^= expanded[60*idx + (4 * round + 6)];
-            state[4*idx + 3] ^= expanded[60*idx + (4 * round + 7)];
+            memcpy(&rk[4*j], &w[4*i], 4 * sizeof(uint32_t));
+            interleave_in(&skey[8*i + j], &skey[8*i + j + 4], &rk[4*j]);
         }
+        ortho(&skey[8*i]);
     }
 
-    out[ 0] = state[0]; out[ 1] = state[4]; out[ 2] = state[8];  out[ 3] = state[12];
-    out[ 4] = state[1]; out[ 5] = state[5]; out[ 6] = state[9];  out[ 7] = state[13];
-    out[ 8] = state[2]; out[ 9] = state[6]; out[10] = state[10]; out[11] = state[14];
-    out[12] = state[3]; out[13] = state[7]; out[14] = state[11]; out[15] = state[15];
+    crypto_memzero(w, sizeof(w));
+    crypto_memzero(rk, sizeof(rk));
+}
+
+static inline void add_round_key(uint64_t *q, const uint64_t *sk)
+{
+    q[0] ^= sk[0];
+    q[1] ^= sk[1];
+    q[2] ^= sk[2];
+    q[3] ^= sk[3];
+    q[4] ^= sk[4];
+    q[5] ^= sk[5];
+    q[6] ^= sk[6];
+    q[7] ^= sk[7];
+}
+
+static inline void shift_rows(uint64_t *q)
+{
+    int32_t i;
+    uint64_t x;
+
+    for (i = 0; i < 8; ++i)
+    {
+        x = q[i];
+        q[i] = (x & 0x000000000000FFFFULL)
+            | ((x & 0x00000000FFF00000ULL) >> 4)
+            | ((x & 0x00000000000F0000ULL) << 12)
+            | ((x & 0x0000FF0000000000ULL) >> 8)
+            | ((x & 0x000000FF00000000ULL) << 8)
+            | ((x & 0xF000000000000000ULL) >> 12)
+            | ((x & 0x0FFF000000000000ULL) << 4);
+    }
+}
+
+static inline uint64_t rotr32(uint64_t x)
+{
+    return (x << 32) | (x >> 32);
+}
+
+static inline void mix_columns(uint64_t *q)
+{
+    uint64_t q0, q1, q2, q3, q4, q5, q6, q7;
+    uint64_t r0, r1, r2, r3, r4, r5, r6, r7;
+
+    q0 = q[0];
+    q1 = q[1];
+    q2 = q[2];
+    q3 = q[3];
+    q4 = q[4];
+    q5 = q[5];
+    q6 = q[6];
+    q7 = q[7];
+    r0 = (q0 >> 16) | (q0 << 48);
+    r1 = (q1 >> 16) | (q1 << 48);
+    r2 = (q2 >> 16) | (q2 << 48);
+    r3 = (q3 >> 16) | (q3 << 48);
+    r4 = (q4 >> 16) | (q4 << 48);
+    r5 = (q5 >> 16) | (q5 << 48);
+    r6 = (q6 >> 16) | (q6 << 48);
+    r7 = (q7 >> 16) | (q7 << 48);
+
+    q[0] = q7 ^ r7 ^ r0 ^ rotr32(q0 ^ r0);
+    q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ rotr32(q1 ^ r1);
+    q[2] = q1 ^ r1 ^ r2 ^ rotr32(q2 ^ r2);
+    q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ rotr32(q3 ^ r3);
+    q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ rotr32(q4 ^ r4);
+    q[5] = q4 ^ r4 ^ r5 ^ rotr32(q5 ^ r5);
+    q[6] = q5 ^ r5 ^ r6 ^ rotr32(q6 ^ r6);
+    q[7] = q6 ^ r6 ^ r7 ^ rotr32(q7 ^ r7);
+}
+
+/**
+ * @brief Encrypts up to four blocks with the bit-sliced engine.
+ * 
+ * @param out The output blocks, 16 * num_blocks bytes
+ * @param in The input blocks, 16 * num_blocks bytes
+ * @param num_blocks The number of blocks, between 1 and 4
+ * @param skey The bit-sliced key-schedule
+ */
+static void bitslice_encrypt4(uint8_t *out,
+                              const uint8_t *in,
+                              size_t num_blocks,
+                              const uint64_t *skey)
+{
+    uint64_t q[8];
+    uint32_t w[16];
+    size_t i;
+    int32_t round;
+
+    memset(w, 0, sizeof(w));
+    for (i = 0; i < 4 * num_blocks; ++i)
+    {
+        w[i] = little_endian_load32(in + 4*i);
+    }
+    for (i = 0; i < 4; ++i)
+    {
+        interleave_in(&q[i], &q[i + 4], &w[4*i]);
+    }
+    ortho(q);
+
+    add_round_key(q, skey);
+    for (round = 1; round < AES256_ROUNDS; ++round)
+    {
+        bitslice_sbox(q);
+        shift_rows(q);
+        mix_columns(q);
+        add_round_key(q, skey + 8*round);
+    }
+    bitslice_sbox(q);
+    shift_rows(q);
+    add_round_key(q, skey + 8*AES256_ROUNDS);
+
+    ortho(q);
+    for (i = 0; i < 4; ++i)
+    {
+        interleave_out(&w[4*i], q[i], q[i + 4]);
+    }
+    for (i = 0; i < 4 * num_blocks; ++i)
+    {
+        little_endian_store32(out + 4*i, w[i]);
+    }
+
+    crypto_memzero(q, sizeof(q));
+    crypto_memzero(w, sizeof(w));
+}
+
+bool aes256_use_hardware(bool enable)
+{
+    HARDWARE_ENABLED_STORE(enable ? 1 : 0);
+    return aes256_hardware_enabled();
+}
+
+bool aes256_hardware_enabled(void)
+{
+    return HARDWARE_ENABLED_LOAD() != 0 && aes256_ni_available();
+}
+
+void aes256_init(aes256_ctx *ctx, const uint8_t *key)
+{
+    ctx->aesni = aes256_hardware_enabled();
+    if (ctx->aesni)
+    {
+        aes256_ni_expand_key((uint8_t *)ctx->skey, key);
+    }
+    else
+    {
+        bitslice_expand_key(ctx->skey, key);
+    }
+}
+
+void aes256_encrypt_block(uint8_t *out,
+                          const uint8_t *in,
+                          const aes256_ctx *ctx)
+{
+    aes256_encrypt_blocks(out, in, 1, ctx);
+}
+
+void aes256_encrypt_blocks(uint8_t *out,
+                           const uint8_t *in,
+                           size_t num_blocks,
+                           const aes256_ctx *ctx)
+{
+    size_t n;
+
+    if (ctx->aesni)
+    {
+        aes256_ni_encrypt_blocks(out, in, num_blocks, (const uint8_t *)ctx->skey);
+        return;
+    }
+
+    while (num_blocks > 0)
+    {
+        n = 4;
+        if (num_blocks < n)
+        {
+            n = num_blocks;
+        }
+        bitslice_encrypt4(out, in, n, ctx->skey);
+        out += n * AES256_BLOCK_SIZE;
+        in += n * AES256_BLOCK_SIZE;
+        num_blocks -= n;
+    }
+}
+
+void aes256_wipe(aes256_ctx *ctx)
+{
+    crypto_memzero(ctx, sizeof(aes256_ctx));
+}
+
+void aes256_bitslice_encrypt(uint8_t *out,
+                             const uint8_t *in,
+                             const uint8_t *key)
+{
+    aes256_ctx ctx;
+
+    aes256_init(&ctx, key);
+    aes256_encrypt_block(out, in, &ctx);
+    aes256_wipe(&ctx);
 }
 
 void aes256_bitslice_decrypt(uint8_t *out,
                              const uint8_t *in,
                              const uint8_t *key)
 {
-    uint8_t expanded[240];
+    uint8_t expanded[AES256_ROUND_KEYS];
     uint8_t state[16];
     uint8_t new_state[16];
     uint8_t a0, a1, a2, a3;
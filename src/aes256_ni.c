@@ -0,0 +1,401 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+/**
+ * AES-NI and PCLMULQDQ accelerated AES-256 and GHASH.
+ *
+ * Reference: Shay Gueron, "Intel Advanced Encryption Standard (AES)
+ * New Instructions Set", and Shay Gueron and Michael E. Kounavis,
+ * "Intel Carry-Less Multiplication Instruction and its Usage for
+ * Computing the GCM Mode"
+ */
+
+#include <string.h>
+#include "aes256_ni.h"
+#include "utils.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+# define AES256_NI_SUPPORTED
+#endif
+
+#if defined(AES256_NI_SUPPORTED)
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+# define AESNI_TARGET
+#else
+# include <cpuid.h>
+# define AESNI_TARGET __attribute__((target("sse2,ssse3,aes,pclmul")))
+#endif
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+#define CPUID_ECX_PCLMULQDQ     (1u << 1)
+#define CPUID_ECX_SSSE3         (1u << 9)
+#define CPUID_ECX_AESNI         (1u << 25)
+
+static bool cpu_supports_aesni(void)
+{
+    uint32_t ecx;
+    const uint32_t required =
+        CPUID_ECX_PCLMULQDQ | CPUID_ECX_SSSE3 | CPUID_ECX_AESNI;
+#if defined(_MSC_VER)
+    int32_t info[4];
+
+    __cpuid(info, 1);
+    ecx = (uint32_t)info[2];
+#else
+    unsigned int eax, ebx, ecx_, edx;
+
+    if (0 == __get_cpuid(1, &eax, &ebx, &ecx_, &edx))
+    {
+        return false;
+    }
+    ecx = (uint32_t)ecx_;
+#endif
+
+    return ((ecx & required) == required);
+}
+
+bool aes256_ni_available(void)
+{
+    /* 0: unknown, 1: supported, 2: unsupported */
+    static volatile int32_t status = 0;
+
+    if (status == 0)
+    {
+        status = cpu_supports_aesni() ? 1 : 2;
+    }
+
+    return (status == 1);
+}
+
+/******** AES-256 ********/
+
+AESNI_TARGET
+static inline __m128i key_256_assist_1(__m128i t1, __m128i t2)
+{
+    __m128i t4;
+
+    t2 = _mm_shuffle_epi32(t2, 0xff);
+    t4 = _mm_slli_si128(t1, 0x4);
+    t1 = _mm_xor_si128(t1, t4);
+    t4 = _mm_slli_si128(t4, 0x4);
+    t1 = _mm_xor_si128(t1, t4);
+    t4 = _mm_slli_si128(t4, 0x4);
+    t1 = _mm_xor_si128(t1, t4);
+    return _mm_xor_si128(t1, t2);
+}
+
+AESNI_TARGET
+static inline __m128i key_256_assist_2(__m128i t1, __m128i t3)
+{
+    __m128i t2, t4;
+
+    t4 = _mm_aeskeygenassist_si128(t1, 0x0);
+    t2 = _mm_shuffle_epi32(t4, 0xaa);
+    t4 = _mm_slli_si128(t3, 0x4);
+    t3 = _mm_xor_si128(t3, t4);
+    t4 = _mm_slli_si128(t4, 0x4);
+    t3 = _mm_xor_si128(t3, t4);
+    t4 = _mm_slli_si128(t4, 0x4);
+    t3 = _mm_xor_si128(t3, t4);
+    return _mm_xor_si128(t3, t2);
+}
+
+/* The round constant has to be an immediate operand, hence a macro */
+#define KEY_256_ROUND(idx, rcon)                                    \
+    t2 = _mm_aeskeygenassist_si128(t3, rcon);                       \
+    t1 = key_256_assist_1(t1, t2);                                  \
+    _mm_storeu_si128((__m128i *)(rk + 16*(idx)), t1);               \
+    t3 = key_256_assist_2(t1, t3);                                  \
+    _mm_storeu_si128((__m128i *)(rk + 16*((idx) + 1)), t3)
+
+AESNI_TARGET
+void aes256_ni_expand_key(uint8_t *rk, const uint8_t *key)
+{
+    __m128i t1, t2, t3;
+
+    t1 = _mm_loadu_si128((const __m128i *)key);
+    t3 = _mm_loadu_si128((const __m128i *)(key + 16));
+    _mm_storeu_si128((__m128i *)rk, t1);
+    _mm_storeu_si128((__m128i *)(rk + 16), t3);
+
+    KEY_256_ROUND( 2, 0x01);
+    KEY_256_ROUND( 4, 0x02);
+    KEY_256_ROUND( 6, 0x04);
+    KEY_256_ROUND( 8, 0x08);
+    KEY_256_ROUND(10, 0x10);
+    KEY_256_ROUND(12, 0x20);
+    t2 = _mm_aeskeygenassist_si128(t3, 0x40);
+    t1 = key_256_assist_1(t1, t2);
+    _mm_storeu_si128((__m128i *)(rk + 16*14), t1);
+}
+
+AESNI_TARGET
+void aes256_ni_encrypt_blocks(uint8_t *out,
+                              const uint8_t *in,
+                              size_t num_blocks,
+                              const uint8_t *rk)
+{
+    __m128i k[15];
+    __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+    int32_t i;
+
+    for (i = 0; i < 15; ++i)
+    {
+        k[i] = _mm_loadu_si128((const __m128i *)(rk + 16*i));
+    }
+
+    while (num_blocks >= 8)
+    {
+        b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in      )), k[0]);
+        b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in +  16)), k[0]);
+        b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in +  32)), k[0]);
+        b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in +  48)), k[0]);
+        b4 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in +  64)), k[0]);
+        b5 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in +  80)), k[0]);
+        b6 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in +  96)), k[0]);
+        b7 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + 112)), k[0]);
+        for (i = 1; i < 14; ++i)
+        {
+            b0 = _mm_aesenc_si128(b0, k[i]);
+            b1 = _mm_aesenc_si128(b1, k[i]);
+            b2 = _mm_aesenc_si128(b2, k[i]);
+            b3 = _mm_aesenc_si128(b3, k[i]);
+            b4 = _mm_aesenc_si128(b4, k[i]);
+            b5 = _mm_aesenc_si128(b5, k[i]);
+            b6 = _mm_aesenc_si128(b6, k[i]);
+            b7 = _mm_aesenc_si128(b7, k[i]);
+        }
+        _mm_storeu_si128((__m128i *)(out      ), _mm_aesenclast_si128(b0, k[14]));
+        _mm_storeu_si128((__m128i *)(out +  16), _mm_aesenclast_si128(b1, k[14]));
+        _mm_storeu_si128((__m128i *)(out +  32), _mm_aesenclast_si128(b2, k[14]));
+        _mm_storeu_si128((__m128i *)(out +  48), _mm_aesenclast_si128(b3, k[14]));
+        _mm_storeu_si128((__m128i *)(out +  64), _mm_aesenclast_si128(b4, k[14]));
+        _mm_storeu_si128((__m128i *)(out +  80), _mm_aesenclast_si128(b5, k[14]));
+        _mm_storeu_si128((__m128i *)(out +  96), _mm_aesenclast_si128(b6, k[14]));
+        _mm_storeu_si128((__m128i *)(out + 112), _mm_aesenclast_si128(b7, k[14]));
+        in += 128;
+        out += 128;
+        num_blocks -= 8;
+    }
+
+    while (num_blocks > 0)
+    {
+        b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), k[0]);
+        for (i = 1; i < 14; ++i)
+        {
+            b0 = _mm_aesenc_si128(b0, k[i]);
+        }
+        _mm_storeu_si128((__m128i *)out, _mm_aesenclast_si128(b0, k[14]));
+        in += 16;
+        out += 16;
+        --num_blocks;
+    }
+
+    crypto_memzero(k, sizeof(k));
+}
+
+/******** GHASH ********/
+
+/**
+ * GHASH operates on bit-reflected values. The inputs are byte-swapped
+ * so that the reflection reduces to a one-bit left shift of the
+ * carry-less product prior to the reduction.
+ */
+
+AESNI_TARGET
+static inline __m128i byte_swap(__m128i x)
+{
+    const __m128i mask = _mm_set_epi8( 0,  1,  2,  3,  4,  5,  6,  7,
+                                       8,  9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(x, mask);
+}
+
+/**
+ * @brief Computes the unreduced 256-bit carry-less product a * b and
+ * accumulates it into (lo, hi).
+ */
+AESNI_TARGET
+static inline void clmul_accumulate(__m128i *lo,
+                                    __m128i *hi,
+                                    __m128i a,
+                                    __m128i b)
+{
+    __m128i t0, t1, t2, t3;
+
+    t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    t1 = _mm_clmulepi64_si128(a, b, 0x10);
+    t2 = _mm_clmulepi64_si128(a, b, 0x01);
+    t3 = _mm_clmulepi64_si128(a, b, 0x11);
+    t1 = _mm_xor_si128(t1, t2);
+    *lo = _mm_xor_si128(*lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+    *hi = _mm_xor_si128(*hi, _mm_xor_si128(t3, _mm_srli_si128(t1, 8)));
+}
+
+/**
+ * @brief Shifts the 256-bit product (lo, hi) left by one bit and
+ * reduces it modulo x^128 + x^7 + x^2 + x + 1.
+ */
+AESNI_TARGET
+static inline __m128i reduce(__m128i lo, __m128i hi)
+{
+    __m128i t2, t4, t5, t7, t8, t9;
+
+    t7 = _mm_srli_epi32(lo, 31);
+    t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(hi, t8);
+    hi = _mm_or_si128(hi, t9);
+
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+
+    t2 = _mm_srli_epi32(lo, 1);
+    t4 = _mm_srli_epi32(lo, 2);
+    t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+
+    return _mm_xor_si128(hi, lo);
+}
+
+AESNI_TARGET
+static inline __m128i gfmul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+
+    clmul_accumulate(&lo, &hi, a, b);
+    return reduce(lo, hi);
+}
+
+AESNI_TARGET
+void ghash_clmul_init(uint8_t *table, const uint8_t *H)
+{
+    __m128i h1, h2, h3, h4;
+
+    h1 = byte_swap(_mm_loadu_si128((const __m128i *)H));
+    h2 = gfmul(h1, h1);
+    h3 = gfmul(h2, h1);
+    h4 = gfmul(h3, h1);
+    _mm_storeu_si128((__m128i *)(table     ), h1);
+    _mm_storeu_si128((__m128i *)(table + 16), h2);
+    _mm_storeu_si128((__m128i *)(table + 32), h3);
+    _mm_storeu_si128((__m128i *)(table + 48), h4);
+}
+
+AESNI_TARGET
+void ghash_clmul(uint8_t *accum,
+                 const uint8_t *table,
+                 const uint8_t *x,
+                 size_t len)
+{
+    __m128i y, h1, h2, h3, h4;
+    __m128i x0, x1, x2, x3;
+    __m128i lo, hi;
+    uint8_t last[16];
+
+    y  = byte_swap(_mm_loadu_si128((const __m128i *)accum));
+    h1 = _mm_loadu_si128((const __m128i *)(table     ));
+    h2 = _mm_loadu_si128((const __m128i *)(table + 16));
+    h3 = _mm_loadu_si128((const __m128i *)(table + 32));
+    h4 = _mm_loadu_si128((const __m128i *)(table + 48));
+
+    while (len >= 64)
+    {
+        x0 = byte_swap(_mm_loadu_si128((const __m128i *)(x     )));
+        x1 = byte_swap(_mm_loadu_si128((const __m128i *)(x + 16)));
+        x2 = byte_swap(_mm_loadu_si128((const __m128i *)(x + 32)));
+        x3 = byte_swap(_mm_loadu_si128((const __m128i *)(x + 48)));
+
+        /* y = (y + x0)*H^4 + x1*H^3 + x2*H^2 + x3*H */
+        lo = _mm_setzero_si128();
+        hi = _mm_setzero_si128();
+        clmul_accumulate(&lo, &hi, _mm_xor_si128(y, x0), h4);
+        clmul_accumulate(&lo, &hi, x1, h3);
+        clmul_accumulate(&lo, &hi, x2, h2);
+        clmul_accumulate(&lo, &hi, x3, h1);
+        y = reduce(lo, hi);
+
+        x += 64;
+        len -= 64;
+    }
+
+    while (len >= 16)
+    {
+        x0 = byte_swap(_mm_loadu_si128((const __m128i *)x));
+        y = gfmul(_mm_xor_si128(y, x0), h1);
+        x += 16;
+        len -= 16;
+    }
+
+    if (len > 0)
+    {
+        memset(last, 0, sizeof(last));
+        memcpy(last, x, len);
+        x0 = byte_swap(_mm_loadu_si128((const __m128i *)last));
+        y = gfmul(_mm_xor_si128(y, x0), h1);
+        crypto_memzero(last, sizeof(last));
+    }
+
+    _mm_storeu_si128((__m128i *)accum, byte_swap(y));
+}
+
+#else /* !AES256_NI_SUPPORTED */
+
+bool aes256_ni_available(void)
+{
+    return false;
+}
+
+void aes256_ni_expand_key(uint8_t *rk, const uint8_t *key)
+{
+    (void) rk;
+    (void) key;
+}
+
+void aes256_ni_encrypt_blocks(uint8_t *out,
+                              const uint8_t *in,
+                              size_t num_blocks,
+                              const uint8_t *rk)
+{
+    (void) out;
+    (void) in;
+    (void) num_blocks;
+    (void) rk;
+}
+
+void ghash_clmul_init(uint8_t *table, const uint8_t *H)
+{
+    (void) table;
+    (void) H;
+}
+
+void ghash_clmul(uint8_t *accum,
+                 const uint8_t *table,
+                 const uint8_t *x,
+                 size_t len)
+{
+    (void) accum;
+    (void) table;
+    (void) x;
+    (void) len;
+}
+
+#endif /* AES256_NI_SUPPORTED */
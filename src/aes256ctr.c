@@ -1,10 +1,14 @@
 // Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
 // See LICENSE.md file for license, copying and use information.
 
+#include <string.h>
 #include "aes256ctr.h"
 #include "aes256.h"
 #include "utils.h"
 
+/* The number of counter blocks encrypted per call to the AES engine */
+#define KEYSTREAM_BLOCKS    8
+
 static inline uint8_t ct_eq_ff(uint8_t u)
 {
     uint8_t v = u ^ (uint8_t)0xff;
@@ -94,43 +98,54 @@ int32_t aes256ctr_encrypt(uint8_t *c,
                           const uint8_t *iv,
                           const uint8_t *key)
 {
+    aes256_ctx ctx;
     uint8_t T[AES256CTR_IV_SIZE];
-    uint8_t stream[16];
-    size_t i, block_len;
+    uint8_t stream[KEYSTREAM_BLOCKS * AES256_BLOCK_SIZE];
+    size_t i, num_blocks, stream_len;
 
     for (i = 0; i < AES256CTR_IV_SIZE; i++)
     {
         T[i] = iv[i];
     }
 
+    aes256_init(&ctx, key);
+
     *c_len = msg_len;
     while (msg_len > 0)
     {
-        block_len = 16;
-        if (msg_len < block_len) 
+        /* Lay out the counter blocks and encrypt them in one go */
+        num_blocks = 0;
+        stream_len = 0;
+        while ((num_blocks < KEYSTREAM_BLOCKS) && (stream_len < msg_len))
         {
-            block_len = msg_len;
+            memcpy(&stream[num_blocks * AES256_BLOCK_SIZE], T, AES256CTR_IV_SIZE);
+            increment_counter(T);
+            stream_len += AES256_BLOCK_SIZE;
+            ++num_blocks;
         }
-        
-        aes256_bitslice_encrypt(stream, T, key);
+        aes256_encrypt_blocks(stream, stream, num_blocks, &ctx);
 
-        for (i = 0; i < block_len; ++i)
+        if (msg_len < stream_len) 
+        {
+            stream_len = msg_len;
+        }
+        for (i = 0; i < stream_len; ++i)
         {
             c[i] = msg[i] ^ stream[i];
         }
 
-        c += block_len;
-        msg += block_len;
-        msg_len -= block_len;
-
-        increment_counter(T);
+        c += stream_len;
+        msg += stream_len;
+        msg_len -= stream_len;
     }
 
+    aes256_wipe(&ctx);
     crypto_memzero(T, AES256CTR_IV_SIZE);
     crypto_memzero(stream, sizeof(stream));
 
     return 0;
-}                      
+}
+
 int32_t aes256ctr_decrypt(uint8_t *msg,
                           size_t *msg_len,
                           const uint8_t *c,
@@ -1,9 +1,17 @@
 // Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
 // See LICENSE.md file for license, copying and use information.
 
+#include <string.h>
 #include "aes256.h"
+#include "aes256_ni.h"
 #include "aes256gcm.h"
 #include "utils.h"
+#include "thread_pool.h"
+
+/* The number of counter blocks encrypted per call to the AES engine */
+#define KEYSTREAM_BLOCKS    8
+#define MIN_SEGMENT_SIZE    (16 * 1024)
+#define MAX_SEGMENTS        256
 
 static void big_endian_store32(uint8_t *x, uint32_t u)
 {
@@ -25,63 +33,152 @@ static void big_endian_store64(uint8_t *x, uint64_t u)
     x[0] = u & 0xFF;
 }
 
+static uint64_t big_endian_load64(const uint8_t *x)
+{
+    return ((uint64_t)x[0] << 56) | ((uint64_t)x[1] << 48) |
+           ((uint64_t)x[2] << 40) | ((uint64_t)x[3] << 32) |
+           ((uint64_t)x[4] << 24) | ((uint64_t)x[5] << 16) |
+           ((uint64_t)x[6] <<  8) |  (uint64_t)x[7];
+}
+
 /**
- * @brief Computes (a + x)*y.
+ * @brief Carry-less multiplication of two 64-bit words, keeping
+ * the low 64 bits of the result.
  * 
- * @param a The input/output vector a, 16 bytes long
- * @param x The input vector x, x_len bytes long
- * @param x_len The length of vector x (in bytes)
- * @param y The input vector y, 16 bytes long
+ * @note Integer multiplications are used with the operands split
+ * into four interleaved masks, so that every fourth bit is set;
+ * the resulting holes absorb the carries. This is constant-time
+ * as long as the CPU multiplier is.
+ * 
+ * @param x The first operand
+ * @param y The second operand
+ * @return The low 64 bits of the carry-less product
  */
-static void add_mul(uint8_t *a,
-                    const uint8_t *x, 
-                    size_t x_len,
-                    const uint8_t *y)
-{
-    int32_t i, j;
-    uint8_t a_bits[128], y_bits[128];
-    uint8_t axy_bits[256];
-    
-    for (i = 0; i < (int)x_len; ++i)
-    {
-        a[i] ^= x[i];
-    }
+static uint64_t bmul64(uint64_t x, uint64_t y)
+{
+    uint64_t x0, x1, x2, x3;
+    uint64_t y0, y1, y2, y3;
+    uint64_t z0, z1, z2, z3;
 
-    /* Performs reflection on (a + x) and y */
-    for (i = 0; i < 128; ++i)
-    {
-        a_bits[i] = (a[i >> 3] >> (7 - (i & 7))) & 1;
-        y_bits[i] = (y[i >> 3] >> (7 - (i & 7))) & 1;
-    }
+    x0 = x & (uint64_t)0x1111111111111111;
+    x1 = x & (uint64_t)0x2222222222222222;
+    x2 = x & (uint64_t)0x4444444444444444;
+    x3 = x & (uint64_t)0x8888888888888888;
+    y0 = y & (uint64_t)0x1111111111111111;
+    y1 = y & (uint64_t)0x2222222222222222;
+    y2 = y & (uint64_t)0x4444444444444444;
+    y3 = y & (uint64_t)0x8888888888888888;
+    z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+    z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+    z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+    z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+    z0 &= (uint64_t)0x1111111111111111;
+    z1 &= (uint64_t)0x2222222222222222;
+    z2 &= (uint64_t)0x4444444444444444;
+    z3 &= (uint64_t)0x8888888888888888;
 
-    crypto_memzero(axy_bits, sizeof(axy_bits));
-    for (i = 0; i < 128; ++i)
-    {
-        for (j = 0; j < 128; ++j)
-        {
-            axy_bits[i + j] ^= a_bits[i] & y_bits[j];
-        }
-    }
+    return z0 | z1 | z2 | z3;
+}
 
-    /**
-     * Galois field reduction, GF(2^128) is defined 
-     * by polynomial x^128 + x^7 + x^2 + 1
-     */
-    for (i = 127; i >= 0; --i)
-    {
-        axy_bits[i]       ^= axy_bits[i + 128];
-        axy_bits[i +   1] ^= axy_bits[i + 128];
-        axy_bits[i +   2] ^= axy_bits[i + 128];
-        axy_bits[i +   7] ^= axy_bits[i + 128];
-        axy_bits[i + 128] ^= axy_bits[i + 128];
-    }
+/**
+ * @brief Reverses the bit order of a 64-bit word.
+ */
+static uint64_t rev64(uint64_t x)
+{
+#define RMS(m, s) \
+    x = ((x & (uint64_t)(m)) << (s)) | ((x >> (s)) & (uint64_t)(m))
 
-    /* Undo the reflection on the output */
-    crypto_memzero(a, 16);
-    for (i = 0; i < 128; ++i)
-    {
-        a[i >> 3] |= (axy_bits[i] << (7 - (i & 7)));
-    }
+    RMS(0x5555555555555555,  1);
+    RMS(0x3333333333333333,  2);
+    RMS(0x0F0F0F0F0F0F0F0F,  4);
+    RMS(0x00FF00FF00FF00FF,  8);
+    RMS(0x0000FFFF0000FFFF, 16);
+
+#undef RMS
+    return (x << 32) | (x >> 32);
+}
+
+static void ghash_power_set(ghash_power *hp, uint64_t h1, uint64_t h0)
+{
+    hp->h0 = h0;
+    hp->h1 = h1;
+    hp->h2 = h0 ^ h1;
+    hp->h0r = rev64(h0);
+    hp->h1r = rev64(h1);
+    hp->h2r = hp->h0r ^ hp->h1r;
+}
+
+/**
+ * @brief Accumulates the unreduced 256-bit carry-less product of
+ * y = (y1:y0) and a power of H into {@code v}.
+ * 
+ * @note The low halves of the 64x64 products are computed with
+ * bmul64() directly, and the high halves with bmul64() on the bit
+ * reversed operands. Three such products are combined Karatsuba
+ * style.
+ * 
+ * @param v The 256-bit accumulator, v[0] being the least significant
+ * @param y1 The high word of the operand
+ * @param y0 The low word of the operand
+ * @param hp The power of H
+ */
+static void clmul128(uint64_t *v,
+                     uint64_t y1,
+                     uint64_t y0,
+                     const ghash_power *hp)
+{
+    uint64_t y2, y0r, y1r, y2r;
+    uint64_t z0, z1, z2, z0h, z1h, z2h;
+
+    y0r = rev64(y0);
+    y1r = rev64(y1);
+    y2 = y0 ^ y1;
+    y2r = y0r ^ y1r;
+
+    z0 = bmul64(y0, hp->h0);
+    z1 = bmul64(y1, hp->h1);
+    z2 = bmul64(y2, hp->h2);
+    z0h = bmul64(y0r, hp->h0r);
+    z1h = bmul64(y1r, hp->h1r);
+    z2h = bmul64(y2r, hp->h2r);
+    z2 ^= z0 ^ z1;
+    z2h ^= z0h ^ z1h;
+    z0h = rev64(z0h) >> 1;
+    z1h = rev64(z1h) >> 1;
+    z2h = rev64(z2h) >> 1;
+
+    v[0] ^= z0;
+    v[1] ^= z0h ^ z2;
+    v[2] ^= z1 ^ z2h;
+    v[3] ^= z1h;
+}
+
+/**
+ * @brief Reduces a 256-bit product modulo x^128 + x^7 + x^2 + 1.
+ * 
+ * @note GCM uses a bit-reflected representation, hence the product
+ * is first shifted by one bit.
+ * 
+ * @param y1 The high word of the result
+ * @param y0 The low word of the result
+ * @param v The 256-bit product
+ */
+static void reduce(uint64_t *y1, uint64_t *y0, const uint64_t *v)
+{
+    uint64_t v0, v1, v2, v3;
+
+    v3 = (v[3] << 1) | (v[2] >> 63);
+    v2 = (v[2] << 1) | (v[1] >> 63);
+    v1 = (v[1] << 1) | (v[0] >> 63);
+    v0 = (v[0] << 1);
+
+    v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+    v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+    v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+    v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+
+    *y0 = v2;
+    *y1 = v3;
 }
 
 static int32_t diff(const uint8_t *x, const uint8_t *y)
@@ -108,6 +205,186 @@ static int32_t diff(const uint8_t *x, const uint8_t *y)
     return (1 & ((result - 1) >> 8)) - 1;
 }
 
+/**
+ * @brief Encrypts or decrypts {@code len} bytes in counter mode,
+ * using the 32-bit big-endian counter held in the last four bytes
+ * of {@code J}.
+ * 
+ * @note The counter is pre-incremented, i.e. the first block uses
+ * {@code *index + 1}. On return {@code *index} holds the last
+ * counter value used.
+ * 
+ * @param out The output buffer, len bytes long
+ * @param in The input buffer, len bytes long
+ * @param len The length of the input in bytes
+ * @param J The counter block, 16 bytes
+ * @param index The pointer to the counter value
+ * @param ctx The initialised AES256 context
+ */
+static void ctr32_xor(uint8_t *out,
+                      const uint8_t *in,
+                      size_t len,
+                      uint8_t *J,
+                      uint32_t *index,
+                      const aes256_ctx *ctx)
+{
+    uint8_t stream[KEYSTREAM_BLOCKS * AES256_BLOCK_SIZE];
+    size_t i, num_blocks, stream_len;
+
+    while (len > 0)
+    {
+        num_blocks = 0;
+        stream_len = 0;
+        while ((num_blocks < KEYSTREAM_BLOCKS) && (stream_len < len))
+        {
+            ++(*index);
+            big_endian_store32(J + 12, *index);
+            memcpy(&stream[num_blocks * AES256_BLOCK_SIZE], J, 16);
+            stream_len += AES256_BLOCK_SIZE;
+            ++num_blocks;
+        }
+        aes256_encrypt_blocks(stream, stream, num_blocks, ctx);
+
+        if (len < stream_len)
+        {
+            stream_len = len;
+        }
+        for (i = 0; i < stream_len; ++i)
+        {
+            out[i] = in[i] ^ stream[i];
+        }
+
+        out += stream_len;
+        in += stream_len;
+        len -= stream_len;
+    }
+
+    crypto_memzero(stream, sizeof(stream));
+}
+
+/**
+ * @brief Derives the GHASH key H = E(K, 0^128) and precomputes
+ * H, H^2, H^3 and H^4.
+ * 
+ * @note The carry-less multiplication engine is used whenever the
+ * AES context uses AES-NI.
+ * 
+ * @param gk The output GHASH key
+ * @param ctx The initialised AES256 context
+ */
+static void ghash_init(ghash_key *gk, const aes256_ctx *ctx)
+{
+    uint64_t v[4];
+    uint64_t h1, h0;
+    int32_t i;
+
+    crypto_memzero(gk->H, sizeof(gk->H));
+    aes256_encrypt_block(gk->H, gk->H, ctx);
+
+    gk->clmul = ctx->aesni;
+    if (gk->clmul)
+    {
+        ghash_clmul_init(gk->table, gk->H);
+        return;
+    }
+
+    /* powers[i] holds H^(i + 1) */
+    h1 = big_endian_load64(gk->H);
+    h0 = big_endian_load64(gk->H + 8);
+    ghash_power_set(&gk->powers[0], h1, h0);
+    for (i = 1; i < 4; ++i)
+    {
+        crypto_memzero(v, sizeof(v));
+        clmul128(v, h1, h0, &gk->powers[0]);
+        reduce(&h1, &h0, v);
+        ghash_power_set(&gk->powers[i], h1, h0);
+    }
+
+    crypto_memzero(v, sizeof(v));
+    h1 = h0 = 0;
+}
+
+/**
+ * @brief Absorbs {@code len} bytes into the GHASH accumulator,
+ * zero-padding the last partial block.
+ * 
+ * @note The portable engine processes four blocks at a time,
+ * multiplying them by H^4, H^3, H^2 and H and reducing the sum
+ * of the products once.
+ * 
+ * @param accum The GHASH accumulator, 16 bytes
+ * @param gk The GHASH key
+ * @param x The input buffer
+ * @param len The length of the input in bytes
+ */
+static void ghash(uint8_t *accum,
+                  const ghash_key *gk,
+                  const uint8_t *x,
+                  size_t len)
+{
+    uint64_t v[4] = {0};
+    uint64_t y1, y0;
+    uint8_t tail[16] = {0};
+    size_t i;
+
+    if (gk->clmul)
+    {
+        ghash_clmul(accum, gk->table, x, len);
+        return;
+    }
+
+    y1 = big_endian_load64(accum);
+    y0 = big_endian_load64(accum + 8);
+
+    while (len >= 64)
+    {
+        crypto_memzero(v, sizeof(v));
+        clmul128(v, y1 ^ big_endian_load64(x),
+                 y0 ^ big_endian_load64(x + 8), &gk->powers[3]);
+        for (i = 1; i < 4; ++i)
+        {
+            clmul128(v, big_endian_load64(x + 16 * i),
+                     big_endian_load64(x + 16 * i + 8),
+                     &gk->powers[3 - i]);
+        }
+        reduce(&y1, &y0, v);
+        x += 64;
+        len -= 64;
+    }
+
+    while (len > 0)
+    {
+        if (len < 16)
+        {
+            memcpy(tail, x, len);
+            x = tail;
+            len = 16;
+        }
+        crypto_memzero(v, sizeof(v));
+        clmul128(v, y1 ^ big_endian_load64(x),
+                 y0 ^ big_endian_load64(x + 8), &gk->powers[0]);
+        reduce(&y1, &y0, v);
+        x += 16;
+        len -= 16;
+    }
+
+    big_endian_store64(accum, y1);
+    big_endian_store64(accum + 8, y0);
+
+    crypto_memzero(v, sizeof(v));
+    crypto_memzero(tail, sizeof(tail));
+}
+
+/**
+ * @brief Tells whether {@code len} more bytes, after {@code done},
+ * keep a message within AES256GCM_MAX_MSG_SIZE bytes.
+ */
+static bool gcm_fits(uint64_t done, size_t len)
+{
+    return (uint64_t)len <= AES256GCM_MAX_MSG_SIZE &&
+           done <= AES256GCM_MAX_MSG_SIZE - (uint64_t)len;
+}
+
 int32_t aes256gcm_encrypt(uint8_t* c,
                           size_t *c_len,
                           const uint8_t* msg,
@@ -117,22 +394,26 @@ int32_t aes256gcm_encrypt(uint8_t* c,
                           const uint8_t* nonce,
                           const uint8_t* key)
 {
-    uint8_t H[16];
+    aes256_ctx ctx;
+    ghash_key gk;
     uint8_t J[16];
     uint8_t T[16];
-    uint8_t Z[16];
     uint8_t accum[16];
-    uint8_t stream[16];
     uint8_t final_block[16];
-	uint32_t i, index;
-    size_t block_len;
+    uint32_t i, index;
+
+    if (!gcm_fits(0, msg_len))
+    {
+        return -1;
+    }
 
     *c_len = msg_len + 16;
     big_endian_store64(final_block, 8 * aad_len);
     big_endian_store64(final_block + 8, 8 * msg_len);
 
-    crypto_memzero(Z, sizeof(Z));
-    aes256_bitslice_encrypt(H, Z, key);
+    aes256_init(&ctx, key);
+
+    ghash_init(&gk, &ctx);
 
     for (i = 0; i < 12; ++i) 
     {
@@ -140,48 +421,26 @@ int32_t aes256gcm_encrypt(uint8_t* c,
     }
     index = 1;
     big_endian_store32(J + 12, index);
-    aes256_bitslice_encrypt(T, J, key);
+    aes256_encrypt_block(T, J, &ctx);
 
     crypto_memzero(accum, sizeof(accum));
+    ghash(accum, &gk, aad, aad_len);
 
-    while (aad_len > 0)
-    {
-        block_len = 16;
-        if (aad_len < block_len) 
-        {
-            block_len = aad_len;
-        }
-        add_mul(accum, aad, block_len, H);
-        aad += block_len;
-        aad_len -= block_len;
-    }
+    ctr32_xor(c, msg, msg_len, J, &index, &ctx);
+    ghash(accum, &gk, c, msg_len);
+    c += msg_len;
 
-    while (msg_len > 0)
-    {
-        block_len = 16;
-        if (msg_len < block_len) 
-        {
-            block_len = msg_len;
-        }
-        ++index;
-        big_endian_store32(J + 12, index);
-        aes256_bitslice_encrypt(stream, J, key);
-        for (i = 0; i < block_len; ++i)
-        {
-            c[i] = msg[i] ^ stream[i];
-        }
-        add_mul(accum, c, block_len, H);
-        c += block_len;
-        msg += block_len;
-        msg_len -= block_len;
-    }
-
-    add_mul(accum, final_block, 16, H);
+    ghash(accum, &gk, final_block, sizeof(final_block));
     for (i = 0; i < 16; ++i)
     {
         c[i] = T[i] ^ accum[i];
     }
 
+    aes256_wipe(&ctx);
+    crypto_memzero(&gk, sizeof(gk));
+    crypto_memzero(T, sizeof(T));
+    crypto_memzero(accum, sizeof(accum));
+
     return 0;
 }
 
@@ -194,20 +453,17 @@ int32_t aes256gcm_decrypt(uint8_t *msg,
                           const uint8_t *nonce,
                           const uint8_t *key)
 {
-    uint8_t H[16];
+    aes256_ctx ctx;
+    ghash_key gk;
     uint8_t J[16];
     uint8_t T[16];
-    uint8_t Z[16];
     uint8_t accum[16];
-    uint8_t stream[16];
     uint8_t final_block[16];
-    size_t block_len = 16;
     size_t m_len;
-    size_t orig_m_len;
     uint32_t i, index;
-    const uint8_t *orig_c;
+    int32_t result = 0;
 
-    if (c_len < 16)
+    if (c_len < 16 || !gcm_fits(0, c_len - 16))
     {
         return -1;
     }
@@ -216,8 +472,9 @@ int32_t aes256gcm_decrypt(uint8_t *msg,
     big_endian_store64(final_block, 8 * aad_len);
     big_endian_store64(final_block + 8, 8 * m_len);
 
-    crypto_memzero(Z, sizeof(Z));
-    aes256_bitslice_encrypt(H, Z, key);
+    aes256_init(&ctx, key);
+
+    ghash_init(&gk, &ctx);
 
     for (i = 0; i < 12; ++i) 
     {
@@ -225,70 +482,621 @@ int32_t aes256gcm_decrypt(uint8_t *msg,
     }
     index = 1;
     big_endian_store32(J + 12, index);
-    aes256_bitslice_encrypt(T, J, key);
+    aes256_encrypt_block(T, J, &ctx);
 
     crypto_memzero(accum, sizeof(accum));
+    ghash(accum, &gk, aad, aad_len);
+    ghash(accum, &gk, c, m_len);
 
-    while (aad_len > 0)
+    ghash(accum, &gk, final_block, sizeof(final_block));
+    for (i = 0; i < 16; ++i) 
+    {
+        accum[i] ^= T[i];
+    }
+    
+    /* Compare GCM tag */
+    if (diff(accum, c + m_len) != 0) 
     {
-        block_len = 16;
-        if (aad_len < block_len) 
+        result = -1;
+        goto decrypt_bail;
+    }
+
+    *msg_len = m_len;
+    ctr32_xor(msg, c, m_len, J, &index, &ctx);
+
+decrypt_bail:
+    aes256_wipe(&ctx);
+    crypto_memzero(&gk, sizeof(gk));
+    crypto_memzero(T, sizeof(T));
+    crypto_memzero(accum, sizeof(accum));
+
+    return result;
+}
+
+void aes256gcm_init(aes256gcm_ctx *gcm,
+                    const uint8_t *aad,
+                    size_t aad_len,
+                    const uint8_t *nonce,
+                    const uint8_t *key)
+{
+    uint32_t i;
+
+    aes256_init(&gcm->ctx, key);
+
+    ghash_init(&gcm->gk, &gcm->ctx);
+
+    for (i = 0; i < 12; ++i) 
+    {
+        gcm->J[i] = nonce[i];
+    }
+    gcm->index = 1;
+    big_endian_store32(gcm->J + 12, gcm->index);
+    aes256_encrypt_block(gcm->T, gcm->J, &gcm->ctx);
+
+    crypto_memzero(gcm->accum, sizeof(gcm->accum));
+    ghash(gcm->accum, &gcm->gk, aad, aad_len);
+
+    gcm->pending_len = 0;
+    gcm->stream_pos = AES256_BLOCK_SIZE;
+    gcm->aad_len = aad_len;
+    gcm->msg_len = 0;
+    gcm->verified = false;
+}
+
+/**
+ * @brief Returns the number of bytes of the message run through
+ * counter mode by an incremental context in the current pass.
+ */
+static uint64_t gcm_stream_len(const aes256gcm_ctx *gcm)
+{
+    return (uint64_t)(gcm->index - 1) * AES256_BLOCK_SIZE
+        - (AES256_BLOCK_SIZE - gcm->stream_pos);
+}
+
+/**
+ * @brief Absorbs ciphertext into the GHASH accumulator of an
+ * incremental context, keeping back the last partial block.
+ */
+static void gcm_absorb(aes256gcm_ctx *gcm, const uint8_t *x, size_t len)
+{
+    size_t n;
+
+    gcm->msg_len += len;
+
+    if (gcm->pending_len > 0)
+    {
+        n = sizeof(gcm->pending) - gcm->pending_len;
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(gcm->pending + gcm->pending_len, x, n);
+        gcm->pending_len += n;
+        x += n;
+        len -= n;
+        if (gcm->pending_len < sizeof(gcm->pending))
         {
-            block_len = aad_len;
+            return;
         }
-        add_mul(accum, aad, block_len, H);
-        aad += block_len;
-        aad_len -= block_len;
+        ghash(gcm->accum, &gcm->gk, gcm->pending, sizeof(gcm->pending));
+        gcm->pending_len = 0;
+    }
+
+    n = len & ~(size_t)15;
+    ghash(gcm->accum, &gcm->gk, x, n);
+    memcpy(gcm->pending, x + n, len - n);
+    gcm->pending_len = len - n;
+}
+
+/**
+ * @brief Runs counter mode for an incremental context, keeping the
+ * unused part of the last keystream block for the next call.
+ */
+static void gcm_xor_keystream(aes256gcm_ctx *gcm,
+                              uint8_t *out,
+                              const uint8_t *in,
+                              size_t len)
+{
+    size_t i, n;
+
+    while (len > 0 && gcm->stream_pos < AES256_BLOCK_SIZE)
+    {
+        *out++ = *in++ ^ gcm->stream[gcm->stream_pos++];
+        --len;
     }
 
-    orig_c = c;
-    orig_m_len = m_len;
-    while (m_len > 0)
+    n = len & ~(size_t)15;
+    ctr32_xor(out, in, n, gcm->J, &gcm->index, &gcm->ctx);
+    out += n;
+    in += n;
+    len -= n;
+
+    if (len > 0)
     {
-        block_len = 16;
-        if (m_len < block_len) 
+        ++gcm->index;
+        big_endian_store32(gcm->J + 12, gcm->index);
+        aes256_encrypt_block(gcm->stream, gcm->J, &gcm->ctx);
+        for (i = 0; i < len; ++i)
         {
-            block_len = m_len;
+            out[i] = in[i] ^ gcm->stream[i];
         }
-        add_mul(accum, c, block_len, H);
-        c += block_len;
-        m_len -= block_len;
+        gcm->stream_pos = len;
     }
+}
 
-    add_mul(accum, final_block, 16, H);
-    for (i = 0; i < 16; ++i) 
+/**
+ * @brief Computes the tag of an incremental context.
+ */
+static void gcm_tag(aes256gcm_ctx *gcm, uint8_t *tag)
+{
+    uint8_t final_block[16];
+    uint32_t i;
+
+    ghash(gcm->accum, &gcm->gk, gcm->pending, gcm->pending_len);
+    gcm->pending_len = 0;
+
+    big_endian_store64(final_block, 8 * gcm->aad_len);
+    big_endian_store64(final_block + 8, 8 * gcm->msg_len);
+    ghash(gcm->accum, &gcm->gk, final_block, sizeof(final_block));
+    for (i = 0; i < 16; ++i)
     {
-        accum[i] ^= T[i];
+        tag[i] = gcm->T[i] ^ gcm->accum[i];
     }
-    
-    /* Compare GCM tag */
-    if (diff(accum, c) != 0) 
+}
+
+int32_t aes256gcm_encrypt_update(aes256gcm_ctx *gcm,
+                                 uint8_t *c,
+                                 const uint8_t *msg,
+                                 size_t len)
+{
+    if (!gcm_fits(gcm->msg_len, len))
     {
         return -1;
     }
 
-    c = orig_c;
-    m_len = orig_m_len;
-    *msg_len = m_len;
+    gcm_xor_keystream(gcm, c, msg, len);
+    gcm_absorb(gcm, c, len);
 
-    while (m_len > 0)
+    return 0;
+}
+
+void aes256gcm_encrypt_final(aes256gcm_ctx *gcm, uint8_t *tag)
+{
+    gcm_tag(gcm, tag);
+    aes256gcm_wipe(gcm);
+}
+
+int32_t aes256gcm_authenticate(aes256gcm_ctx *gcm,
+                               const uint8_t *c,
+                               size_t len)
+{
+    if (!gcm_fits(gcm->msg_len, len))
     {
-        block_len = 16;
-        if (m_len < block_len)
+        return -1;
+    }
+
+    gcm_absorb(gcm, c, len);
+
+    return 0;
+}
+
+int32_t aes256gcm_verify(aes256gcm_ctx *gcm, const uint8_t *tag)
+{
+    uint8_t expected[16];
+    int32_t result;
+
+    gcm_tag(gcm, expected);
+    result = diff(expected, tag);
+    crypto_memzero(expected, sizeof(expected));
+    crypto_memzero(gcm->accum, sizeof(gcm->accum));
+
+    /* Rewind the counter for the second pass */
+    gcm->verified = (result == 0);
+    gcm->index = 1;
+    gcm->stream_pos = AES256_BLOCK_SIZE;
+
+    return result;
+}
+
+int32_t aes256gcm_decrypt_update(aes256gcm_ctx *gcm,
+                                 uint8_t *msg,
+                                 const uint8_t *c,
+                                 size_t len)
+{
+    if (!gcm->verified || !gcm_fits(gcm_stream_len(gcm), len))
+    {
+        return -1;
+    }
+
+    gcm_xor_keystream(gcm, msg, c, len);
+
+    return 0;
+}
+
+int32_t aes256gcm_decrypt_skip(aes256gcm_ctx *gcm, size_t len)
+{
+    size_t n;
+
+    if (!gcm->verified || !gcm_fits(gcm_stream_len(gcm), len))
+    {
+        return -1;
+    }
+
+    n = AES256_BLOCK_SIZE - gcm->stream_pos;
+    if (n > len)
+    {
+        n = len;
+    }
+    gcm->stream_pos += n;
+    len -= n;
+
+    gcm->index += (uint32_t)(len / AES256_BLOCK_SIZE);
+    len %= AES256_BLOCK_SIZE;
+    if (len > 0)
+    {
+        ++gcm->index;
+        big_endian_store32(gcm->J + 12, gcm->index);
+        aes256_encrypt_block(gcm->stream, gcm->J, &gcm->ctx);
+        gcm->stream_pos = len;
+    }
+
+    return 0;
+}
+
+void aes256gcm_wipe(aes256gcm_ctx *gcm)
+{
+    aes256_wipe(&gcm->ctx);
+    crypto_memzero(gcm, sizeof(aes256gcm_ctx));
+}
+
+/**
+ * @brief Multiplies x = (x1:x0) by y = (y1:y0) in GF(2^128).
+ */
+static void gf_mul(uint64_t *x1, uint64_t *x0, uint64_t y1, uint64_t y0)
+{
+    ghash_power hp;
+    uint64_t v[4] = {0};
+
+    ghash_power_set(&hp, y1, y0);
+    clmul128(v, *x1, *x0, &hp);
+    reduce(x1, x0, v);
+
+    crypto_memzero(&hp, sizeof(hp));
+    crypto_memzero(v, sizeof(v));
+}
+
+/**
+ * @brief Computes H^e, e > 0, by square-and-multiply.
+ * 
+ * @note The exponent is a number of blocks, which is public.
+ */
+static void gf_pow(uint64_t *r1, uint64_t *r0, const uint8_t *H, size_t e)
+{
+    uint64_t h1 = big_endian_load64(H);
+    uint64_t h0 = big_endian_load64(H + 8);
+    int32_t bit = 8 * (int32_t)sizeof(e) - 1;
+
+    while (((e >> bit) & 1) == 0)
+    {
+        --bit;
+    }
+
+    *r1 = h1;
+    *r0 = h0;
+    for (--bit; bit >= 0; --bit)
+    {
+        gf_mul(r1, r0, *r1, *r0);
+        if ((e >> bit) & 1)
         {
-            block_len = m_len;
+            gf_mul(r1, r0, h1, h0);
         }
-        ++index;
-        big_endian_store32(J + 12, index);
-        aes256_bitslice_encrypt(stream, J, key);
-        for (i = 0; i < block_len; ++i)
+    }
+
+    h1 = h0 = 0;
+}
+
+/**
+ * @brief The shared state of the segments of a parallel GCM
+ * operation.
+ * 
+ * @note A segment may be run through counter mode from {@code in}
+ * to {@code out}, and the GHASH of its part of {@code hashed} is
+ * computed into {@code partials} from a zero accumulator.
+ */
+typedef struct
+{
+    const aes256_ctx *ctx;
+    const ghash_key *gk;
+    const uint8_t *J;
+    uint8_t *out;
+    const uint8_t *in;
+    const uint8_t *hashed;
+    size_t len;
+    size_t segment_size;
+    bool ctr;
+    uint8_t (*partials)[16];
+} gcm_segments;
+
+static void gcm_segment_task(void *arg, size_t index)
+{
+    gcm_segments *segs = (gcm_segments *)arg;
+    size_t offset = index * segs->segment_size;
+    size_t len = segs->len - offset;
+    uint8_t J[16];
+    uint32_t counter;
+
+    if (len > segs->segment_size)
+    {
+        len = segs->segment_size;
+    }
+
+    if (segs->ctr)
+    {
+        memcpy(J, segs->J, sizeof(J));
+        counter = 1 + (uint32_t)(offset / AES256_BLOCK_SIZE);
+        ctr32_xor(segs->out + offset, segs->in + offset, len,
+                  J, &counter, segs->ctx);
+        crypto_memzero(J, sizeof(J));
+    }
+    if (segs->hashed != NULL)
+    {
+        crypto_memzero(segs->partials[index], 16);
+        ghash(segs->partials[index], segs->gk, segs->hashed + offset, len);
+    }
+}
+
+/**
+ * @brief Runs the segments on the pool, or on the calling thread
+ * if it is NULL.
+ */
+static void gcm_segments_run(gcm_segments *segs,
+                             size_t num_segments,
+                             struct bdap_thread_pool *pool)
+{
+    size_t i;
+
+    if (pool != NULL && num_segments > 1)
+    {
+        bdap_thread_pool_run(pool, num_segments, gcm_segment_task, segs);
+    }
+    else
+    {
+        for (i = 0; i < num_segments; ++i)
         {
-            msg[i] = c[i] ^ stream[i];
+            gcm_segment_task(segs, i);
         }
-        c += block_len;
-        msg += block_len;
-        m_len -= block_len;
     }
+}
+
+/**
+ * @brief Folds the partial GHASHes of the segments into the
+ * accumulator.
+ * 
+ * @note A segment of m blocks hashed from zero contributes
+ * X_1 H^m + ... + X_m H, so that accum = accum H^m + P_i for every
+ * segment in order gives the same result as a single pass.
+ * 
+ * @param accum The GHASH accumulator, 16 bytes
+ * @param gk The GHASH key
+ * @param segs The segments, with their partial GHASHes
+ * @param num_segments The number of segments
+ */
+static void ghash_combine(uint8_t *accum,
+                          const ghash_key *gk,
+                          const gcm_segments *segs,
+                          size_t num_segments)
+{
+    uint64_t y1, y0, s1, s0, t1, t0;
+    size_t i, last_blocks;
+
+    gf_pow(&s1, &s0, gk->H, segs->segment_size / 16);
+    last_blocks = (segs->len - (num_segments - 1) * segs->segment_size + 15) / 16;
+    gf_pow(&t1, &t0, gk->H, last_blocks);
+
+    y1 = big_endian_load64(accum);
+    y0 = big_endian_load64(accum + 8);
+    for (i = 0; i < num_segments; ++i)
+    {
+        if (i + 1 < num_segments)
+        {
+            gf_mul(&y1, &y0, s1, s0);
+        }
+        else
+        {
+            gf_mul(&y1, &y0, t1, t0);
+        }
+        y1 ^= big_endian_load64(segs->partials[i]);
+        y0 ^= big_endian_load64(segs->partials[i] + 8);
+    }
+    big_endian_store64(accum, y1);
+    big_endian_store64(accum + 8, y0);
+
+    y1 = y0 = s1 = s0 = t1 = t0 = 0;
+}
+
+/**
+ * @brief Splits {@code len} bytes into at most MAX_SEGMENTS segments
+ * of a multiple of the block size, and of at least MIN_SEGMENT_SIZE
+ * bytes.
+ * 
+ * @return the number of segments
+ */
+static size_t gcm_segments_init(gcm_segments *segs, size_t len)
+{
+    size_t segment_size = (len + MAX_SEGMENTS - 1) / MAX_SEGMENTS;
+
+    segment_size = (segment_size + 15) & ~(size_t)15;
+    if (segment_size < MIN_SEGMENT_SIZE)
+    {
+        segment_size = MIN_SEGMENT_SIZE;
+    }
+    segs->len = len;
+    segs->segment_size = segment_size;
+
+    return (len + segment_size - 1) / segment_size;
+}
+
+int32_t aes256gcm_encrypt_parallel(uint8_t* c,
+                                   size_t *c_len,
+                                   const uint8_t* msg,
+                                   size_t msg_len,
+                                   const uint8_t* aad,
+                                   size_t aad_len,
+                                   const uint8_t* nonce,
+                                   const uint8_t* key,
+                                   struct bdap_thread_pool *pool)
+{
+    aes256_ctx ctx;
+    ghash_key gk;
+    gcm_segments segs;
+    uint8_t partials[MAX_SEGMENTS][16];
+    uint8_t J[16];
+    uint8_t T[16];
+    uint8_t accum[16];
+    uint8_t final_block[16];
+    size_t num_segments;
+    uint32_t i;
+
+    if (!gcm_fits(0, msg_len))
+    {
+        return -1;
+    }
+
+    *c_len = msg_len + 16;
+    big_endian_store64(final_block, 8 * aad_len);
+    big_endian_store64(final_block + 8, 8 * msg_len);
+
+    aes256_init(&ctx, key);
+
+    ghash_init(&gk, &ctx);
+
+    for (i = 0; i < 12; ++i) 
+    {
+        J[i] = nonce[i];
+    }
+    big_endian_store32(J + 12, 1);
+    aes256_encrypt_block(T, J, &ctx);
+
+    crypto_memzero(accum, sizeof(accum));
+    ghash(accum, &gk, aad, aad_len);
+
+    if (msg_len > 0)
+    {
+        num_segments = gcm_segments_init(&segs, msg_len);
+        segs.ctx = &ctx;
+        segs.gk = &gk;
+        segs.J = J;
+        segs.out = c;
+        segs.in = msg;
+        segs.hashed = c;
+        segs.ctr = true;
+        segs.partials = partials;
+        gcm_segments_run(&segs, num_segments, pool);
+        ghash_combine(accum, &gk, &segs, num_segments);
+    }
+    c += msg_len;
+
+    ghash(accum, &gk, final_block, sizeof(final_block));
+    for (i = 0; i < 16; ++i)
+    {
+        c[i] = T[i] ^ accum[i];
+    }
+
+    aes256_wipe(&ctx);
+    crypto_memzero(&gk, sizeof(gk));
+    crypto_memzero(T, sizeof(T));
+    crypto_memzero(accum, sizeof(accum));
 
     return 0;
 }
+
+int32_t aes256gcm_decrypt_parallel(uint8_t *msg,
+                                   size_t *msg_len,
+                                   const uint8_t *c,
+                                   size_t c_len,
+                                   const uint8_t *aad,
+                                   size_t aad_len,
+                                   const uint8_t *nonce,
+                                   const uint8_t *key,
+                                   struct bdap_thread_pool *pool)
+{
+    aes256_ctx ctx;
+    ghash_key gk;
+    gcm_segments segs;
+    uint8_t partials[MAX_SEGMENTS][16];
+    uint8_t J[16];
+    uint8_t T[16];
+    uint8_t accum[16];
+    uint8_t final_block[16];
+    size_t m_len, num_segments = 0;
+    uint32_t i;
+    int32_t result = 0;
+
+    if (c_len < 16 || !gcm_fits(0, c_len - 16))
+    {
+        return -1;
+    }
+    m_len = c_len - 16;
+
+    big_endian_store64(final_block, 8 * aad_len);
+    big_endian_store64(final_block + 8, 8 * m_len);
+
+    aes256_init(&ctx, key);
+
+    ghash_init(&gk, &ctx);
+
+    for (i = 0; i < 12; ++i) 
+    {
+        J[i] = nonce[i];
+    }
+    big_endian_store32(J + 12, 1);
+    aes256_encrypt_block(T, J, &ctx);
+
+    crypto_memzero(accum, sizeof(accum));
+    ghash(accum, &gk, aad, aad_len);
+
+    /* The tag is verified before anything is decrypted */
+    if (m_len > 0)
+    {
+        num_segments = gcm_segments_init(&segs, m_len);
+        segs.ctx = &ctx;
+        segs.gk = &gk;
+        segs.J = J;
+        segs.out = msg;
+        segs.in = c;
+        segs.hashed = c;
+        segs.ctr = false;
+        segs.partials = partials;
+        gcm_segments_run(&segs, num_segments, pool);
+        ghash_combine(accum, &gk, &segs, num_segments);
+    }
+
+    ghash(accum, &gk, final_block, sizeof(final_block));
+    for (i = 0; i < 16; ++i) 
+    {
+        accum[i] ^= T[i];
+    }
+    
+    /* Compare GCM tag */
+    if (diff(accum, c + m_len) != 0) 
+    {
+        result = -1;
+        goto decrypt_parallel_bail;
+    }
+
+    *msg_len = m_len;
+    if (m_len > 0)
+    {
+        segs.hashed = NULL;
+        segs.ctr = true;
+        gcm_segments_run(&segs, num_segments, pool);
+    }
+
+decrypt_parallel_bail:
+    aes256_wipe(&ctx);
+    crypto_memzero(&gk, sizeof(gk));
+    crypto_memzero(T, sizeof(T));
+    crypto_memzero(accum, sizeof(accum));
+
+    return result;
+}
@@ -2,25 +2,55 @@
 // See LICENSE.md file for license, copying and use information.
 
 #include "curve25519.h"
+#include "curve25519_avx2.h"
 #include "fe.h"
+#include "ge.h"
 #include "utils.h"
 #include "rand.h"
 
+static volatile bool hardware_enabled = true;
+
 /**
- * @brief Performs curve25519 Diffie-Hellman exchange between point p and scalar n.
+ * @brief Clamps the scalar n into e.
+ */
+static void clamp_scalar(uint8_t *e, const uint8_t *n)
+{
+    uint32_t i;
+
+    /**
+     * From curve25519 specification, one needs to ensure that:
+     * - the bits 0, 1 and 2 of the first byte should be clear
+     * - the bit 7 of the last byte should also be clear
+     * - the bit 6 of the last byte should be set
+     */
+    for (i = 0; i < CURVE25519_SCALAR_SIZE; ++i)
+    {
+        e[i] = n[i];
+    }
+    e[ 0] &= 0xf8; /* Clear bits 0, 1, and 2 */
+    e[31] &= 0x7f; /* Clear bit 7 */
+    e[31] |= 0x40; /* Set bit 6 */
+}
+
+/**
+ * @brief Performs curve25519 Diffie-Hellman exchange between point p and
+ * scalar n, leaving the result in projective (X:Z) form.
  * 
- * @note q = [n].p
+ * @note [n].p = X/Z, the division is left to the caller so that several
+ * results can be normalised with a single inversion, see
+ * fe_batch_inv(fe*, const fe*, size_t).
  * 
- * @param q The scalar multiplication output
+ * @param x The X coordinate of the scalar multiplication output
+ * @param z The Z coordinate of the scalar multiplication output
  * @param n The scalar value, 32 bytes
  * @param p The curve25519 point, 32 bytes
  * @return true on success
  * @return false on failure, e.g invalid point
  */
-bool curve25519_dh(uint8_t *q, const uint8_t *n, const uint8_t *p)
+bool curve25519_dh_projective(fe x, fe z, const uint8_t *n, const uint8_t *p)
 {
     uint8_t e[CURVE25519_SCALAR_SIZE];
-    uint32_t i, b, swap;
+    uint32_t b, swap;
     fe x1, x2, x3;
     fe z2, z3;
     fe t0, t1;
@@ -31,19 +61,7 @@ bool curve25519_dh(uint8_t *q, const uint8_t *n, const uint8_t *p)
         return false;
     }
 
-    /**
-     * From curve25519 specification, one needs to ensure that:
-     * - the bits 0, 1 and 2 of the first byte should be clear
-     * - the bit 7 of the last byte should also be clear
-     * - the bit 6 of the last byte should be set
-     */
-    for (i = 0; i < CURVE25519_SCALAR_SIZE; ++i)
-    {
-        e[i] = n[i];
-    }
-    e[ 0] &= 0xf8; /* Clear bits 0, 1, and 2 */
-    e[31] &= 0x7f; /* Clear bit 7 */
-    e[31] |= 0x40; /* Set bit 6 */
+    clamp_scalar(e, n);
 
     fe_frombytes(x1, p);
     fe_one(x2);
@@ -82,9 +100,170 @@ bool curve25519_dh(uint8_t *q, const uint8_t *n, const uint8_t *p)
     fe_swap(x2, x3, swap);
     fe_swap(z2, z3, swap);
 
-    fe_inv(z2, z2);
-    fe_mul(x2, x2, z2);
-    fe_tobytes(q, x2);
+    fe_copy(x, x2);
+    fe_copy(z, z2);
+
+    crypto_memzero(e, sizeof(e));
+
+    return true;
+}
+
+bool curve25519_use_hardware(bool enable)
+{
+    hardware_enabled = enable;
+    return curve25519_hardware_enabled();
+}
+
+bool curve25519_hardware_enabled(void)
+{
+    return hardware_enabled && curve25519_avx2_available();
+}
+
+/**
+ * @brief Performs four curve25519 Diffie-Hellman exchanges between the
+ * points p[0], ..., p[3] and the same scalar n, leaving the results in
+ * projective (X:Z) form.
+ * 
+ * @note The four Montgomery ladders run in lockstep on AVX2 when it is
+ * available, and one after another otherwise.
+ * 
+ * @param x The X coordinates of the outputs, 4 field elements
+ * @param z The Z coordinates of the outputs, 4 field elements
+ * @param n The scalar value, 32 bytes
+ * @param p The four curve25519 points, 32 bytes each
+ * @return true on success
+ * @return false on failure, e.g one of the points is invalid
+ */
+bool curve25519_dh_x4(fe *x, fe *z, const uint8_t *n, const uint8_t *const *p)
+{
+    uint8_t e[CURVE25519_SCALAR_SIZE];
+    uint8_t xs[4*CURVE25519_POINT_SIZE], zs[4*CURVE25519_POINT_SIZE];
+    uint32_t i;
+
+    if (false == curve25519_hardware_enabled())
+    {
+        for (i = 0; i < 4; ++i)
+        {
+            if (false == curve25519_dh_projective(x[i], z[i], n, p[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    for (i = 0; i < 4; ++i)
+    {
+        if (fe_has_small_order(p[i]))
+        {
+            return false;
+        }
+    }
+
+    clamp_scalar(e, n);
+    curve25519_avx2_ladder_x4(xs, zs, e, p);
+    for (i = 0; i < 4; ++i)
+    {
+        fe_frombytes(x[i], &xs[CURVE25519_POINT_SIZE*i]);
+        fe_frombytes(z[i], &zs[CURVE25519_POINT_SIZE*i]);
+    }
+
+    crypto_memzero(e, sizeof(e));
+    crypto_memzero(xs, sizeof(xs));
+    crypto_memzero(zs, sizeof(zs));
+
+    return true;
+}
+
+/**
+ * @brief Performs curve25519 Diffie-Hellman exchanges between the points
+ * p[0], ..., p[num - 1] and the same scalar n, leaving the results in
+ * projective (X:Z) form.
+ * 
+ * @note The points are processed four at a time with
+ * curve25519_dh_x4(fe*, fe*, const uint8_t*, const uint8_t* const*).
+ * A trailing group of three points is padded to four when the AVX2
+ * engine is in use, as four lanes cost less than three scalar ladders.
+ * 
+ * @param x The X coordinates of the outputs, num field elements
+ * @param z The Z coordinates of the outputs, num field elements
+ * @param n The scalar value, 32 bytes
+ * @param p The curve25519 points, 32 bytes each
+ * @param num The number of points
+ * @return true on success
+ * @return false on failure, e.g one of the points is invalid
+ */
+bool curve25519_dh_batch(fe *x,
+                         fe *z,
+                         const uint8_t *n,
+                         const uint8_t *const *p,
+                         size_t num)
+{
+    const uint8_t *pad[4];
+    fe xt[4], zt[4];
+    size_t i, j, rest;
+    bool result = true;
+
+    for (i = 0; i + 4 <= num; i += 4)
+    {
+        if (false == curve25519_dh_x4(&x[i], &z[i], n, &p[i]))
+        {
+            return false;
+        }
+    }
+
+    rest = num - i;
+    if (rest == 3 && curve25519_hardware_enabled())
+    {
+        for (j = 0; j < 4; ++j)
+        {
+            pad[j] = p[i + (j < rest ? j : 0)];
+        }
+        result = curve25519_dh_x4(xt, zt, n, pad);
+        for (j = 0; j < rest; ++j)
+        {
+            fe_copy(x[i + j], xt[j]);
+            fe_copy(z[i + j], zt[j]);
+        }
+        crypto_memzero(xt, sizeof(xt));
+        crypto_memzero(zt, sizeof(zt));
+        return result;
+    }
+
+    for (; i < num; ++i)
+    {
+        if (false == curve25519_dh_projective(x[i], z[i], n, p[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Performs curve25519 Diffie-Hellman exchange between point p and scalar n.
+ * 
+ * @note q = [n].p
+ * 
+ * @param q The scalar multiplication output
+ * @param n The scalar value, 32 bytes
+ * @param p The curve25519 point, 32 bytes
+ * @return true on success
+ * @return false on failure, e.g invalid point
+ */
+bool curve25519_dh(uint8_t *q, const uint8_t *n, const uint8_t *p)
+{
+    fe x, z;
+
+    if (false == curve25519_dh_projective(x, z, n, p))
+    {
+        return false;
+    }
+
+    fe_inv(z, z);
+    fe_mul(x, x, z);
+    fe_tobytes(q, x);
 
     return true;
 }
@@ -92,6 +271,12 @@ bool curve25519_dh(uint8_t *q, const uint8_t *n, const uint8_t *p)
 /**
  * @brief Creates a curve25519 public-key from a private-key.
  * 
+ * @note Rather than running the ladder on the base-point u = 9, the
+ * clamped scalar multiplies the Ed25519 base-point with the fixed-base
+ * table of ge_scalarmult_base(ge_p3*, const uint8_t*), and the result
+ * is mapped to u = (1 + y)/(1 - y). Both base-points correspond under
+ * this map, hence the outputs are identical.
+ * 
  * @param q The public-key output, a point
  * @param n The private-key input, a scalar
  * @return true on success
@@ -99,8 +284,26 @@ bool curve25519_dh(uint8_t *q, const uint8_t *n, const uint8_t *p)
  */
 bool curve25519_public_key_from_private_key(uint8_t *q, const uint8_t *n)
 {
-    static const uint8_t basepoint[CURVE25519_POINT_SIZE] = {9};
-    return curve25519_dh(q, n, basepoint);
+    uint8_t e[CURVE25519_SCALAR_SIZE];
+    ge_p3 A;
+    fe x, z;
+
+    clamp_scalar(e, n);
+    ge_scalarmult_base(&A, e);
+
+    /* u = (1 + y)/(1 - y) = (Z + Y)/(Z - Y) */
+    fe_add(x, A.z, A.y);
+    fe_sub(z, A.z, A.y);
+    fe_inv(z, z);
+    fe_mul(x, x, z);
+    fe_tobytes(q, x);
+
+    crypto_memzero(e, sizeof(e));
+    crypto_memzero(&A, sizeof(A));
+    crypto_memzero(x, sizeof(x));
+    crypto_memzero(z, sizeof(z));
+
+    return true;
 }
 
 /**
@@ -113,7 +316,14 @@ bool curve25519_public_key_from_private_key(uint8_t *q, const uint8_t *n)
  */
 bool curve25519_random_keypair(uint8_t* public_key, uint8_t* private_key)
 {
-    bdap_randombytes(private_key, CURVE25519_SCALAR_SIZE);
+    return curve25519_random_keypair_with_rng(public_key, private_key, NULL);
+}
+
+bool curve25519_random_keypair_with_rng(uint8_t* public_key,
+                                        uint8_t* private_key,
+                                        const struct bdap_rng* rng)
+{
+    bdap_rng_randombytes(rng, private_key, CURVE25519_SCALAR_SIZE);
     return curve25519_public_key_from_private_key(public_key, private_key);
 }
 
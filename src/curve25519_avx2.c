@@ -0,0 +1,658 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+/**
+ * AVX2 accelerated curve25519 Montgomery ladder, four lanes.
+ *
+ * Each 256-bit register holds the same limb of four independent field
+ * elements, in the radix 2^25.5 representation of fe_25_5.h with
+ * unsigned limbs. The four ladders share the scalar, so that the
+ * conditional swaps are identical across lanes and the lanes run in
+ * lockstep.
+ *
+ * Reference: Daniel J. Bernstein, "Curve25519: new Diffie-Hellman
+ * speed records", and Tung Chou, "Sandy2x: New Curve25519 Speed
+ * Records"
+ */
+
+#include "curve25519_avx2.h"
+#include "utils.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+# define CURVE25519_AVX2_SUPPORTED
+#endif
+
+#if defined(CURVE25519_AVX2_SUPPORTED)
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+# define AVX2_TARGET
+#else
+# include <cpuid.h>
+# define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#include <immintrin.h>
+
+/* Limb sizes and offsets of the radix 2^25.5 representation */
+static const uint32_t limb_bits[10] = {
+    26, 25, 26, 25, 26, 25, 26, 25, 26, 25
+};
+
+static const uint32_t limb_offset[10] = {
+    0, 26, 51, 77, 102, 128, 153, 179, 204, 230
+};
+
+static uint64_t little_endian_load_8(const uint8_t *in)
+{
+    uint64_t result;
+    result  =  (uint64_t)in[0];
+    result |= ((uint64_t)in[1]) <<  8;
+    result |= ((uint64_t)in[2]) << 16;
+    result |= ((uint64_t)in[3]) << 24;
+    result |= ((uint64_t)in[4]) << 32;
+    result |= ((uint64_t)in[5]) << 40;
+    result |= ((uint64_t)in[6]) << 48;
+    result |= ((uint64_t)in[7]) << 56;
+    return result;
+}
+
+static void little_endian_store_8(uint8_t *out, uint64_t u)
+{
+    out[0] = (uint8_t)u; u >>= 8;
+    out[1] = (uint8_t)u; u >>= 8;
+    out[2] = (uint8_t)u; u >>= 8;
+    out[3] = (uint8_t)u; u >>= 8;
+    out[4] = (uint8_t)u; u >>= 8;
+    out[5] = (uint8_t)u; u >>= 8;
+    out[6] = (uint8_t)u; u >>= 8;
+    out[7] = (uint8_t)u;
+}
+
+/**
+ * @brief Unpacks a 32-byte little-endian value into ten unsigned limbs,
+ * ignoring the most significant bit.
+ */
+static void limbs_frombytes(uint64_t *h, const uint8_t *s)
+{
+    uint64_t w[4];
+    uint32_t i, word, shift;
+
+    for (i = 0; i < 4; ++i)
+    {
+        w[i] = little_endian_load_8(s + 8*i);
+    }
+    for (i = 0; i < 10; ++i)
+    {
+        word = limb_offset[i] >> 6;
+        shift = limb_offset[i] & 63;
+        h[i] = w[word] >> shift;
+        if (shift + limb_bits[i] > 64)
+        {
+            h[i] |= w[word + 1] << (64 - shift);
+        }
+        h[i] &= ((uint64_t)1 << limb_bits[i]) - 1;
+    }
+}
+
+/**
+ * @brief Packs ten carried limbs into a 32-byte little-endian value,
+ * fully reduced modulo 2^255 - 19.
+ *
+ * @note The limbs must be bounded as at the output of a
+ * multiplication, the reduction follows fe_tobytes of fe_25_5.
+ */
+static void limbs_tobytes(uint8_t *s, const uint64_t *f)
+{
+    int64_t h[10], q, carry;
+    uint64_t w[4];
+    uint32_t i, word, shift;
+
+    for (i = 0; i < 10; ++i)
+    {
+        h[i] = (int64_t)f[i];
+    }
+
+    /* q = 1 if and only if h >= 2^255 - 19 */
+    q = (19 * h[9] + ((int64_t)1 << 24)) >> 25;
+    for (i = 0; i < 10; ++i)
+    {
+        q = (h[i] + q) >> limb_bits[i];
+    }
+
+    /* h - (2^255 - 19) q, the 2^255 q is dropped by the carries */
+    h[0] += 19 * q;
+    for (i = 0; i < 9; ++i)
+    {
+        carry = h[i] >> limb_bits[i];
+        h[i + 1] += carry;
+        h[i] -= carry << limb_bits[i];
+    }
+    h[9] &= ((int64_t)1 << 25) - 1;
+
+    w[0] = w[1] = w[2] = w[3] = 0;
+    for (i = 0; i < 10; ++i)
+    {
+        word = limb_offset[i] >> 6;
+        shift = limb_offset[i] & 63;
+        w[word] |= (uint64_t)h[i] << shift;
+        if (shift + limb_bits[i] > 64)
+        {
+            w[word + 1] |= (uint64_t)h[i] >> (64 - shift);
+        }
+    }
+    for (i = 0; i < 4; ++i)
+    {
+        little_endian_store_8(s + 8*i, w[i]);
+    }
+
+    crypto_memzero(h, sizeof(h));
+    crypto_memzero(w, sizeof(w));
+}
+
+#define CPUID_ECX_OSXSAVE       (1u << 27)
+#define CPUID_ECX_AVX           (1u << 28)
+#define CPUID_EBX_AVX2          (1u << 5)
+#define XCR0_SSE_AVX_STATE      0x6u
+
+static uint32_t read_xcr0(void)
+{
+#if defined(_MSC_VER)
+    return (uint32_t)_xgetbv(0);
+#else
+    uint32_t eax, edx;
+
+    __asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return eax;
+#endif
+}
+
+static bool cpu_supports_avx2(void)
+{
+    uint32_t ebx, ecx;
+    const uint32_t required = CPUID_ECX_OSXSAVE | CPUID_ECX_AVX;
+#if defined(_MSC_VER)
+    int32_t info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    ecx = (uint32_t)info[2];
+    __cpuidex(info, 7, 0);
+    ebx = (uint32_t)info[1];
+#else
+    unsigned int eax_, ebx_, ecx_, edx_;
+
+    if (__get_cpuid_max(0, NULL) < 7)
+    {
+        return false;
+    }
+    __cpuid(1, eax_, ebx_, ecx_, edx_);
+    ecx = (uint32_t)ecx_;
+    __cpuid_count(7, 0, eax_, ebx_, ecx_, edx_);
+    ebx = (uint32_t)ebx_;
+#endif
+
+    /* The OS must also save the YMM registers on context switches */
+    if ((ecx & required) != required)
+    {
+        return false;
+    }
+    if ((read_xcr0() & XCR0_SSE_AVX_STATE) != XCR0_SSE_AVX_STATE)
+    {
+        return false;
+    }
+
+    return ((ebx & CPUID_EBX_AVX2) != 0);
+}
+
+bool curve25519_avx2_available(void)
+{
+    /* 0: unknown, 1: supported, 2: unsupported */
+    static volatile int32_t status = 0;
+
+    if (status == 0)
+    {
+        status = cpu_supports_avx2() ? 1 : 2;
+    }
+
+    return (status == 1);
+}
+
+/**
+ * fe4 holds the same limb of four field elements in each register.
+ */
+typedef __m256i fe4[10];
+
+#define VADD(a, b)      _mm256_add_epi64((a), (b))
+#define VMUL(a, b)      _mm256_mul_epu32((a), (b))
+#define VMAC(h, a, b)   (h) = VADD((h), VMUL((a), (b)))
+
+AVX2_TARGET
+static inline void fe4_zero(fe4 h)
+{
+    int32_t i;
+
+    for (i = 0; i < 10; ++i)
+    {
+        h[i] = _mm256_setzero_si256();
+    }
+}
+
+AVX2_TARGET
+static inline void fe4_one(fe4 h)
+{
+    fe4_zero(h);
+    h[0] = _mm256_set1_epi64x(1);
+}
+
+AVX2_TARGET
+static inline void fe4_copy(fe4 h, const fe4 f)
+{
+    int32_t i;
+
+    for (i = 0; i < 10; ++i)
+    {
+        h[i] = f[i];
+    }
+}
+
+/**
+ * @brief Swaps f and g in all four lanes if and only if ctrl is 1.
+ */
+AVX2_TARGET
+static inline void fe4_swap(fe4 f, fe4 g, uint32_t ctrl)
+{
+    const __m256i mask = _mm256_set1_epi64x(-(int64_t)ctrl);
+    __m256i t;
+    int32_t i;
+
+    for (i = 0; i < 10; ++i)
+    {
+        t = _mm256_and_si256(_mm256_xor_si256(f[i], g[i]), mask);
+        f[i] = _mm256_xor_si256(f[i], t);
+        g[i] = _mm256_xor_si256(g[i], t);
+    }
+}
+
+/**
+ * @brief h = f + g, without carrying.
+ */
+AVX2_TARGET
+static inline void fe4_add(fe4 h, const fe4 f, const fe4 g)
+{
+    int32_t i;
+
+    for (i = 0; i < 10; ++i)
+    {
+        h[i] = VADD(f[i], g[i]);
+    }
+}
+
+/**
+ * @brief h = f + 2p - g, without carrying.
+ *
+ * @note g must be carried, so that no limb becomes negative.
+ */
+AVX2_TARGET
+static inline void fe4_sub(fe4 h, const fe4 f, const fe4 g)
+{
+    const __m256i two_p0 = _mm256_set1_epi64x(0x7ffffda);
+    const __m256i two_p_even = _mm256_set1_epi64x(0x7fffffe);
+    const __m256i two_p_odd = _mm256_set1_epi64x(0x3fffffe);
+    int32_t i;
+
+    h[0] = _mm256_sub_epi64(VADD(f[0], two_p0), g[0]);
+    h[1] = _mm256_sub_epi64(VADD(f[1], two_p_odd), g[1]);
+    for (i = 2; i < 10; i += 2)
+    {
+        h[i] = _mm256_sub_epi64(VADD(f[i], two_p_even), g[i]);
+        h[i + 1] = _mm256_sub_epi64(VADD(f[i + 1], two_p_odd), g[i + 1]);
+    }
+}
+
+/**
+ * @brief Carries the 64-bit limbs h0, ..., h9 into out.
+ *
+ * @note The two interleaved carry chains follow fe_mul of fe_25_5,
+ * the limbs of the output are at most 26 bits, plus a small excess
+ * in h1 and h5.
+ */
+AVX2_TARGET
+static inline void fe4_carry(fe4 out,
+                             __m256i h0, __m256i h1, __m256i h2, __m256i h3,
+                             __m256i h4, __m256i h5, __m256i h6, __m256i h7,
+                             __m256i h8, __m256i h9)
+{
+    const __m256i mask26 = _mm256_set1_epi64x(0x3ffffff);
+    const __m256i mask25 = _mm256_set1_epi64x(0x1ffffff);
+    __m256i c;
+
+#define FE4_CARRY(a, b, bits) \
+    c = _mm256_srli_epi64(a, bits); \
+    a = _mm256_and_si256(a, mask##bits); \
+    b = VADD(b, c)
+
+    FE4_CARRY(h0, h1, 26);
+    FE4_CARRY(h4, h5, 26);
+    FE4_CARRY(h1, h2, 25);
+    FE4_CARRY(h5, h6, 25);
+    FE4_CARRY(h2, h3, 26);
+    FE4_CARRY(h6, h7, 26);
+    FE4_CARRY(h3, h4, 25);
+    FE4_CARRY(h7, h8, 25);
+    FE4_CARRY(h4, h5, 26);
+    FE4_CARRY(h8, h9, 26);
+
+    /* 2^255 = 19 mod p, the carry may exceed 32 bits */
+    c = _mm256_srli_epi64(h9, 25);
+    h9 = _mm256_and_si256(h9, mask25);
+    h0 = VADD(h0, c);
+    h0 = VADD(h0, _mm256_slli_epi64(c, 1));
+    h0 = VADD(h0, _mm256_slli_epi64(c, 4));
+    FE4_CARRY(h0, h1, 26);
+
+#undef FE4_CARRY
+
+    out[0] = h0; out[1] = h1; out[2] = h2; out[3] = h3; out[4] = h4;
+    out[5] = h5; out[6] = h6; out[7] = h7; out[8] = h8; out[9] = h9;
+}
+
+/**
+ * @brief h = f * g
+ *
+ * @note The inputs may be the unreduced outputs of fe4_add or
+ * fe4_sub of carried values, the limbs are then below 1.5 * 2^27
+ * (even) and 1.5 * 2^26 (odd) and all accumulators stay below 2^63.
+ */
+AVX2_TARGET
+static void fe4_mul(fe4 h, const fe4 f, const fe4 g)
+{
+    const __m256i nineteen = _mm256_set1_epi64x(19);
+    __m256i f0, f1, f2, f3, f4, f5, f6, f7, f8, f9;
+    __m256i g0, g1, g2, g3, g4, g5, g6, g7, g8, g9;
+    __m256i f1_2, f3_2, f5_2, f7_2, f9_2;
+    __m256i g1_19, g2_19, g3_19, g4_19, g5_19, g6_19, g7_19, g8_19, g9_19;
+    __m256i h0, h1, h2, h3, h4, h5, h6, h7, h8, h9;
+
+    f0 = f[0]; f1 = f[1]; f2 = f[2]; f3 = f[3]; f4 = f[4];
+    f5 = f[5]; f6 = f[6]; f7 = f[7]; f8 = f[8]; f9 = f[9];
+    g0 = g[0]; g1 = g[1]; g2 = g[2]; g3 = g[3]; g4 = g[4];
+    g5 = g[5]; g6 = g[6]; g7 = g[7]; g8 = g[8]; g9 = g[9];
+
+    f1_2 = VADD(f1, f1);
+    f3_2 = VADD(f3, f3);
+    f5_2 = VADD(f5, f5);
+    f7_2 = VADD(f7, f7);
+    f9_2 = VADD(f9, f9);
+
+    g1_19 = VMUL(g1, nineteen);
+    g2_19 = VMUL(g2, nineteen);
+    g3_19 = VMUL(g3, nineteen);
+    g4_19 = VMUL(g4, nineteen);
+    g5_19 = VMUL(g5, nineteen);
+    g6_19 = VMUL(g6, nineteen);
+    g7_19 = VMUL(g7, nineteen);
+    g8_19 = VMUL(g8, nineteen);
+    g9_19 = VMUL(g9, nineteen);
+
+    h0 = VMUL(f0, g0);
+    VMAC(h0, f1_2, g9_19); VMAC(h0, f2, g8_19); VMAC(h0, f3_2, g7_19);
+    VMAC(h0, f4, g6_19); VMAC(h0, f5_2, g5_19); VMAC(h0, f6, g4_19);
+    VMAC(h0, f7_2, g3_19); VMAC(h0, f8, g2_19); VMAC(h0, f9_2, g1_19);
+    h1 = VMUL(f0, g1);
+    VMAC(h1, f1, g0); VMAC(h1, f2, g9_19); VMAC(h1, f3, g8_19);
+    VMAC(h1, f4, g7_19); VMAC(h1, f5, g6_19); VMAC(h1, f6, g5_19);
+    VMAC(h1, f7, g4_19); VMAC(h1, f8, g3_19); VMAC(h1, f9, g2_19);
+    h2 = VMUL(f0, g2);
+    VMAC(h2, f1_2, g1); VMAC(h2, f2, g0); VMAC(h2, f3_2, g9_19);
+    VMAC(h2, f4, g8_19); VMAC(h2, f5_2, g7_19); VMAC(h2, f6, g6_19);
+    VMAC(h2, f7_2, g5_19); VMAC(h2, f8, g4_19); VMAC(h2, f9_2, g3_19);
+    h3 = VMUL(f0, g3);
+    VMAC(h3, f1, g2); VMAC(h3, f2, g1); VMAC(h3, f3, g0); VMAC(h3, f4, g9_19);
+    VMAC(h3, f5, g8_19); VMAC(h3, f6, g7_19); VMAC(h3, f7, g6_19);
+    VMAC(h3, f8, g5_19); VMAC(h3, f9, g4_19);
+    h4 = VMUL(f0, g4);
+    VMAC(h4, f1_2, g3); VMAC(h4, f2, g2); VMAC(h4, f3_2, g1);
+    VMAC(h4, f4, g0); VMAC(h4, f5_2, g9_19); VMAC(h4, f6, g8_19);
+    VMAC(h4, f7_2, g7_19); VMAC(h4, f8, g6_19); VMAC(h4, f9_2, g5_19);
+    h5 = VMUL(f0, g5);
+    VMAC(h5, f1, g4); VMAC(h5, f2, g3); VMAC(h5, f3, g2); VMAC(h5, f4, g1);
+    VMAC(h5, f5, g0); VMAC(h5, f6, g9_19); VMAC(h5, f7, g8_19);
+    VMAC(h5, f8, g7_19); VMAC(h5, f9, g6_19);
+    h6 = VMUL(f0, g6);
+    VMAC(h6, f1_2, g5); VMAC(h6, f2, g4); VMAC(h6, f3_2, g3);
+    VMAC(h6, f4, g2); VMAC(h6, f5_2, g1); VMAC(h6, f6, g0);
+    VMAC(h6, f7_2, g9_19); VMAC(h6, f8, g8_19); VMAC(h6, f9_2, g7_19);
+    h7 = VMUL(f0, g7);
+    VMAC(h7, f1, g6); VMAC(h7, f2, g5); VMAC(h7, f3, g4); VMAC(h7, f4, g3);
+    VMAC(h7, f5, g2); VMAC(h7, f6, g1); VMAC(h7, f7, g0); VMAC(h7, f8, g9_19);
+    VMAC(h7, f9, g8_19);
+    h8 = VMUL(f0, g8);
+    VMAC(h8, f1_2, g7); VMAC(h8, f2, g6); VMAC(h8, f3_2, g5);
+    VMAC(h8, f4, g4); VMAC(h8, f5_2, g3); VMAC(h8, f6, g2);
+    VMAC(h8, f7_2, g1); VMAC(h8, f8, g0); VMAC(h8, f9_2, g9_19);
+    h9 = VMUL(f0, g9);
+    VMAC(h9, f1, g8); VMAC(h9, f2, g7); VMAC(h9, f3, g6); VMAC(h9, f4, g5);
+    VMAC(h9, f5, g4); VMAC(h9, f6, g3); VMAC(h9, f7, g2); VMAC(h9, f8, g1);
+    VMAC(h9, f9, g0);
+
+    fe4_carry(h, h0, h1, h2, h3, h4, h5, h6, h7, h8, h9);
+}
+
+/**
+ * @brief h = f^2
+ *
+ * @note Same input bounds as fe4_mul(fe4, const fe4, const fe4).
+ */
+AVX2_TARGET
+static void fe4_sqr(fe4 h, const fe4 f)
+{
+    const __m256i nineteen = _mm256_set1_epi64x(19);
+    __m256i f0, f1, f2, f3, f4, f5, f6, f7, f8, f9;
+    __m256i f0_2, f1_2, f2_2, f3_2, f4_2, f5_2, f6_2, f7_2, f8_2, f9_2;
+    __m256i f1_4, f3_4, f5_4, f7_4;
+    __m256i f5_19, f6_19, f7_19, f8_19, f9_19;
+    __m256i h0, h1, h2, h3, h4, h5, h6, h7, h8, h9;
+
+    f0 = f[0]; f1 = f[1]; f2 = f[2]; f3 = f[3]; f4 = f[4];
+    f5 = f[5]; f6 = f[6]; f7 = f[7]; f8 = f[8]; f9 = f[9];
+
+    f0_2 = VADD(f0, f0);
+    f1_2 = VADD(f1, f1);
+    f2_2 = VADD(f2, f2);
+    f3_2 = VADD(f3, f3);
+    f4_2 = VADD(f4, f4);
+    f5_2 = VADD(f5, f5);
+    f6_2 = VADD(f6, f6);
+    f7_2 = VADD(f7, f7);
+    f8_2 = VADD(f8, f8);
+    f9_2 = VADD(f9, f9);
+    f1_4 = VADD(f1_2, f1_2);
+    f3_4 = VADD(f3_2, f3_2);
+    f5_4 = VADD(f5_2, f5_2);
+    f7_4 = VADD(f7_2, f7_2);
+
+    f5_19 = VMUL(f5, nineteen);
+    f6_19 = VMUL(f6, nineteen);
+    f7_19 = VMUL(f7, nineteen);
+    f8_19 = VMUL(f8, nineteen);
+    f9_19 = VMUL(f9, nineteen);
+
+    h0 = VMUL(f0, f0);
+    VMAC(h0, f1_4, f9_19); VMAC(h0, f2_2, f8_19); VMAC(h0, f3_4, f7_19);
+    VMAC(h0, f4_2, f6_19); VMAC(h0, f5_2, f5_19);
+    h1 = VMUL(f0_2, f1);
+    VMAC(h1, f2_2, f9_19); VMAC(h1, f3_2, f8_19); VMAC(h1, f4_2, f7_19);
+    VMAC(h1, f5_2, f6_19);
+    h2 = VMUL(f0_2, f2);
+    VMAC(h2, f1_2, f1); VMAC(h2, f3_4, f9_19); VMAC(h2, f4_2, f8_19);
+    VMAC(h2, f5_4, f7_19); VMAC(h2, f6, f6_19);
+    h3 = VMUL(f0_2, f3);
+    VMAC(h3, f1_2, f2); VMAC(h3, f4_2, f9_19); VMAC(h3, f5_2, f8_19);
+    VMAC(h3, f6_2, f7_19);
+    h4 = VMUL(f0_2, f4);
+    VMAC(h4, f1_4, f3); VMAC(h4, f2, f2); VMAC(h4, f5_4, f9_19);
+    VMAC(h4, f6_2, f8_19); VMAC(h4, f7_2, f7_19);
+    h5 = VMUL(f0_2, f5);
+    VMAC(h5, f1_2, f4); VMAC(h5, f2_2, f3); VMAC(h5, f6_2, f9_19);
+    VMAC(h5, f7_2, f8_19);
+    h6 = VMUL(f0_2, f6);
+    VMAC(h6, f1_4, f5); VMAC(h6, f2_2, f4); VMAC(h6, f3_2, f3);
+    VMAC(h6, f7_4, f9_19); VMAC(h6, f8, f8_19);
+    h7 = VMUL(f0_2, f7);
+    VMAC(h7, f1_2, f6); VMAC(h7, f2_2, f5); VMAC(h7, f3_2, f4);
+    VMAC(h7, f8_2, f9_19);
+    h8 = VMUL(f0_2, f8);
+    VMAC(h8, f1_4, f7); VMAC(h8, f2_2, f6); VMAC(h8, f3_4, f5);
+    VMAC(h8, f4, f4); VMAC(h8, f9_2, f9_19);
+    h9 = VMUL(f0_2, f9);
+    VMAC(h9, f1_2, f8); VMAC(h9, f2_2, f7); VMAC(h9, f3_2, f6);
+    VMAC(h9, f4_2, f5);
+
+    fe4_carry(h, h0, h1, h2, h3, h4, h5, h6, h7, h8, h9);
+}
+
+/**
+ * @brief h = 121666 * f
+ */
+AVX2_TARGET
+static inline void fe4_mul121666(fe4 h, const fe4 f)
+{
+    const __m256i k = _mm256_set1_epi64x(121666);
+
+    fe4_carry(h,
+              VMUL(f[0], k), VMUL(f[1], k), VMUL(f[2], k), VMUL(f[3], k),
+              VMUL(f[4], k), VMUL(f[5], k), VMUL(f[6], k), VMUL(f[7], k),
+              VMUL(f[8], k), VMUL(f[9], k));
+}
+
+/**
+ * @brief Runs the Montgomery ladder of curve25519_dh_projective on
+ * four points in lockstep.
+ */
+AVX2_TARGET
+static void fe4_ladder(fe4 x2, fe4 z2, const fe4 x1, const uint8_t *e)
+{
+    fe4 x3, z3, t0, t1;
+    uint32_t b, swap;
+    int32_t pos;
+
+    fe4_one(x2);
+    fe4_zero(z2);
+    fe4_copy(x3, x1);
+    fe4_one(z3);
+
+    swap = 0;
+    for (pos = 254; pos >= 0; --pos)
+    {
+        b = e[pos >> 3] >> (pos & 7);
+        b &= 1;
+        swap ^= b;
+        fe4_swap(x2, x3, swap);
+        fe4_swap(z2, z3, swap);
+        swap = b;
+        fe4_sub(t0, x3, z3);
+        fe4_sub(t1, x2, z2);
+        fe4_add(x2, x2, z2);
+        fe4_add(z2, x3, z3);
+        fe4_mul(z3, t0, x2);
+        fe4_mul(z2, z2, t1);
+        fe4_sqr(t0, t1);
+        fe4_sqr(t1, x2);
+        fe4_add(x3, z3, z2);
+        fe4_sub(z2, z3, z2);
+        fe4_mul(x2, t1, t0);
+        fe4_sub(t1, t1, t0);
+        fe4_sqr(z2, z2);
+        fe4_mul121666(z3, t1);
+        fe4_sqr(x3, x3);
+        fe4_add(t0, t0, z3);
+        fe4_mul(z3, x1, z2);
+        fe4_mul(z2, t1, t0);
+    }
+    fe4_swap(x2, x3, swap);
+    fe4_swap(z2, z3, swap);
+
+    crypto_memzero(x3, sizeof(x3));
+    crypto_memzero(z3, sizeof(z3));
+    crypto_memzero(t0, sizeof(t0));
+    crypto_memzero(t1, sizeof(t1));
+}
+
+/**
+ * @brief Extracts lane i of a carried fe4 as 32 reduced bytes.
+ */
+AVX2_TARGET
+static void fe4_tobytes(uint8_t *s, const fe4 f, uint32_t lane)
+{
+    uint64_t lanes[4];
+    uint64_t h[10];
+    int32_t i;
+
+    for (i = 0; i < 10; ++i)
+    {
+        _mm256_storeu_si256((__m256i *)lanes, f[i]);
+        h[i] = lanes[lane];
+    }
+    limbs_tobytes(s, h);
+
+    crypto_memzero(lanes, sizeof(lanes));
+    crypto_memzero(h, sizeof(h));
+}
+
+AVX2_TARGET
+void curve25519_avx2_ladder_x4(uint8_t *x,
+                               uint8_t *z,
+                               const uint8_t *e,
+                               const uint8_t *const *p)
+{
+    uint64_t h[4][10];
+    fe4 x1, x2, z2;
+    uint32_t i;
+
+    for (i = 0; i < 4; ++i)
+    {
+        limbs_frombytes(h[i], p[i]);
+    }
+    for (i = 0; i < 10; ++i)
+    {
+        x1[i] = _mm256_set_epi64x((int64_t)h[3][i],
+                                  (int64_t)h[2][i],
+                                  (int64_t)h[1][i],
+                                  (int64_t)h[0][i]);
+    }
+
+    fe4_ladder(x2, z2, x1, e);
+
+    for (i = 0; i < 4; ++i)
+    {
+        fe4_tobytes(x + CURVE25519_AVX2_FE_SIZE*i, x2, i);
+        fe4_tobytes(z + CURVE25519_AVX2_FE_SIZE*i, z2, i);
+    }
+
+    crypto_memzero(x2, sizeof(x2));
+    crypto_memzero(z2, sizeof(z2));
+}
+
+#else
+
+bool curve25519_avx2_available(void)
+{
+    return false;
+}
+
+void curve25519_avx2_ladder_x4(uint8_t *x,
+                               uint8_t *z,
+                               const uint8_t *e,
+                               const uint8_t *const *p)
+{
+    (void) x;
+    (void) z;
+    (void) e;
+    (void) p;
+}
+
+#endif /* CURVE25519_AVX2_SUPPORTED */
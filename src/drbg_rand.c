@@ -0,0 +1,157 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#include <stdbool.h>
+#include <string.h>
+#if !defined(_WIN32)
+# include <pthread.h>
+#endif
+#include "drbg_rand.h"
+#include "os_rand.h"
+#include "aes256ctr.h"
+#include "utils.h"
+
+#if defined(_MSC_VER)
+# define DRBG_THREAD_LOCAL  __declspec(thread)
+#else
+# define DRBG_THREAD_LOCAL  __thread
+#endif
+
+#define DRBG_KEY_SIZE       AES256CTR_KEY_SIZE
+#define DRBG_BLOCK_SIZE     (DRBG_KEY_SIZE + DRBG_BUFFER_SIZE)
+
+/**
+ * @brief The state of a thread's generator: the key of the next
+ * refill and the unused part of the last one.
+ */
+typedef struct
+{
+    uint8_t key[DRBG_KEY_SIZE];
+    uint8_t buffer[DRBG_BUFFER_SIZE];
+    size_t bytes_available;
+    uint32_t refills;
+    uint32_t fork_generation;
+    bool seeded;
+} drbg_state;
+
+static DRBG_THREAD_LOCAL drbg_state _state;
+static const uint8_t _zeros[DRBG_BLOCK_SIZE];
+
+/* Incremented in the child of every fork(), where the forking
+ * thread's state is a copy of the parent's */
+static volatile uint32_t _fork_generation = 0;
+
+#if !defined(_WIN32)
+static pthread_once_t _atfork_once = PTHREAD_ONCE_INIT;
+
+static void drbg_atfork_child(void)
+{
+    ++_fork_generation;
+}
+
+static void drbg_register_atfork(void)
+{
+    (void)pthread_atfork(NULL, NULL, drbg_atfork_child);
+}
+#endif
+
+/**
+ * @brief Mixes fresh OS randomness into the key and drops the
+ * buffered bytes.
+ */
+static void drbg_seed(drbg_state* state)
+{
+    uint8_t seed[DRBG_KEY_SIZE];
+    size_t i;
+
+#if !defined(_WIN32)
+    (void)pthread_once(&_atfork_once, drbg_register_atfork);
+#endif
+    os_randombytes(seed, sizeof(seed));
+    for (i = 0; i < DRBG_KEY_SIZE; ++i)
+    {
+        state->key[i] ^= seed[i];
+    }
+    crypto_memzero(seed, sizeof(seed));
+    crypto_memzero(state->buffer, sizeof(state->buffer));
+
+    state->bytes_available = 0;
+    state->refills = 0;
+    state->fork_generation = _fork_generation;
+    state->seeded = true;
+}
+
+/**
+ * @brief Encrypts a zero block under the current key, which is
+ * replaced by the first DRBG_KEY_SIZE bytes of the keystream, and
+ * buffers the rest.
+ */
+static void drbg_refill(drbg_state* state)
+{
+    static const uint8_t iv[AES256CTR_IV_SIZE] = {0};
+    uint8_t block[DRBG_BLOCK_SIZE];
+    size_t unused;
+
+    if (state->refills >= DRBG_RESEED_INTERVAL)
+    {
+        drbg_seed(state);
+    }
+
+    (void)aes256ctr_encrypt(block,
+                            &unused,
+                            _zeros,
+                            sizeof(_zeros),
+                            iv,
+                            state->key);
+    memcpy(state->key, block, DRBG_KEY_SIZE);
+    memcpy(state->buffer, block + DRBG_KEY_SIZE, DRBG_BUFFER_SIZE);
+    crypto_memzero(block, sizeof(block));
+
+    state->bytes_available = DRBG_BUFFER_SIZE;
+    ++state->refills;
+}
+
+void drbg_randominit(const uint8_t* seed, size_t seed_size)
+{
+    /* Dummy placeholder */
+    (void) seed; /* avoid warning about unused parameter */
+    (void) seed_size; /* avoid warning about unused parameter */
+}
+
+void drbg_randombytes(uint8_t* buf, size_t buf_size)
+{
+    drbg_state *state = &_state;
+    uint8_t *ptr;
+    size_t size;
+
+    if (!state->seeded || state->fork_generation != _fork_generation)
+    {
+        drbg_seed(state);
+    }
+
+    while (buf_size > 0)
+    {
+        if (state->bytes_available == 0)
+        {
+            drbg_refill(state);
+        }
+        size = buf_size;
+        if (size > state->bytes_available)
+        {
+            size = state->bytes_available;
+        }
+
+        /* Hand the bytes out from the end of the buffer and wipe them */
+        ptr = &state->buffer[state->bytes_available - size];
+        memcpy(buf, ptr, size);
+        crypto_memzero(ptr, size);
+        buf += size;
+        buf_size -= size;
+        state->bytes_available -= size;
+    }
+}
+
+void drbg_reseed(void)
+{
+    _state.seeded = false;
+}
@@ -35,10 +35,25 @@ void ed25519_seeded_keypair(uint8_t* pk,
  * @param sk the pointer to the output private-key, 64 bytes
  */
 void ed25519_keypair(uint8_t* pk, uint8_t* sk)
+{
+    ed25519_keypair_with_rng(pk, sk, NULL);
+}
+
+/**
+ * @brief Randomly generates an Ed25519 public/private key-pair with
+ * a random number generator context.
+ *
+ * @param pk the pointer to the output public-key, 32 bytes
+ * @param sk the pointer to the output private-key, 64 bytes
+ * @param rng the generator, or NULL for bdap_randombytes
+ */
+void ed25519_keypair_with_rng(uint8_t* pk,
+                              uint8_t* sk,
+                              const struct bdap_rng* rng)
 {
     uint8_t seed[ED25519_PRIVATE_KEY_SEED_SIZE];
 
-    bdap_randombytes(seed, sizeof(seed));
+    bdap_rng_randombytes(rng, seed, sizeof(seed));
     ed25519_seeded_keypair(pk, sk, seed);
 
     crypto_memzero(seed, sizeof(seed));
@@ -78,18 +93,23 @@ void ed25519_public_key_from_private_key_seed(uint8_t *p,
  */
 
 /**
- * @brief Converts Ed25519 public-key to Curve25519 public-key.
+ * @brief Converts Ed25519 public-key to a projective Curve25519
+ * u-coordinate (X:Z), i.e. u = (1 + y)/(1 - y) = X/Z.
  * 
- * @param curve25519_pk the output Curve25519 public-key
+ * @note The division is left to the caller so that several keys
+ * can be normalised with a single inversion, see
+ * fe_batch_inv(fe*, const fe*, size_t).
+ * 
+ * @param x the output X coordinate
+ * @param z the output Z coordinate, never zero on success
  * @param ed25519_pk the input Ed25519 public-key
  * @return 0 on success, non-zero otherwise
  */
-int32_t ed25519_to_curve25519_public_key(uint8_t *curve25519_pk,
-                                         const uint8_t *ed25519_pk)
+int32_t ed25519_to_curve25519_public_key_projective(fe x,
+                                                    fe z,
+                                                    const uint8_t *ed25519_pk)
 {
     ge_p3 A;
-    fe x;
-    fe o_m_y;
 
     if (ge_has_small_order(ed25519_pk) ||
         ge_frombytes(&A, ed25519_pk) != 0 ||
@@ -98,10 +118,32 @@ int32_t ed25519_to_curve25519_public_key(uint8_t *curve25519_pk,
         return -1;
     }
 
-    fe_one(o_m_y);
-    fe_sub(o_m_y, o_m_y, A.y);
+    fe_one(z);
+    fe_sub(z, z, A.y);
     fe_one(x);
     fe_add(x, x, A.y);
+
+    return 0;
+}
+
+/**
+ * @brief Converts Ed25519 public-key to Curve25519 public-key.
+ * 
+ * @param curve25519_pk the output Curve25519 public-key
+ * @param ed25519_pk the input Ed25519 public-key
+ * @return 0 on success, non-zero otherwise
+ */
+int32_t ed25519_to_curve25519_public_key(uint8_t *curve25519_pk,
+                                         const uint8_t *ed25519_pk)
+{
+    fe x;
+    fe o_m_y;
+
+    if (ed25519_to_curve25519_public_key_projective(x, o_m_y, ed25519_pk) != 0)
+    {
+        return -1;
+    }
+
     fe_inv(o_m_y, o_m_y);
     fe_mul(x, x, o_m_y);
     
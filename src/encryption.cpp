@@ -1,9 +1,15 @@
 // Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
 // See LICENSE.md file for license, copying and use information.
 
+#include <algorithm>
 #include <cstdint>
+#include <istream>
+#include <ostream>
 #include "encryption_core.h"
 #include "encryption.h"
+#include "encryption_error.h"
+#include "thread_pool.h"
+#include "utils.h"
 
 /**
  * @brief Returns the size of BDAP ciphertext in bytes for given number of recipients
@@ -37,15 +43,19 @@ size_t BDAPExpectedDecryptedSize(const CharVector& vchCipherText)
  * @param vchData The input data to be encrypted
  * @param vchCipherText The output ciphertext
  * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nThreads The number of threads, 0 for the number of processors
  * @return true on success
  * @return false on failure
  */
 bool EncryptBDAPData(const vCharVector& vchPubKeys,
                      const CharVector& vchData,
                      CharVector& vchCipherText,
-                     std::string& strErrorMessage)
+                     std::string& strErrorMessage,
+                     const uint32_t nThreads)
 {
     bool status = false;
+    bdap_thread_pool pool;
+    bool fPool = false;
     uint16_t index;
     uint16_t numRecipients = uint16_t(vchPubKeys.size());
 
@@ -58,20 +68,200 @@ bool EncryptBDAPData(const vCharVector& vchPubKeys,
     size_t ciphertextSize = BDAPCiphertextSize(numRecipients, vchData.size());
     vchCipherText.resize(ciphertextSize);
 
+    if (nThreads != 1 && (numRecipients > BDAP_BATCH_SIZE ||
+                          vchData.size() >= bdap_get_parallel_gcm_threshold()))
+    {
+        fPool = bdap_thread_pool_init(&pool, nThreads);
+    }
+
     const char *error_message;
-    status = bdap_encrypt(vchCipherText.data(),
-                          numRecipients,
-                          publicKeys,
-                          vchData.data(),
-                          vchData.size(),
-                          &error_message);
+    status = bdap_encrypt_parallel(vchCipherText.data(),
+                                   numRecipients,
+                                   publicKeys,
+                                   vchData.data(),
+                                   vchData.size(),
+                                   fPool ? &pool : NULL,
+                                   &error_message);
     strErrorMessage = error_message;
 
+    if (fPool)
+    {
+        bdap_thread_pool_destroy(&pool);
+    }
+
     delete[] publicKeys;
 
     return status;
 }
 
+/**
+ * @brief Encrypts a piece of data using BDAP for a set of recipient's public-keys,
+ * with the segmented v2 layout whose ranges can be decrypted on their own.
+ * 
+ * @param vchPubKeys The set of recipients Ed25519 public-keys, 32 bytes each
+ * @param vchData The input data to be encrypted
+ * @param vchCipherText The output ciphertext
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nSegmentSize The segment size in bytes, a power of two from 1 KiB to 16 MiB
+ * @param nThreads The number of threads, 0 for the number of processors
+ * @return true on success
+ * @return false on failure
+ */
+bool EncryptBDAPDataV2(const vCharVector& vchPubKeys,
+                       const CharVector& vchData,
+                       CharVector& vchCipherText,
+                       std::string& strErrorMessage,
+                       const size_t nSegmentSize,
+                       const uint32_t nThreads)
+{
+    bool status = false;
+    bdap_thread_pool pool;
+    bool fPool = false;
+    uint16_t index;
+    uint16_t numRecipients = uint16_t(vchPubKeys.size());
+    std::vector<const uint8_t*> publicKeys(numRecipients);
+
+    for (index = 0; index < numRecipients; index++)
+    {
+        publicKeys[index] = vchPubKeys[index].data();
+    }
+
+    vchCipherText.resize(bdap_ciphertext_size_v2(numRecipients, vchData.size(), nSegmentSize));
+
+    if (nThreads != 1 && (numRecipients > BDAP_BATCH_SIZE || vchData.size() > nSegmentSize))
+    {
+        fPool = bdap_thread_pool_init(&pool, nThreads);
+    }
+
+    const char *error_message;
+    status = bdap_encrypt_v2(vchCipherText.data(),
+                             numRecipients,
+                             publicKeys.data(),
+                             vchData.data(),
+                             vchData.size(),
+                             nSegmentSize,
+                             fPool ? &pool : NULL,
+                             &error_message);
+    strErrorMessage = error_message;
+    if (!status)
+    {
+        vchCipherText.clear();
+    }
+
+    if (fPool)
+    {
+        bdap_thread_pool_destroy(&pool);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Validates and converts the recipients' public-keys.
+ * 
+ * @param vchPubKeys The set of recipients Ed25519 public-keys, 32 bytes each
+ */
+BDAPRecipientSet::BDAPRecipientSet(const vCharVector& vchPubKeys)
+    : vRecipients(vchPubKeys.size())
+{
+    uint16_t index;
+    uint16_t numRecipients = uint16_t(vchPubKeys.size());
+    std::vector<const uint8_t*> publicKeys(numRecipients);
+    bdap_recipient_set set;
+
+    for (index = 0; index < numRecipients; index++)
+    {
+        publicKeys[index] = vchPubKeys[index].data();
+    }
+
+    const char *error_message;
+    fValid = bdap_recipient_set_init(&set,
+                                     vRecipients.data(),
+                                     numRecipients,
+                                     publicKeys.data(),
+                                     &error_message);
+    strInitErrorMessage = error_message;
+}
+
+/**
+ * @brief Checks whether or not all the public-keys were converted successfully.
+ * 
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @return true if the set is usable
+ * @return false otherwise
+ */
+bool BDAPRecipientSet::IsValid(std::string& strErrorMessage) const
+{
+    strErrorMessage = strInitErrorMessage;
+
+    return fValid;
+}
+
+/**
+ * @brief Returns the number of recipients in the set.
+ */
+uint16_t BDAPRecipientSet::Size() const
+{
+    return uint16_t(vRecipients.size());
+}
+
+/**
+ * @brief Encrypts a piece of data using BDAP for a prepared set of recipients.
+ * 
+ * @param recipientSet The prepared set of recipients
+ * @param vchData The input data to be encrypted
+ * @param vchCipherText The output ciphertext
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nThreads The number of threads, 0 for the number of processors
+ * @return true on success
+ * @return false on failure
+ */
+bool EncryptBDAPData(const BDAPRecipientSet& recipientSet,
+                     const CharVector& vchData,
+                     CharVector& vchCipherText,
+                     std::string& strErrorMessage,
+                     const uint32_t nThreads)
+{
+    bool status = false;
+    bdap_recipient_set set;
+    bdap_thread_pool pool;
+    bool fPool = false;
+
+    if (!recipientSet.fValid)
+    {
+        strErrorMessage = recipientSet.strInitErrorMessage;
+        return false;
+    }
+
+    set.recipients = recipientSet.vRecipients.data();
+    set.num_recipients = recipientSet.Size();
+
+    size_t ciphertextSize = BDAPCiphertextSize(set.num_recipients, vchData.size());
+    vchCipherText.resize(ciphertextSize);
+
+    if (nThreads != 1 && (set.num_recipients > BDAP_BATCH_SIZE ||
+                          vchData.size() >= bdap_get_parallel_gcm_threshold()))
+    {
+        fPool = bdap_thread_pool_init(&pool, nThreads);
+    }
+
+    const char *error_message;
+    status = bdap_encrypt_to_set_parallel(vchCipherText.data(),
+                                          &set,
+                                          vchData.data(),
+                                          vchData.size(),
+                                          fPool ? &pool : NULL,
+                                          &error_message);
+    strErrorMessage = error_message;
+
+    if (fPool)
+    {
+        bdap_thread_pool_destroy(&pool);
+    }
+
+    return status;
+}
+
 /**
  * @brief Decrypts a piece of BDAP encrypted ciphertext using a Ed25519 private-key seed.
  * 
@@ -79,13 +269,15 @@ bool EncryptBDAPData(const vCharVector& vchPubKeys,
  * @param vchCipherText The input BDAP ciphertext
  * @param vchData The decrypted output
  * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nThreads The number of threads, 0 for the number of processors
  * @return true on success
  * @return false on failure
  */
 bool DecryptBDAPData(const CharVector& vchPrivKeySeed,
                      const CharVector& vchCipherText,
                      CharVector& vchData,
-                     std::string& strErrorMessage)
+                     std::string& strErrorMessage,
+                     const uint32_t nThreads)
 {
     bool status = false;
     const char *error_message;
@@ -101,11 +293,534 @@ bool DecryptBDAPData(const CharVector& vchPrivKeySeed,
     size_t expectedDecryptedSize = BDAPExpectedDecryptedSize(vchCipherText);
     vchData.resize(expectedDecryptedSize);
 
-    status = bdap_decrypt(vchData.data(),
-                          vchPrivKeySeed.data(),
-                          vchCipherText.data(),
-                          vchCipherText.size(),
-                          &error_message);
+    if (nThreads == 1 || expectedDecryptedSize < bdap_get_parallel_gcm_threshold())
+    {
+        status = bdap_decrypt(vchData.data(),
+                              vchPrivKeySeed.data(),
+                              vchCipherText.data(),
+                              vchCipherText.size(),
+                              &error_message);
+        strErrorMessage = error_message;
+
+        return status;
+    }
+
+    bdap_decrypt_key key;
+    bdap_thread_pool pool;
+    bool fPool = false;
+
+    status = bdap_decrypt_key_init(&key, vchPrivKeySeed.data(), &error_message);
+    if (status)
+    {
+        fPool = bdap_thread_pool_init(&pool, nThreads);
+        status = bdap_decrypt_with_key_parallel(vchData.data(),
+                                                &key,
+                                                vchCipherText.data(),
+                                                vchCipherText.size(),
+                                                fPool ? &pool : NULL,
+                                                &error_message);
+    }
+    strErrorMessage = error_message;
+
+    if (fPool)
+    {
+        bdap_thread_pool_destroy(&pool);
+    }
+    bdap_decrypt_key_wipe(&key);
+
+    return status;
+}
+
+/**
+ * @brief Encrypts a stream using BDAP for a set of recipient's public-keys.
+ * 
+ * @param vchPubKeys The set of recipients Ed25519 public-keys, 32 bytes each
+ * @param input The data to be encrypted, read until its end
+ * @param output The output ciphertext
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nChunkSize The size of the chunks in bytes
+ * @return true on success
+ * @return false on failure
+ */
+bool EncryptBDAPStream(const vCharVector& vchPubKeys,
+                       std::istream& input,
+                       std::ostream& output,
+                       std::string& strErrorMessage,
+                       const size_t nChunkSize)
+{
+    bool status = false;
+    uint16_t index;
+    uint16_t numRecipients = uint16_t(vchPubKeys.size());
+    bdap_encrypt_stream stream;
+    uint8_t tag[AES256GCM_TAG_SIZE];
+
+    std::vector<const uint8_t*> publicKeys(numRecipients);
+    for (index = 0; index < numRecipients; index++)
+    {
+        publicKeys[index] = vchPubKeys[index].data();
+    }
+
+    const char *error_message;
+    CharVector vchHeader(BDAPCiphertextSize(numRecipients, 0) - AES256GCM_TAG_SIZE);
+    if (false == bdap_encrypt_stream_init(&stream,
+                                          vchHeader.data(),
+                                          numRecipients,
+                                          publicKeys.data(),
+                                          &error_message))
+    {
+        strErrorMessage = error_message;
+        return false;
+    }
+    output.write(reinterpret_cast<const char*>(vchHeader.data()), vchHeader.size());
+
+    CharVector vchChunk(nChunkSize > 0 ? nChunkSize : 1);
+    CharVector vchCipherChunk(vchChunk.size());
+    bool updated = true;
+    while (updated && input.good() && output.good())
+    {
+        input.read(reinterpret_cast<char*>(vchChunk.data()), vchChunk.size());
+        size_t nRead = size_t(input.gcount());
+        updated = bdap_encrypt_stream_update(&stream, vchCipherChunk.data(), vchChunk.data(),
+                                             nRead, &error_message);
+        output.write(reinterpret_cast<const char*>(vchCipherChunk.data()), updated ? nRead : 0);
+    }
+    crypto_memzero(vchChunk.data(), vchChunk.size());
+
+    bdap_encrypt_stream_final(&stream, tag);
+    if (!updated)
+    {
+        /* The input is too long for a single AES-GCM message */
+        crypto_memzero(tag, sizeof(tag));
+        strErrorMessage = error_message;
+        return false;
+    }
+    output.write(reinterpret_cast<const char*>(tag), sizeof(tag));
+
+    status = input.eof() && !input.bad() && output.good();
+    strErrorMessage = bdap_error_message[status ? BDAP_SUCCESS : BDAP_STREAM_IO_FAILED];
+
+    return status;
+}
+
+/**
+ * @brief Decrypts a BDAP ciphertext stream using a Ed25519 private-key seed.
+ * 
+ * @param vchPrivKeySeed The Ed25519 private-key seed, 32 bytes
+ * @param input The input BDAP ciphertext, from its current position to its end
+ * @param output The decrypted output
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nChunkSize The size of the chunks in bytes
+ * @return true on success
+ * @return false on failure
+ */
+bool DecryptBDAPStream(const CharVector& vchPrivKeySeed,
+                       std::istream& input,
+                       std::ostream& output,
+                       std::string& strErrorMessage,
+                       const size_t nChunkSize)
+{
+    bool status = false;
+    const char *error_message = bdap_error_message[BDAP_STREAM_IO_FAILED];
+    bdap_decrypt_key key;
+    bdap_decrypt_stream stream;
+    uint8_t prefix[2];
+    uint8_t tag[AES256GCM_TAG_SIZE];
+    size_t nCipherTextSize, nHeaderSize, nPayloadSize, nLeft, nRead;
+
+    std::streampos start = input.tellg();
+    input.seekg(0, std::ios::end);
+    std::streampos end = input.tellg();
+    input.seekg(start);
+    if (start < 0 || end < start || !input.good())
+    {
+        strErrorMessage = error_message;
+        return false;
+    }
+    nCipherTextSize = size_t(end - start);
+
+    /* Read the header, its size is given by its first two bytes */
+    if (nCipherTextSize < sizeof(prefix) ||
+        !input.read(reinterpret_cast<char*>(prefix), sizeof(prefix)))
+    {
+        strErrorMessage = bdap_error_message[BDAP_INVALID_CIPHERTEXT];
+        return false;
+    }
+    nHeaderSize = bdap_header_size(prefix);
+    if (nCipherTextSize < nHeaderSize + AES256GCM_TAG_SIZE)
+    {
+        strErrorMessage = bdap_error_message[BDAP_INVALID_CIPHERTEXT];
+        return false;
+    }
+    CharVector vchHeader(nHeaderSize);
+    std::copy(prefix, prefix + sizeof(prefix), vchHeader.begin());
+    if (!input.read(reinterpret_cast<char*>(vchHeader.data() + sizeof(prefix)),
+                    nHeaderSize - sizeof(prefix)))
+    {
+        strErrorMessage = error_message;
+        return false;
+    }
+
+    status = bdap_decrypt_key_init(&key, vchPrivKeySeed.data(), &error_message);
+    if (status)
+    {
+        status = bdap_decrypt_stream_init(&stream, &key, vchHeader.data(),
+                                          nCipherTextSize, &error_message);
+    }
+    bdap_decrypt_key_wipe(&key);
+    if (!status)
+    {
+        strErrorMessage = error_message;
+        return false;
+    }
+    nPayloadSize = nCipherTextSize - nHeaderSize - AES256GCM_TAG_SIZE;
+
+    CharVector vchChunk(nChunkSize > 0 ? nChunkSize : 1);
+    CharVector vchPlainChunk(vchChunk.size());
+
+    /* 1. Authenticate the whole payload */
+    for (nLeft = nPayloadSize; status && nLeft > 0; nLeft -= nRead)
+    {
+        nRead = std::min(nLeft, vchChunk.size());
+        status = bool(input.read(reinterpret_cast<char*>(vchChunk.data()), nRead));
+        if (status && !bdap_decrypt_stream_authenticate(&stream, vchChunk.data(), nRead,
+                                                        &error_message))
+        {
+            status = false;
+            goto decrypt_stream_bail;
+        }
+    }
+    status = status && bool(input.read(reinterpret_cast<char*>(tag), sizeof(tag)));
+    if (!status)
+    {
+        error_message = bdap_error_message[BDAP_STREAM_IO_FAILED];
+        goto decrypt_stream_bail;
+    }
+    if (!bdap_decrypt_stream_verify(&stream, tag, &error_message))
+    {
+        status = false;
+        goto decrypt_stream_bail;
+    }
+
+    /* 2. Decrypt it */
+    input.seekg(start + std::streamoff(nHeaderSize));
+    for (nLeft = nPayloadSize; status && nLeft > 0; nLeft -= nRead)
+    {
+        nRead = std::min(nLeft, vchChunk.size());
+        status = bool(input.read(reinterpret_cast<char*>(vchChunk.data()), nRead)) &&
+                 bdap_decrypt_stream_update(&stream, vchPlainChunk.data(), vchChunk.data(),
+                                            nRead, &error_message);
+        output.write(reinterpret_cast<const char*>(vchPlainChunk.data()), status ? nRead : 0);
+        status = status && output.good();
+    }
+    error_message = bdap_error_message[status ? BDAP_SUCCESS : BDAP_STREAM_IO_FAILED];
+
+decrypt_stream_bail:
+    crypto_memzero(vchPlainChunk.data(), vchPlainChunk.size());
+    bdap_decrypt_stream_wipe(&stream);
+    strErrorMessage = error_message;
+
+    return status;
+}
+
+/**
+ * @brief Decrypts a batch of BDAP ciphertexts using a Ed25519 private-key seed.
+ * 
+ * @param vchPrivKeySeed The Ed25519 private-key seed, 32 bytes
+ * @param vchCipherTexts The input BDAP ciphertexts
+ * @param vchData The decrypted outputs, one per ciphertext
+ * @param vStatus The status codes, one per ciphertext, see encryption_error.h
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @param nThreads The number of threads, 0 for the number of processors
+ * @return true if all the ciphertexts were decrypted
+ * @return false on failure
+ */
+bool DecryptBDAPBatch(const CharVector& vchPrivKeySeed,
+                      const vCharVector& vchCipherTexts,
+                      vCharVector& vchData,
+                      std::vector<uint16_t>& vStatus,
+                      std::string& strErrorMessage,
+                      const uint32_t nThreads)
+{
+    bool status = false;
+    const char *error_message;
+    bdap_decrypt_key key;
+    bdap_thread_pool pool;
+    bool fPool = false;
+    size_t i, nCipherTexts = vchCipherTexts.size();
+
+    vchData.assign(nCipherTexts, CharVector());
+    vStatus.assign(nCipherTexts, BDAP_SUCCESS);
+
+    std::vector<uint8_t*> vPlaintexts(nCipherTexts);
+    std::vector<const uint8_t*> vCipherTexts(nCipherTexts);
+    std::vector<size_t> vCipherTextSizes(nCipherTexts);
+    for (i = 0; i < nCipherTexts; ++i)
+    {
+        /* Invalid ciphertexts are rejected before anything is written */
+        if (bdap_validate_ciphertext(vchCipherTexts[i].data(),
+                                     vchCipherTexts[i].size(),
+                                     NULL))
+        {
+            vchData[i].resize(BDAPExpectedDecryptedSize(vchCipherTexts[i]));
+        }
+        vPlaintexts[i] = vchData[i].data();
+        vCipherTexts[i] = vchCipherTexts[i].data();
+        vCipherTextSizes[i] = vchCipherTexts[i].size();
+    }
+
+    if (false == bdap_decrypt_key_init(&key, vchPrivKeySeed.data(), &error_message))
+    {
+        strErrorMessage = error_message;
+        vStatus.assign(nCipherTexts, BDAP_UNKNOWN_ERROR);
+        bdap_decrypt_key_wipe(&key);
+        return false;
+    }
+
+    if (nThreads != 1 && nCipherTexts > 1)
+    {
+        fPool = bdap_thread_pool_init(&pool, nThreads);
+    }
+
+    status = bdap_decrypt_batch(vPlaintexts.data(),
+                                vStatus.data(),
+                                &key,
+                                vCipherTexts.data(),
+                                vCipherTextSizes.data(),
+                                nCipherTexts,
+                                fPool ? &pool : NULL);
+
+    if (fPool)
+    {
+        bdap_thread_pool_destroy(&pool);
+    }
+    bdap_decrypt_key_wipe(&key);
+
+    strErrorMessage = bdap_error_message[BDAP_SUCCESS];
+    for (i = 0; i < nCipherTexts; ++i)
+    {
+        if (vStatus[i] != BDAP_SUCCESS)
+        {
+            strErrorMessage = bdap_error_message[vStatus[i]];
+            vchData[i].clear();
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Derives the decryption keys from an Ed25519 private-key seed.
+ * 
+ * @param vchPrivKeySeed The Ed25519 private-key seed, 32 bytes
+ */
+BDAPDecryptor::BDAPDecryptor(const CharVector& vchPrivKeySeed)
+{
+    const char *error_message;
+
+    fValid = bdap_decrypt_key_init(&key, vchPrivKeySeed.data(), &error_message);
+    strInitErrorMessage = error_message;
+}
+
+BDAPDecryptor::~BDAPDecryptor()
+{
+    bdap_decrypt_key_wipe(&key);
+}
+
+/**
+ * @brief Checks whether or not the decryption keys were derived successfully.
+ * 
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @return true if the keys are usable
+ * @return false otherwise
+ */
+bool BDAPDecryptor::IsValid(std::string& strErrorMessage) const
+{
+    strErrorMessage = strInitErrorMessage;
+
+    return fValid;
+}
+
+/**
+ * @brief Decrypts a piece of BDAP encrypted ciphertext.
+ * 
+ * @param vchCipherText The input BDAP ciphertext
+ * @param vchData The decrypted output
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @return true on success
+ * @return false on failure
+ */
+bool BDAPDecryptor::Decrypt(const CharVector& vchCipherText,
+                            CharVector& vchData,
+                            std::string& strErrorMessage) const
+{
+    bool status = false;
+    const char *error_message;
+
+    if (!fValid)
+    {
+        strErrorMessage = strInitErrorMessage;
+        return false;
+    }
+
+    if (false == bdap_validate_ciphertext(vchCipherText.data(),
+                                          vchCipherText.size(),
+                                          &error_message))
+    {
+        strErrorMessage = error_message;
+        return false;
+    }
+
+    size_t expectedDecryptedSize = BDAPExpectedDecryptedSize(vchCipherText);
+    vchData.resize(expectedDecryptedSize);
+
+    status = bdap_decrypt_with_key(vchData.data(),
+                                   &key,
+                                   vchCipherText.data(),
+                                   vchCipherText.size(),
+                                   &error_message);
+    strErrorMessage = error_message;
+
+    return status;
+}
+
+/**
+ * @brief Decrypts a range of the data of a BDAP v2 ciphertext, authenticating
+ * and decrypting only the segments it overlaps.
+ * 
+ * @param vchCipherText The input BDAP v2 ciphertext
+ * @param nOffset The offset of the range in the data
+ * @param nLength The length of the range in bytes
+ * @param vchData The decrypted range
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @return true on success
+ * @return false on failure
+ */
+bool BDAPDecryptor::DecryptRange(const CharVector& vchCipherText,
+                                 const size_t nOffset,
+                                 const size_t nLength,
+                                 CharVector& vchData,
+                                 std::string& strErrorMessage) const
+{
+    bool status = false;
+    const char *error_message;
+
+    if (!fValid)
+    {
+        strErrorMessage = strInitErrorMessage;
+        return false;
+    }
+
+    if (false == bdap_validate_ciphertext(vchCipherText.data(),
+                                          vchCipherText.size(),
+                                          &error_message))
+    {
+        strErrorMessage = error_message;
+        return false;
+    }
+
+    if (nLength > BDAPExpectedDecryptedSize(vchCipherText))
+    {
+        strErrorMessage = bdap_error_message[BDAP_INVALID_RANGE];
+        return false;
+    }
+
+    vchData.resize(nLength);
+    status = bdap_decrypt_range(vchData.data(),
+                                &key,
+                                vchCipherText.data(),
+                                vchCipherText.size(),
+                                nOffset,
+                                nLength,
+                                NULL,
+                                &error_message);
+    strErrorMessage = error_message;
+    if (!status)
+    {
+        vchData.clear();
+    }
+
+    return status;
+}
+
+/**
+ * @brief Creates an empty keyring.
+ * 
+ * @param nCapacity The maximum number of identities
+ */
+BDAPKeyring::BDAPKeyring(const size_t nCapacity)
+    : vKeys(nCapacity), vIndex(BDAP_KEYRING_INDEX_SIZE(nCapacity))
+{
+    bdap_keyring_init(&keyring, vKeys.data(), vIndex.data(), nCapacity);
+}
+
+BDAPKeyring::~BDAPKeyring()
+{
+    bdap_keyring_wipe(&keyring);
+}
+
+/**
+ * @brief Derives the decryption keys of an identity and adds them to the keyring.
+ * 
+ * @param vchPrivKeySeed The Ed25519 private-key seed, 32 bytes
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @return true on success
+ * @return false on failure
+ */
+bool BDAPKeyring::AddKey(const CharVector& vchPrivKeySeed, std::string& strErrorMessage)
+{
+    bool status = false;
+    const char *error_message;
+
+    status = bdap_keyring_add(&keyring, vchPrivKeySeed.data(), &error_message);
+    strErrorMessage = error_message;
+
+    return status;
+}
+
+/**
+ * @brief Returns the number of identities in the keyring.
+ */
+size_t BDAPKeyring::Size() const
+{
+    return keyring.num_keys;
+}
+
+/**
+ * @brief Decrypts a piece of BDAP encrypted ciphertext with whichever identity
+ * it is addressed to.
+ * 
+ * @param vchCipherText The input BDAP ciphertext
+ * @param vchData The decrypted output
+ * @param nIdentity The position of the identity in the order of AddKey, or Size()
+ *                  if none is a recipient
+ * @param strErrorMessage The string containing error-message in the event of failure
+ * @return true on success
+ * @return false on failure
+ */
+bool BDAPKeyring::Decrypt(const CharVector& vchCipherText,
+                          CharVector& vchData,
+                          size_t& nIdentity,
+                          std::string& strErrorMessage) const
+{
+    bool status = false;
+    const char *error_message;
+
+    nIdentity = keyring.num_keys;
+    if (false == bdap_validate_ciphertext(vchCipherText.data(),
+                                          vchCipherText.size(),
+                                          &error_message))
+    {
+        strErrorMessage = error_message;
+        return false;
+    }
+
+    vchData.resize(BDAPExpectedDecryptedSize(vchCipherText));
+    status = bdap_keyring_decrypt(vchData.data(),
+                                  &nIdentity,
+                                  &keyring,
+                                  vchCipherText.data(),
+                                  vchCipherText.size(),
+                                  &error_message);
     strErrorMessage = error_message;
 
     return status;
@@ -6,17 +6,32 @@
 #include "encryption_error.h"
 #include "ed25519.h"
 #include "curve25519.h"
+#include "fe.h"
+#include "fingerprint.h"
 #include "aes256ctr.h"
 #include "aes256gcm.h"
 #include "shake256.h"
 #include "rand.h"
 #include "utils.h"
+#include "thread_pool.h"
 
-#define FINGERPRINT_SIZE    7
+#define FINGERPRINT_SIZE    BDAP_FINGERPRINT_SIZE
 #define SECRET_SIZE         32
-#define BUF_SIZE            3*CURVE25519_PUBLIC_KEY_SIZE
+#define SLOT_SIZE           (FINGERPRINT_SIZE + SECRET_SIZE)
+#define SORTED_FLAG         0x80
 #define KEY_IV_SIZE         AES256CTR_KEY_SIZE + AES256CTR_IV_SIZE
 #define KEY_NONCE_SIZE      AES256GCM_KEY_SIZE + AES256GCM_NONCE_SIZE
+#define BATCH_SIZE          BDAP_BATCH_SIZE
+#define MAX_BATCHES         ((UINT16_MAX + BATCH_SIZE - 1) / BATCH_SIZE)
+#define V2_PREAMBLE_SIZE    BDAP_V2_PREAMBLE_SIZE
+#define V2_VERSION          2
+#define V2_MIN_SEGMENT_SHIFT 10
+#define V2_MAX_SEGMENT_SHIFT 24
+#define V2_NONCE_PREFIX_SIZE 7
+#define MAX_SEGMENT_TASKS   256
+
+static volatile size_t parallel_gcm_threshold = BDAP_PARALLEL_GCM_THRESHOLD;
+static volatile bool constant_time_lookup = false;
 
 static uint16_t bdap_ciphertext_number_of_recipients(
     const uint8_t* ciphertext)
@@ -30,15 +45,234 @@ static size_t bdap_ciphertext_header_size(const uint16_t num_recipients)
         + num_recipients * (FINGERPRINT_SIZE + SECRET_SIZE);
 }
 
+/**
+ * @brief The secrets of bdap_encrypt_header.
+ */
+typedef struct
+{
+    uint8_t ephemeral_sk[CURVE25519_PRIVATE_KEY_SIZE];
+    uint8_t s[SECRET_SIZE];
+} bdap_encrypt_secrets;
+
+/**
+ * @brief The scratch state of bdap_decrypt_secret.
+ */
+typedef struct
+{
+    uint8_t Q[CURVE25519_POINT_SIZE];
+    uint8_t s[SECRET_SIZE];
+    uint8_t key_iv[KEY_IV_SIZE];
+    shake256_ctx xof;
+} bdap_decrypt_scratch;
+
+/**
+ * @brief The number of Diffie-Hellman exchanges of a batch that
+ * share an inversion, so that their projective results fit a slot.
+ */
+#define DH_GROUP_SIZE 4
+
+/**
+ * @brief The projective shared points of a group of exchanges of
+ * bdap_encrypt_batch_task.
+ */
+typedef struct
+{
+    fe X[DH_GROUP_SIZE];
+    fe Z[DH_GROUP_SIZE];
+    fe Z_inv[DH_GROUP_SIZE];
+} bdap_encrypt_dh_scratch;
+
+/**
+ * @brief The per recipient key derivation state of
+ * bdap_encrypt_batch_task.
+ */
+typedef struct
+{
+    uint8_t Q[CURVE25519_POINT_SIZE];
+    uint8_t key_iv[KEY_IV_SIZE];
+    uint8_t c[SECRET_SIZE];
+    shake256_ctx xof;
+} bdap_encrypt_key_scratch;
+
+typedef char bdap_encrypt_secrets_fit[
+    (sizeof(bdap_encrypt_secrets) <= CRYPTO_SECURE_SLOT_SIZE) ? 1 : -1];
+typedef char bdap_encrypt_dh_scratch_fits[
+    (sizeof(bdap_encrypt_dh_scratch) <= CRYPTO_SECURE_SLOT_SIZE) ? 1 : -1];
+typedef char bdap_encrypt_key_scratch_fits[
+    (sizeof(bdap_encrypt_key_scratch) <= CRYPTO_SECURE_SLOT_SIZE) ? 1 : -1];
+typedef char bdap_decrypt_scratch_fits[
+    (sizeof(bdap_decrypt_scratch) <= CRYPTO_SECURE_SLOT_SIZE) ? 1 : -1];
+typedef char bdap_decrypt_key_fits[
+    (sizeof(bdap_decrypt_key) <= CRYPTO_SECURE_SLOT_SIZE) ? 1 : -1];
+
+/**
+ * @brief Takes a slot of the secure arena for the secrets of a
+ * call, so that they are kept in locked memory without any system
+ * call.
+ * 
+ * @note When the arena is unavailable or exhausted, the secrets
+ * are kept in {@code fallback}, a buffer of the caller, instead.
+ * Either way, the memory returned is zeroed.
+ * 
+ * @param fallback the caller's buffer
+ * @param size the size of the secrets in bytes
+ * @return the slot, or {@code fallback}
+ */
+static void* bdap_secrets_take(void* fallback, const size_t size)
+{
+    void* slot = crypto_secure_alloc();
+
+    if (slot == NULL)
+    {
+        memset(fallback, 0, size);
+        return fallback;
+    }
+
+    return slot;
+}
+
+/**
+ * @brief Wipes the secrets taken by bdap_secrets_take(void*,
+ * const size_t) and gives their slot back.
+ */
+static void bdap_secrets_release(void* secrets,
+                                 void* fallback,
+                                 const size_t size)
+{
+    if (secrets == fallback)
+    {
+        crypto_memzero(fallback, size);
+    }
+    else
+    {
+        crypto_secure_free(secrets);
+    }
+}
+
+static void bdap_slot_swap(uint8_t* a, uint8_t* b)
+{
+    uint8_t tmp[SLOT_SIZE];
+
+    memcpy(tmp, a, SLOT_SIZE);
+    memcpy(a, b, SLOT_SIZE);
+    memcpy(b, tmp, SLOT_SIZE);
+}
+
+static void bdap_slot_sift_down(uint8_t* slots, size_t root, const size_t end)
+{
+    size_t child;
+
+    while ((child = 2 * root + 1) < end)
+    {
+        if (child + 1 < end &&
+            memcmp(slots + child * SLOT_SIZE,
+                   slots + (child + 1) * SLOT_SIZE,
+                   FINGERPRINT_SIZE) < 0)
+        {
+            ++child;
+        }
+        if (memcmp(slots + root * SLOT_SIZE,
+                   slots + child * SLOT_SIZE,
+                   FINGERPRINT_SIZE) >= 0)
+        {
+            return;
+        }
+        bdap_slot_swap(slots + root * SLOT_SIZE, slots + child * SLOT_SIZE);
+        root = child;
+    }
+}
+
+/**
+ * @brief Sorts the | f_i | c_i | pairs of a header by fingerprint,
+ * in place.
+ * 
+ * @note A heapsort, so that neither memory nor recursion depth
+ * grows with the number of recipients.
+ */
+static void bdap_sort_slots(uint8_t* slots, const uint16_t num_recipients)
+{
+    size_t idx;
+
+    for (idx = num_recipients / 2; idx > 0; --idx)
+    {
+        bdap_slot_sift_down(slots, idx - 1, num_recipients);
+    }
+    for (idx = num_recipients; idx > 1; --idx)
+    {
+        bdap_slot_swap(slots, slots + (idx - 1) * SLOT_SIZE);
+        bdap_slot_sift_down(slots, 0, idx - 1);
+    }
+}
+
+/**
+ * @brief Finds the first | f_i | c_i | pair with a given
+ * fingerprint in sorted pairs.
+ * 
+ * @return the pair, or NULL if there is none
+ */
+static const uint8_t* bdap_find_slot_sorted(const uint8_t* slots,
+                                            const uint16_t num_recipients,
+                                            const uint8_t* fingerprint)
+{
+    size_t lo = 0, hi = num_recipients, mid;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (memcmp(slots + mid * SLOT_SIZE, fingerprint, FINGERPRINT_SIZE) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo < num_recipients &&
+        memcmp(slots + lo * SLOT_SIZE, fingerprint, FINGERPRINT_SIZE) == 0)
+    {
+        return slots + lo * SLOT_SIZE;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Copies the encrypted secret of pair {@code index} while
+ * reading every pair, so that the memory accesses do not depend
+ * on the index.
+ */
+static void bdap_copy_secret_constant_time(uint8_t* encrypted_secret,
+                                           const uint8_t* slots,
+                                           const uint16_t num_recipients,
+                                           const size_t index)
+{
+    size_t i, j;
+    uint8_t mask;
+
+    memset(encrypted_secret, 0, SECRET_SIZE);
+    for (i = 0; i < num_recipients; ++i)
+    {
+        mask = (uint8_t)(0 - (uint8_t)(i == index));
+        for (j = 0; j < SECRET_SIZE; ++j)
+        {
+            encrypted_secret[j] |= mask & slots[i * SLOT_SIZE + FINGERPRINT_SIZE + j];
+        }
+    }
+}
+
 static bool bdap_get_ephemeral_public_key_and_encrypted_secret(
     uint8_t* ephemeral_public_key,
     uint8_t* encrypted_secret,
     const uint8_t* ciphertext,
     const uint8_t* ed25519_public_key)
 {
-    uint16_t i, num_recipients = 0;
+    uint16_t num_recipients = 0;
+    size_t index;
     const uint8_t *ptr = ciphertext;
     const uint8_t *fingerprint = ed25519_public_key;
+    bool constant_time = constant_time_lookup;
 
     /* N */
     num_recipients = (uint16_t)(ptr[0] + 256 * ptr[1]);
@@ -48,21 +282,170 @@ static bool bdap_get_ephemeral_public_key_and_encrypted_secret(
     memcpy(ephemeral_public_key, ptr, CURVE25519_PUBLIC_KEY_SIZE);
     ptr += CURVE25519_PUBLIC_KEY_SIZE;
 
-    /* | f_i | c_i | */
-    for (i = 0; i < num_recipients; ++i)
+    /* | f_i | c_i |, binary search if the pairs are sorted */
+    if (!constant_time &&
+        (ephemeral_public_key[CURVE25519_PUBLIC_KEY_SIZE - 1] & SORTED_FLAG))
     {
-        if (crypto_is_memequal(fingerprint, ptr, FINGERPRINT_SIZE))
+        ptr = bdap_find_slot_sorted(ptr, num_recipients, fingerprint);
+        if (ptr == NULL)
         {
-            memcpy(encrypted_secret, ptr + FINGERPRINT_SIZE, SECRET_SIZE);
-            return true;
+            crypto_memzero(ephemeral_public_key, CURVE25519_PUBLIC_KEY_SIZE);
+            return false;
         }
+        memcpy(encrypted_secret, ptr + FINGERPRINT_SIZE, SECRET_SIZE);
+        return true;
+    }
 
-        ptr += (FINGERPRINT_SIZE + SECRET_SIZE);
+    index = fingerprint_find(ptr,
+                             num_recipients,
+                             SLOT_SIZE,
+                             fingerprint,
+                             constant_time);
+    if (index >= num_recipients)
+    {
+        crypto_memzero(ephemeral_public_key, CURVE25519_PUBLIC_KEY_SIZE);
+        return false;
     }
 
-    crypto_memzero(ephemeral_public_key, CURVE25519_PUBLIC_KEY_SIZE);
+    if (constant_time)
+    {
+        bdap_copy_secret_constant_time(encrypted_secret,
+                                       ptr,
+                                       num_recipients,
+                                       index);
+    }
+    else
+    {
+        memcpy(encrypted_secret, ptr + index * SLOT_SIZE + FINGERPRINT_SIZE,
+               SECRET_SIZE);
+    }
 
-    return false;
+    return true;
+}
+
+/**
+ * @brief The payload layout of a v2 ciphertext.
+ */
+typedef struct
+{
+    size_t header_size;
+    size_t segment_size;
+    size_t num_segments;
+    size_t last_segment_size;
+    size_t plaintext_size;
+} bdap_v2_layout;
+
+static bool bdap_ciphertext_is_v2(const uint8_t* ciphertext,
+                                  const size_t ciphertext_size)
+{
+    return (ciphertext_size >= 2 && ciphertext[0] == 0 && ciphertext[1] == 0);
+}
+
+/**
+ * @brief Returns log2 of a segment size, or 0 if it is not a power
+ * of two between BDAP_V2_MIN_SEGMENT_SIZE and BDAP_V2_MAX_SEGMENT_SIZE.
+ */
+static uint8_t bdap_v2_segment_shift(const size_t segment_size)
+{
+    uint8_t shift;
+
+    for (shift = V2_MIN_SEGMENT_SHIFT; shift <= V2_MAX_SEGMENT_SHIFT; ++shift)
+    {
+        if (segment_size == ((size_t)1 << shift))
+        {
+            return shift;
+        }
+    }
+
+    return 0;
+}
+
+static size_t bdap_v2_num_segments(const size_t plaintext_size,
+                                   const size_t segment_size)
+{
+    if (plaintext_size == 0)
+    {
+        return 1;
+    }
+
+    return plaintext_size / segment_size
+        + (plaintext_size % segment_size != 0);
+}
+
+/**
+ * @brief Parses the preamble of a v2 ciphertext and checks that its
+ * size matches a whole number of segments.
+ * 
+ * @param layout the output layout
+ * @param ciphertext the ciphertext, starting with 00 00
+ * @param ciphertext_size the ciphertext size in bytes
+ * @return true if the ciphertext is a well-formed v2 ciphertext
+ * @return false otherwise
+ */
+static bool bdap_v2_parse_layout(bdap_v2_layout* layout,
+                                 const uint8_t* ciphertext,
+                                 const size_t ciphertext_size)
+{
+    uint16_t num_recipients;
+    size_t payload_size, stride;
+
+    if (ciphertext_size < V2_PREAMBLE_SIZE + 2 ||
+        ciphertext[2] != V2_VERSION ||
+        ciphertext[3] < V2_MIN_SEGMENT_SHIFT ||
+        ciphertext[3] > V2_MAX_SEGMENT_SHIFT)
+    {
+        return false;
+    }
+
+    num_recipients = bdap_ciphertext_number_of_recipients(
+        ciphertext + V2_PREAMBLE_SIZE);
+    layout->header_size = V2_PREAMBLE_SIZE
+        + bdap_ciphertext_header_size(num_recipients);
+    if ((num_recipients <= 0) ||
+        (ciphertext_size < layout->header_size + AES256GCM_TAG_SIZE))
+    {
+        return false;
+    }
+
+    layout->segment_size = (size_t)1 << ciphertext[3];
+    stride = layout->segment_size + AES256GCM_TAG_SIZE;
+    payload_size = ciphertext_size - layout->header_size;
+    layout->num_segments = payload_size / stride + (payload_size % stride != 0);
+    layout->last_segment_size = payload_size
+        - (layout->num_segments - 1) * stride;
+
+    /* Every segment carries a tag, and only an empty plaintext
+     * has an empty last segment */
+    if ((layout->last_segment_size < AES256GCM_TAG_SIZE) ||
+        (layout->last_segment_size == AES256GCM_TAG_SIZE &&
+         layout->num_segments > 1) ||
+        ((uint64_t)layout->num_segments - 1 > UINT32_MAX))
+    {
+        return false;
+    }
+    layout->last_segment_size -= AES256GCM_TAG_SIZE;
+    layout->plaintext_size = payload_size
+        - layout->num_segments * AES256GCM_TAG_SIZE;
+
+    return true;
+}
+
+/**
+ * @brief Derives the nonce of a v2 segment, i.e. the first 7 bytes
+ * of the payload nonce, the big-endian segment index and the
+ * last-segment flag.
+ */
+static void bdap_v2_segment_nonce(uint8_t* nonce,
+                                  const uint8_t* key_nonce,
+                                  const size_t index,
+                                  const bool last)
+{
+    memcpy(nonce, &key_nonce[AES256GCM_KEY_SIZE], V2_NONCE_PREFIX_SIZE);
+    nonce[7] = (uint8_t)(index >> 24);
+    nonce[8] = (uint8_t)(index >> 16);
+    nonce[9] = (uint8_t)(index >> 8);
+    nonce[10] = (uint8_t)index;
+    nonce[11] = last ? 1 : 0;
 }
 
 /**
@@ -82,13 +465,23 @@ bool bdap_validate_ciphertext(const uint8_t* ciphertext,
     uint16_t error_code = BDAP_SUCCESS;
     uint16_t num_recipients = 0;
     size_t minimum_ciphertext_size = 0;
+    bdap_v2_layout layout;
 
-    if (ciphertext == NULL)
+    if (ciphertext == NULL || ciphertext_size < 2)
     {
         error_code = BDAP_INVALID_CIPHERTEXT;
         goto validate_bail;
     }
 
+    if (bdap_ciphertext_is_v2(ciphertext, ciphertext_size))
+    {
+        if (true != bdap_v2_parse_layout(&layout, ciphertext, ciphertext_size))
+        {
+            error_code = BDAP_INVALID_CIPHERTEXT;
+        }
+        goto validate_bail;
+    }
+
     num_recipients = bdap_ciphertext_number_of_recipients(ciphertext);
  
     minimum_ciphertext_size = bdap_ciphertext_header_size(num_recipients) + AES256GCM_TAG_SIZE;
@@ -133,356 +526,3072 @@ size_t bdap_ciphertext_size(const uint16_t num_recipients,
 size_t bdap_decrypted_size(const uint8_t *ciphertext,
                            const size_t ciphertext_size)
 {
-    uint16_t num_recipients = 
-        bdap_ciphertext_number_of_recipients(ciphertext);
+    uint16_t num_recipients;
+    bdap_v2_layout layout;
+
+    if (bdap_ciphertext_is_v2(ciphertext, ciphertext_size))
+    {
+        if (true != bdap_v2_parse_layout(&layout, ciphertext, ciphertext_size))
+        {
+            return 0;
+        }
+        return layout.plaintext_size;
+    }
+
+    num_recipients = bdap_ciphertext_number_of_recipients(ciphertext);
     return ciphertext_size
                 - bdap_ciphertext_header_size(num_recipients)
                 - AES256GCM_TAG_SIZE;
 }
 
 /**
- * @brief Performs BDAP end-to-end encryption on a piece of
- * plaintext for a group of recipients.
- * 
- * @note Each recipient provides their Ed25519 public-key,
- * which is 32 bytes in size.
- * 
- * @note The size of the ciphertext can be obtained from
- * bdap_ciphertext_size(const uint16_t, const size_t) function.
- * 
- * @note The caller of this method does not need to allocate
- * and deallocate memory for error messages. This method returns
- * a pointer to a pre-defined string. The parameter {@code
- * error_message} can also be NULL, which means that the caller
- * doesn't want any error messages.
+ * @brief Prepares a recipient, i.e. converts the Ed25519 public-key
+ * to Curve25519 and records the fingerprint.
  * 
- * @param ciphertext the output ciphertext pointer
- * @param num_recipients the number of recipients
- * @param ed25519_public_key the pointer to an array of
- *                           recipient's public-keys
- * @param plaintext the input plaintext pointer
- * @param plaintext_size the plaintext size in bytes
- * @param error_message the pointer to the error message
- *                      in the event of error
+ * @param recipient the output recipient
+ * @param ed25519_public_key the recipient's Ed25519 public-key
  * @return true on success
- * @return false otherwise
+ * @return false if the public-key is not a valid point
  */
-bool bdap_encrypt(uint8_t* ciphertext,
-                  const uint16_t num_recipients,
-                  const uint8_t** ed25519_public_key,
-                  const uint8_t* plaintext,
-                  const size_t plaintext_size,
-                  const char** error_message)
+static bool bdap_recipient_init(bdap_recipient* recipient,
+                                const uint8_t* ed25519_public_key)
 {
-    bool result = true;
-    uint16_t idx, error_code = BDAP_SUCCESS;
-    uint8_t *c_ptr = ciphertext;
-    uint8_t ephemeral_pk[CURVE25519_PUBLIC_KEY_SIZE] = {0};
-    uint8_t ephemeral_sk[CURVE25519_PRIVATE_KEY_SIZE] = {0};
-    uint8_t s[SECRET_SIZE] = {0};
-    uint8_t curve25519_pk[CURVE25519_PUBLIC_KEY_SIZE] = {0};
-    uint8_t Q[CURVE25519_POINT_SIZE] = {0};
-    uint8_t buf[BUF_SIZE] = {0};
-    uint8_t key_iv[KEY_IV_SIZE] = {0};
-    uint8_t key_nonce[KEY_NONCE_SIZE] = {0};
-    uint8_t c[SECRET_SIZE] = {0};
-    size_t unused, ciphertext_size;
+    memcpy(recipient->fingerprint, ed25519_public_key, FINGERPRINT_SIZE);
 
-    ciphertext_size = bdap_ciphertext_size(num_recipients, plaintext_size);
+    return (0 == ed25519_to_curve25519_public_key(recipient->curve25519_pk,
+                                                  ed25519_public_key));
+}
 
-    /* Write N, the number of recipients */
-    *c_ptr++ = (uint8_t) num_recipients;
-    *c_ptr++ = (uint8_t)(num_recipients >> 8);
+/**
+ * @brief The shared state of the recipient batches of a
+ * bdap_encrypt_core call.
+ */
+typedef struct
+{
+    uint8_t* slots;
+    uint16_t num_recipients;
+    const uint8_t** ed25519_public_key;
+    const bdap_recipient* recipients;
+    const uint8_t* ephemeral_pk;
+    const uint8_t* ephemeral_sk;
+    const uint8_t* s;
+    uint16_t* status;
+} bdap_encrypt_batch_ctx;
 
-    /* 1. Generate an ephemeral Curve25519 keypair */
-    if (true != curve25519_random_keypair(ephemeral_pk, ephemeral_sk))
+/**
+ * @brief Writes the | f_i | c_i | pairs of the recipients
+ * [index * BATCH_SIZE, (index + 1) * BATCH_SIZE).
+ * 
+ * @note Every pair has a fixed offset in the ciphertext, so that
+ * the batches can be processed in any order and concurrently.
+ * The projective results of the key conversions of a batch are
+ * normalised with a single inversion, and those of its
+ * Diffie-Hellman exchanges with one per DH_GROUP_SIZE recipients.
+ * The shared points and the keys derived from them are kept in
+ * two slots of the secure arena.
+ */
+static void bdap_encrypt_batch_task(void* arg, size_t index)
+{
+    bdap_encrypt_batch_ctx* ctx = (bdap_encrypt_batch_ctx*)arg;
+    uint16_t idx, group, group_size, error_code = BDAP_SUCCESS;
+    uint16_t base = (uint16_t)(index * BATCH_SIZE);
+    uint16_t batch_size = ctx->num_recipients - base;
+    uint8_t *c_ptr = ctx->slots + base * (FINGERPRINT_SIZE + SECRET_SIZE);
+    bdap_recipient converted[BATCH_SIZE];
+    const bdap_recipient *batch;
+    const uint8_t *points[BATCH_SIZE];
+    fe X[BATCH_SIZE], Z[BATCH_SIZE], Z_inv[BATCH_SIZE];
+    bdap_encrypt_dh_scratch dh_fallback;
+    bdap_encrypt_key_scratch key_fallback;
+    bdap_encrypt_dh_scratch* dh;
+    bdap_encrypt_key_scratch* key;
+    size_t unused;
+
+    dh = bdap_secrets_take(&dh_fallback, sizeof(dh_fallback));
+    key = bdap_secrets_take(&key_fallback, sizeof(key_fallback));
+
+    if (batch_size > BATCH_SIZE)
     {
-        result = false;
-        error_code = BDAP_X25519_KEYPAIR_FAILED;
-        goto bdap_e2e_encrypt_bail;
+        batch_size = BATCH_SIZE;
     }
-    memcpy(c_ptr, ephemeral_pk, sizeof(ephemeral_pk));
-    c_ptr += sizeof(ephemeral_pk);
-
-    /* 2. Generate a random 32-byte secret */
-    bdap_randombytes(s, sizeof(s));
 
-    for (idx = 0; idx < num_recipients; ++idx)
+    /* 3a. Derive Curve25519 public-keys from Ed25519 public-keys */
+    if (ctx->recipients == NULL)
     {
-        /* 3a. Derive Curve25519 public-key from Ed25519 public-key */
-        if (0 != ed25519_to_curve25519_public_key(curve25519_pk,
-                                                  ed25519_public_key[idx]))
+        for (idx = 0; idx < batch_size; ++idx)
         {
-            result = false;
-            error_code = BDAP_ED25519_TO_X25519_PUBLIC_KEY_FAILED;
-            crypto_memzero(ciphertext, ciphertext_size);
-            goto bdap_e2e_encrypt_bail;
-        }                                          
-
-        /* 3b. Curve25519 Diffie-Hellman exchange */
-        if (curve25519_dh(Q, ephemeral_sk, curve25519_pk) == false)
+            if (0 != ed25519_to_curve25519_public_key_projective(
+                         X[idx], Z[idx], ctx->ed25519_public_key[base + idx]))
+            {
+                error_code = BDAP_ED25519_TO_X25519_PUBLIC_KEY_FAILED;
+                goto bdap_encrypt_batch_task_bail;
+            }
+            memcpy(converted[idx].fingerprint,
+                   ctx->ed25519_public_key[base + idx],
+                   FINGERPRINT_SIZE);
+        }
+        fe_batch_inv(Z_inv, (const fe *)Z, batch_size);
+        for (idx = 0; idx < batch_size; ++idx)
         {
-            result = false;
-            error_code = BDAP_X25519_DH_FAILED;
-            crypto_memzero(ciphertext, ciphertext_size);
-            goto bdap_e2e_encrypt_bail;
+            fe_mul(X[idx], X[idx], Z_inv[idx]);
+            fe_tobytes(converted[idx].curve25519_pk, X[idx]);
         }
+        batch = converted;
+    }
+    else
+    {
+        batch = &ctx->recipients[base];
+    }
 
-        /* 3c. XOF(Q | curve25519_public_key | ephemeral_pk, 48) */
-        memcpy(buf, Q, sizeof(Q));
-        memcpy(buf + CURVE25519_PUBLIC_KEY_SIZE,
-               curve25519_pk,
-               CURVE25519_PUBLIC_KEY_SIZE);
-        memcpy(buf + 2*CURVE25519_PUBLIC_KEY_SIZE,
-               ephemeral_pk,
-               sizeof(ephemeral_pk));
-        if (0 != shake256(key_iv, KEY_IV_SIZE, buf, BUF_SIZE))
+    for (idx = 0; idx < batch_size; ++idx)
+    {
+        points[idx] = batch[idx].curve25519_pk;
+    }
+
+    for (group = 0; group < batch_size; group += group_size)
+    {
+        group_size = batch_size - group;
+        if (group_size > DH_GROUP_SIZE)
         {
-            result = false;
-            error_code = BDAP_AESCTR_KEY_DERIVATION_FAILED;
-            crypto_memzero(ciphertext, ciphertext_size);
-            goto bdap_e2e_encrypt_bail;
+            group_size = DH_GROUP_SIZE;
         }
 
-        /* 3d. AESCTR_E(key, iv, s) -> c */
-        if (aes256ctr_encrypt(c,
-                              &unused,
-                              s,
-                              sizeof(s),
-                              &key_iv[AES256CTR_KEY_SIZE],
-                              key_iv) != 0)
+        /* 3b. Curve25519 Diffie-Hellman exchanges, four at a time */
+        if (curve25519_dh_batch(dh->X,
+                                dh->Z,
+                                ctx->ephemeral_sk,
+                                &points[group],
+                                group_size) == false)
         {
-            result = false;
-            error_code = BDAP_AESCTR_ENCRYPT_FAILED;
-            crypto_memzero(ciphertext, ciphertext_size);
-            goto bdap_e2e_encrypt_bail;
+            error_code = BDAP_X25519_DH_FAILED;
+            goto bdap_encrypt_batch_task_bail;
         }
+        fe_batch_inv(dh->Z_inv, (const fe *)dh->Z, group_size);
 
-        /* Write fingerprint and encrypted secret pair */
-        memcpy(c_ptr, ed25519_public_key[idx], FINGERPRINT_SIZE);
-        c_ptr += FINGERPRINT_SIZE;
-        memcpy(c_ptr, c, sizeof(c));
-        c_ptr += sizeof(c);
-    }
+        for (idx = group; idx < group + group_size; ++idx)
+        {
+            fe_mul(dh->X[idx - group],
+                   dh->X[idx - group],
+                   dh->Z_inv[idx - group]);
+            fe_tobytes(key->Q, dh->X[idx - group]);
 
-    /* 4. XOF(s, 44) */
-    crypto_memzero(buf, sizeof(buf));
-    if (0 != shake256(key_nonce, KEY_NONCE_SIZE, s, sizeof(s)))
-    {
-        result = false;
-        error_code = BDAP_AESGCM_KEY_DERIVATION_FAILED;
-        crypto_memzero(ciphertext, ciphertext_size);
-        goto bdap_e2e_encrypt_bail;
-    }
+            /* 3c. XOF(Q | curve25519_public_key | ephemeral_pk, 48) */
+            shake256_init(&key->xof);
+            if (0 != shake256_absorb(&key->xof, key->Q, sizeof(key->Q)) ||
+                0 != shake256_absorb(&key->xof,
+                                     batch[idx].curve25519_pk,
+                                     CURVE25519_PUBLIC_KEY_SIZE) ||
+                0 != shake256_absorb(&key->xof,
+                                     ctx->ephemeral_pk,
+                                     CURVE25519_PUBLIC_KEY_SIZE) ||
+                0 != shake256_finalize(&key->xof) ||
+                0 != shake256_squeeze(&key->xof, key->key_iv, KEY_IV_SIZE))
+            {
+                error_code = BDAP_AESCTR_KEY_DERIVATION_FAILED;
+                goto bdap_encrypt_batch_task_bail;
+            }
 
-    /* 5. AESGCM_E(key, nonce, plaintext) */
-    result = (aes256gcm_encrypt(c_ptr,
-                                &unused,
-                                plaintext,
-                                plaintext_size,
-                                NULL,
-                                0,
-                                &key_nonce[AES256GCM_KEY_SIZE],
-                                key_nonce) == 0);
-    if (true != result)
-    {
-        error_code = BDAP_AESGCM_ENCRYPT_FAILED;
-        crypto_memzero(ciphertext, ciphertext_size);
+            /* 3d. AESCTR_E(key, iv, s) -> c */
+            if (aes256ctr_encrypt(key->c,
+                                  &unused,
+                                  ctx->s,
+                                  SECRET_SIZE,
+                                  &key->key_iv[AES256CTR_KEY_SIZE],
+                                  key->key_iv) != 0)
+            {
+                error_code = BDAP_AESCTR_ENCRYPT_FAILED;
+                goto bdap_encrypt_batch_task_bail;
+            }
+
+            /* Write fingerprint and encrypted secret pair */
+            memcpy(c_ptr, batch[idx].fingerprint, FINGERPRINT_SIZE);
+            c_ptr += FINGERPRINT_SIZE;
+            memcpy(c_ptr, key->c, sizeof(key->c));
+            c_ptr += sizeof(key->c);
+        }
     }
 
-bdap_e2e_encrypt_bail:
-    crypto_memzero(s, sizeof(s));
-    crypto_memzero(key_iv, sizeof(key_iv));
-    crypto_memzero(key_nonce, sizeof(key_nonce));
-    crypto_memzero(ephemeral_sk, sizeof(ephemeral_sk));
-    crypto_memzero(ephemeral_pk, sizeof(ephemeral_pk));
-    crypto_memzero(curve25519_pk, CURVE25519_PUBLIC_KEY_SIZE);
-    crypto_memzero(c, sizeof(c));
-    crypto_memzero(Q, sizeof(Q));
-    crypto_memzero(buf, sizeof(buf));
+bdap_encrypt_batch_task_bail:
+    bdap_secrets_release(key, &key_fallback, sizeof(key_fallback));
+    bdap_secrets_release(dh, &dh_fallback, sizeof(dh_fallback));
+    ctx->status[index] = error_code;
+}
+
+/**
+ * @brief Writes the | f_i | c_i | pairs of a group of recipients,
+ * given either as Ed25519 public-keys or as prepared recipients,
+ * for an ephemeral keypair and a secret.
+ * 
+ * @note With a thread pool, the batches of recipients are spread
+ * across its threads. The error reported is the one of the first
+ * failing batch, which is also the one the calling thread alone
+ * would have stopped at, so that the outcome does not depend on
+ * the scheduling.
+ * 
+ * @return BDAP_SUCCESS or the error code
+ */
+static uint16_t bdap_encrypt_slots(uint8_t* slots,
+                                   const uint16_t num_recipients,
+                                   const uint8_t** ed25519_public_key,
+                                   const bdap_recipient* recipients,
+                                   const uint8_t* ephemeral_pk,
+                                   const uint8_t* ephemeral_sk,
+                                   const uint8_t* s,
+                                   bdap_thread_pool* pool)
+{
+    uint16_t status[MAX_BATCHES];
+    size_t idx, num_batches;
+    bdap_encrypt_batch_ctx ctx;
+
+    ctx.slots = slots;
+    ctx.num_recipients = num_recipients;
+    ctx.ed25519_public_key = ed25519_public_key;
+    ctx.recipients = recipients;
+    ctx.ephemeral_pk = ephemeral_pk;
+    ctx.ephemeral_sk = ephemeral_sk;
+    ctx.s = s;
+    ctx.status = status;
+
+    num_batches = (num_recipients + BATCH_SIZE - 1) / BATCH_SIZE;
+    if (pool != NULL && num_batches > 1)
+    {
+        bdap_thread_pool_run(pool,
+                             num_batches,
+                             bdap_encrypt_batch_task,
+                             &ctx);
+    }
+    else
+    {
+        for (idx = 0; idx < num_batches; ++idx)
+        {
+            bdap_encrypt_batch_task(&ctx, idx);
+            if (status[idx] != BDAP_SUCCESS)
+            {
+                break;
+            }
+        }
+    }
+    for (idx = 0; idx < num_batches; ++idx)
+    {
+        if (status[idx] != BDAP_SUCCESS)
+        {
+            return status[idx];
+        }
+    }
+
+    return BDAP_SUCCESS;
+}
+
+/**
+ * @brief Writes the BDAP header, i.e. N, U and the | f_i | c_i |
+ * pairs, for a group of recipients given either as Ed25519
+ * public-keys or as prepared recipients, and derives the
+ * AES-256-GCM key and nonce of the payload.
+ * 
+ * @note Exactly one of {@code ed25519_public_key} and
+ * {@code recipients} must be non-NULL.
+ * 
+ * @note With a thread pool, the batches of recipients are spread
+ * across its threads, see bdap_encrypt_slots. On error the header
+ * is wiped.
+ * 
+ * @note The pairs are sorted by fingerprint, and the most
+ * significant bit of U is set to flag it, so that recipients find
+ * their pair with a binary search.
+ * 
+ * @param header the output header pointer
+ * @param key_nonce the output key and nonce, KEY_NONCE_SIZE bytes
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys, or NULL
+ * @param recipients the pointer to an array of prepared
+ *                   recipients, or NULL
+ * @param pool the thread pool, or NULL
+ * @param sealed the output sealed message, or NULL
+ * @param rng the random number generator, or NULL
+ * @return BDAP_SUCCESS or the error code
+ */
+static uint16_t bdap_encrypt_header(uint8_t* header,
+                                    uint8_t* key_nonce,
+                                    const uint16_t num_recipients,
+                                    const uint8_t** ed25519_public_key,
+                                    const bdap_recipient* recipients,
+                                    bdap_thread_pool* pool,
+                                    bdap_sealed_message* sealed,
+                                    const bdap_rng* rng)
+{
+    uint16_t error_code = BDAP_SUCCESS;
+    uint8_t *c_ptr = header;
+    uint8_t ephemeral_pk[CURVE25519_PUBLIC_KEY_SIZE] = {0};
+    bdap_encrypt_secrets fallback;
+    bdap_encrypt_secrets* secrets;
+    uint8_t *ephemeral_sk, *s;
+
+    secrets = bdap_secrets_take(&fallback, sizeof(fallback));
+    ephemeral_sk = secrets->ephemeral_sk;
+    s = secrets->s;
+
+    /* Write N, the number of recipients */
+    *c_ptr++ = (uint8_t) num_recipients;
+    *c_ptr++ = (uint8_t)(num_recipients >> 8);
+
+    /* 1. Generate an ephemeral Curve25519 keypair */
+    if (true != curve25519_random_keypair_with_rng(ephemeral_pk,
+                                                   ephemeral_sk,
+                                                   rng))
+    {
+        error_code = BDAP_X25519_KEYPAIR_FAILED;
+        goto bdap_encrypt_header_bail;
+    }
+
+    /* Flag the sorted pairs in the most significant bit of U, which
+     * Curve25519 ignores. U is hashed as written, flag included, so
+     * the header stays readable by decoders that scan linearly. */
+    ephemeral_pk[CURVE25519_PUBLIC_KEY_SIZE - 1] |= SORTED_FLAG;
+    memcpy(c_ptr, ephemeral_pk, sizeof(ephemeral_pk));
+    c_ptr += sizeof(ephemeral_pk);
+
+    /* 2. Generate a random 32-byte secret */
+    bdap_rng_randombytes(rng, s, SECRET_SIZE);
+
+    /* 3. Write the | f_i | c_i | pairs, batch by batch */
+    error_code = bdap_encrypt_slots(c_ptr,
+                                    num_recipients,
+                                    ed25519_public_key,
+                                    recipients,
+                                    ephemeral_pk,
+                                    ephemeral_sk,
+                                    s,
+                                    pool);
+    if (error_code != BDAP_SUCCESS)
+    {
+        goto bdap_encrypt_header_bail;
+    }
+    bdap_sort_slots(c_ptr, num_recipients);
+
+    /* 4. XOF(s, 44) */
+    if (0 != shake256(key_nonce, KEY_NONCE_SIZE, s, SECRET_SIZE))
+    {
+        error_code = BDAP_AESGCM_KEY_DERIVATION_FAILED;
+        goto bdap_encrypt_header_bail;
+    }
+
+    /* Keep what is needed to add recipients later */
+    if (sealed != NULL)
+    {
+        memcpy(sealed->ephemeral_pk, ephemeral_pk, sizeof(ephemeral_pk));
+        memcpy(sealed->ephemeral_sk, ephemeral_sk, CURVE25519_PRIVATE_KEY_SIZE);
+        memcpy(sealed->secret, s, SECRET_SIZE);
+    }
+
+bdap_encrypt_header_bail:
+    if (error_code != BDAP_SUCCESS)
+    {
+        crypto_memzero(header, bdap_ciphertext_header_size(num_recipients));
+        crypto_memzero(key_nonce, KEY_NONCE_SIZE);
+    }
+    bdap_secrets_release(secrets, &fallback, sizeof(fallback));
+    crypto_memzero(ephemeral_pk, sizeof(ephemeral_pk));
+
+    return error_code;
+}
+
+/**
+ * @brief Encrypts the payload of a v1 ciphertext, i.e. the
+ * plaintext followed by the tag, with the payload key and nonce.
+ * 
+ * @note With a thread pool, payloads of at least
+ * parallel_gcm_threshold bytes are encrypted in parallel.
+ */
+static bool bdap_encrypt_payload(uint8_t* payload,
+                                 const uint8_t* key_nonce,
+                                 const uint8_t* plaintext,
+                                 const size_t plaintext_size,
+                                 bdap_thread_pool* pool)
+{
+    size_t unused;
+
+    if (pool != NULL && plaintext_size >= parallel_gcm_threshold)
+    {
+        return (aes256gcm_encrypt_parallel(payload,
+                                           &unused,
+                                           plaintext,
+                                           plaintext_size,
+                                           NULL,
+                                           0,
+                                           &key_nonce[AES256GCM_KEY_SIZE],
+                                           key_nonce,
+                                           pool) == 0);
+    }
+
+    return (aes256gcm_encrypt(payload,
+                              &unused,
+                              plaintext,
+                              plaintext_size,
+                              NULL,
+                              0,
+                              &key_nonce[AES256GCM_KEY_SIZE],
+                              key_nonce) == 0);
+}
+
+/**
+ * @brief Performs BDAP end-to-end encryption for a group of
+ * recipients, given either as Ed25519 public-keys or as prepared
+ * recipients.
+ * 
+ * @note See bdap_encrypt_header(uint8_t*, uint8_t*, const uint16_t,
+ * const uint8_t**, const bdap_recipient*, bdap_thread_pool*,
+ * bdap_sealed_message*, const bdap_rng*).
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys, or NULL
+ * @param recipients the pointer to an array of prepared
+ *                   recipients, or NULL
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param pool the thread pool, or NULL
+ * @param sealed the output sealed message, or NULL
+ * @param rng the random number generator, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+static bool bdap_encrypt_core(uint8_t* ciphertext,
+                              const uint16_t num_recipients,
+                              const uint8_t** ed25519_public_key,
+                              const bdap_recipient* recipients,
+                              const uint8_t* plaintext,
+                              const size_t plaintext_size,
+                              bdap_thread_pool* pool,
+                              bdap_sealed_message* sealed,
+                              const bdap_rng* rng,
+                              const char** error_message)
+{
+    bool result = true;
+    uint16_t error_code = BDAP_SUCCESS;
+    uint8_t *c_ptr = ciphertext;
+    uint8_t key_nonce_fallback[KEY_NONCE_SIZE];
+    uint8_t* key_nonce = bdap_secrets_take(key_nonce_fallback,
+                                           KEY_NONCE_SIZE);
+    size_t ciphertext_size;
+
+    ciphertext_size = bdap_ciphertext_size(num_recipients, plaintext_size);
+
+    /* 1-4. N | U | f_i | c_i | and the payload key */
+    error_code = bdap_encrypt_header(ciphertext,
+                                     key_nonce,
+                                     num_recipients,
+                                     ed25519_public_key,
+                                     recipients,
+                                     pool,
+                                     sealed,
+                                     rng);
+    if (error_code != BDAP_SUCCESS)
+    {
+        result = false;
+        crypto_memzero(ciphertext, ciphertext_size);
+        goto bdap_e2e_encrypt_bail;
+    }
+    c_ptr += bdap_ciphertext_header_size(num_recipients);
+
+    /* 5. AESGCM_E(key, nonce, plaintext) */
+    result = bdap_encrypt_payload(c_ptr,
+                                  key_nonce,
+                                  plaintext,
+                                  plaintext_size,
+                                  pool);
+    if (true != result)
+    {
+        error_code = BDAP_AESGCM_ENCRYPT_FAILED;
+        crypto_memzero(ciphertext, ciphertext_size);
+    }
+
+bdap_e2e_encrypt_bail:
+    bdap_secrets_release(key_nonce, key_nonce_fallback, KEY_NONCE_SIZE);
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return result;
+}
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a group of recipients.
+ * 
+ * @note Each recipient provides their Ed25519 public-key,
+ * which is 32 bytes in size.
+ * 
+ * @note The size of the ciphertext can be obtained from
+ * bdap_ciphertext_size(const uint16_t, const size_t) function.
+ * 
+ * @note The caller of this method does not need to allocate
+ * and deallocate memory for error messages. This method returns
+ * a pointer to a pre-defined string. The parameter {@code
+ * error_message} can also be NULL, which means that the caller
+ * doesn't want any error messages.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt(uint8_t* ciphertext,
+                  const uint16_t num_recipients,
+                  const uint8_t** ed25519_public_key,
+                  const uint8_t* plaintext,
+                  const size_t plaintext_size,
+                  const char** error_message)
+{
+    return bdap_encrypt_core(ciphertext,
+                             num_recipients,
+                             ed25519_public_key,
+                             NULL,
+                             plaintext,
+                             plaintext_size,
+                             NULL,
+                             NULL,
+                             NULL,
+                             error_message);
+}
+
+bool bdap_encrypt_with_rng(uint8_t* ciphertext,
+                           const uint16_t num_recipients,
+                           const uint8_t** ed25519_public_key,
+                           const uint8_t* plaintext,
+                           const size_t plaintext_size,
+                           const struct bdap_rng* rng,
+                           const char** error_message)
+{
+    return bdap_encrypt_core(ciphertext,
+                             num_recipients,
+                             ed25519_public_key,
+                             NULL,
+                             plaintext,
+                             plaintext_size,
+                             NULL,
+                             NULL,
+                             rng,
+                             error_message);
+}
+
+/**
+ * @brief Prepares a set of recipients for repeated encryption.
+ * 
+ * @note The caller provides the storage for {@code num_recipients}
+ * prepared recipients, which must outlive the set.
+ * 
+ * @param set the output recipient set
+ * @param recipients the storage for the prepared recipients
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false if any of the public-keys is invalid
+ */
+bool bdap_recipient_set_init(bdap_recipient_set* set,
+                             bdap_recipient* recipients,
+                             const uint16_t num_recipients,
+                             const uint8_t** ed25519_public_key,
+                             const char** error_message)
+{
+    uint16_t idx;
+    uint16_t error_code = BDAP_SUCCESS;
+
+    set->recipients = recipients;
+    set->num_recipients = num_recipients;
+
+    for (idx = 0; idx < num_recipients; ++idx)
+    {
+        if (true != bdap_recipient_init(&recipients[idx],
+                                        ed25519_public_key[idx]))
+        {
+            error_code = BDAP_ED25519_TO_X25519_PUBLIC_KEY_FAILED;
+            set->num_recipients = 0;
+            break;
+        }
+    }
+
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return (error_code == BDAP_SUCCESS);
+}
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a prepared set of recipients.
+ * 
+ * @note The ciphertext is identical in format to the one
+ * produced by bdap_encrypt(uint8_t*, const uint16_t,
+ * const uint8_t**, const uint8_t*, const size_t, const char**),
+ * its size can be obtained from bdap_ciphertext_size(const
+ * uint16_t, const size_t) function.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param set the prepared recipient set
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_to_set(uint8_t* ciphertext,
+                         const bdap_recipient_set* set,
+                         const uint8_t* plaintext,
+                         const size_t plaintext_size,
+                         const char** error_message)
+{
+    return bdap_encrypt_core(ciphertext,
+                             set->num_recipients,
+                             NULL,
+                             set->recipients,
+                             plaintext,
+                             plaintext_size,
+                             NULL,
+                             NULL,
+                             NULL,
+                             error_message);
+}
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a group of recipients, spreading the recipients
+ * across the threads of a pool.
+ * 
+ * @note The ciphertext is identical in format to the one
+ * produced by bdap_encrypt(uint8_t*, const uint16_t,
+ * const uint8_t**, const uint8_t*, const size_t, const char**).
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param num_recipients the number of recipients
+ * @param ed25519_public_key the pointer to an array of
+ *                           recipient's public-keys
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_parallel(uint8_t* ciphertext,
+                           const uint16_t num_recipients,
+                           const uint8_t** ed25519_public_key,
+                           const uint8_t* plaintext,
+                           const size_t plaintext_size,
+                           struct bdap_thread_pool* pool,
+                           const char** error_message)
+{
+    return bdap_encrypt_core(ciphertext,
+                             num_recipients,
+                             ed25519_public_key,
+                             NULL,
+                             plaintext,
+                             plaintext_size,
+                             pool,
+                             NULL,
+                             NULL,
+                             error_message);
+}
+
+/**
+ * @brief Performs BDAP end-to-end encryption on a piece of
+ * plaintext for a prepared set of recipients, spreading the
+ * recipients across the threads of a pool.
+ * 
+ * @param ciphertext the output ciphertext pointer
+ * @param set the prepared recipient set
+ * @param plaintext the input plaintext pointer
+ * @param plaintext_size the plaintext size in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_encrypt_to_set_parallel(uint8_t* ciphertext,
+                                  const bdap_recipient_set* set,
+                                  const uint8_t* plaintext,
+                                  const size_t plaintext_size,
+                                  struct bdap_thread_pool* pool,
+                                  const char** error_message)
+{
+    return bdap_encrypt_core(ciphertext,
+                             set->num_recipients,
+                             NULL,
+                             set->recipients,
+                             plaintext,
+                             plaintext_size,
+                             pool,
+                             NULL,
+                             NULL,
+                             error_message);
+}
+
+size_t bdap_ciphertext_size_v2(const uint16_t num_recipients,
+                               const size_t plaintext_size,
+                               const size_t segment_size)
+{
+    return V2_PREAMBLE_SIZE
+        + bdap_ciphertext_header_size(num_recipients)
+        + plaintext_size
+        + bdap_v2_num_segments(plaintext_size, segment_size)
+            * AES256GCM_TAG_SIZE;
+}
+
+/**
+ * @brief The shared state of the segment tasks of a
+ * bdap_encrypt_v2_core call.
+ */
+typedef struct
+{
+    uint8_t* payload;
+    const uint8_t* plaintext;
+    size_t plaintext_size;
+    size_t segment_size;
+    size_t num_segments;
+    size_t num_tasks;
+    const uint8_t* key_nonce;
+    const uint8_t* aad;
+    uint16_t* status;
+} bdap_v2_encrypt_ctx;
+
+/**
+ * @brief Encrypts the index-th of num_tasks contiguous runs of
+ * segments, each segment at its fixed offset in the payload.
+ */
+static void bdap_v2_encrypt_task(void* arg, size_t index)
+{
+    bdap_v2_encrypt_ctx* ctx = (bdap_v2_encrypt_ctx*)arg;
+    size_t idx, size, unused;
+    size_t first = index * ctx->num_segments / ctx->num_tasks;
+    size_t last = (index + 1) * ctx->num_segments / ctx->num_tasks;
+    uint16_t error_code = BDAP_SUCCESS;
+    uint8_t nonce[AES256GCM_NONCE_SIZE];
+
+    for (idx = first; idx < last; ++idx)
+    {
+        size = ctx->plaintext_size - idx * ctx->segment_size;
+        if (size > ctx->segment_size)
+        {
+            size = ctx->segment_size;
+        }
+
+        bdap_v2_segment_nonce(nonce,
+                              ctx->key_nonce,
+                              idx,
+                              idx == ctx->num_segments - 1);
+        if (aes256gcm_encrypt(ctx->payload
+                                  + idx * (ctx->segment_size + AES256GCM_TAG_SIZE),
+                              &unused,
+                              ctx->plaintext + idx * ctx->segment_size,
+                              size,
+                              ctx->aad,
+                              V2_PREAMBLE_SIZE,
+                              nonce,
+                              ctx->key_nonce) != 0)
+        {
+            error_code = BDAP_AESGCM_ENCRYPT_FAILED;
+            break;
+        }
+    }
+
+    crypto_memzero(nonce, sizeof(nonce));
+    ctx->status[index] = error_code;
+}
+
+/**
+ * @brief Performs BDAP end-to-end encryption with the v2 layout
+ * for a group of recipients, given either as Ed25519 public-keys
+ * or as prepared recipients.
+ * 
+ * @note The recipients and then the segments are spread across
+ * the threads of the pool, if any. The segments are grouped into
+ * at most MAX_SEGMENT_TASKS runs.
+ */
+static bool bdap_encrypt_v2_core(uint8_t* ciphertext,
+                                 const uint16_t num_recipients,
+                                 const uint8_t** ed25519_public_key,
+                                 const bdap_recipient* recipients,
+                                 const uint8_t* plaintext,
+                                 const size_t plaintext_size,
+                                 const size_t segment_size,
+                                 bdap_thread_pool* pool,
+                                 bdap_sealed_message* sealed,
+                                 const char** error_message)
+{
+    uint16_t error_code = BDAP_SUCCESS;
+    uint16_t status[MAX_SEGMENT_TASKS];
+    uint8_t key_nonce_fallback[KEY_NONCE_SIZE];
+    uint8_t* key_nonce = bdap_secrets_take(key_nonce_fallback,
+                                           KEY_NONCE_SIZE);
+    uint8_t shift = bdap_v2_segment_shift(segment_size);
+    size_t idx;
+    bdap_v2_encrypt_ctx ctx;
+
+    if (shift == 0)
+    {
+        error_code = BDAP_INVALID_SEGMENT_SIZE;
+        goto bdap_encrypt_v2_bail;
+    }
+
+    /* 00 00 | version | log2(S) */
+    ciphertext[0] = 0;
+    ciphertext[1] = 0;
+    ciphertext[2] = V2_VERSION;
+    ciphertext[3] = shift;
+
+    /* 1-4. N | U | f_i | c_i | and the payload key */
+    error_code = bdap_encrypt_header(ciphertext + V2_PREAMBLE_SIZE,
+                                     key_nonce,
+                                     num_recipients,
+                                     ed25519_public_key,
+                                     recipients,
+                                     pool,
+                                     sealed,
+                                     NULL);
+    if (error_code != BDAP_SUCCESS)
+    {
+        goto bdap_encrypt_v2_bail;
+    }
+
+    /* 5. AESGCM_E(key, nonce_j, P_j) for every segment */
+    ctx.payload = ciphertext + V2_PREAMBLE_SIZE
+        + bdap_ciphertext_header_size(num_recipients);
+    ctx.plaintext = plaintext;
+    ctx.plaintext_size = plaintext_size;
+    ctx.segment_size = segment_size;
+    ctx.num_segments = bdap_v2_num_segments(plaintext_size, segment_size);
+    ctx.num_tasks = ctx.num_segments < MAX_SEGMENT_TASKS ?
+        ctx.num_segments : MAX_SEGMENT_TASKS;
+    ctx.key_nonce = key_nonce;
+    ctx.aad = ciphertext;
+    ctx.status = status;
+
+    if (pool != NULL && ctx.num_tasks > 1)
+    {
+        bdap_thread_pool_run(pool, ctx.num_tasks, bdap_v2_encrypt_task, &ctx);
+    }
+    else
+    {
+        for (idx = 0; idx < ctx.num_tasks; ++idx)
+        {
+            bdap_v2_encrypt_task(&ctx, idx);
+        }
+    }
+    for (idx = 0; idx < ctx.num_tasks; ++idx)
+    {
+        if (status[idx] != BDAP_SUCCESS)
+        {
+            error_code = status[idx];
+            break;
+        }
+    }
+
+bdap_encrypt_v2_bail:
+    if (error_code != BDAP_SUCCESS && shift != 0)
+    {
+        crypto_memzero(ciphertext, bdap_ciphertext_size_v2(num_recipients,
+                                                           plaintext_size,
+                                                           segment_size));
+    }
+    bdap_secrets_release(key_nonce, key_nonce_fallback, KEY_NONCE_SIZE);
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return (error_code == BDAP_SUCCESS);
+}
+
+bool bdap_encrypt_v2(uint8_t* ciphertext,
+                     const uint16_t num_recipients,
+                     const uint8_t** ed25519_public_key,
+                     const uint8_t* plaintext,
+                     const size_t plaintext_size,
+                     const size_t segment_size,
+                     struct bdap_thread_pool* pool,
+                     const char** error_message)
+{
+    return bdap_encrypt_v2_core(ciphertext,
+                                num_recipients,
+                                ed25519_public_key,
+                                NULL,
+                                plaintext,
+                                plaintext_size,
+                                segment_size,
+                                pool,
+                                NULL,
+                                error_message);
+}
+
+bool bdap_encrypt_to_set_v2(uint8_t* ciphertext,
+                            const bdap_recipient_set* set,
+                            const uint8_t* plaintext,
+                            const size_t plaintext_size,
+                            const size_t segment_size,
+                            struct bdap_thread_pool* pool,
+                            const char** error_message)
+{
+    return bdap_encrypt_v2_core(ciphertext,
+                                set->num_recipients,
+                                NULL,
+                                set->recipients,
+                                plaintext,
+                                plaintext_size,
+                                segment_size,
+                                pool,
+                                NULL,
+                                error_message);
+}
+
+/**
+ * @brief Derives the keys of a BDAP decryption key, which is
+ * wiped on failure, from an Ed25519 private-key seed.
+ * 
+ * @return BDAP_SUCCESS or the error code
+ */
+static uint16_t bdap_decrypt_key_derive(bdap_decrypt_key* key,
+                                        const uint8_t* ed25519_private_key_seed)
+{
+    /* Compute Ed25519 public-key from private-key seed */
+    ed25519_public_key_from_private_key_seed(key->ed25519_pk,
+                                             ed25519_private_key_seed);
+
+    /* Derive Curve25519 private-key from Ed25519 private-key seed */
+    ed25519_to_curve25519_private_key(key->curve25519_sk,
+                                      ed25519_private_key_seed);
+
+    /* Compute Curve25519 public-key from the private-key */
+    if (true != curve25519_public_key_from_private_key(
+                    key->curve25519_pk, key->curve25519_sk))
+    {
+        crypto_memzero(key->ed25519_pk, sizeof(key->ed25519_pk));
+        crypto_memzero(key->curve25519_sk, sizeof(key->curve25519_sk));
+        crypto_memzero(key->curve25519_pk, sizeof(key->curve25519_pk));
+        return BDAP_X25519_PUBLIC_KEY_DERIVATION_FAILED;
+    }
+
+    return BDAP_SUCCESS;
+}
+
+/**
+ * @brief The body of bdap_decrypt_key_init(bdap_decrypt_key*,
+ * const uint8_t*, const char**), reporting an error code rather
+ * than a message.
+ */
+static uint16_t bdap_decrypt_key_init_core(bdap_decrypt_key* key,
+                                           const uint8_t* ed25519_private_key_seed)
+{
+    uint16_t error_code = BDAP_SUCCESS;
+
+    crypto_memzero(key, sizeof(bdap_decrypt_key));
+
+    if (!crypto_mlock((void*)ed25519_private_key_seed,
+                      ED25519_PRIVATE_KEY_SEED_SIZE))
+    {
+        return BDAP_MEMORY_PROTECTION_FAILED;
+    }
+
+    if (!crypto_mlock(key, sizeof(bdap_decrypt_key)))
+    {
+        error_code = BDAP_MEMORY_PROTECTION_FAILED;
+        goto bdap_decrypt_key_bail;
+    }
+    key->locked = true;
+
+    error_code = bdap_decrypt_key_derive(key, ed25519_private_key_seed);
+
+bdap_decrypt_key_bail:
+    (void)crypto_munlock((void*)ed25519_private_key_seed,
+                         ED25519_PRIVATE_KEY_SEED_SIZE);
+
+    return error_code;
+}
+
+/**
+ * @brief Derives a BDAP decryption key from an Ed25519
+ * private-key seed.
+ * 
+ * @note The decryption key is locked in memory until it is
+ * released by bdap_decrypt_key_wipe(bdap_decrypt_key*), which
+ * must be called even if this method fails.
+ * 
+ * @param key the output decryption key
+ * @param ed25519_private_key_seed the pointer to the decryption
+ *                                 private-key seed
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt_key_init(bdap_decrypt_key* key,
+                           const uint8_t* ed25519_private_key_seed,
+                           const char** error_message)
+{
+    uint16_t error_code;
+
+    error_code = bdap_decrypt_key_init_core(key, ed25519_private_key_seed);
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return (error_code == BDAP_SUCCESS);
+}
+
+/**
+ * @brief Wipes and unlocks a BDAP decryption key.
+ * 
+ * @param key the decryption key
+ */
+void bdap_decrypt_key_wipe(bdap_decrypt_key* key)
+{
+    bool locked = key->locked;
+
+    crypto_memzero(key, sizeof(bdap_decrypt_key));
+    if (locked)
+    {
+        (void)crypto_munlock(key, sizeof(bdap_decrypt_key));
+    }
+}
+
+/**
+ * @brief Recovers the secret of a recipient from its encrypted
+ * secret and derives the AES-256-GCM key and nonce of the payload.
+ * 
+ * @param key_nonce the output key and nonce, KEY_NONCE_SIZE bytes
+ * @param key the decryption key of the recipient
+ * @param ephemeral_public_key the ephemeral public-key U
+ * @param encrypted_secret the recipient's encrypted secret c_i
+ * @return BDAP_SUCCESS or the error code
+ */
+static uint16_t bdap_decrypt_secret(uint8_t* key_nonce,
+                                    const bdap_decrypt_key* key,
+                                    const uint8_t* ephemeral_public_key,
+                                    const uint8_t* encrypted_secret)
+{
+    size_t unused;
+    uint16_t error_code = BDAP_SUCCESS;
+    bdap_decrypt_scratch fallback;
+    bdap_decrypt_scratch* scratch;
+
+    scratch = bdap_secrets_take(&fallback, sizeof(fallback));
+
+    /* 4. Curve25519 Diffie-Hellman exchange */
+    if (true != curve25519_dh(scratch->Q,
+                              key->curve25519_sk,
+                              ephemeral_public_key))
+    {
+        error_code = BDAP_X25519_DH_FAILED;
+        goto bdap_decrypt_secret_bail;
+    }
+
+    /* 5. XOF(Q | curve25519_pk | curve25519_ephemeral_pk, 48) */
+    shake256_init(&scratch->xof);
+    if (0 != shake256_absorb(&scratch->xof, scratch->Q, sizeof(scratch->Q)) ||
+        0 != shake256_absorb(&scratch->xof,
+                             key->curve25519_pk,
+                             CURVE25519_PUBLIC_KEY_SIZE) ||
+        0 != shake256_absorb(&scratch->xof,
+                             ephemeral_public_key,
+                             CURVE25519_PUBLIC_KEY_SIZE) ||
+        0 != shake256_finalize(&scratch->xof) ||
+        0 != shake256_squeeze(&scratch->xof, scratch->key_iv, KEY_IV_SIZE))
+    {
+        error_code = BDAP_AESCTR_KEY_DERIVATION_FAILED;
+        goto bdap_decrypt_secret_bail;
+    }
+
+    /* 6. AESCTR_D(key, iv, c) -> s */
+    if (aes256ctr_decrypt(scratch->s,
+                          &unused,
+                          encrypted_secret,
+                          SECRET_SIZE,
+                          &scratch->key_iv[AES256CTR_KEY_SIZE],
+                          scratch->key_iv) != 0)
+    {
+        error_code = BDAP_AESCTR_DECRYPT_FAILED;
+        goto bdap_decrypt_secret_bail;
+    }
+
+    /* 7. XOF(s, 44) */
+    if (0 != shake256(key_nonce, KEY_NONCE_SIZE, scratch->s, sizeof(scratch->s)))
+    {
+        error_code = BDAP_AESGCM_KEY_DERIVATION_FAILED;
+    }
+
+bdap_decrypt_secret_bail:
+    bdap_secrets_release(scratch, &fallback, sizeof(fallback));
+
+    return error_code;
+}
+
+/**
+ * @brief Finds the recipient's pair in a BDAP header and derives
+ * the AES-256-GCM key and nonce of the payload.
+ * 
+ * @note The header must have been validated, see
+ * bdap_validate_ciphertext(const uint8_t*, const size_t,
+ * const char**).
+ * 
+ * @param key_nonce the output key and nonce, KEY_NONCE_SIZE bytes
+ * @param key the decryption key
+ * @param header the input header pointer
+ * @return BDAP_SUCCESS or the error code
+ */
+static uint16_t bdap_decrypt_header(uint8_t* key_nonce,
+                                    const bdap_decrypt_key* key,
+                                    const uint8_t* header)
+{
+    uint16_t error_code;
+    uint8_t curve25519_ephemeral_pk[CURVE25519_PUBLIC_KEY_SIZE] = {0};
+    uint8_t c[SECRET_SIZE] = {0};
+
+    /* 1. Parse the input ciphertext */
+    /* 2. Search through the fingerprint and encrypted secret pair */
+    /*    to obtain one where the fingerprint matches */
+    /* 3. Abort if not found */
+    if (true != bdap_get_ephemeral_public_key_and_encrypted_secret(
+                    curve25519_ephemeral_pk, c, header, key->ed25519_pk))
+    {
+        return BDAP_NO_VALID_RECIPIENT;
+    }
+
+    /* 4-7. Recover the secret and derive the payload key */
+    error_code = bdap_decrypt_secret(key_nonce, key, curve25519_ephemeral_pk, c);
+
+    crypto_memzero(curve25519_ephemeral_pk, sizeof(curve25519_ephemeral_pk));
+    crypto_memzero(c, sizeof(c));
+
+    return error_code;
+}
+
+/**
+ * @brief The shared state of the segment tasks of a
+ * bdap_decrypt_range_core call.
+ */
+typedef struct
+{
+    uint8_t* plaintext;
+    const uint8_t* payload;
+    const bdap_v2_layout* layout;
+    size_t offset;
+    size_t end;
+    size_t first_segment;
+    size_t num_segments;
+    size_t num_tasks;
+    const uint8_t* key_nonce;
+    const uint8_t* aad;
+    uint16_t* status;
+} bdap_v2_decrypt_ctx;
+
+/**
+ * @brief Authenticates the index-th of num_tasks contiguous runs of
+ * the segments overlapping [offset, end), and decrypts the part of
+ * each segment that lies in the range.
+ */
+static void bdap_v2_decrypt_task(void* arg, size_t index)
+{
+    bdap_v2_decrypt_ctx* ctx = (bdap_v2_decrypt_ctx*)arg;
+    const bdap_v2_layout* layout = ctx->layout;
+    size_t idx, segment_offset, size, start, stop;
+    size_t first = ctx->first_segment
+        + index * ctx->num_segments / ctx->num_tasks;
+    size_t last = ctx->first_segment
+        + (index + 1) * ctx->num_segments / ctx->num_tasks;
+    uint16_t error_code = BDAP_SUCCESS;
+    uint8_t nonce[AES256GCM_NONCE_SIZE];
+    const uint8_t* c_ptr;
+    aes256gcm_ctx gcm;
+
+    for (idx = first; idx < last; ++idx)
+    {
+        segment_offset = idx * layout->segment_size;
+        size = (idx == layout->num_segments - 1) ?
+            layout->last_segment_size : layout->segment_size;
+        start = (ctx->offset > segment_offset) ?
+            ctx->offset - segment_offset : 0;
+        stop = (ctx->end < segment_offset + size) ?
+            ctx->end - segment_offset : size;
+        c_ptr = ctx->payload
+            + idx * (layout->segment_size + AES256GCM_TAG_SIZE);
+
+        bdap_v2_segment_nonce(nonce,
+                              ctx->key_nonce,
+                              idx,
+                              idx == layout->num_segments - 1);
+        aes256gcm_init(&gcm, ctx->aad, V2_PREAMBLE_SIZE, nonce, ctx->key_nonce);
+        if (0 != aes256gcm_authenticate(&gcm, c_ptr, size) ||
+            0 != aes256gcm_verify(&gcm, c_ptr + size))
+        {
+            error_code = BDAP_AESGCM_DECRYPT_FAILED;
+            break;
+        }
+        (void)aes256gcm_decrypt_skip(&gcm, start);
+        (void)aes256gcm_decrypt_update(&gcm,
+                                       ctx->plaintext
+                                           + (segment_offset + start - ctx->offset),
+                                       c_ptr + start,
+                                       stop - start);
+        aes256gcm_wipe(&gcm);
+    }
+
+    aes256gcm_wipe(&gcm);
+    crypto_memzero(nonce, sizeof(nonce));
+    ctx->status[index] = error_code;
+}
+
+/**
+ * @brief Authenticates the last segment of a v2 ciphertext without
+ * decrypting it.
+ * 
+ * @note The last segment is the only one whose nonce carries the
+ * last-segment flag, so checking its tag detects a ciphertext that
+ * was truncated, even to an empty last segment, or whose last
+ * segments were dropped.
+ * 
+ * @return BDAP_SUCCESS or the error code
+ */
+static uint16_t bdap_v2_verify_last_segment(const uint8_t* key_nonce,
+                                            const uint8_t* ciphertext,
+                                            const bdap_v2_layout* layout)
+{
+    uint16_t error_code = BDAP_SUCCESS;
+    size_t idx = layout->num_segments - 1;
+    uint8_t nonce[AES256GCM_NONCE_SIZE];
+    const uint8_t* c_ptr = ciphertext + layout->header_size
+        + idx * (layout->segment_size + AES256GCM_TAG_SIZE);
+    aes256gcm_ctx gcm;
+
+    bdap_v2_segment_nonce(nonce, key_nonce, idx, true);
+    aes256gcm_init(&gcm, ciphertext, V2_PREAMBLE_SIZE, nonce, key_nonce);
+    if (0 != aes256gcm_authenticate(&gcm, c_ptr, layout->last_segment_size) ||
+        0 != aes256gcm_verify(&gcm, c_ptr + layout->last_segment_size))
+    {
+        error_code = BDAP_AESGCM_DECRYPT_FAILED;
+    }
+
+    aes256gcm_wipe(&gcm);
+    crypto_memzero(nonce, sizeof(nonce));
+
+    return error_code;
+}
+
+/**
+ * @brief Authenticates the segments of a v2 ciphertext overlapping
+ * [offset, offset + length) and decrypts that range of the plaintext.
+ * 
+ * @note The range must be within the plaintext, it can be empty.
+ * The last segment is authenticated whether or not it overlaps the
+ * range, see bdap_v2_verify_last_segment. On failure the output is
+ * wiped.
+ * 
+ * @param plaintext the output plaintext pointer, length bytes
+ * @param key_nonce the payload key and nonce, KEY_NONCE_SIZE bytes
+ * @param ciphertext the input v2 ciphertext pointer
+ * @param layout the payload layout of the ciphertext
+ * @param offset the offset of the range in the plaintext
+ * @param length the length of the range in bytes
+ * @param pool the thread pool, or NULL
+ * @return BDAP_SUCCESS or the error code
+ */
+static uint16_t bdap_v2_decrypt_segments(uint8_t* plaintext,
+                                         const uint8_t* key_nonce,
+                                         const uint8_t* ciphertext,
+                                         const bdap_v2_layout* layout,
+                                         const size_t offset,
+                                         const size_t length,
+                                         bdap_thread_pool* pool)
+{
+    uint16_t error_code;
+    uint16_t task_status[MAX_SEGMENT_TASKS];
+    size_t idx;
+    bdap_v2_decrypt_ctx ctx;
+
+    /* The last segment, unless the range covers it */
+    if (length == 0 ||
+        (offset + length - 1) / layout->segment_size < layout->num_segments - 1)
+    {
+        error_code = bdap_v2_verify_last_segment(key_nonce, ciphertext, layout);
+        if (error_code != BDAP_SUCCESS || length == 0)
+        {
+            crypto_memzero(plaintext, length);
+            return error_code;
+        }
+    }
+
+    /* 8. AESGCM_D(key, nonce_j, C_j) for the segments in range */
+    ctx.plaintext = plaintext;
+    ctx.payload = ciphertext + layout->header_size;
+    ctx.layout = layout;
+    ctx.offset = offset;
+    ctx.end = offset + length;
+    ctx.first_segment = offset / layout->segment_size;
+    ctx.num_segments = (ctx.end - 1) / layout->segment_size
+        - ctx.first_segment + 1;
+    ctx.num_tasks = ctx.num_segments < MAX_SEGMENT_TASKS ?
+        ctx.num_segments : MAX_SEGMENT_TASKS;
+    ctx.key_nonce = key_nonce;
+    ctx.aad = ciphertext;
+    ctx.status = task_status;
+
+    if (pool != NULL && ctx.num_tasks > 1)
+    {
+        bdap_thread_pool_run(pool, ctx.num_tasks, bdap_v2_decrypt_task, &ctx);
+    }
+    else
+    {
+        for (idx = 0; idx < ctx.num_tasks; ++idx)
+        {
+            bdap_v2_decrypt_task(&ctx, idx);
+            if (task_status[idx] != BDAP_SUCCESS)
+            {
+                ctx.num_tasks = idx + 1;
+                break;
+            }
+        }
+    }
+    for (idx = 0; idx < ctx.num_tasks; ++idx)
+    {
+        if (task_status[idx] != BDAP_SUCCESS)
+        {
+            crypto_memzero(plaintext, length);
+            return task_status[idx];
+        }
+    }
+
+    return BDAP_SUCCESS;
+}
+
+/**
+ * @brief Decrypts the payload of a v1 ciphertext, in parallel if
+ * a pool is given and the payload reaches the parallel threshold.
+ * 
+ * @param plaintext the output plaintext pointer
+ * @param key_nonce the payload key and nonce, KEY_NONCE_SIZE bytes
+ * @param ciphertext the input v1 ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param pool the thread pool, or NULL
+ * @return BDAP_SUCCESS or the error code
+ */
+static uint16_t bdap_decrypt_payload(uint8_t* plaintext,
+                                     const uint8_t* key_nonce,
+                                     const uint8_t* ciphertext,
+                                     const size_t ciphertext_size,
+                                     bdap_thread_pool* pool)
+{
+    bool result;
+    size_t unused;
+    size_t ciphertext_header_size = bdap_ciphertext_header_size(
+        bdap_ciphertext_number_of_recipients(ciphertext));
+    const uint8_t* c_ptr = ciphertext + ciphertext_header_size;
+
+    /* 8. AESGCM_D(key, nonce, ciphertext) */
+    if (pool != NULL &&
+        ciphertext_size - ciphertext_header_size >= parallel_gcm_threshold)
+    {
+        result = (aes256gcm_decrypt_parallel(plaintext,
+                                             &unused,
+                                             c_ptr,
+                                             ciphertext_size - ciphertext_header_size,
+                                             NULL,
+                                             0,
+                                             &key_nonce[AES256GCM_KEY_SIZE],
+                                             key_nonce,
+                                             pool) == 0);
+    }
+    else
+    {
+        result = (aes256gcm_decrypt(plaintext,
+                                    &unused,
+                                    c_ptr,
+                                    ciphertext_size - ciphertext_header_size,
+                                    NULL,
+                                    0,
+                                    &key_nonce[AES256GCM_KEY_SIZE],
+                                    key_nonce) == 0);
+    }
+
+    return result ? BDAP_SUCCESS : BDAP_AESGCM_DECRYPT_FAILED;
+}
+
+/**
+ * @brief The body of bdap_decrypt_range(uint8_t*,
+ * const bdap_decrypt_key*, const uint8_t*, const size_t,
+ * const size_t, const size_t, struct bdap_thread_pool*,
+ * const char**), reporting an error code rather than a message.
+ */
+static bool bdap_decrypt_range_core(uint8_t* plaintext,
+                                    const bdap_decrypt_key* key,
+                                    const uint8_t* ciphertext,
+                                    const size_t ciphertext_size,
+                                    const size_t offset,
+                                    const size_t length,
+                                    bdap_thread_pool* pool,
+                                    uint16_t* status)
+{
+    uint16_t error_code = BDAP_SUCCESS;
+    uint8_t key_nonce_fallback[KEY_NONCE_SIZE];
+    uint8_t* key_nonce = bdap_secrets_take(key_nonce_fallback,
+                                           KEY_NONCE_SIZE);
+    bdap_v2_layout layout;
+
+    if (ciphertext == NULL ||
+        !bdap_ciphertext_is_v2(ciphertext, ciphertext_size) ||
+        !bdap_v2_parse_layout(&layout, ciphertext, ciphertext_size))
+    {
+        error_code = BDAP_INVALID_CIPHERTEXT;
+        goto bdap_decrypt_range_bail;
+    }
+
+    if (offset > layout.plaintext_size ||
+        length > layout.plaintext_size - offset)
+    {
+        error_code = BDAP_INVALID_RANGE;
+        goto bdap_decrypt_range_bail;
+    }
+
+    /* 1-7. Recover the payload key from the header */
+    error_code = bdap_decrypt_header(key_nonce,
+                                     key,
+                                     ciphertext + V2_PREAMBLE_SIZE);
+    if (error_code != BDAP_SUCCESS)
+    {
+        goto bdap_decrypt_range_bail;
+    }
+
+    /* 8. AESGCM_D(key, nonce_j, C_j) for the segments in range */
+    error_code = bdap_v2_decrypt_segments(plaintext,
+                                          key_nonce,
+                                          ciphertext,
+                                          &layout,
+                                          offset,
+                                          length,
+                                          pool);
+
+bdap_decrypt_range_bail:
+    bdap_secrets_release(key_nonce, key_nonce_fallback, KEY_NONCE_SIZE);
+    *status = error_code;
+
+    return (error_code == BDAP_SUCCESS);
+}
+
+/**
+ * @brief Decrypts the bytes [offset, offset + length) of the
+ * plaintext of a v2 ciphertext.
+ * 
+ * @param plaintext the output plaintext pointer, length bytes
+ * @param key the decryption key
+ * @param ciphertext the input v2 ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param offset the offset of the range in the plaintext
+ * @param length the length of the range in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt_range(uint8_t* plaintext,
+                        const bdap_decrypt_key* key,
+                        const uint8_t* ciphertext,
+                        const size_t ciphertext_size,
+                        const size_t offset,
+                        const size_t length,
+                        struct bdap_thread_pool* pool,
+                        const char** error_message)
+{
+    bool result;
+    uint16_t error_code = BDAP_SUCCESS;
+
+    result = bdap_decrypt_range_core(plaintext,
+                                     key,
+                                     ciphertext,
+                                     ciphertext_size,
+                                     offset,
+                                     length,
+                                     pool,
+                                     &error_code);
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return result;
+}
+
+/**
+ * @brief Decrypts a ciphertext that was already validated, see
+ * bdap_decrypt_with_key_core(uint8_t*, const bdap_decrypt_key*,
+ * const uint8_t*, const size_t, bdap_thread_pool*, uint16_t*).
+ */
+static bool bdap_decrypt_validated(uint8_t* plaintext,
+                                   const bdap_decrypt_key* key,
+                                   const uint8_t* ciphertext,
+                                   const size_t ciphertext_size,
+                                   bdap_thread_pool* pool,
+                                   uint16_t* status)
+{
+    bool result = false;
+    uint16_t error_code = BDAP_SUCCESS;
+    uint8_t key_nonce_fallback[KEY_NONCE_SIZE];
+    uint8_t* key_nonce;
+
+    if (bdap_ciphertext_is_v2(ciphertext, ciphertext_size))
+    {
+        return bdap_decrypt_range_core(plaintext,
+                                       key,
+                                       ciphertext,
+                                       ciphertext_size,
+                                       0,
+                                       bdap_decrypted_size(ciphertext,
+                                                           ciphertext_size),
+                                       pool,
+                                       status);
+    }
+
+    key_nonce = bdap_secrets_take(key_nonce_fallback, KEY_NONCE_SIZE);
+
+    /* 1-7. Recover the payload key from the header */
+    error_code = bdap_decrypt_header(key_nonce, key, ciphertext);
+    if (error_code != BDAP_SUCCESS)
+    {
+        goto bdap_e2e_decrypt_bail;
+    }
+
+    /* 8. AESGCM_D(key, nonce, ciphertext) */
+    error_code = bdap_decrypt_payload(plaintext,
+                                      key_nonce,
+                                      ciphertext,
+                                      ciphertext_size,
+                                      pool);
+    result = (error_code == BDAP_SUCCESS);
+
+bdap_e2e_decrypt_bail:
+    bdap_secrets_release(key_nonce, key_nonce_fallback, KEY_NONCE_SIZE);
+    *status = error_code;
+
+    return result;
+}
+
+/**
+ * @brief The body of bdap_decrypt_with_key(uint8_t*,
+ * const bdap_decrypt_key*, const uint8_t*, const size_t,
+ * const char**), reporting an error code rather than a message.
+ */
+static bool bdap_decrypt_with_key_core(uint8_t* plaintext,
+                                       const bdap_decrypt_key* key,
+                                       const uint8_t* ciphertext,
+                                       const size_t ciphertext_size,
+                                       bdap_thread_pool* pool,
+                                       uint16_t* status)
+{
+    if (false == bdap_validate_ciphertext(ciphertext, ciphertext_size, NULL))
+    {
+        *status = BDAP_INVALID_CIPHERTEXT;
+        return false;
+    }
+
+    return bdap_decrypt_validated(plaintext,
+                                  key,
+                                  ciphertext,
+                                  ciphertext_size,
+                                  pool,
+                                  status);
+}
+
+/**
+ * @brief Performs BDAP end-to-end decryption on a piece of
+ * ciphertext using a precomputed decryption key.
+ * 
+ * @note Only a single Curve25519 Diffie-Hellman exchange is
+ * performed per ciphertext, see bdap_decrypt(uint8_t*,
+ * const uint8_t*, const uint8_t*, const size_t, const char**)
+ * for the remaining notes.
+ * 
+ * @param plaintext the output plaintext pointer
+ * @param key the decryption key
+ * @param ciphertext the input ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt_with_key(uint8_t* plaintext,
+                           const bdap_decrypt_key* key,
+                           const uint8_t* ciphertext,
+                           const size_t ciphertext_size,
+                           const char** error_message)
+{
+    bool result;
+    uint16_t error_code = BDAP_SUCCESS;
+
+    result = bdap_decrypt_with_key_core(plaintext,
+                                        key,
+                                        ciphertext,
+                                        ciphertext_size,
+                                        NULL,
+                                        &error_code);
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return result;
+}
+
+/**
+ * @brief Performs BDAP end-to-end decryption on a piece of
+ * ciphertext using a precomputed decryption key, spreading the
+ * payload across the threads of a pool when it is large enough.
+ * 
+ * @param plaintext the output plaintext pointer
+ * @param key the decryption key
+ * @param ciphertext the input ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param pool the thread pool, or NULL
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt_with_key_parallel(uint8_t* plaintext,
+                                    const bdap_decrypt_key* key,
+                                    const uint8_t* ciphertext,
+                                    const size_t ciphertext_size,
+                                    struct bdap_thread_pool* pool,
+                                    const char** error_message)
+{
+    bool result;
+    uint16_t error_code = BDAP_SUCCESS;
+
+    result = bdap_decrypt_with_key_core(plaintext,
+                                        key,
+                                        ciphertext,
+                                        ciphertext_size,
+                                        pool,
+                                        &error_code);
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return result;
+}
+
+void bdap_set_parallel_gcm_threshold(const size_t threshold)
+{
+    parallel_gcm_threshold = threshold;
+}
+
+size_t bdap_get_parallel_gcm_threshold(void)
+{
+    return parallel_gcm_threshold;
+}
+
+void bdap_set_constant_time_lookup(const bool enable)
+{
+    constant_time_lookup = enable;
+}
+
+bool bdap_get_constant_time_lookup(void)
+{
+    return constant_time_lookup;
+}
+
+/**
+ * @brief The shared state of a bdap_decrypt_batch call.
+ */
+typedef struct
+{
+    uint8_t** plaintexts;
+    uint16_t* status;
+    const bdap_decrypt_key* key;
+    const uint8_t* const* ciphertexts;
+    const size_t* ciphertext_sizes;
+} bdap_decrypt_batch_ctx;
+
+static void bdap_decrypt_batch_task(void* arg, size_t index)
+{
+    bdap_decrypt_batch_ctx* ctx = (bdap_decrypt_batch_ctx*)arg;
+
+    (void)bdap_decrypt_with_key_core(ctx->plaintexts[index],
+                                     ctx->key,
+                                     ctx->ciphertexts[index],
+                                     ctx->ciphertext_sizes[index],
+                                     NULL,
+                                     &ctx->status[index]);
+}
+
+/**
+ * @brief Performs BDAP end-to-end decryption on a batch of
+ * ciphertexts using a precomputed decryption key.
+ * 
+ * @note The ciphertexts are spread across the threads of the
+ * pool, or decrypted by the calling thread if it is NULL.
+ * 
+ * @param plaintexts the output plaintext pointers
+ * @param status the output status codes, see encryption_error.h
+ * @param key the decryption key
+ * @param ciphertexts the input ciphertext pointers
+ * @param ciphertext_sizes the ciphertext sizes in bytes
+ * @param num_ciphertexts the number of ciphertexts
+ * @param pool the thread pool, or NULL
+ * @return true if all the ciphertexts were decrypted
+ * @return false otherwise
+ */
+bool bdap_decrypt_batch(uint8_t** plaintexts,
+                        uint16_t* status,
+                        const bdap_decrypt_key* key,
+                        const uint8_t* const* ciphertexts,
+                        const size_t* ciphertext_sizes,
+                        const size_t num_ciphertexts,
+                        struct bdap_thread_pool* pool)
+{
+    size_t idx;
+    bdap_decrypt_batch_ctx ctx;
+
+    ctx.plaintexts = plaintexts;
+    ctx.status = status;
+    ctx.key = key;
+    ctx.ciphertexts = ciphertexts;
+    ctx.ciphertext_sizes = ciphertext_sizes;
+
+    if (pool != NULL)
+    {
+        bdap_thread_pool_run(pool,
+                             num_ciphertexts,
+                             bdap_decrypt_batch_task,
+                             &ctx);
+    }
+    else
+    {
+        for (idx = 0; idx < num_ciphertexts; ++idx)
+        {
+            bdap_decrypt_batch_task(&ctx, idx);
+        }
+    }
+
+    for (idx = 0; idx < num_ciphertexts; ++idx)
+    {
+        if (status[idx] != BDAP_SUCCESS)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Performs BDAP end-to-end decryption on a piece of
+ * ciphertext.
+ * 
+ * @note In order to perform decryption, an Ed25519 private-key
+ * is required. The standard Ed25519 private key consists of
+ * 32 bytes seed and 32 bytes public-key. This method requires
+ * only the first 32 bytes seed of the private-key.
+ * 
+ * @note The expected size of the plaintext can be obtained from
+ * bdap_decrypted_size(const uint8_t*, const size_t) function.
+ *
+ * @note The caller of this method does not need to allocate
+ * and deallocate memory for error messages. This method returns
+ * a pointer to a pre-defined string. The parameter {@code
+ * error_message} can also be NULL, which means that the caller
+ * doesn't want any error messages.
+ * 
+ * @note The keys derived from the private-key and the scratch
+ * state are kept in slots of the secure arena, see
+ * crypto_secure_alloc(), so that no memory is locked per call.
+ * The private-key seed is never locked in place: when no slot can
+ * be taken, the decryption fails with
+ * BDAP_MEMORY_PROTECTION_FAILED.
+ * 
+ * @note When decrypting many ciphertexts with the same private-key,
+ * use bdap_decrypt_with_key(uint8_t*, const bdap_decrypt_key*,
+ * const uint8_t*, const size_t, const char**) instead.
+ * 
+ * @param plaintext the output plaintext pointer 
+ * @param plaintext_size the output plaintext size in bytes
+ * @param ed25519_private_key_seed the pointer to the decryption
+ *                                 private-key seed
+ * @param ciphertext the input ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_decrypt(uint8_t* plaintext,
+                  const uint8_t* ed25519_private_key_seed,
+                  const uint8_t* ciphertext,
+                  const size_t ciphertext_size,
+                  const char** error_message)
+{
+    bool result = false;
+    uint16_t error_code;
+    bdap_decrypt_key* key;
+
+    /* The ciphertext is validated before the costly key derivation */
+    if (false == bdap_validate_ciphertext(ciphertext, ciphertext_size, NULL))
+    {
+        error_code = BDAP_INVALID_CIPHERTEXT;
+        goto bdap_decrypt_bail;
+    }
+
+    key = crypto_secure_alloc();
+    if (key == NULL)
+    {
+        error_code = BDAP_MEMORY_PROTECTION_FAILED;
+        goto bdap_decrypt_bail;
+    }
+
+    error_code = bdap_decrypt_key_derive(key, ed25519_private_key_seed);
+    if (error_code == BDAP_SUCCESS)
+    {
+        result = bdap_decrypt_validated(plaintext,
+                                        key,
+                                        ciphertext,
+                                        ciphertext_size,
+                                        NULL,
+                                        &error_code);
+    }
+    crypto_secure_free(key);
+
+bdap_decrypt_bail:
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return result;
+}
+
+/**
+ * @brief Hashes a fingerprint to a position of a keyring index.
+ */
+static size_t bdap_keyring_slot(const uint8_t* fingerprint,
+                                const size_t index_size)
+{
+    uint64_t v = 0;
+    size_t i;
+
+    for (i = FINGERPRINT_SIZE; i > 0; --i)
+    {
+        v = (v << 8) | fingerprint[i - 1];
+    }
+    v = (v * 0x9E3779B97F4A7C15ULL) >> 32;
+
+    return (size_t)((v * index_size) >> 32);
+}
+
+/**
+ * @brief Looks a fingerprint up in the index of a keyring.
+ * 
+ * @return the position of the key, or keyring->num_keys if there
+ * is none
+ */
+static size_t bdap_keyring_lookup(const bdap_keyring* keyring,
+                                  const uint8_t* fingerprint)
+{
+    size_t pos;
+    uint32_t entry;
+
+    if (keyring->num_keys == 0)
+    {
+        return keyring->num_keys;
+    }
+
+    /* The index is at most half full, so an empty entry ends the probe */
+    pos = bdap_keyring_slot(fingerprint, keyring->index_size);
+    while ((entry = keyring->index[pos]) != 0)
+    {
+        if (memcmp(keyring->keys[entry - 1].ed25519_pk,
+                   fingerprint,
+                   FINGERPRINT_SIZE) == 0)
+        {
+            return entry - 1;
+        }
+        if (++pos == keyring->index_size)
+        {
+            pos = 0;
+        }
+    }
+
+    return keyring->num_keys;
+}
+
+/**
+ * @brief Initialises an empty keyring over caller-provided storage.
+ * 
+ * @param keyring the keyring
+ * @param keys the storage of the keys, capacity entries
+ * @param index the storage of the index,
+ *              BDAP_KEYRING_INDEX_SIZE(capacity) entries
+ * @param capacity the maximum number of keys, below UINT32_MAX
+ */
+void bdap_keyring_init(bdap_keyring* keyring,
+                       bdap_decrypt_key* keys,
+                       uint32_t* index,
+                       const size_t capacity)
+{
+    keyring->keys = keys;
+    keyring->index = index;
+    keyring->capacity = capacity;
+    keyring->num_keys = 0;
+    keyring->index_size = BDAP_KEYRING_INDEX_SIZE(capacity);
+    keyring->locked = false;
+    if (keyring->index_size > 0)
+    {
+        memset(index, 0, keyring->index_size * sizeof(uint32_t));
+    }
+}
+
+/**
+ * @brief Derives the decryption key of an identity and adds it to
+ * a keyring, at position keyring->num_keys.
+ * 
+ * @param keyring the keyring
+ * @param ed25519_private_key_seed the Ed25519 private-key seed
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_keyring_add(bdap_keyring* keyring,
+                      const uint8_t* ed25519_private_key_seed,
+                      const char** error_message)
+{
+    uint16_t error_code = BDAP_SUCCESS;
+    size_t pos;
+    bdap_decrypt_key* key;
+
+    if (keyring->num_keys >= keyring->capacity)
+    {
+        error_code = BDAP_KEYRING_FULL;
+        goto bdap_keyring_add_bail;
+    }
+
+    /* The storage of the keys is locked once and for all */
+    if (!keyring->locked)
+    {
+        if (!crypto_mlock(keyring->keys,
+                          keyring->capacity * sizeof(bdap_decrypt_key)))
+        {
+            error_code = BDAP_MEMORY_PROTECTION_FAILED;
+            goto bdap_keyring_add_bail;
+        }
+        keyring->locked = true;
+    }
+
+    if (!crypto_mlock((void*)ed25519_private_key_seed,
+                      ED25519_PRIVATE_KEY_SEED_SIZE))
+    {
+        error_code = BDAP_MEMORY_PROTECTION_FAILED;
+        goto bdap_keyring_add_bail;
+    }
+
+    key = &keyring->keys[keyring->num_keys];
+    crypto_memzero(key, sizeof(bdap_decrypt_key));
+    error_code = bdap_decrypt_key_derive(key, ed25519_private_key_seed);
+    (void)crypto_munlock((void*)ed25519_private_key_seed,
+                         ED25519_PRIVATE_KEY_SEED_SIZE);
+    if (error_code != BDAP_SUCCESS)
+    {
+        crypto_memzero(key, sizeof(bdap_decrypt_key));
+        goto bdap_keyring_add_bail;
+    }
+
+    /* A duplicate fingerprint is shadowed by the earlier key */
+    pos = bdap_keyring_slot(key->ed25519_pk, keyring->index_size);
+    while (keyring->index[pos] != 0)
+    {
+        if (++pos == keyring->index_size)
+        {
+            pos = 0;
+        }
+    }
+    keyring->index[pos] = (uint32_t)(++keyring->num_keys);
+
+bdap_keyring_add_bail:
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return (error_code == BDAP_SUCCESS);
+}
+
+/**
+ * @brief The body of bdap_keyring_decrypt(uint8_t*, size_t*,
+ * const bdap_keyring*, const uint8_t*, const size_t, const char**),
+ * reporting an error code rather than a message.
+ */
+static bool bdap_keyring_decrypt_core(uint8_t* plaintext,
+                                      size_t* identity,
+                                      const bdap_keyring* keyring,
+                                      const uint8_t* ciphertext,
+                                      const size_t ciphertext_size,
+                                      uint16_t* status)
+{
+    size_t idx, found = keyring->num_keys;
+    uint16_t num_recipients;
+    uint16_t error_code = BDAP_SUCCESS;
+    uint8_t key_nonce_fallback[KEY_NONCE_SIZE];
+    uint8_t* key_nonce = bdap_secrets_take(key_nonce_fallback,
+                                           KEY_NONCE_SIZE);
+    const uint8_t* header = ciphertext;
+    const uint8_t* slots;
+    bool is_v2;
+    bdap_v2_layout layout;
+
+    if (false == bdap_validate_ciphertext(ciphertext, ciphertext_size, NULL))
+    {
+        error_code = BDAP_INVALID_CIPHERTEXT;
+        goto bdap_keyring_decrypt_bail;
+    }
+
+    is_v2 = bdap_ciphertext_is_v2(ciphertext, ciphertext_size);
+    if (is_v2)
+    {
+        (void)bdap_v2_parse_layout(&layout, ciphertext, ciphertext_size);
+        header += V2_PREAMBLE_SIZE;
+    }
+
+    /* 1-3. One pass over the | f_i | c_i | pairs, looking each */
+    /*      fingerprint up in the index */
+    num_recipients = bdap_ciphertext_number_of_recipients(header);
+    slots = header + sizeof(num_recipients) + CURVE25519_PUBLIC_KEY_SIZE;
+    for (idx = 0; idx < num_recipients; ++idx)
+    {
+        found = bdap_keyring_lookup(keyring, slots + idx * SLOT_SIZE);
+        if (found < keyring->num_keys)
+        {
+            break;
+        }
+    }
+    if (found >= keyring->num_keys)
+    {
+        error_code = BDAP_NO_VALID_RECIPIENT;
+        goto bdap_keyring_decrypt_bail;
+    }
+
+    /* 4-7. Recover the secret and derive the payload key */
+    error_code = bdap_decrypt_secret(key_nonce,
+                                     &keyring->keys[found],
+                                     header + sizeof(num_recipients),
+                                     slots + idx * SLOT_SIZE + FINGERPRINT_SIZE);
+    if (error_code != BDAP_SUCCESS)
+    {
+        goto bdap_keyring_decrypt_bail;
+    }
+
+    /* 8. AESGCM_D(key, nonce, ciphertext) */
+    if (!is_v2)
+    {
+        error_code = bdap_decrypt_payload(plaintext,
+                                          key_nonce,
+                                          ciphertext,
+                                          ciphertext_size,
+                                          NULL);
+    }
+    else
+    {
+        error_code = bdap_v2_decrypt_segments(plaintext,
+                                              key_nonce,
+                                              ciphertext,
+                                              &layout,
+                                              0,
+                                              layout.plaintext_size,
+                                              NULL);
+    }
+
+bdap_keyring_decrypt_bail:
+    bdap_secrets_release(key_nonce, key_nonce_fallback, KEY_NONCE_SIZE);
+    if (identity != NULL)
+    {
+        *identity = found;
+    }
+    *status = error_code;
+
+    return (error_code == BDAP_SUCCESS);
+}
+
+/**
+ * @brief Decrypts a v1 or v2 ciphertext with whichever key of a
+ * keyring it is addressed to.
+ * 
+ * @param plaintext the output plaintext pointer
+ * @param identity the position of the key that was used, or
+ *                 keyring->num_keys if none matches. May be NULL
+ * @param keyring the keyring
+ * @param ciphertext the input ciphertext pointer
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_keyring_decrypt(uint8_t* plaintext,
+                          size_t* identity,
+                          const bdap_keyring* keyring,
+                          const uint8_t* ciphertext,
+                          const size_t ciphertext_size,
+                          const char** error_message)
+{
+    bool result;
+    uint16_t error_code = BDAP_SUCCESS;
+
+    result = bdap_keyring_decrypt_core(plaintext,
+                                       identity,
+                                       keyring,
+                                       ciphertext,
+                                       ciphertext_size,
+                                       &error_code);
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return result;
+}
+
+/**
+ * @brief Wipes and unlocks the keys of a keyring and empties it.
+ * 
+ * @param keyring the keyring
+ */
+void bdap_keyring_wipe(bdap_keyring* keyring)
+{
+    size_t idx;
+
+    for (idx = 0; idx < keyring->num_keys; ++idx)
+    {
+        crypto_memzero(&keyring->keys[idx], sizeof(bdap_decrypt_key));
+    }
+    if (keyring->locked)
+    {
+        (void)crypto_munlock(keyring->keys,
+                             keyring->capacity * sizeof(bdap_decrypt_key));
+        keyring->locked = false;
+    }
+    keyring->num_keys = 0;
+    if (keyring->index_size > 0)
+    {
+        memset(keyring->index, 0, keyring->index_size * sizeof(uint32_t));
+    }
+}
+
+size_t bdap_header_size(const uint8_t* ciphertext)
+{
+    return bdap_ciphertext_header_size(
+        bdap_ciphertext_number_of_recipients(ciphertext));
+}
+
+/**
+ * @brief Parses the header of a ciphertext in place.
+ * 
+ * @param view the output view
+ * @param ciphertext the ciphertext
+ * @param ciphertext_size the ciphertext size in bytes
+ * @param error_message the pointer to the error message
+ *                      in the event of error
+ * @return true on success
+ * @return false otherwise
+ */
+bool bdap_header_view_init(bdap_header_view* view,
+                           const uint8_t* ciphertext,
+                           const size_t ciphertext_size,
+                           const char** error_message)
+{
+    const uint8_t* header = ciphertext;
+    bdap_v2_layout layout;
+
+    memset(view, 0, sizeof(bdap_header_view));
+    if (false == bdap_validate_ciphertext(ciphertext,
+                                          ciphertext_size,
+                                          error_message))
+    {
+        return false;
+    }
+
+    view->ciphertext = ciphertext;
+    view->version = 1;
+    if (bdap_ciphertext_is_v2(ciphertext, ciphertext_size))
+    {
+        (void)bdap_v2_parse_layout(&layout, ciphertext, ciphertext_size);
+        view->version = V2_VERSION;
+        view->payload_offset = layout.header_size;
+        header += V2_PREAMBLE_SIZE;
+    }
+
+    view->num_recipients = bdap_ciphertext_number_of_recipients(header);
+    view->ephemeral_public_key = header + sizeof(view->num_recipients);
+    view->slots = view->ephemeral_public_key + CURVE25519_PUBLIC_KEY_SIZE;
+    view->sorted =
+        (view->ephemeral_public_key[CURVE25519_PUBLIC_KEY_SIZE - 1] & SORTED_FLAG) != 0;
+    if (view->version == 1)
+    {
+        view->payload_offset = bdap_ciphertext_header_size(view->num_recipients);
+    }
+    view->payload_size = ciphertext_size - view->payload_offset;
+
+    return true;
+}
+
+/**
+ * @brief Returns the fingerprint of a recipient of a header.
+ * 
+ * @param view the header view
+ * @param index the position of the recipient's pair
+ * @return the fingerprint, or NULL if index is out of range
+ */
+const uint8_t* bdap_header_view_fingerprint(const bdap_header_view* view,
+                                            const uint16_t index)
+{
+    if (index >= view->num_recipients)
+    {
+        return NULL;
+    }
+
+    return view->slots + index * SLOT_SIZE;
+}
+
+/**
+ * @brief Checks whether or not a header lists a fingerprint.
+ * 
+ * @param view the header view
+ * @param fingerprint the fingerprint
+ * @return true if a pair has that fingerprint
+ * @return false otherwise
+ */
+bool bdap_has_recipient(const bdap_header_view* view,
+                        const uint8_t* fingerprint)
+{
+    if (view->sorted)
+    {
+        return NULL != bdap_find_slot_sorted(view->slots,
+                                             view->num_recipients,
+                                             fingerprint);
+    }
+
+    return view->num_recipients > fingerprint_find(view->slots,
+                                                   view->num_recipients,
+                                                   SLOT_SIZE,
+                                                   fingerprint,
+                                                   false);
+}
+
+/**
+ * @brief Locks a sealed message in memory before an encryption
+ * keeps its secrets there.
+ * 
+ * @note The lock is counted, so that wiping a sealed message does
+ * not unlock the other locked data sharing its pages.
+ * 
+ * @return BDAP_SUCCESS or the error code
+ */
+static uint16_t bdap_sealed_message_lock(bdap_sealed_message* sealed)
+{
+    crypto_memzero(sealed, sizeof(bdap_sealed_message));
+
+    if (!crypto_mlock(sealed, sizeof(bdap_sealed_message)))
+    {
+        return BDAP_MEMORY_PROTECTION_FAILED;
+    }
+    sealed->locked = true;
+
+    return BDAP_SUCCESS;
+}
+
+/**
+ * @brief Performs BDAP end-to-end encryption and keeps a sealed
+ * message to add recipients to the ciphertext later.
+ * 
+ * @note The sealed message is locked in memory until it is
+ * released by bdap_sealed_message_wipe(bdap_sealed_message*),
+ * which must be called even if this method fails.
+ */
+bool bdap_encrypt_sealed(uint8_t* ciphertext,
+                         bdap_sealed_message* sealed,
+                         const uint16_t num_recipients,
+                         const uint8_t** ed25519_public_key,
+                         const uint8_t* plaintext,
+                         const size_t plaintext_size,
+                         const char** error_message)
+{
+    uint16_t error_code = bdap_sealed_message_lock(sealed);
+
+    if (error_code != BDAP_SUCCESS)
+    {
+        if (error_message != NULL)
+        {
+            *error_message = bdap_error_message[error_code];
+        }
+        return false;
+    }
+
+    return bdap_encrypt_core(ciphertext,
+                             num_recipients,
+                             ed25519_public_key,
+                             NULL,
+                             plaintext,
+                             plaintext_size,
+                             NULL,
+                             sealed,
+                             NULL,
+                             error_message);
+}
+
+bool bdap_encrypt_v2_sealed(uint8_t* ciphertext,
+                            bdap_sealed_message* sealed,
+                            const uint16_t num_recipients,
+                            const uint8_t** ed25519_public_key,
+                            const uint8_t* plaintext,
+                            const size_t plaintext_size,
+                            const size_t segment_size,
+                            struct bdap_thread_pool* pool,
+                            const char** error_message)
+{
+    uint16_t error_code = bdap_sealed_message_lock(sealed);
+
+    if (error_code != BDAP_SUCCESS)
+    {
+        if (error_message != NULL)
+        {
+            *error_message = bdap_error_message[error_code];
+        }
+        return false;
+    }
+
+    return bdap_encrypt_v2_core(ciphertext,
+                                num_recipients,
+                                ed25519_public_key,
+                                NULL,
+                                plaintext,
+                                plaintext_size,
+                                segment_size,
+                                pool,
+                                sealed,
+                                error_message);
+}
+
+/**
+ * @brief Wipes and unlocks a sealed message.
+ * 
+ * @param sealed the sealed message
+ */
+void bdap_sealed_message_wipe(bdap_sealed_message* sealed)
+{
+    bool locked = sealed->locked;
+
+    crypto_memzero(sealed, sizeof(bdap_sealed_message));
+    if (locked)
+    {
+        (void)crypto_munlock(sealed, sizeof(bdap_sealed_message));
+    }
+}
+
+size_t bdap_added_header_size(const bdap_header_view* view,
+                              const uint16_t num_recipients)
+{
+    return view->payload_offset + (size_t)num_recipients * SLOT_SIZE;
+}
+
+/**
+ * @brief Merges sorted pairs into sorted pairs, from the last one
+ * down, so that the {@code num_added} pairs at the start of the
+ * output are only overwritten once they have been read.
+ * 
+ * @param slots the output pairs, starting with the added ones
+ * @param num_added the number of added pairs
+ * @param existing the existing pairs, which must not overlap slots
+ * @param num_existing the number of existing pairs
+ */
+static void bdap_merge_slots(uint8_t* slots,
+                             const size_t num_added,
+                             const uint8_t* existing,
+                             const size_t num_existing)
+{
+    size_t i = num_existing, j = num_added;
+
+    while (i > 0)
+    {
+        if (j > 0 && memcmp(slots + (j - 1) * SLOT_SIZE,
+                            existing + (i - 1) * SLOT_SIZE,
+                            FINGERPRINT_SIZE) > 0)
+        {
+            memmove(slots + (i + j - 1) * SLOT_SIZE,
+                    slots + (j - 1) * SLOT_SIZE,
+                    SLOT_SIZE);
+            --j;
+        }
+        else
+        {
+            memcpy(slots + (i + j - 1) * SLOT_SIZE,
+                   existing + (i - 1) * SLOT_SIZE,
+                   SLOT_SIZE);
+            --i;
+        }
+    }
+}
+
+/**
+ * @brief Writes the header of a ciphertext with more recipients.
+ * 
+ * @note The sealed message must be the one kept when encrypting
+ * the ciphertext, which is checked against its ephemeral
+ * public-key U. The new pairs encrypt the same secret s, so the
+ * payload key, and thus the payload, stay the same.
+ */
+bool bdap_add_recipients(uint8_t* header,
+                         const bdap_sealed_message* sealed,
+                         const bdap_header_view* view,
+                         const uint16_t num_recipients,
+                         const uint8_t** ed25519_public_key,
+                         const char** error_message)
+{
+    uint16_t error_code = BDAP_SUCCESS;
+    uint16_t total = view->num_recipients + num_recipients;
+    size_t preamble_size = (view->version == V2_VERSION) ? V2_PREAMBLE_SIZE : 0;
+    uint8_t *c_ptr = header;
+    uint8_t *slots;
+
+    if ((size_t)view->num_recipients + num_recipients > UINT16_MAX)
+    {
+        error_code = BDAP_TOO_MANY_RECIPIENTS;
+        goto bdap_add_recipients_bail;
+    }
+    if (0 != memcmp(view->ephemeral_public_key,
+                    sealed->ephemeral_pk,
+                    CURVE25519_PUBLIC_KEY_SIZE))
+    {
+        error_code = BDAP_SEALED_MESSAGE_MISMATCH;
+        goto bdap_add_recipients_bail;
+    }
+
+    /* Preamble of a v2 ciphertext, the AAD of its segments */
+    memcpy(c_ptr, view->ciphertext, preamble_size);
+    c_ptr += preamble_size;
+
+    /* Write the new N and the unchanged U */
+    *c_ptr++ = (uint8_t) total;
+    *c_ptr++ = (uint8_t)(total >> 8);
+    memcpy(c_ptr, view->ephemeral_public_key, CURVE25519_PUBLIC_KEY_SIZE);
+    slots = c_ptr + CURVE25519_PUBLIC_KEY_SIZE;
+
+    /* 3. Write the pairs of the added recipients only */
+    error_code = bdap_encrypt_slots(slots,
+                                    num_recipients,
+                                    ed25519_public_key,
+                                    NULL,
+                                    sealed->ephemeral_pk,
+                                    sealed->ephemeral_sk,
+                                    sealed->secret,
+                                    NULL);
+    if (error_code != BDAP_SUCCESS)
+    {
+        goto bdap_add_recipients_bail;
+    }
+
+    /* Keep a sorted header sorted, an unsorted one is appended to */
+    if (view->sorted)
+    {
+        bdap_sort_slots(slots, num_recipients);
+        bdap_merge_slots(slots, num_recipients, view->slots, view->num_recipients);
+    }
+    else
+    {
+        memmove(slots + (size_t)view->num_recipients * SLOT_SIZE,
+                slots,
+                (size_t)num_recipients * SLOT_SIZE);
+        memcpy(slots, view->slots, (size_t)view->num_recipients * SLOT_SIZE);
+    }
+
+bdap_add_recipients_bail:
+    if (error_code != BDAP_SUCCESS && error_code != BDAP_TOO_MANY_RECIPIENTS)
+    {
+        crypto_memzero(header, bdap_added_header_size(view, num_recipients));
+    }
     if (error_message != NULL)
     {
         *error_message = bdap_error_message[error_code];
     }
 
-    return result;
+    return (error_code == BDAP_SUCCESS);
 }
 
 /**
- * @brief Performs BDAP end-to-end decryption on a piece of
- * ciphertext.
+ * @brief Picks the registered pool with the fewest ready headers,
+ * among those that are not full and have not failed.
  * 
- * @note In order to perform decryption, an Ed25519 private-key
- * is required. The standard Ed25519 private key consists of
- * 32 bytes seed and 32 bytes public-key. This method requires
- * only the first 32 bytes seed of the private-key.
+ * @note The producer's lock must be held.
  * 
- * @note The expected size of the plaintext can be obtained from
- * bdap_decrypted_size(const uint8_t*, const size_t) function.
- *
- * @note The caller of this method does not need to allocate
- * and deallocate memory for error messages. This method returns
- * a pointer to a pre-defined string. The parameter {@code
- * error_message} can also be NULL, which means that the caller
- * doesn't want any error messages.
+ * @return the pool, or NULL if there is nothing to produce
+ */
+static bdap_header_pool* bdap_header_producer_pick(bdap_header_producer* producer)
+{
+    bdap_header_pool *pool, *emptiest = NULL;
+
+    for (pool = producer->pools; pool != NULL; pool = pool->next)
+    {
+        if (pool->count < pool->capacity &&
+            pool->error_code == BDAP_SUCCESS &&
+            (emptiest == NULL || pool->count < emptiest->count))
+        {
+            emptiest = pool;
+        }
+    }
+
+    return emptiest;
+}
+
+/**
+ * @brief The thread of a header producer.
  * 
- * @param plaintext the output plaintext pointer 
- * @param plaintext_size the output plaintext size in bytes
- * @param ed25519_private_key_seed the pointer to the decryption
- *                                 private-key seed
- * @param ciphertext the input ciphertext pointer
- * @param ciphertext_size the ciphertext size in bytes
+ * @note The entry after the last ready one is written without the
+ * lock: taking a header only advances the head, so the entry
+ * stays free until the producer counts it as ready. A pool is not
+ * unregistered while it is the current one.
+ */
+static void bdap_header_producer_main(void* arg)
+{
+    bdap_header_producer* producer = (bdap_header_producer*)arg;
+    bdap_header_pool* pool;
+    uint8_t* entry;
+    uint16_t error_code;
+
+    bdap_mutex_lock(&producer->lock);
+    while (!producer->shutdown)
+    {
+        pool = bdap_header_producer_pick(producer);
+        if (pool == NULL)
+        {
+            bdap_cond_wait(&producer->wake, &producer->lock);
+            continue;
+        }
+        producer->current = pool;
+        entry = pool->storage
+            + ((pool->head + pool->count) % pool->capacity) * pool->entry_size;
+        bdap_mutex_unlock(&producer->lock);
+
+        /* 1-4. N | U | f_i | c_i | and the payload key */
+        error_code = bdap_encrypt_header(entry + KEY_NONCE_SIZE,
+                                         entry,
+                                         pool->set->num_recipients,
+                                         NULL,
+                                         pool->set->recipients,
+                                         NULL,
+                                         NULL,
+                                         producer->rng);
+
+        bdap_mutex_lock(&producer->lock);
+        if (error_code == BDAP_SUCCESS)
+        {
+            ++pool->count;
+        }
+        else
+        {
+            pool->error_code = error_code;
+        }
+        producer->current = NULL;
+        bdap_cond_broadcast(&producer->idle);
+    }
+    bdap_mutex_unlock(&producer->lock);
+}
+
+bool bdap_header_producer_init(bdap_header_producer* producer)
+{
+    return bdap_header_producer_init_with_rng(producer, NULL);
+}
+
+bool bdap_header_producer_init_with_rng(bdap_header_producer* producer,
+                                        const struct bdap_rng* rng)
+{
+    producer->pools = NULL;
+    producer->current = NULL;
+    producer->rng = rng;
+    producer->shutdown = false;
+
+    if (!bdap_mutex_init(&producer->lock))
+    {
+        return false;
+    }
+    if (!bdap_cond_init(&producer->wake))
+    {
+        goto bdap_header_producer_init_bail_lock;
+    }
+    if (!bdap_cond_init(&producer->idle))
+    {
+        goto bdap_header_producer_init_bail_wake;
+    }
+    if (!bdap_thread_create(&producer->thread,
+                            bdap_header_producer_main,
+                            producer))
+    {
+        goto bdap_header_producer_init_bail;
+    }
+
+    return true;
+
+bdap_header_producer_init_bail:
+    bdap_cond_destroy(&producer->idle);
+bdap_header_producer_init_bail_wake:
+    bdap_cond_destroy(&producer->wake);
+bdap_header_producer_init_bail_lock:
+    bdap_mutex_destroy(&producer->lock);
+
+    return false;
+}
+
+void bdap_header_producer_destroy(bdap_header_producer* producer)
+{
+    bdap_mutex_lock(&producer->lock);
+    producer->shutdown = true;
+    bdap_cond_broadcast(&producer->wake);
+    bdap_mutex_unlock(&producer->lock);
+
+    bdap_thread_join(&producer->thread);
+
+    while (producer->pools != NULL)
+    {
+        bdap_header_pool_wipe(producer->pools);
+    }
+    bdap_cond_destroy(&producer->idle);
+    bdap_cond_destroy(&producer->wake);
+    bdap_mutex_destroy(&producer->lock);
+}
+
+size_t bdap_header_pool_storage_size(const uint16_t num_recipients,
+                                     const size_t capacity)
+{
+    return capacity
+        * (KEY_NONCE_SIZE + bdap_ciphertext_header_size(num_recipients));
+}
+
+/**
+ * @brief Initialises a header pool, locks its storage in memory and
+ * registers it to a header producer.
+ * 
+ * @param pool the header pool
+ * @param producer the header producer
+ * @param set the prepared set of recipients
+ * @param storage the storage
+ * @param capacity the maximum number of ready headers
  * @param error_message the pointer to the error message
  *                      in the event of error
  * @return true on success
  * @return false otherwise
  */
-bool bdap_decrypt(uint8_t* plaintext,
-                  const uint8_t* ed25519_private_key_seed,
-                  const uint8_t* ciphertext,
-                  const size_t ciphertext_size,
-                  const char** error_message)
+bool bdap_header_pool_init(bdap_header_pool* pool,
+                           bdap_header_producer* producer,
+                           const bdap_recipient_set* set,
+                           uint8_t* storage,
+                           const size_t capacity,
+                           const char** error_message)
 {
-    bool result = false;
-    size_t unused;
-    size_t ciphertext_header_size;
-    uint16_t num_recipients = 0;
     uint16_t error_code = BDAP_SUCCESS;
-    uint8_t curve25519_sk[CURVE25519_PRIVATE_KEY_SIZE] = {0};
-    uint8_t curve25519_pk[CURVE25519_PUBLIC_KEY_SIZE] = {0};
-    uint8_t curve25519_ephemeral_pk[CURVE25519_PUBLIC_KEY_SIZE] = {0};
-    uint8_t ed25519_pk[ED25519_PUBLIC_KEY_SIZE] = {0};
-    uint8_t Q[CURVE25519_POINT_SIZE] = {0};
-    uint8_t c[SECRET_SIZE] = {0};
-    uint8_t s[SECRET_SIZE] = {0};
-    uint8_t buf[BUF_SIZE] = {0};
-    uint8_t key_iv[KEY_IV_SIZE] = {0};
-    uint8_t key_nonce[KEY_NONCE_SIZE] = {0};
-    const uint8_t* c_ptr = ciphertext;
 
-    if (!crypto_mlock((void*)ed25519_private_key_seed,
-                      ED25519_PRIVATE_KEY_SEED_SIZE) ||
-        !crypto_mlock(curve25519_sk, CURVE25519_PRIVATE_KEY_SIZE))
+    memset(pool, 0, sizeof(bdap_header_pool));
+    pool->set = set;
+    pool->storage = storage;
+    pool->capacity = capacity;
+    pool->entry_size = KEY_NONCE_SIZE
+        + bdap_ciphertext_header_size(set->num_recipients);
+
+    if (capacity == 0 || set->num_recipients == 0)
+    {
+        error_code = BDAP_INVALID_HEADER_POOL;
+        goto bdap_header_pool_init_bail;
+    }
+
+    if (!crypto_mlock(storage, bdap_header_pool_storage_size(
+                                   set->num_recipients, capacity)))
     {
         error_code = BDAP_MEMORY_PROTECTION_FAILED;
-        goto bdap_e2e_decrypt_bail_without_munlock;
+        goto bdap_header_pool_init_bail;
     }
+    pool->locked = true;
 
-    if (false == bdap_validate_ciphertext(ciphertext, ciphertext_size, error_message))
+    /* Register and wake the producer up */
+    pool->producer = producer;
+    bdap_mutex_lock(&producer->lock);
+    pool->next = producer->pools;
+    producer->pools = pool;
+    bdap_cond_signal(&producer->wake);
+    bdap_mutex_unlock(&producer->lock);
+
+bdap_header_pool_init_bail:
+    if (error_message != NULL)
     {
-        error_code = BDAP_INVALID_CIPHERTEXT;
-        goto bdap_e2e_decrypt_bail;
+        *error_message = bdap_error_message[error_code];
     }
 
-    /* 2. Compute Ed25519 public-key from private-key seed */
-    ed25519_public_key_from_private_key_seed(ed25519_pk, ed25519_private_key_seed);
+    return (error_code == BDAP_SUCCESS);
+}
+
+size_t bdap_header_pool_available(bdap_header_pool* pool)
+{
+    size_t count;
 
-    /* 1. Parse the input ciphertext */
-    /* 3. Search through the fingerprint and encrypted secret pair */
-    /*    to obtain one where the fingerprint matches */
-    /* 4. Abort if not found */
-    result = bdap_get_ephemeral_public_key_and_encrypted_secret(
-        curve25519_ephemeral_pk, c, c_ptr, ed25519_pk);
-    if (true != result)
+    if (pool->producer == NULL)
     {
-        error_code = BDAP_NO_VALID_RECIPIENT;
-        goto bdap_e2e_decrypt_bail;
+        return 0;
     }
 
-    /* 5. Derive Curve25519 private-key from Ed25519 private-key seed */
-    ed25519_to_curve25519_private_key(curve25519_sk,
-                                      ed25519_private_key_seed);
+    bdap_mutex_lock(&pool->producer->lock);
+    count = pool->count;
+    bdap_mutex_unlock(&pool->producer->lock);
 
-    /* 6. Compute Curve25519 public-key from the private-key */
-    result = curve25519_public_key_from_private_key(
-        curve25519_pk, curve25519_sk);
-    if (true != result)
+    return count;
+}
+
+void bdap_header_pool_wipe(bdap_header_pool* pool)
+{
+    bdap_header_producer* producer = pool->producer;
+    bdap_header_pool** link;
+
+    if (producer != NULL)
     {
-        error_code = BDAP_X25519_PUBLIC_KEY_DERIVATION_FAILED;
-        goto bdap_e2e_decrypt_bail;
+        bdap_mutex_lock(&producer->lock);
+        while (producer->current == pool)
+        {
+            bdap_cond_wait(&producer->idle, &producer->lock);
+        }
+        for (link = &producer->pools; *link != NULL; link = &(*link)->next)
+        {
+            if (*link == pool)
+            {
+                *link = pool->next;
+                break;
+            }
+        }
+        bdap_mutex_unlock(&producer->lock);
     }
 
-    /* 7. Curve25519 Diffie-Hellman exchange */
-    result = curve25519_dh(Q, curve25519_sk, curve25519_ephemeral_pk);
-    if (true != result)
+    if (pool->storage != NULL && pool->capacity > 0)
     {
-        error_code = BDAP_X25519_DH_FAILED;
-        goto bdap_e2e_decrypt_bail;
+        crypto_memzero(pool->storage, pool->capacity * pool->entry_size);
+        if (pool->locked)
+        {
+            (void)crypto_munlock(pool->storage, pool->capacity * pool->entry_size);
+        }
     }
+    memset(pool, 0, sizeof(bdap_header_pool));
+}
 
-    /* 8. XOF(Q | curve25519_pk | curve25519_ephemeral_pk, 48) */
-    memcpy(buf, Q, sizeof(Q));
-    memcpy(buf + CURVE25519_PUBLIC_KEY_SIZE,
-            curve25519_pk,
-            CURVE25519_PUBLIC_KEY_SIZE);
-    memcpy(buf + 2*CURVE25519_PUBLIC_KEY_SIZE,
-            curve25519_ephemeral_pk,
-            sizeof(curve25519_ephemeral_pk));
-    result = (0 == shake256(key_iv, KEY_IV_SIZE, buf, BUF_SIZE));
-    if (true != result)
+/**
+ * @brief Takes the oldest ready header of a pool and wipes its
+ * entry.
+ * 
+ * @param header the output header
+ * @param key_nonce the output payload key and nonce
+ * @param pool the header pool
+ * @return true if a header was taken
+ * @return false if the pool is empty
+ */
+static bool bdap_header_pool_take(uint8_t* header,
+                                  uint8_t* key_nonce,
+                                  bdap_header_pool* pool)
+{
+    uint8_t* entry;
+    bool result = false;
+
+    if (pool->producer == NULL)
     {
-        error_code = BDAP_AESCTR_KEY_DERIVATION_FAILED;
-        goto bdap_e2e_decrypt_bail;
+        return false;
     }
 
-    /* 9. AESCTR_D(key, iv, c) -> s */
-    if (aes256ctr_decrypt(s,
-                          &unused,
-                          c,
-                          sizeof(c),
-                          &key_iv[AES256CTR_KEY_SIZE],
-                          key_iv) != 0)
+    bdap_mutex_lock(&pool->producer->lock);
+    if (pool->count > 0)
     {
-        result = false;
-        error_code = BDAP_AESCTR_DECRYPT_FAILED;
-        goto bdap_e2e_decrypt_bail;
+        entry = pool->storage + pool->head * pool->entry_size;
+        memcpy(key_nonce, entry, KEY_NONCE_SIZE);
+        memcpy(header, entry + KEY_NONCE_SIZE, pool->entry_size - KEY_NONCE_SIZE);
+        crypto_memzero(entry, pool->entry_size);
+        pool->head = (pool->head + 1) % pool->capacity;
+        --pool->count;
+        bdap_cond_signal(&pool->producer->wake);
+        result = true;
     }
+    bdap_mutex_unlock(&pool->producer->lock);
 
-    /* 10. XOF(s, 44) */
-    crypto_memzero(buf, sizeof(buf));
-    result = (0 == shake256(key_nonce, KEY_NONCE_SIZE, s, sizeof(s)));
-    if (true != result)
+    return result;
+}
+
+/**
+ * @brief Performs BDAP end-to-end encryption with a ready header
+ * of a pool, or with a fresh one if it is empty.
+ */
+bool bdap_encrypt_with_pool(uint8_t* ciphertext,
+                            bdap_header_pool* pool,
+                            const uint8_t* plaintext,
+                            const size_t plaintext_size,
+                            const char** error_message)
+{
+    uint16_t error_code = BDAP_SUCCESS;
+    uint16_t num_recipients = pool->set->num_recipients;
+    uint8_t key_nonce_fallback[KEY_NONCE_SIZE];
+    uint8_t* key_nonce = bdap_secrets_take(key_nonce_fallback,
+                                           KEY_NONCE_SIZE);
+
+    /* 1-4. N | U | f_i | c_i | and the payload key */
+    if (!bdap_header_pool_take(ciphertext, key_nonce, pool))
     {
-        error_code = BDAP_AESGCM_KEY_DERIVATION_FAILED;
-        goto bdap_e2e_decrypt_bail;
+        error_code = bdap_encrypt_header(ciphertext,
+                                         key_nonce,
+                                         num_recipients,
+                                         NULL,
+                                         pool->set->recipients,
+                                         NULL,
+                                         NULL,
+                                         NULL);
+        if (error_code != BDAP_SUCCESS)
+        {
+            goto bdap_encrypt_with_pool_bail;
+        }
     }
 
-    /* 11. AESGCM_D(key, nonce, ciphertext) */
-    num_recipients = bdap_ciphertext_number_of_recipients(ciphertext);
-    ciphertext_header_size = bdap_ciphertext_header_size(num_recipients);
-    c_ptr += ciphertext_header_size;
+    /* 5. AESGCM_E(key, nonce, plaintext) */
+    if (true != bdap_encrypt_payload(ciphertext
+                                         + bdap_ciphertext_header_size(num_recipients),
+                                     key_nonce,
+                                     plaintext,
+                                     plaintext_size,
+                                     NULL))
+    {
+        error_code = BDAP_AESGCM_ENCRYPT_FAILED;
+    }
 
-    result = (aes256gcm_decrypt(plaintext,
-                                &unused,
-                                c_ptr,
-                                ciphertext_size - ciphertext_header_size,
-                                NULL,
-                                0,
-                                &key_nonce[AES256GCM_KEY_SIZE],
-                                key_nonce) == 0);
-    if (true != result)
+bdap_encrypt_with_pool_bail:
+    if (error_code != BDAP_SUCCESS)
     {
-        error_code = BDAP_AESGCM_DECRYPT_FAILED;
+        crypto_memzero(ciphertext, bdap_ciphertext_size(num_recipients,
+                                                        plaintext_size));
     }
-bdap_e2e_decrypt_bail:
-    (void)crypto_munlock((void*)ed25519_private_key_seed,
-                         ED25519_PRIVATE_KEY_SEED_SIZE);
-    (void)crypto_munlock(curve25519_sk, CURVE25519_PRIVATE_KEY_SIZE);
-bdap_e2e_decrypt_bail_without_munlock:    
-    crypto_memzero(curve25519_sk, sizeof(curve25519_sk));
-    crypto_memzero(curve25519_ephemeral_pk, sizeof(curve25519_ephemeral_pk));
-    crypto_memzero(ed25519_pk, sizeof(ed25519_pk));
-    crypto_memzero(curve25519_pk, sizeof(curve25519_pk));
-    crypto_memzero(s, sizeof(s));
-    crypto_memzero(c, sizeof(c));
-    crypto_memzero(key_iv, sizeof(key_iv));
-    crypto_memzero(key_nonce, sizeof(key_nonce));
-    crypto_memzero(Q, sizeof(Q));
-    crypto_memzero(buf, sizeof(buf));
+    bdap_secrets_release(key_nonce, key_nonce_fallback, KEY_NONCE_SIZE);
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return (error_code == BDAP_SUCCESS);
+}
+
+/**
+ * @brief Starts a streaming encryption for a group of recipients
+ * given either as Ed25519 public-keys or as prepared recipients.
+ */
+static bool bdap_encrypt_stream_init_core(bdap_encrypt_stream* stream,
+                                          uint8_t* header,
+                                          const uint16_t num_recipients,
+                                          const uint8_t** ed25519_public_key,
+                                          const bdap_recipient* recipients,
+                                          const char** error_message)
+{
+    uint16_t error_code;
+    uint8_t key_nonce_fallback[KEY_NONCE_SIZE];
+    uint8_t* key_nonce = bdap_secrets_take(key_nonce_fallback,
+                                           KEY_NONCE_SIZE);
+
+    error_code = bdap_encrypt_header(header,
+                                     key_nonce,
+                                     num_recipients,
+                                     ed25519_public_key,
+                                     recipients,
+                                     NULL,
+                                     NULL,
+                                     NULL);
+    if (error_code == BDAP_SUCCESS)
+    {
+        aes256gcm_init(&stream->gcm,
+                       NULL,
+                       0,
+                       &key_nonce[AES256GCM_KEY_SIZE],
+                       key_nonce);
+    }
+    else
+    {
+        crypto_memzero(stream, sizeof(bdap_encrypt_stream));
+    }
+
+    bdap_secrets_release(key_nonce, key_nonce_fallback, KEY_NONCE_SIZE);
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[error_code];
+    }
+
+    return (error_code == BDAP_SUCCESS);
+}
+
+bool bdap_encrypt_stream_init(bdap_encrypt_stream* stream,
+                              uint8_t* header,
+                              const uint16_t num_recipients,
+                              const uint8_t** ed25519_public_key,
+                              const char** error_message)
+{
+    return bdap_encrypt_stream_init_core(stream,
+                                         header,
+                                         num_recipients,
+                                         ed25519_public_key,
+                                         NULL,
+                                         error_message);
+}
+
+bool bdap_encrypt_stream_init_to_set(bdap_encrypt_stream* stream,
+                                     uint8_t* header,
+                                     const bdap_recipient_set* set,
+                                     const char** error_message)
+{
+    return bdap_encrypt_stream_init_core(stream,
+                                         header,
+                                         set->num_recipients,
+                                         NULL,
+                                         set->recipients,
+                                         error_message);
+}
+
+bool bdap_encrypt_stream_update(bdap_encrypt_stream* stream,
+                                uint8_t* ciphertext,
+                                const uint8_t* plaintext,
+                                const size_t plaintext_size,
+                                const char** error_message)
+{
+    bool result = (0 == aes256gcm_encrypt_update(&stream->gcm,
+                                                 ciphertext,
+                                                 plaintext,
+                                                 plaintext_size));
+
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[
+            result ? BDAP_SUCCESS : BDAP_MESSAGE_TOO_LONG];
+    }
+
+    return result;
+}
+
+void bdap_encrypt_stream_final(bdap_encrypt_stream* stream,
+                               uint8_t* tag)
+{
+    aes256gcm_encrypt_final(&stream->gcm, tag);
+}
+
+bool bdap_decrypt_stream_init(bdap_decrypt_stream* stream,
+                              const bdap_decrypt_key* key,
+                              const uint8_t* header,
+                              const size_t ciphertext_size,
+                              const char** error_message)
+{
+    uint16_t error_code = BDAP_SUCCESS;
+    uint8_t key_nonce_fallback[KEY_NONCE_SIZE];
+    uint8_t* key_nonce = bdap_secrets_take(key_nonce_fallback,
+                                           KEY_NONCE_SIZE);
+
+    crypto_memzero(stream, sizeof(bdap_decrypt_stream));
+
+    if (false == bdap_validate_ciphertext(header, ciphertext_size, NULL) ||
+        bdap_ciphertext_is_v2(header, ciphertext_size))
+    {
+        error_code = BDAP_INVALID_CIPHERTEXT;
+        goto bdap_decrypt_stream_init_bail;
+    }
+
+    error_code = bdap_decrypt_header(key_nonce, key, header);
+    if (error_code != BDAP_SUCCESS)
+    {
+        goto bdap_decrypt_stream_init_bail;
+    }
+
+    aes256gcm_init(&stream->gcm,
+                   NULL,
+                   0,
+                   &key_nonce[AES256GCM_KEY_SIZE],
+                   key_nonce);
+
+bdap_decrypt_stream_init_bail:
+    bdap_secrets_release(key_nonce, key_nonce_fallback, KEY_NONCE_SIZE);
     if (error_message != NULL)
     {
         *error_message = bdap_error_message[error_code];
     }
 
+    return (error_code == BDAP_SUCCESS);
+}
+
+bool bdap_decrypt_stream_authenticate(bdap_decrypt_stream* stream,
+                                      const uint8_t* ciphertext,
+                                      const size_t ciphertext_size,
+                                      const char** error_message)
+{
+    bool result = (0 == aes256gcm_authenticate(&stream->gcm,
+                                               ciphertext,
+                                               ciphertext_size));
+
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[
+            result ? BDAP_SUCCESS : BDAP_MESSAGE_TOO_LONG];
+    }
+
+    return result;
+}
+
+bool bdap_decrypt_stream_verify(bdap_decrypt_stream* stream,
+                                const uint8_t* tag,
+                                const char** error_message)
+{
+    bool result = (0 == aes256gcm_verify(&stream->gcm, tag));
+
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[
+            result ? BDAP_SUCCESS : BDAP_AESGCM_DECRYPT_FAILED];
+    }
+
+    return result;
+}
+
+bool bdap_decrypt_stream_update(bdap_decrypt_stream* stream,
+                                uint8_t* plaintext,
+                                const uint8_t* ciphertext,
+                                const size_t ciphertext_size,
+                                const char** error_message)
+{
+    bool result = (0 == aes256gcm_decrypt_update(&stream->gcm,
+                                                 plaintext,
+                                                 ciphertext,
+                                                 ciphertext_size));
+
+    if (error_message != NULL)
+    {
+        *error_message = bdap_error_message[
+            result ? BDAP_SUCCESS : BDAP_AESGCM_DECRYPT_FAILED];
+    }
+
     return result;
 }
+
+void bdap_decrypt_stream_wipe(bdap_decrypt_stream* stream)
+{
+    aes256gcm_wipe(&stream->gcm);
+}
@@ -19,5 +19,13 @@ const char* bdap_error_message[] =
     "AES-GCM decrypt failed",
     "Unable to find a valid recipient's encrypted secret",
     "Memory protection failed",
-    "Invalid ciphertext"
+    "Invalid ciphertext",
+    "Unable to read or write the stream",
+    "Invalid segment size",
+    "Invalid plaintext range",
+    "The keyring is full",
+    "The sealed message does not belong to the ciphertext",
+    "Too many recipients",
+    "Invalid header pool capacity or recipient set",
+    "The message exceeds the AES-GCM size limit"
 };
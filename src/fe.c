@@ -4,6 +4,8 @@
 #include "fe.h"
 #include "utils.h"
 
+#ifndef FE_51
+
 typedef int64_t fe64[10];
 
 #define FE_COPY(u, v) {\
@@ -741,6 +743,8 @@ void fe_2sqr(fe h, const fe f)
     FE_COPY(h, (int32_t)w);
 }
 
+#endif /* FE_51 */
+
 /**
  * @brief Inverts a field element.
  * 
@@ -809,6 +813,55 @@ void fe_inv(fe x, const fe z)
     fe_mul(x, t1, t0);
 }
 
+/**
+ * @brief Inverts {@code n} field elements with a single inversion
+ * (Montgomery's trick).
+ * 
+ * @note Costs one fe_inv(fe, const fe) plus 3(n - 1) multiplications.
+ * Zero elements are mapped to zero, as with fe_inv(fe, const fe),
+ * without affecting the other elements. The arrays x and z must
+ * not overlap.
+ * 
+ * @param x The output of inversion, n field elements
+ * @param z The field elements to be inverted, n field elements
+ * @param n The number of field elements
+ */
+void fe_batch_inv(fe *x, const fe *z, size_t n)
+{
+    size_t i;
+    fe one = {1}, zero = {0};
+    fe acc, t;
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    /* x[i] = z[0] * z[1] * ... * z[i], with zeros replaced by one */
+    fe_copy(x[0], z[0]);
+    fe_cmov(x[0], one, fe_iszero(z[0]));
+    for (i = 1; i < n; ++i)
+    {
+        fe_copy(t, z[i]);
+        fe_cmov(t, one, fe_iszero(z[i]));
+        fe_mul(x[i], x[i - 1], t);
+    }
+
+    fe_inv(acc, x[n - 1]);
+
+    /* acc = 1 / (z[0] * ... * z[i]) at the start of each iteration */
+    for (i = n - 1; i > 0; --i)
+    {
+        fe_copy(t, z[i]);
+        fe_cmov(t, one, fe_iszero(z[i]));
+        fe_mul(x[i], acc, x[i - 1]);
+        fe_mul(acc, acc, t);
+        fe_cmov(x[i], zero, fe_iszero(z[i]));
+    }
+    fe_copy(x[0], acc);
+    fe_cmov(x[0], zero, fe_iszero(z[0]));
+}
+
 /**
  * @brief Computes z^(2^252 - 3).
  * 
@@ -874,6 +927,8 @@ void fe_pow_2e252m3(fe x, const fe z)
     fe_mul(x, t0, z);
 }
 
+#ifndef FE_51
+
 /**
  * @brief Negate a field element v.
  * 
@@ -885,6 +940,8 @@ void fe_neg(fe u, const fe v)
     FE_CONST_MUL(u, -1, v);
 }
 
+#endif /* FE_51 */
+
 /**
  * @brief Returns true if field element v is zero, otherwise false.
  * 
@@ -922,6 +979,8 @@ bool fe_isnegative(const fe v)
     return (bool)(u[0] & 1);
 }
 
+#ifndef FE_51
+
 /**
  * @brief Loads a field element from a byte-array.
  * 
@@ -1067,6 +1126,8 @@ void fe_tobytes(uint8_t *s, const fe h)
     s[31] = v[9] >> 18;
 }
 
+#endif /* FE_51 */
+
 /**
  * @brief Checks whether or not the point p has a small order.
  * 
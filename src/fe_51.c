@@ -0,0 +1,398 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#include "fe.h"
+
+#ifdef FE_51
+
+#define FE_MASK51   0x7ffffffffffffULL
+
+#if defined(__GNUC__)
+__extension__ typedef unsigned __int128 uint128_t;
+#else
+typedef unsigned __int128 uint128_t;
+#endif
+
+static uint64_t little_endian_load_8(const uint8_t *in)
+{
+    uint64_t result;
+    result  =  (uint64_t)in[0];
+    result |= ((uint64_t)in[1]) <<  8;
+    result |= ((uint64_t)in[2]) << 16;
+    result |= ((uint64_t)in[3]) << 24;
+    result |= ((uint64_t)in[4]) << 32;
+    result |= ((uint64_t)in[5]) << 40;
+    result |= ((uint64_t)in[6]) << 48;
+    result |= ((uint64_t)in[7]) << 56;
+    return result;
+}
+
+static void little_endian_store_8(uint8_t *out, uint64_t u)
+{
+    out[0] = (uint8_t)u; u >>= 8;
+    out[1] = (uint8_t)u; u >>= 8;
+    out[2] = (uint8_t)u; u >>= 8;
+    out[3] = (uint8_t)u; u >>= 8;
+    out[4] = (uint8_t)u; u >>= 8;
+    out[5] = (uint8_t)u; u >>= 8;
+    out[6] = (uint8_t)u; u >>= 8;
+    out[7] = (uint8_t)u;
+}
+
+/**
+ * @brief Carries the 128-bit limb products r0..r4 into h.
+ */
+static void fe_carry128(fe h,
+                        uint128_t r0,
+                        uint128_t r1,
+                        uint128_t r2,
+                        uint128_t r3,
+                        uint128_t r4)
+{
+    uint64_t h0, h1, h2, h3, h4, c;
+
+    h0 = (uint64_t)r0 & FE_MASK51; r1 += (uint64_t)(r0 >> 51);
+    h1 = (uint64_t)r1 & FE_MASK51; r2 += (uint64_t)(r1 >> 51);
+    h2 = (uint64_t)r2 & FE_MASK51; r3 += (uint64_t)(r2 >> 51);
+    h3 = (uint64_t)r3 & FE_MASK51; r4 += (uint64_t)(r3 >> 51);
+    h4 = (uint64_t)r4 & FE_MASK51;
+    h0 += 19ULL * (uint64_t)(r4 >> 51);
+    c = h0 >> 51; h0 &= FE_MASK51;
+    h1 += c;
+
+    h[0] = h0;
+    h[1] = h1;
+    h[2] = h2;
+    h[3] = h3;
+    h[4] = h4;
+}
+
+/**
+ * @brief Zeros a field element h.
+ *
+ * @param h The field element to be zero-ed
+ */
+void fe_zero(fe h)
+{
+    h[0] = 0;
+    h[1] = 0;
+    h[2] = 0;
+    h[3] = 0;
+    h[4] = 0;
+}
+
+/**
+ * @brief Set the field element h to 1.
+ *
+ * @param h The field element to be set to 1
+ */
+void fe_one(fe h)
+{
+    h[0] = 1;
+    h[1] = 0;
+    h[2] = 0;
+    h[3] = 0;
+    h[4] = 0;
+}
+
+/**
+ * @brief Copies field element v to u.
+ *
+ * @param u The destination field element
+ * @param v The source field element
+ */
+void fe_copy(fe u, const fe v)
+{
+    u[0] = v[0];
+    u[1] = v[1];
+    u[2] = v[2];
+    u[3] = v[3];
+    u[4] = v[4];
+}
+
+/**
+ * @brief Sets field element f to g if cond is non-zero.
+ *
+ * @note The field element f is unchanged if cond is zero.
+ *
+ * @param f The field element f
+ * @param g The field element g
+ * @param cond The condition
+ */
+void fe_cmov(fe f, const fe g, uint32_t cond)
+{
+    const uint64_t mask = (uint64_t)0 - (uint64_t)cond;
+
+    f[0] ^= (f[0] ^ g[0]) & mask;
+    f[1] ^= (f[1] ^ g[1]) & mask;
+    f[2] ^= (f[2] ^ g[2]) & mask;
+    f[3] ^= (f[3] ^ g[3]) & mask;
+    f[4] ^= (f[4] ^ g[4]) & mask;
+}
+
+/**
+ * @brief Add field elements f and g
+ *
+ * @note h = f + g
+ * @note It is acceptable to overlap h with f or g.
+ * @note The result is not carried, a few additions may be chained
+ * before a multiplication or squaring.
+ *
+ * @param h The output of addition
+ * @param f One of the input to addtion
+ * @param g The other input to addition
+ */
+void fe_add(fe h, const fe f, const fe g)
+{
+    h[0] = f[0] + g[0];
+    h[1] = f[1] + g[1];
+    h[2] = f[2] + g[2];
+    h[3] = f[3] + g[3];
+    h[4] = f[4] + g[4];
+}
+
+/**
+ * @brief Subtract field element g from f
+ *
+ * @note h = f - g
+ * @note It is acceptable to overlap h with f or g.
+ * @note g is carried first and 2p is added, so that no limb
+ * becomes negative.
+ *
+ * @param h The output of subtraction
+ * @param f The input to subtract from
+ * @param g The input to be subtracted
+ */
+void fe_sub(fe h, const fe f, const fe g)
+{
+    uint64_t h0, h1, h2, h3, h4;
+
+    h0 = g[0];
+    h1 = g[1];
+    h2 = g[2];
+    h3 = g[3];
+    h4 = g[4];
+
+    h1 += h0 >> 51; h0 &= FE_MASK51;
+    h2 += h1 >> 51; h1 &= FE_MASK51;
+    h3 += h2 >> 51; h2 &= FE_MASK51;
+    h4 += h3 >> 51; h3 &= FE_MASK51;
+    h0 += 19ULL * (h4 >> 51); h4 &= FE_MASK51;
+
+    h[0] = (f[0] + 0xfffffffffffdaULL) - h0;
+    h[1] = (f[1] + 0xffffffffffffeULL) - h1;
+    h[2] = (f[2] + 0xffffffffffffeULL) - h2;
+    h[3] = (f[3] + 0xffffffffffffeULL) - h3;
+    h[4] = (f[4] + 0xffffffffffffeULL) - h4;
+}
+
+/**
+ * @brief Swaps field element f and g if and only if ctrl is true.
+ *
+ * @param f An input field element
+ * @param g Another input field element
+ * @param ctrl Swap control flag
+ */
+void fe_swap(fe f, fe g, uint32_t ctrl)
+{
+    const uint64_t mask = (uint64_t)0 - (uint64_t)ctrl;
+    uint64_t w;
+
+    w = (f[0] ^ g[0]) & mask; f[0] ^= w; g[0] ^= w;
+    w = (f[1] ^ g[1]) & mask; f[1] ^= w; g[1] ^= w;
+    w = (f[2] ^ g[2]) & mask; f[2] ^= w; g[2] ^= w;
+    w = (f[3] ^ g[3]) & mask; f[3] ^= w; g[3] ^= w;
+    w = (f[4] ^ g[4]) & mask; f[4] ^= w; g[4] ^= w;
+}
+
+/**
+ * @brief Multiplies field elements f and g to produce h.
+ *
+ * @param h The product of field multiplication
+ * @param f The multiplier
+ * @param g The multiplicant
+ */
+void fe_mul(fe h, const fe f, const fe g)
+{
+    uint64_t f0, f1, f2, f3, f4;
+    uint64_t g0, g1, g2, g3, g4;
+    uint64_t f1_19, f2_19, f3_19, f4_19;
+    uint128_t r0, r1, r2, r3, r4;
+
+    f0 = f[0]; f1 = f[1]; f2 = f[2]; f3 = f[3]; f4 = f[4];
+    g0 = g[0]; g1 = g[1]; g2 = g[2]; g3 = g[3]; g4 = g[4];
+
+    f1_19 = 19ULL * f1;
+    f2_19 = 19ULL * f2;
+    f3_19 = 19ULL * f3;
+    f4_19 = 19ULL * f4;
+
+    r0 = (uint128_t)f0 * g0 + (uint128_t)f1_19 * g4 + (uint128_t)f2_19 * g3
+       + (uint128_t)f3_19 * g2 + (uint128_t)f4_19 * g1;
+    r1 = (uint128_t)f0 * g1 + (uint128_t)f1 * g0 + (uint128_t)f2_19 * g4
+       + (uint128_t)f3_19 * g3 + (uint128_t)f4_19 * g2;
+    r2 = (uint128_t)f0 * g2 + (uint128_t)f1 * g1 + (uint128_t)f2 * g0
+       + (uint128_t)f3_19 * g4 + (uint128_t)f4_19 * g3;
+    r3 = (uint128_t)f0 * g3 + (uint128_t)f1 * g2 + (uint128_t)f2 * g1
+       + (uint128_t)f3 * g0 + (uint128_t)f4_19 * g4;
+    r4 = (uint128_t)f0 * g4 + (uint128_t)f1 * g3 + (uint128_t)f2 * g2
+       + (uint128_t)f3 * g1 + (uint128_t)f4 * g0;
+
+    fe_carry128(h, r0, r1, r2, r3, r4);
+}
+
+/**
+ * @brief Multiplies field element f with 121666.
+ *
+ * @param h The product of the multiplication
+ * @param f The multiplier
+ */
+void fe_mul121666(fe h, const fe f)
+{
+    fe_carry128(h,
+                (uint128_t)f[0] * 121666U,
+                (uint128_t)f[1] * 121666U,
+                (uint128_t)f[2] * 121666U,
+                (uint128_t)f[3] * 121666U,
+                (uint128_t)f[4] * 121666U);
+}
+
+/**
+ * @brief Computes the unreduced limbs of f^2.
+ */
+static void fe_sqr128(uint128_t *r, const fe f)
+{
+    uint64_t f0, f1, f2, f3, f4;
+    uint64_t f0_2, f1_2, f1_38, f2_38, f3_38, f3_19, f4_19;
+
+    f0 = f[0]; f1 = f[1]; f2 = f[2]; f3 = f[3]; f4 = f[4];
+
+    f0_2 = f0 << 1;
+    f1_2 = f1 << 1;
+    f1_38 = 38ULL * f1;
+    f2_38 = 38ULL * f2;
+    f3_38 = 38ULL * f3;
+    f3_19 = 19ULL * f3;
+    f4_19 = 19ULL * f4;
+
+    r[0] = (uint128_t)f0 * f0 + (uint128_t)f1_38 * f4 + (uint128_t)f2_38 * f3;
+    r[1] = (uint128_t)f0_2 * f1 + (uint128_t)f2_38 * f4 + (uint128_t)f3_19 * f3;
+    r[2] = (uint128_t)f0_2 * f2 + (uint128_t)f1 * f1 + (uint128_t)f3_38 * f4;
+    r[3] = (uint128_t)f0_2 * f3 + (uint128_t)f1_2 * f2 + (uint128_t)f4_19 * f4;
+    r[4] = (uint128_t)f0_2 * f4 + (uint128_t)f1_2 * f3 + (uint128_t)f2 * f2;
+}
+
+/**
+ * @brief Returns the squared value of field element f.
+ *
+ * @param h The squared output
+ * @param f The input field element
+ */
+void fe_sqr(fe h, const fe f)
+{
+    uint128_t r[5];
+
+    fe_sqr128(r, f);
+    fe_carry128(h, r[0], r[1], r[2], r[3], r[4]);
+}
+
+/**
+ * @brief Returns the value of 2 * fe_sqr(f).
+ *
+ * @param h The resulting output
+ * @param f The input field element
+ */
+void fe_2sqr(fe h, const fe f)
+{
+    uint128_t r[5];
+
+    fe_sqr128(r, f);
+    fe_carry128(h, r[0] << 1, r[1] << 1, r[2] << 1, r[3] << 1, r[4] << 1);
+}
+
+/**
+ * @brief Negate a field element v.
+ *
+ * @param u The negated field element
+ * @param v The input field element
+ */
+void fe_neg(fe u, const fe v)
+{
+    fe zero;
+
+    fe_zero(zero);
+    fe_sub(u, zero, v);
+}
+
+/**
+ * @brief Loads a field element from a byte-array.
+ *
+ * @note The most significant bit of the byte-array is ignored.
+ *
+ * @param h The field element loaded
+ * @param s The input byte-array
+ */
+void fe_frombytes(fe h, const uint8_t *s)
+{
+    h[0] =  little_endian_load_8(s)              & FE_MASK51;
+    h[1] = (little_endian_load_8(s +  6) >>  3)  & FE_MASK51;
+    h[2] = (little_endian_load_8(s + 12) >>  6)  & FE_MASK51;
+    h[3] = (little_endian_load_8(s + 19) >>  1)  & FE_MASK51;
+    h[4] = (little_endian_load_8(s + 24) >> 12)  & FE_MASK51;
+}
+
+/**
+ * @brief Stores a field element h to a byte-array.
+ *
+ * @note The output is fully reduced modulo 2^255 - 19.
+ *
+ * @param s The output byte-array
+ * @param h The input field element
+ */
+void fe_tobytes(uint8_t *s, const fe h)
+{
+    uint64_t t0, t1, t2, t3, t4;
+
+    t0 = h[0]; t1 = h[1]; t2 = h[2]; t3 = h[3]; t4 = h[4];
+
+    /* Carry twice, t is then below 2^255 + 19 */
+    t1 += t0 >> 51; t0 &= FE_MASK51;
+    t2 += t1 >> 51; t1 &= FE_MASK51;
+    t3 += t2 >> 51; t2 &= FE_MASK51;
+    t4 += t3 >> 51; t3 &= FE_MASK51;
+    t0 += 19ULL * (t4 >> 51); t4 &= FE_MASK51;
+
+    t1 += t0 >> 51; t0 &= FE_MASK51;
+    t2 += t1 >> 51; t1 &= FE_MASK51;
+    t3 += t2 >> 51; t2 &= FE_MASK51;
+    t4 += t3 >> 51; t3 &= FE_MASK51;
+    t0 += 19ULL * (t4 >> 51); t4 &= FE_MASK51;
+
+    /* t + 19 overflows 2^255 if and only if t >= p */
+    t0 += 19ULL;
+    t1 += t0 >> 51; t0 &= FE_MASK51;
+    t2 += t1 >> 51; t1 &= FE_MASK51;
+    t3 += t2 >> 51; t2 &= FE_MASK51;
+    t4 += t3 >> 51; t3 &= FE_MASK51;
+    t0 += 19ULL * (t4 >> 51); t4 &= FE_MASK51;
+
+    /* Subtract the 19 again, adding 2^255 to avoid borrows */
+    t0 += 0x8000000000000ULL - 19ULL;
+    t1 += 0x8000000000000ULL - 1ULL;
+    t2 += 0x8000000000000ULL - 1ULL;
+    t3 += 0x8000000000000ULL - 1ULL;
+    t4 += 0x8000000000000ULL - 1ULL;
+
+    t1 += t0 >> 51; t0 &= FE_MASK51;
+    t2 += t1 >> 51; t1 &= FE_MASK51;
+    t3 += t2 >> 51; t2 &= FE_MASK51;
+    t4 += t3 >> 51; t3 &= FE_MASK51;
+    t4 &= FE_MASK51;
+
+    little_endian_store_8(s,      t0        | (t1 << 51));
+    little_endian_store_8(s +  8, (t1 >> 13) | (t2 << 38));
+    little_endian_store_8(s + 16, (t2 >> 26) | (t3 << 25));
+    little_endian_store_8(s + 24, (t3 >> 39) | (t4 << 12));
+}
+
+#endif /* FE_51 */
@@ -0,0 +1,284 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+/**
+ * Fingerprint scanners for the | f_i | c_i | table of a BDAP header.
+ *
+ * A fingerprint is compared as the low 56 bits of a little-endian
+ * 64-bit load from the start of its slot. The SSE2 scanner packs two
+ * slots per register, the AVX2 scanner gathers four slots per register
+ * at the slot stride, and both compare eight slots per iteration.
+ */
+
+#include "fingerprint.h"
+#include "curve25519_avx2.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+# define FINGERPRINT_SIMD_SUPPORTED
+#endif
+
+#if defined(FINGERPRINT_SIMD_SUPPORTED)
+# if defined(_MSC_VER)
+#  include <intrin.h>
+#  define SSE2_TARGET
+#  define AVX2_TARGET
+# else
+#  define SSE2_TARGET __attribute__((target("sse2")))
+#  define AVX2_TARGET __attribute__((target("avx2")))
+# endif
+# include <immintrin.h>
+#endif
+
+#define FINGERPRINT_MASK    0x00FFFFFFFFFFFFFFULL
+
+static volatile bool hardware_enabled = true;
+
+/**
+ * @brief The state of a constant-time scan: the index of the first
+ * match, and an all-ones mask while there has been none.
+ */
+typedef struct
+{
+    uint64_t index;
+    uint64_t unmatched;
+} fingerprint_match;
+
+static uint64_t little_endian_load_7(const uint8_t *in)
+{
+    uint64_t result;
+    result  =  (uint64_t)in[0];
+    result |= ((uint64_t)in[1]) <<  8;
+    result |= ((uint64_t)in[2]) << 16;
+    result |= ((uint64_t)in[3]) << 24;
+    result |= ((uint64_t)in[4]) << 32;
+    result |= ((uint64_t)in[5]) << 40;
+    result |= ((uint64_t)in[6]) << 48;
+    return result;
+}
+
+/**
+ * @brief Records slot {@code index} as the first match if
+ * {@code match} is all-ones and no slot matched before.
+ */
+static void fingerprint_match_update(fingerprint_match *m,
+                                     uint64_t index,
+                                     uint64_t match)
+{
+    match &= m->unmatched;
+    m->index |= index & match;
+    m->unmatched &= ~match;
+}
+
+/**
+ * @brief Scans the slots [begin, end) one at a time.
+ *
+ * @return the index of the first match in non-constant time,
+ * {@code end} otherwise
+ */
+static size_t fingerprint_scan_portable(const uint8_t *slots,
+                                        size_t begin,
+                                        size_t end,
+                                        size_t stride,
+                                        uint64_t target,
+                                        bool constant_time,
+                                        fingerprint_match *m)
+{
+    uint64_t diff;
+    size_t i;
+
+    for (i = begin; i < end; ++i)
+    {
+        diff = little_endian_load_7(slots + i * stride) ^ target;
+        if (constant_time)
+        {
+            /* All-ones iff diff is zero */
+            fingerprint_match_update(m, i, ((diff | (0 - diff)) >> 63) - 1);
+        }
+        else if (diff == 0)
+        {
+            return i;
+        }
+    }
+
+    return end;
+}
+
+#if defined(FINGERPRINT_SIMD_SUPPORTED)
+
+/**
+ * @brief Returns the index of the lowest set bit of an 8-bit lane
+ * mask, 8 if it is zero, without branches.
+ */
+static uint32_t fingerprint_lowest_lane(uint32_t lanes)
+{
+    /* Count the bits below the lowest set bit */
+    uint32_t v = ((lanes & (0 - lanes)) - 1) & 0xFF;
+
+    v = v - ((v >> 1) & 0x55);
+    v = (v & 0x33) + ((v >> 2) & 0x33);
+    return (v + (v >> 4)) & 0x0F;
+}
+
+/**
+ * @brief Finds the matching slots among the 8 slots whose per-byte
+ * equality masks are given, two slots per 16-bit group.
+ *
+ * @return the bit mask of the matching slots
+ */
+static uint32_t fingerprint_lanes_sse2(uint32_t eq_lo, uint32_t eq_hi)
+{
+    uint32_t lanes = 0, i;
+    uint64_t eq = eq_lo | ((uint64_t)eq_hi << 32);
+
+    for (i = 0; i < 8; ++i)
+    {
+        lanes |= (uint32_t)(((eq >> (8 * i)) & 0xFF) == 0xFF) << i;
+    }
+
+    return lanes;
+}
+
+SSE2_TARGET
+static size_t fingerprint_scan_sse2(const uint8_t *slots,
+                                    size_t num_slots,
+                                    size_t stride,
+                                    uint64_t target,
+                                    bool constant_time,
+                                    fingerprint_match *m)
+{
+    const __m128i mask = _mm_set1_epi64x((long long)FINGERPRINT_MASK);
+    const __m128i t = _mm_set1_epi64x((long long)target);
+    __m128i v[4];
+    uint32_t lanes, eq_lo, eq_hi, j;
+    const uint8_t *p;
+    size_t i;
+
+    for (i = 0; i + 8 <= num_slots; i += 8)
+    {
+        p = slots + i * stride;
+        for (j = 0; j < 4; ++j)
+        {
+            v[j] = _mm_unpacklo_epi64(
+                _mm_loadl_epi64((const __m128i *)(p + (2 * j) * stride)),
+                _mm_loadl_epi64((const __m128i *)(p + (2 * j + 1) * stride)));
+            v[j] = _mm_cmpeq_epi8(_mm_and_si128(v[j], mask), t);
+        }
+        eq_lo = (uint32_t)_mm_movemask_epi8(v[0])
+              | ((uint32_t)_mm_movemask_epi8(v[1]) << 16);
+        eq_hi = (uint32_t)_mm_movemask_epi8(v[2])
+              | ((uint32_t)_mm_movemask_epi8(v[3]) << 16);
+        lanes = fingerprint_lanes_sse2(eq_lo, eq_hi);
+
+        if (constant_time)
+        {
+            fingerprint_match_update(m, i + fingerprint_lowest_lane(lanes),
+                                     0 - (uint64_t)(lanes != 0));
+        }
+        else if (lanes != 0)
+        {
+            return i + fingerprint_lowest_lane(lanes);
+        }
+    }
+
+    return fingerprint_scan_portable(slots, i, num_slots, stride,
+                                     target, constant_time, m);
+}
+
+AVX2_TARGET
+static size_t fingerprint_scan_avx2(const uint8_t *slots,
+                                    size_t num_slots,
+                                    size_t stride,
+                                    uint64_t target,
+                                    bool constant_time,
+                                    fingerprint_match *m)
+{
+    const __m256i mask = _mm256_set1_epi64x((long long)FINGERPRINT_MASK);
+    const __m256i t = _mm256_set1_epi64x((long long)target);
+    const __m256i offsets = _mm256_set_epi64x((long long)(3 * stride),
+                                              (long long)(2 * stride),
+                                              (long long)stride,
+                                              0);
+    __m256i v0, v1;
+    uint32_t lanes;
+    const uint8_t *p;
+    size_t i;
+
+    for (i = 0; i + 8 <= num_slots; i += 8)
+    {
+        p = slots + i * stride;
+        v0 = _mm256_i64gather_epi64((const long long *)p, offsets, 1);
+        v1 = _mm256_i64gather_epi64((const long long *)(p + 4 * stride),
+                                    offsets, 1);
+        v0 = _mm256_cmpeq_epi64(_mm256_and_si256(v0, mask), t);
+        v1 = _mm256_cmpeq_epi64(_mm256_and_si256(v1, mask), t);
+        lanes = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(v0))
+              | ((uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(v1)) << 4);
+
+        if (constant_time)
+        {
+            fingerprint_match_update(m, i + fingerprint_lowest_lane(lanes),
+                                     0 - (uint64_t)(lanes != 0));
+        }
+        else if (lanes != 0)
+        {
+            return i + fingerprint_lowest_lane(lanes);
+        }
+    }
+
+    return fingerprint_scan_portable(slots, i, num_slots, stride,
+                                     target, constant_time, m);
+}
+
+#endif
+
+bool fingerprint_use_hardware(bool enable)
+{
+    hardware_enabled = enable;
+    return fingerprint_hardware_enabled();
+}
+
+bool fingerprint_hardware_enabled(void)
+{
+#if defined(FINGERPRINT_SIMD_SUPPORTED)
+    return hardware_enabled;
+#else
+    return false;
+#endif
+}
+
+size_t fingerprint_find(const uint8_t *slots,
+                        size_t num_slots,
+                        size_t stride,
+                        const uint8_t *fingerprint,
+                        bool constant_time)
+{
+    uint64_t target = little_endian_load_7(fingerprint);
+    fingerprint_match m = { 0, ~(uint64_t)0 };
+    size_t found;
+
+#if defined(FINGERPRINT_SIMD_SUPPORTED)
+    if (fingerprint_hardware_enabled() && curve25519_avx2_available())
+    {
+        found = fingerprint_scan_avx2(slots, num_slots, stride,
+                                      target, constant_time, &m);
+    }
+    else if (fingerprint_hardware_enabled())
+    {
+        found = fingerprint_scan_sse2(slots, num_slots, stride,
+                                      target, constant_time, &m);
+    }
+    else
+#endif
+    {
+        found = fingerprint_scan_portable(slots, 0, num_slots, stride,
+                                          target, constant_time, &m);
+    }
+
+    if (constant_time)
+    {
+        found = (size_t)((m.index & ~m.unmatched)
+                       | ((uint64_t)num_slots & m.unmatched));
+    }
+
+    return found;
+}
@@ -2,7 +2,11 @@
 // See LICENSE.md file for license, copying and use information.
 
 #include "ge.h"
+#ifdef FE_51
+#include "fe_51.h"
+#else
 #include "fe_25_5.h"
+#endif
 
 typedef struct
 {
@@ -12,6 +16,22 @@ typedef struct
     fe t2d;
 } ge_cached;
 
+#ifdef FE_51
+static fe d = {
+    0x34dca135978a3ULL, 0x1a8283b156ebdULL, 0x5e7a26001c029ULL,
+    0x739c663a03cbbULL, 0x52036cee2b6ffULL
+};
+
+static fe d2 = {
+    0x69b9426b2f159ULL, 0x35050762add7aULL, 0x3cf44c0038052ULL,
+    0x6738cc7407977ULL, 0x2406d9dc56dffULL
+};
+
+static fe sqrt_m_1 = {
+    0x61b274a0ea0b0ULL, 0x0d5a5fc8f189dULL, 0x7ef5e9cbd0c60ULL,
+    0x78595a6804c9eULL, 0x2b8324804fc1dULL
+};
+#else
 static fe d = {
     -10913610,  13857413, -15372611,   6949391,    114729,
      -8787816,  -6275908,  -3247719, -18696448, -12055116
@@ -26,6 +46,7 @@ static fe sqrt_m_1 = {
     -32595792,  -7943725,   9377950,   3500415,  12389472,
       -272473, -25146209,  -2005654,    326686,  11406482
 };
+#endif
 
 static uint8_t negative(char b)
 {
@@ -3,12 +3,13 @@
 
 #include "rand.h"
 #include "os_rand.h"
+#include "drbg_rand.h"
 #include "shake256_rand.h"
 
 void (*bdap_randominit) 
-    (const uint8_t* seed, size_t seed_size) = os_randominit;
+    (const uint8_t* seed, size_t seed_size) = drbg_randominit;
 void (*bdap_randombytes)
-    (uint8_t *buf, size_t buf_size) = os_randombytes;
+    (uint8_t *buf, size_t buf_size) = drbg_randombytes;
 
 void use_shake256_rand()
 {
@@ -20,4 +21,22 @@ void use_os_rand()
 {
     bdap_randominit = os_randominit;
     bdap_randombytes = os_randombytes;
-}
\ No newline at end of file
+}
+
+void use_drbg_rand()
+{
+    bdap_randominit = drbg_randominit;
+    bdap_randombytes = drbg_randombytes;
+}
+
+void bdap_rng_randombytes(const bdap_rng *rng, uint8_t *buf, size_t buf_size)
+{
+    if (rng == NULL)
+    {
+        bdap_randombytes(buf, buf_size);
+    }
+    else
+    {
+        rng->randombytes(rng->ctx, buf, buf_size);
+    }
+}
@@ -1,36 +1,25 @@
 // Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
 // See LICENSE.md file for license, copying and use information.
 
-/** libkeccak-tiny
+/** SHAKE256 on top of Keccak-f[1600].
  *
- * A single-file implementation of SHA-3 and SHAKE.
- *
- * Implementor: David Leon Gil
- * License: CC0, attribution kindly requested. Blame taken too,
- * but not liability.
- * 
- * Reference: https://github.com/coruus/keccak-tiny
+ * The sponge follows libkeccak-tiny by David Leon Gil (CC0,
+ * https://github.com/coruus/keccak-tiny). The permutation is the
+ * fully unrolled, lane-complemented 64-bit one of the Keccak team's
+ * optimised implementation (CC0, https://github.com/XKCP/XKCP).
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include "shake256.h"
+#include "utils.h"
+
+#define RATE_LANES          (SHAKE256_RATE / 8)
 
 /******** The Keccak-f[1600] permutation ********/
 
 /*** Constants. ***/
-static const uint8_t rho[24] = \
-{    1,  3,   6, 10, 15, 21,
-    28, 36, 45, 55,  2, 14,
-    27, 41, 56,  8, 25, 43,
-    62, 18, 39, 61, 20, 44
-};
-static const uint8_t pi[24] = \
-{   10,  7, 11, 17, 18, 3,
-     5, 16,  8, 21, 24, 4,
-    15, 23, 19, 13, 12, 2,
-    20, 14, 22,  9, 6,  1
-};
 static const uint64_t RC[24] = \
 {   1ULL, 0x8082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
     0x808bULL, 0x80000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
@@ -40,116 +29,328 @@ static const uint64_t RC[24] = \
     0x8000000080008081ULL, 0x8000000000008080ULL, 0x80000001ULL, 0x8000000080008008ULL
 };
 
-/*** Helper macros to unroll the permutation. ***/
-#define rol(x, s) (((x) << s) | ((x) >> (64 - s)))
-#define REPEAT6(e) e e e e e e
-#define REPEAT24(e) REPEAT6(e e e e)
-#define REPEAT5(e) e e e e e
-#define FOR5(v, s, e) \
-    v = 0;            \
-    REPEAT5(e; v += s;)
-
-/*** Keccak-f[1600] ***/
-static inline void keccakf(void* state)
+/* The lanes kept complemented in the state, i.e. lanes 1, 2, 8,
+ * 12, 17 and 20. Chi then costs one NOT per row instead of five. */
+static const uint64_t complemented[25] = \
+{   0, ~0ULL, ~0ULL, 0, 0,
+    0, 0, 0, ~0ULL, 0,
+    0, 0, ~0ULL, 0, 0,
+    0, 0, ~0ULL, 0, 0,
+    ~0ULL, 0, 0, 0, 0
+};
+
+#define rol(x, s) (((x) << (s)) | ((x) >> (64 - (s))))
+
+/*** One round from the lanes A to the lanes E, which also computes
+ *** the column parities of E for the theta step of the next round.
+ *** Rows are named b, g, k, m and s, columns a, e, i, o and u. ***/
+#define ROUND(i, A, E)                                              \
+    Da = Cu ^ rol(Ce, 1);                                           \
+    De = Ca ^ rol(Ci, 1);                                           \
+    Di = Ce ^ rol(Co, 1);                                           \
+    Do = Ci ^ rol(Cu, 1);                                           \
+    Du = Co ^ rol(Ca, 1);                                           \
+                                                                    \
+    A##ba ^= Da; Bba = A##ba;                                       \
+    A##ge ^= De; Bbe = rol(A##ge, 44);                              \
+    A##ki ^= Di; Bbi = rol(A##ki, 43);                              \
+    A##mo ^= Do; Bbo = rol(A##mo, 21);                              \
+    A##su ^= Du; Bbu = rol(A##su, 14);                              \
+    E##ba =   Bba  ^ (  Bbe  |   Bbi ); E##ba ^= RC[i]; Ca = E##ba; \
+    E##be =   Bbe  ^ ((~Bbi) |   Bbo ); Ce = E##be;                 \
+    E##bi =   Bbi  ^ (  Bbo  &   Bbu ); Ci = E##bi;                 \
+    E##bo =   Bbo  ^ (  Bbu  |   Bba ); Co = E##bo;                 \
+    E##bu =   Bbu  ^ (  Bba  &   Bbe ); Cu = E##bu;                 \
+                                                                    \
+    A##bo ^= Do; Bga = rol(A##bo, 28);                              \
+    A##gu ^= Du; Bge = rol(A##gu, 20);                              \
+    A##ka ^= Da; Bgi = rol(A##ka, 3);                               \
+    A##me ^= De; Bgo = rol(A##me, 45);                              \
+    A##si ^= Di; Bgu = rol(A##si, 61);                              \
+    E##ga =   Bga  ^ (  Bge  |   Bgi ); Ca ^= E##ga;                \
+    E##ge =   Bge  ^ (  Bgi  &   Bgo ); Ce ^= E##ge;                \
+    E##gi =   Bgi  ^ (  Bgo  | (~Bgu)); Ci ^= E##gi;                \
+    E##go =   Bgo  ^ (  Bgu  |   Bga ); Co ^= E##go;                \
+    E##gu =   Bgu  ^ (  Bga  &   Bge ); Cu ^= E##gu;                \
+                                                                    \
+    A##be ^= De; Bka = rol(A##be, 1);                               \
+    A##gi ^= Di; Bke = rol(A##gi, 6);                               \
+    A##ko ^= Do; Bki = rol(A##ko, 25);                              \
+    A##mu ^= Du; Bko = rol(A##mu, 8);                               \
+    A##sa ^= Da; Bku = rol(A##sa, 18);                              \
+    E##ka =   Bka  ^ (  Bke  |   Bki ); Ca ^= E##ka;                \
+    E##ke =   Bke  ^ (  Bki  &   Bko ); Ce ^= E##ke;                \
+    E##ki =   Bki  ^ ((~Bko) &   Bku ); Ci ^= E##ki;                \
+    E##ko = (~Bko) ^ (  Bku  |   Bka ); Co ^= E##ko;                \
+    E##ku =   Bku  ^ (  Bka  &   Bke ); Cu ^= E##ku;                \
+                                                                    \
+    A##bu ^= Du; Bma = rol(A##bu, 27);                              \
+    A##ga ^= Da; Bme = rol(A##ga, 36);                              \
+    A##ke ^= De; Bmi = rol(A##ke, 10);                              \
+    A##mi ^= Di; Bmo = rol(A##mi, 15);                              \
+    A##so ^= Do; Bmu = rol(A##so, 56);                              \
+    E##ma =   Bma  ^ (  Bme  &   Bmi ); Ca ^= E##ma;                \
+    E##me =   Bme  ^ (  Bmi  |   Bmo ); Ce ^= E##me;                \
+    E##mi =   Bmi  ^ ((~Bmo) |   Bmu ); Ci ^= E##mi;                \
+    E##mo = (~Bmo) ^ (  Bmu  &   Bma ); Co ^= E##mo;                \
+    E##mu =   Bmu  ^ (  Bma  |   Bme ); Cu ^= E##mu;                \
+                                                                    \
+    A##bi ^= Di; Bsa = rol(A##bi, 62);                              \
+    A##go ^= Do; Bse = rol(A##go, 55);                              \
+    A##ku ^= Du; Bsi = rol(A##ku, 39);                              \
+    A##ma ^= Da; Bso = rol(A##ma, 41);                              \
+    A##se ^= De; Bsu = rol(A##se, 2);                               \
+    E##sa =   Bsa  ^ ((~Bse) &   Bsi ); Ca ^= E##sa;                \
+    E##se = (~Bse) ^ (  Bsi  |   Bso ); Ce ^= E##se;                \
+    E##si =   Bsi  ^ (  Bso  &   Bsu ); Ci ^= E##si;                \
+    E##so =   Bso  ^ (  Bsu  |   Bsa ); Co ^= E##so;                \
+    E##su =   Bsu  ^ (  Bsa  &   Bse ); Cu ^= E##su;
+
+/*** Keccak-f[1600], on lanes 1, 2, 8, 12, 17 and 20 complemented ***/
+static void keccakf(uint64_t* s)
+{
+    uint64_t Aba, Abe, Abi, Abo, Abu, Aga, Age, Agi, Ago, Agu;
+    uint64_t Aka, Ake, Aki, Ako, Aku, Ama, Ame, Ami, Amo, Amu;
+    uint64_t Asa, Ase, Asi, Aso, Asu;
+    uint64_t Eba, Ebe, Ebi, Ebo, Ebu, Ega, Ege, Egi, Ego, Egu;
+    uint64_t Eka, Eke, Eki, Eko, Eku, Ema, Eme, Emi, Emo, Emu;
+    uint64_t Esa, Ese, Esi, Eso, Esu;
+    uint64_t Bba, Bbe, Bbi, Bbo, Bbu, Bga, Bge, Bgi, Bgo, Bgu;
+    uint64_t Bka, Bke, Bki, Bko, Bku, Bma, Bme, Bmi, Bmo, Bmu;
+    uint64_t Bsa, Bse, Bsi, Bso, Bsu;
+    uint64_t Ca, Ce, Ci, Co, Cu, Da, De, Di, Do, Du;
+
+    Aba = s[ 0]; Abe = s[ 1]; Abi = s[ 2]; Abo = s[ 3]; Abu = s[ 4];
+    Aga = s[ 5]; Age = s[ 6]; Agi = s[ 7]; Ago = s[ 8]; Agu = s[ 9];
+    Aka = s[10]; Ake = s[11]; Aki = s[12]; Ako = s[13]; Aku = s[14];
+    Ama = s[15]; Ame = s[16]; Ami = s[17]; Amo = s[18]; Amu = s[19];
+    Asa = s[20]; Ase = s[21]; Asi = s[22]; Aso = s[23]; Asu = s[24];
+
+    Ca = Aba ^ Aga ^ Aka ^ Ama ^ Asa;
+    Ce = Abe ^ Age ^ Ake ^ Ame ^ Ase;
+    Ci = Abi ^ Agi ^ Aki ^ Ami ^ Asi;
+    Co = Abo ^ Ago ^ Ako ^ Amo ^ Aso;
+    Cu = Abu ^ Agu ^ Aku ^ Amu ^ Asu;
+
+    ROUND( 0, A, E) ROUND( 1, E, A) ROUND( 2, A, E) ROUND( 3, E, A)
+    ROUND( 4, A, E) ROUND( 5, E, A) ROUND( 6, A, E) ROUND( 7, E, A)
+    ROUND( 8, A, E) ROUND( 9, E, A) ROUND(10, A, E) ROUND(11, E, A)
+    ROUND(12, A, E) ROUND(13, E, A) ROUND(14, A, E) ROUND(15, E, A)
+    ROUND(16, A, E) ROUND(17, E, A) ROUND(18, A, E) ROUND(19, E, A)
+    ROUND(20, A, E) ROUND(21, E, A) ROUND(22, A, E) ROUND(23, E, A)
+
+    s[ 0] = Aba; s[ 1] = Abe; s[ 2] = Abi; s[ 3] = Abo; s[ 4] = Abu;
+    s[ 5] = Aga; s[ 6] = Age; s[ 7] = Agi; s[ 8] = Ago; s[ 9] = Agu;
+    s[10] = Aka; s[11] = Ake; s[12] = Aki; s[13] = Ako; s[14] = Aku;
+    s[15] = Ama; s[16] = Ame; s[17] = Ami; s[18] = Amo; s[19] = Amu;
+    s[20] = Asa; s[21] = Ase; s[22] = Asi; s[23] = Aso; s[24] = Asu;
+}
+
+/******** The sponge ********/
+
+static inline uint64_t load64_le(const uint8_t* p)
+{
+    return  (uint64_t)p[0]        | ((uint64_t)p[1] <<  8) |
+           ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+           ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline void store64_le(uint8_t* p, const uint64_t v)
+{
+    p[0] = (uint8_t)(v      ); p[1] = (uint8_t)(v >>  8);
+    p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+    p[4] = (uint8_t)(v >> 32); p[5] = (uint8_t)(v >> 40);
+    p[6] = (uint8_t)(v >> 48); p[7] = (uint8_t)(v >> 56);
+}
+
+/* XORs bytes into the state from byte {@code offset} of the block,
+ * a lane at a time where the lanes are whole */
+static void xorin(uint64_t* lanes,
+                  size_t offset,
+                  const uint8_t* in,
+                  size_t len)
+{
+    for (; len > 0 && (offset & 7) != 0; --len, ++offset)
+    {
+        lanes[offset >> 3] ^= (uint64_t)*in++ << (8 * (offset & 7));
+    }
+    for (; len >= 8; len -= 8, offset += 8, in += 8)
+    {
+        lanes[offset >> 3] ^= load64_le(in);
+    }
+    for (; len > 0; --len, ++offset)
+    {
+        lanes[offset >> 3] ^= (uint64_t)*in++ << (8 * (offset & 7));
+    }
+}
+
+/* Copies bytes out of the state from byte {@code offset} of the
+ * block, a lane at a time where the lanes are whole */
+static void setout(const uint64_t* lanes,
+                   size_t offset,
+                   uint8_t* out,
+                   size_t len)
+{
+    for (; len > 0 && (offset & 7) != 0; --len, ++offset)
+    {
+        *out++ = (uint8_t)((lanes[offset >> 3] ^ complemented[offset >> 3])
+                           >> (8 * (offset & 7)));
+    }
+    for (; len >= 8; len -= 8, offset += 8, out += 8)
+    {
+        store64_le(out, lanes[offset >> 3] ^ complemented[offset >> 3]);
+    }
+    for (; len > 0; --len, ++offset)
+    {
+        *out++ = (uint8_t)((lanes[offset >> 3] ^ complemented[offset >> 3])
+                           >> (8 * (offset & 7)));
+    }
+}
+
+void shake256_init(shake256_ctx* ctx)
 {
-    uint64_t* a = (uint64_t*)state;
-    uint64_t b[5] = {0};
-    uint64_t t = 0;
-    uint8_t x, y, i = 0;
-
-    REPEAT24(
-        /* Theta */
-        FOR5(x, 1,
-             b[x] = 0;
-             FOR5(y, 5,
-                  b[x] ^= a[x + y]; ))
-        FOR5(x, 1,
-             FOR5(y, 5,
-                  a[y + x] ^= b[(x + 4) % 5] ^ rol(b[(x + 1) % 5], 1); ))
-        /* Rho and pi */
-        t = a[1];
-        x = 0;
-        REPEAT24(b[0] = a[pi[x]];
-                 a[pi[x]] = rol(t, rho[x]);
-                 t = b[0];
-                 x++;)
-        /* Chi */
-        FOR5(y,
-             5,
-             FOR5(x, 1,
-                  b[x] = a[y + x];)
-             FOR5(x, 1,
-                  a[y + x] = b[x] ^ ((~b[(x + 1) % 5]) & b[(x + 2) % 5]); ))
-        /* Iota */
-        a[0] ^= RC[i];
-        i++; )
+    memcpy(ctx->lanes, complemented, sizeof(ctx->lanes));
+    ctx->offset = 0;
+    ctx->squeezing = false;
 }
 
-/******** The FIPS202-defined functions. ********/
-
-/*** Some helper macros. ***/
-
-#define _(S) do { S } while (0)
-#define FOR(i, ST, L, S) \
-    _(for (size_t i = 0; i < L; i += ST) { S; }) 
-#define mkapply_ds(NAME, S)                          \
-    static inline void NAME(uint8_t* dst,            \
-                            const uint8_t* src,      \
-                            size_t len) {            \
-    FOR(i, 1, len, S);                               \
-  }
-#define mkapply_sd(NAME, S)                          \
-    static inline void NAME(const uint8_t* src,      \
-                            uint8_t* dst,            \
-                            size_t len) {            \
-    FOR(i, 1, len, S);                               \
-  }
-
-mkapply_ds(xorin, dst[i] ^= src[i])  /* xorin */
-mkapply_sd(setout, dst[i] = src[i])  /* setout */
-
-#define P keccakf
-#define Plen 200
-
-/* Fold P*F over the full blocks of an input. */
-#define foldP(I, L, F)    \
-    while (L >= rate) {   \
-        F(a, I, rate);    \
-        P(a);             \
-        I += rate;        \
-        L -= rate;        \
+int32_t shake256_absorb(shake256_ctx* ctx,
+                        const uint8_t* in,
+                        size_t in_len)
+{
+    size_t i, size;
+
+    if (ctx->squeezing || ((in == NULL) && in_len != 0))
+    {
+        return -1;
+    }
+
+    /* Complete the current block */
+    if (ctx->offset > 0)
+    {
+        size = SHAKE256_RATE - ctx->offset;
+        if (size > in_len)
+        {
+            size = in_len;
+        }
+        xorin(ctx->lanes, ctx->offset, in, size);
+        ctx->offset += size;
+        in += size;
+        in_len -= size;
+        if (ctx->offset < SHAKE256_RATE)
+        {
+            return 0;
+        }
+        keccakf(ctx->lanes);
+        ctx->offset = 0;
+    }
+
+    /* Absorb the full blocks a lane at a time */
+    while (in_len >= SHAKE256_RATE)
+    {
+        for (i = 0; i < RATE_LANES; ++i)
+        {
+            ctx->lanes[i] ^= load64_le(in + 8 * i);
+        }
+        keccakf(ctx->lanes);
+        in += SHAKE256_RATE;
+        in_len -= SHAKE256_RATE;
     }
 
-/** The sponge-based hash construction. **/
-static inline int32_t hash(uint8_t* out, size_t outlen,
-                           const uint8_t* in, size_t inlen,
-                           size_t rate, uint8_t delim)
+    xorin(ctx->lanes, 0, in, in_len);
+    ctx->offset = in_len;
+
+    return 0;
+}
+
+int32_t shake256_finalize(shake256_ctx* ctx)
+{
+    if (ctx->squeezing)
+    {
+        return -1;
+    }
+
+    /* Xor in the DS and pad frame, and apply P */
+    ctx->lanes[ctx->offset >> 3] ^= 0x1fULL << (8 * (ctx->offset & 7));
+    ctx->lanes[RATE_LANES - 1] ^= 0x80ULL << 56;
+    keccakf(ctx->lanes);
+    ctx->offset = 0;
+    ctx->squeezing = true;
+
+    return 0;
+}
+
+int32_t shake256_squeeze(shake256_ctx* ctx,
+                         uint8_t* out,
+                         size_t out_len)
 {
-    uint8_t a[Plen] = {0};
-    if ((out == NULL) || ((in == NULL) && inlen != 0) || (rate >= Plen))
+    size_t i, size;
+
+    if (!ctx->squeezing || ((out == NULL) && out_len != 0))
     {
         return -1;
     }
-    /* Absorb input. */
-    foldP(in, inlen, xorin);
-    /* Xor in the DS and pad frame. */
-    a[inlen] ^= delim;
-    a[rate - 1] ^= 0x80;
-    /* Xor in the last block. */
-    xorin(a, in, inlen);
-    /* Apply P */
-    P(a);
-    /* Squeeze output. */
-    foldP(out, outlen, setout);
-    setout(a, out, outlen);
-    memset(a, 0, 200);
+
+    while (out_len > 0)
+    {
+        if (ctx->offset == SHAKE256_RATE)
+        {
+            keccakf(ctx->lanes);
+            ctx->offset = 0;
+        }
+
+        /* Squeeze the full blocks a lane at a time */
+        if (ctx->offset == 0 && out_len >= SHAKE256_RATE)
+        {
+            for (i = 0; i < RATE_LANES; ++i)
+            {
+                store64_le(out + 8 * i, ctx->lanes[i] ^ complemented[i]);
+            }
+            size = SHAKE256_RATE;
+        }
+        else
+        {
+            size = SHAKE256_RATE - ctx->offset;
+            if (size > out_len)
+            {
+                size = out_len;
+            }
+            setout(ctx->lanes, ctx->offset, out, size);
+        }
+        ctx->offset += size;
+        out += size;
+        out_len -= size;
+    }
+
     return 0;
 }
 
+void shake256_wipe(shake256_ctx* ctx)
+{
+    crypto_memzero_aligned(ctx, sizeof(shake256_ctx));
+}
+
 int32_t shake256(uint8_t* out,
                  size_t out_len,
                  const uint8_t *in,
                  size_t in_len)
 {
-    return hash(out, out_len, in, in_len, 136, 0x1f);
+    int32_t result = -1;
+    shake256_ctx ctx;
+
+    if (out == NULL)
+    {
+        return -1;
+    }
+
+    shake256_init(&ctx);
+    if (0 == shake256_absorb(&ctx, in, in_len) &&
+        0 == shake256_finalize(&ctx))
+    {
+        result = shake256_squeeze(&ctx, out, out_len);
+    }
+    shake256_wipe(&ctx);
+
+    return result;
 }
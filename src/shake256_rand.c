@@ -3,58 +3,68 @@
 
 #include <stdlib.h>
 #include <string.h>
-#if !defined(_MSC_VER)
-# include <unistd.h>
-#endif
 #include "shake256.h"
 #include "shake256_rand.h"
 #include "utils.h"
 
-#define INTERNAL_BUFFER_SIZE        4096
+#define INTERNAL_BUFFER_SIZE        SHAKE256_RNG_BUFFER_SIZE
 
-#if defined(_MSC_VER)
-typedef long long ssize_t;
-#endif
+static shake256_rng _default_rng;
 
-static uint8_t _shake256_buffer[INTERNAL_BUFFER_SIZE];
-static uint8_t _buffer[INTERNAL_BUFFER_SIZE];
-static ssize_t _bytes_available = 0;
-
-void shake256_randominit(const uint8_t* seed, size_t seed_size)
+void shake256_rng_init(shake256_rng* rng,
+                       const uint8_t* seed,
+                       size_t seed_size)
 {
-    crypto_memzero(_shake256_buffer, sizeof(_shake256_buffer));
-    shake256(_shake256_buffer, INTERNAL_BUFFER_SIZE, seed, seed_size);
-    _bytes_available = INTERNAL_BUFFER_SIZE;
+    crypto_memzero(rng->buffer, sizeof(rng->buffer));
+    shake256(rng->buffer, INTERNAL_BUFFER_SIZE, seed, seed_size);
+    rng->bytes_available = INTERNAL_BUFFER_SIZE;
 }
 
-void shake256_randombytes(uint8_t* buf, size_t buf_size)
+void shake256_rng_randombytes(void* ctx, uint8_t* buf, size_t buf_size)
 {
+    shake256_rng *rng = (shake256_rng*)ctx;
+    shake256_ctx xof;
     uint8_t *ptr = buf;
-    ssize_t size;
-    ssize_t bytes_left = (ssize_t)buf_size;
+    size_t size;
+    size_t bytes_left = buf_size;
     while (bytes_left > 0)
     {
         size = bytes_left;
-        if (size > _bytes_available)
+        if (size > rng->bytes_available)
         {
-            size = _bytes_available;
+            size = rng->bytes_available;
         }
         memcpy(ptr,
-               &_shake256_buffer[INTERNAL_BUFFER_SIZE - _bytes_available],
-               (size_t)size);
+               &rng->buffer[INTERNAL_BUFFER_SIZE - rng->bytes_available],
+               size);
         ptr += size;
         bytes_left -= size;
-        _bytes_available -= size;
-        /* Refill SHAKE256 internal buffer if necessary */
-        if (_bytes_available <= 0)
+        rng->bytes_available -= size;
+        /* Refill SHAKE256 internal buffer if necessary, the buffer
+         * is absorbed whole before it is overwritten */
+        if (rng->bytes_available == 0)
         {
-            memcpy(_buffer, _shake256_buffer, sizeof(_shake256_buffer));
-            shake256(_shake256_buffer,
-                     INTERNAL_BUFFER_SIZE,
-                     _buffer,
-                     INTERNAL_BUFFER_SIZE);
-            crypto_memzero(_buffer, sizeof(_buffer));
-            _bytes_available = INTERNAL_BUFFER_SIZE;   
+            shake256_init(&xof);
+            (void)shake256_absorb(&xof, rng->buffer, INTERNAL_BUFFER_SIZE);
+            (void)shake256_finalize(&xof);
+            (void)shake256_squeeze(&xof, rng->buffer, INTERNAL_BUFFER_SIZE);
+            shake256_wipe(&xof);
+            rng->bytes_available = INTERNAL_BUFFER_SIZE;
         }
     }
 }
+
+void shake256_rng_wipe(shake256_rng* rng)
+{
+    crypto_memzero(rng, sizeof(shake256_rng));
+}
+
+void shake256_randominit(const uint8_t* seed, size_t seed_size)
+{
+    shake256_rng_init(&_default_rng, seed, seed_size);
+}
+
+void shake256_randombytes(uint8_t* buf, size_t buf_size)
+{
+    shake256_rng_randombytes(&_default_rng, buf, buf_size);
+}
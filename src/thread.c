@@ -0,0 +1,164 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+# define _POSIX_C_SOURCE 200809L
+#endif
+
+#if !defined(_WIN32)
+# include <unistd.h>
+#endif
+#include "thread.h"
+
+#if defined(_WIN32)
+
+static DWORD WINAPI bdap_thread_start(LPVOID arg)
+{
+    bdap_thread *thread = (bdap_thread *)arg;
+    thread->func(thread->arg);
+    return 0;
+}
+
+bool bdap_thread_create(bdap_thread *thread, bdap_thread_func func, void *arg)
+{
+    thread->func = func;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, bdap_thread_start, thread, 0, NULL);
+    return (thread->handle != NULL);
+}
+
+void bdap_thread_join(bdap_thread *thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+bool bdap_mutex_init(bdap_mutex *mutex)
+{
+    InitializeCriticalSection(mutex);
+    return true;
+}
+
+void bdap_mutex_destroy(bdap_mutex *mutex)
+{
+    DeleteCriticalSection(mutex);
+}
+
+void bdap_mutex_lock(bdap_mutex *mutex)
+{
+    EnterCriticalSection(mutex);
+}
+
+void bdap_mutex_unlock(bdap_mutex *mutex)
+{
+    LeaveCriticalSection(mutex);
+}
+
+bool bdap_cond_init(bdap_cond *cond)
+{
+    InitializeConditionVariable(cond);
+    return true;
+}
+
+void bdap_cond_destroy(bdap_cond *cond)
+{
+    (void) cond;
+}
+
+void bdap_cond_wait(bdap_cond *cond, bdap_mutex *mutex)
+{
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+void bdap_cond_signal(bdap_cond *cond)
+{
+    WakeConditionVariable(cond);
+}
+
+void bdap_cond_broadcast(bdap_cond *cond)
+{
+    WakeAllConditionVariable(cond);
+}
+
+uint32_t bdap_num_cpus(void)
+{
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return (info.dwNumberOfProcessors > 0) ?
+        (uint32_t)info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+static void* bdap_thread_start(void *arg)
+{
+    bdap_thread *thread = (bdap_thread *)arg;
+    thread->func(thread->arg);
+    return NULL;
+}
+
+bool bdap_thread_create(bdap_thread *thread, bdap_thread_func func, void *arg)
+{
+    thread->func = func;
+    thread->arg = arg;
+    return (0 == pthread_create(&thread->handle, NULL, bdap_thread_start, thread));
+}
+
+void bdap_thread_join(bdap_thread *thread)
+{
+    (void)pthread_join(thread->handle, NULL);
+}
+
+bool bdap_mutex_init(bdap_mutex *mutex)
+{
+    return (0 == pthread_mutex_init(mutex, NULL));
+}
+
+void bdap_mutex_destroy(bdap_mutex *mutex)
+{
+    (void)pthread_mutex_destroy(mutex);
+}
+
+void bdap_mutex_lock(bdap_mutex *mutex)
+{
+    (void)pthread_mutex_lock(mutex);
+}
+
+void bdap_mutex_unlock(bdap_mutex *mutex)
+{
+    (void)pthread_mutex_unlock(mutex);
+}
+
+bool bdap_cond_init(bdap_cond *cond)
+{
+    return (0 == pthread_cond_init(cond, NULL));
+}
+
+void bdap_cond_destroy(bdap_cond *cond)
+{
+    (void)pthread_cond_destroy(cond);
+}
+
+void bdap_cond_wait(bdap_cond *cond, bdap_mutex *mutex)
+{
+    (void)pthread_cond_wait(cond, mutex);
+}
+
+void bdap_cond_signal(bdap_cond *cond)
+{
+    (void)pthread_cond_signal(cond);
+}
+
+void bdap_cond_broadcast(bdap_cond *cond)
+{
+    (void)pthread_cond_broadcast(cond);
+}
+
+uint32_t bdap_num_cpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (uint32_t)n : 1;
+}
+
+#endif
@@ -0,0 +1,291 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#include "thread_pool.h"
+
+/**
+ * @brief Takes the next task index from the worker's own range.
+ */
+static bool worker_pop(bdap_pool_worker *worker, size_t *index)
+{
+    bool result = false;
+
+    bdap_mutex_lock(&worker->lock);
+    if (worker->begin < worker->end)
+    {
+        *index = worker->begin++;
+        result = true;
+    }
+    bdap_mutex_unlock(&worker->lock);
+
+    return result;
+}
+
+/**
+ * @brief Moves the upper half of the largest range of the other
+ * workers into the range of the given worker.
+ *
+ * @note The sizes are first read without locking, the victim's
+ * range is then re-checked under its lock. Only one lock is held
+ * at a time.
+ */
+static bool worker_steal(bdap_pool_worker *worker)
+{
+    bdap_thread_pool *pool = worker->pool;
+    bdap_pool_worker *victim = NULL;
+    size_t i, size, largest = 0, begin = 0, end = 0;
+
+    for (i = 0; i < pool->num_threads; ++i)
+    {
+        bdap_mutex_lock(&pool->workers[i].lock);
+        size = pool->workers[i].end - pool->workers[i].begin;
+        bdap_mutex_unlock(&pool->workers[i].lock);
+        if (size > largest)
+        {
+            largest = size;
+            victim = &pool->workers[i];
+        }
+    }
+    if (victim == NULL || victim == worker)
+    {
+        return false;
+    }
+
+    bdap_mutex_lock(&victim->lock);
+    size = victim->end - victim->begin;
+    if (size > 0)
+    {
+        end = victim->end;
+        begin = end - (size + 1) / 2;
+        victim->end = begin;
+    }
+    bdap_mutex_unlock(&victim->lock);
+
+    if (begin == end)
+    {
+        /* Another worker got there first, try again */
+        return true;
+    }
+
+    bdap_mutex_lock(&worker->lock);
+    worker->begin = begin;
+    worker->end = end;
+    bdap_mutex_unlock(&worker->lock);
+
+    return true;
+}
+
+/**
+ * @brief Runs tasks until no worker has any left.
+ */
+static void worker_execute(bdap_pool_worker *worker)
+{
+    bdap_thread_pool *pool = worker->pool;
+    size_t index;
+
+    for (;;)
+    {
+        if (worker_pop(worker, &index))
+        {
+            pool->func(pool->ctx, index);
+        }
+        else if (!worker_steal(worker))
+        {
+            break;
+        }
+    }
+}
+
+static void worker_main(void *arg)
+{
+    bdap_pool_worker *worker = (bdap_pool_worker *)arg;
+    bdap_thread_pool *pool = worker->pool;
+    uint64_t seen = 0;
+
+    bdap_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (!pool->shutdown && pool->generation == seen)
+        {
+            bdap_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->shutdown)
+        {
+            break;
+        }
+        seen = pool->generation;
+        bdap_mutex_unlock(&pool->lock);
+
+        worker_execute(worker);
+
+        bdap_mutex_lock(&pool->lock);
+        if (--pool->active == 0)
+        {
+            bdap_cond_signal(&pool->done);
+        }
+    }
+    bdap_mutex_unlock(&pool->lock);
+}
+
+bool bdap_thread_pool_init(bdap_thread_pool *pool, uint32_t num_threads)
+{
+    uint32_t i, started = 0, mutexes = 0;
+
+    if (num_threads == 0)
+    {
+        num_threads = bdap_num_cpus();
+    }
+    if (num_threads > BDAP_THREAD_POOL_MAX_THREADS)
+    {
+        num_threads = BDAP_THREAD_POOL_MAX_THREADS;
+    }
+
+    pool->num_threads = num_threads;
+    pool->generation = 0;
+    pool->active = 0;
+    pool->shutdown = false;
+    pool->func = NULL;
+    pool->ctx = NULL;
+
+    if (!bdap_mutex_init(&pool->run_lock))
+    {
+        return false;
+    }
+    if (!bdap_mutex_init(&pool->lock))
+    {
+        goto bdap_thread_pool_init_bail_run_lock;
+    }
+    if (!bdap_cond_init(&pool->wake))
+    {
+        goto bdap_thread_pool_init_bail_lock;
+    }
+    if (!bdap_cond_init(&pool->done))
+    {
+        goto bdap_thread_pool_init_bail_wake;
+    }
+
+    for (mutexes = 0; mutexes < num_threads; ++mutexes)
+    {
+        pool->workers[mutexes].pool = pool;
+        pool->workers[mutexes].begin = 0;
+        pool->workers[mutexes].end = 0;
+        if (!bdap_mutex_init(&pool->workers[mutexes].lock))
+        {
+            goto bdap_thread_pool_init_bail;
+        }
+    }
+
+    /* Worker 0 is the caller of bdap_thread_pool_run */
+    for (started = 1; started < num_threads; ++started)
+    {
+        if (!bdap_thread_create(&pool->workers[started].thread,
+                                worker_main,
+                                &pool->workers[started]))
+        {
+            goto bdap_thread_pool_init_bail;
+        }
+    }
+
+    return true;
+
+bdap_thread_pool_init_bail:
+    bdap_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    bdap_cond_broadcast(&pool->wake);
+    bdap_mutex_unlock(&pool->lock);
+    for (i = 1; i < started; ++i)
+    {
+        bdap_thread_join(&pool->workers[i].thread);
+    }
+    for (i = 0; i < mutexes; ++i)
+    {
+        bdap_mutex_destroy(&pool->workers[i].lock);
+    }
+    bdap_cond_destroy(&pool->done);
+bdap_thread_pool_init_bail_wake:
+    bdap_cond_destroy(&pool->wake);
+bdap_thread_pool_init_bail_lock:
+    bdap_mutex_destroy(&pool->lock);
+bdap_thread_pool_init_bail_run_lock:
+    bdap_mutex_destroy(&pool->run_lock);
+
+    return false;
+}
+
+void bdap_thread_pool_destroy(bdap_thread_pool *pool)
+{
+    uint32_t i;
+
+    bdap_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    bdap_cond_broadcast(&pool->wake);
+    bdap_mutex_unlock(&pool->lock);
+
+    for (i = 1; i < pool->num_threads; ++i)
+    {
+        bdap_thread_join(&pool->workers[i].thread);
+    }
+    for (i = 0; i < pool->num_threads; ++i)
+    {
+        bdap_mutex_destroy(&pool->workers[i].lock);
+    }
+    bdap_cond_destroy(&pool->done);
+    bdap_cond_destroy(&pool->wake);
+    bdap_mutex_destroy(&pool->lock);
+    bdap_mutex_destroy(&pool->run_lock);
+}
+
+uint32_t bdap_thread_pool_size(const bdap_thread_pool *pool)
+{
+    return pool->num_threads;
+}
+
+void bdap_thread_pool_run(bdap_thread_pool *pool,
+                          size_t num_tasks,
+                          bdap_task_func func,
+                          void *ctx)
+{
+    uint32_t i;
+    size_t begin = 0, share;
+
+    if (num_tasks == 0)
+    {
+        return;
+    }
+
+    bdap_mutex_lock(&pool->run_lock);
+
+    pool->func = func;
+    pool->ctx = ctx;
+
+    /* Spread the indices evenly, stealing balances the rest */
+    for (i = 0; i < pool->num_threads; ++i)
+    {
+        share = (num_tasks - begin) / (pool->num_threads - i);
+        bdap_mutex_lock(&pool->workers[i].lock);
+        pool->workers[i].begin = begin;
+        pool->workers[i].end = begin + share;
+        bdap_mutex_unlock(&pool->workers[i].lock);
+        begin += share;
+    }
+
+    bdap_mutex_lock(&pool->lock);
+    pool->active = pool->num_threads - 1;
+    ++pool->generation;
+    bdap_cond_broadcast(&pool->wake);
+    bdap_mutex_unlock(&pool->lock);
+
+    worker_execute(&pool->workers[0]);
+
+    bdap_mutex_lock(&pool->lock);
+    while (pool->active != 0)
+    {
+        bdap_cond_wait(&pool->done, &pool->lock);
+    }
+    bdap_mutex_unlock(&pool->lock);
+
+    pool->func = NULL;
+    pool->ctx = NULL;
+
+    bdap_mutex_unlock(&pool->run_lock);
+}
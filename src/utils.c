@@ -1,16 +1,163 @@
 // Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
 // See LICENSE.md file for license, copying and use information.
 
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+# define _DEFAULT_SOURCE
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #if defined(__unix__) || defined(__linux__) || defined(__APPLE__)
 # include <sys/mman.h>
+# include <unistd.h>
+# include <pthread.h>
+# define CRYPTO_SECURE_POSIX
 #endif
 #if defined(_WIN32)
 # include <windows.h>
 #endif
 #include "utils.h"
 
+#if defined(CRYPTO_SECURE_POSIX) && !defined(MAP_ANONYMOUS)
+# define MAP_ANONYMOUS  MAP_ANON
+#endif
+
+#define CRYPTO_SECURE_CHUNK_SIZE \
+    (CRYPTO_SECURE_SLOT_SIZE * CRYPTO_SECURE_CHUNK_SLOTS)
+#define CRYPTO_SECURE_MAX_CHUNKS \
+    (CRYPTO_SECURE_MAX_SLOTS / CRYPTO_SECURE_CHUNK_SLOTS)
+
+/**
+ * @brief The secure arena, the chunks of its slots and the stack of
+ * the free ones, slot i being slot i % CRYPTO_SECURE_CHUNK_SLOTS of
+ * chunk i / CRYPTO_SECURE_CHUNK_SLOTS.
+ */
+typedef struct
+{
+    uint8_t* chunks[CRYPTO_SECURE_MAX_CHUNKS];
+    size_t num_chunks;
+    uint16_t free_slots[CRYPTO_SECURE_MAX_SLOTS];
+    size_t num_free;
+    bool available;
+} crypto_secure_arena;
+
+static crypto_secure_arena _arena;
+
+/**
+ * @brief A page locked by crypto_mlock(void* const, const size_t),
+ * with the number of blocks locked on it.
+ */
+typedef struct
+{
+    uintptr_t page;
+    size_t count;
+} crypto_locked_page;
+
+/**
+ * @brief The pages locked by crypto_mlock(void* const, const size_t),
+ * sorted by address.
+ */
+typedef struct
+{
+    crypto_locked_page pages[CRYPTO_MLOCK_MAX_PAGES];
+    size_t num_pages;
+} crypto_locked_pages;
+
+static crypto_locked_pages _locked;
+
+#if defined(CRYPTO_SECURE_POSIX)
+static pthread_once_t _arena_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t _arena_lock = PTHREAD_MUTEX_INITIALIZER;
+# define ARENA_LOCK()       (void)pthread_mutex_lock(&_arena_lock)
+# define ARENA_UNLOCK()     (void)pthread_mutex_unlock(&_arena_lock)
+static pthread_mutex_t _pages_lock = PTHREAD_MUTEX_INITIALIZER;
+# define PAGES_LOCK()       (void)pthread_mutex_lock(&_pages_lock)
+# define PAGES_UNLOCK()     (void)pthread_mutex_unlock(&_pages_lock)
+#elif defined(_WIN32)
+static INIT_ONCE _arena_once = INIT_ONCE_STATIC_INIT;
+static SRWLOCK _arena_lock = SRWLOCK_INIT;
+# define ARENA_LOCK()       AcquireSRWLockExclusive(&_arena_lock)
+# define ARENA_UNLOCK()     ReleaseSRWLockExclusive(&_arena_lock)
+static SRWLOCK _pages_lock = SRWLOCK_INIT;
+# define PAGES_LOCK()       AcquireSRWLockExclusive(&_pages_lock)
+# define PAGES_UNLOCK()     ReleaseSRWLockExclusive(&_pages_lock)
+#endif
+
+/**
+ * @brief Returns the size of a page of memory.
+ */
+static size_t crypto_page_size(void)
+{
+#if defined(CRYPTO_SECURE_POSIX)
+    long page = sysconf(_SC_PAGESIZE);
+
+    return (page > 0) ? (size_t)page : 4096;
+#elif defined(_WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return 4096;
+#endif
+}
+
+/**
+ * @brief Locks whole pages, whether they are already locked or not.
+ */
+static bool crypto_lock_pages(uintptr_t first, const size_t size)
+{
+#if defined(CRYPTO_SECURE_POSIX)
+    return (0 == mlock((void*)first, size));
+#elif defined(_WIN32)
+    return VirtualLock((void*)first, size);
+#else
+    (void)first;
+    (void)size;
+    return false;
+#endif
+}
+
+/**
+ * @brief Unlocks whole pages.
+ */
+static bool crypto_unlock_pages(uintptr_t first, const size_t size)
+{
+#if defined(CRYPTO_SECURE_POSIX)
+    return (0 == munlock((void*)first, size));
+#elif defined(_WIN32)
+    return VirtualUnlock((void*)first, size);
+#else
+    (void)first;
+    (void)size;
+    return false;
+#endif
+}
+
+/**
+ * @brief Finds the position of the first locked page at or after
+ * {@code page}, with the pages lock held.
+ */
+static size_t crypto_locked_page_find(uintptr_t page)
+{
+    size_t lo = 0, hi = _locked.num_pages, mid;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (_locked.pages[mid].page < page)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
 /**
  * @brief Locks a block of memory at address given by
  * {@code addr}, of {@code size} bytes for storing
@@ -18,6 +165,9 @@
  * 
  * @note On Linux system, this method also prevents
  * the block of memory from being included in coredump.
+ * Locks are counted per page, so that blocks sharing a page
+ * are locked and unlocked independently: a page stays locked
+ * until every block locked on it is unlocked.
  * 
  * @param addr The address to be locked
  * @param size The number of bytes to lock
@@ -26,13 +176,58 @@
  */
 bool crypto_mlock(void* const addr, const size_t size)
 {
-#if defined(__unix__) || defined(__linux__) || defined(__APPLE__)
-    return (0 == mlock(addr, size));
-#elif defined(_WIN32)
-    return VirtualLock(addr, size);
+    size_t page_size = crypto_page_size();
+    size_t lo, hi, old, pos, num;
+    uintptr_t first, last, page;
+    bool result = false;
+
+    if (size == 0)
+    {
+        return true;
+    }
+    first = (uintptr_t)addr & ~(uintptr_t)(page_size - 1);
+    last = ((uintptr_t)addr + size - 1) & ~(uintptr_t)(page_size - 1);
+    num = (size_t)((last - first) / page_size) + 1;
+
+#if defined(CRYPTO_SECURE_POSIX) || defined(_WIN32)
+    PAGES_LOCK();
+    /* The pages of the block already locked, [lo, hi), are replaced
+     * by all of its pages, [lo, lo + num) */
+    lo = crypto_locked_page_find(first);
+    hi = crypto_locked_page_find(last);
+    if (hi < _locked.num_pages && _locked.pages[hi].page == last)
+    {
+        hi++;
+    }
+    if (_locked.num_pages - (hi - lo) + num <= CRYPTO_MLOCK_MAX_PAGES &&
+        crypto_lock_pages(first, num * page_size))
+    {
+        memmove(&_locked.pages[lo + num],
+                &_locked.pages[hi],
+                (_locked.num_pages - hi) * sizeof(crypto_locked_page));
+        for (pos = num, old = hi; pos > 0; --pos)
+        {
+            page = first + (pos - 1) * page_size;
+            _locked.pages[lo + pos - 1].count = 1;
+            if (old > lo && _locked.pages[old - 1].page == page)
+            {
+                _locked.pages[lo + pos - 1].count += _locked.pages[--old].count;
+            }
+            _locked.pages[lo + pos - 1].page = page;
+        }
+        _locked.num_pages += num - (hi - lo);
+        result = true;
+    }
+    PAGES_UNLOCK();
 #else
-    return false;
+    (void)lo;
+    (void)hi;
+    (void)old;
+    (void)pos;
+    (void)page;
 #endif
+
+    return result;
 }
 
 /**
@@ -41,7 +236,8 @@ bool crypto_mlock(void* const addr, const size_t size)
  *
  * @note The block of memory to be unlocked shall be
  * locked by crypto_mlock(void* const, const size_t)
- * in the first place.
+ * in the first place. Only the pages no other locked block
+ * shares are unlocked.
  * 
  * @param addr The address to be unlocked
  * @param size The number of bytes to lock
@@ -50,13 +246,61 @@ bool crypto_mlock(void* const addr, const size_t size)
  */
 bool crypto_munlock(void* const addr, const size_t size)
 {
-#if defined(__unix__) || defined(__linux__) || defined(__APPLE__)
-    return (0 == munlock(addr, size));
-#elif defined(_WIN32)
-    return VirtualUnlock(addr, size);
+    size_t page_size = crypto_page_size();
+    size_t pos, kept, run;
+    uintptr_t first, last, start = 0;
+    bool result = true;
+
+    if (size == 0)
+    {
+        return true;
+    }
+    first = (uintptr_t)addr & ~(uintptr_t)(page_size - 1);
+    last = ((uintptr_t)addr + size - 1) & ~(uintptr_t)(page_size - 1);
+
+#if defined(CRYPTO_SECURE_POSIX) || defined(_WIN32)
+    PAGES_LOCK();
+    /* The pages whose count drops to zero are unlocked a run of
+     * consecutive pages at a time */
+    run = 0;
+    kept = crypto_locked_page_find(first);
+    for (pos = kept;
+         pos < _locked.num_pages && _locked.pages[pos].page <= last;
+         ++pos)
+    {
+        if (--_locked.pages[pos].count > 0)
+        {
+            _locked.pages[kept++] = _locked.pages[pos];
+            continue;
+        }
+        if (run > 0 && _locked.pages[pos].page != start + run * page_size)
+        {
+            result = crypto_unlock_pages(start, run * page_size) && result;
+            run = 0;
+        }
+        if (run++ == 0)
+        {
+            start = _locked.pages[pos].page;
+        }
+    }
+    if (run > 0)
+    {
+        result = crypto_unlock_pages(start, run * page_size) && result;
+    }
+    memmove(&_locked.pages[kept],
+            &_locked.pages[pos],
+            (_locked.num_pages - pos) * sizeof(crypto_locked_page));
+    _locked.num_pages -= pos - kept;
+    PAGES_UNLOCK();
 #else
-    return false;
+    (void)pos;
+    (void)kept;
+    (void)run;
+    (void)start;
+    result = false;
 #endif
+
+    return result;
 }
 
 /**
@@ -81,6 +325,223 @@ void crypto_memzero(void const* ptr, const size_t size)
 #endif    
 }
 
+/**
+ * @brief Zeroes a block of memory with word-sized stores.
+ * 
+ * @param ptr the pointer of memory location to be zeroed,
+ *            aligned on 8 bytes
+ * @param size the size of the memory block in bytes
+ */
+void crypto_memzero_aligned(void* ptr, const size_t size)
+{
+    size_t index = 0;
+    volatile uint64_t *volatile target_ptr =
+        (volatile uint64_t *volatile) ptr;
+
+    for (index=0; index<size/sizeof(uint64_t); index++)
+    {
+        target_ptr[index] = 0;
+    }
+    crypto_memzero((uint8_t*)ptr + index*sizeof(uint64_t),
+                   size % sizeof(uint64_t));
+}
+
+/**
+ * @brief Maps a chunk of the secure arena between two guard pages
+ * and locks it.
+ * 
+ * @return the chunk, or NULL on failure
+ */
+static uint8_t* crypto_secure_chunk_map(void)
+{
+    size_t page_size = crypto_page_size();
+    size_t chunk_size =
+        (CRYPTO_SECURE_CHUNK_SIZE + page_size - 1) & ~(page_size - 1);
+    uint8_t* base;
+#if defined(CRYPTO_SECURE_POSIX)
+    base = mmap(NULL, chunk_size + 2*page_size, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+    if (0 != mprotect(base + page_size, chunk_size, PROT_READ | PROT_WRITE) ||
+        0 != mlock(base + page_size, chunk_size))
+    {
+        (void)munmap(base, chunk_size + 2*page_size);
+        return NULL;
+    }
+# if defined(MADV_DONTDUMP)
+    (void)madvise(base + page_size, chunk_size, MADV_DONTDUMP);
+# endif
+#elif defined(_WIN32)
+    DWORD old_protect;
+
+    base = VirtualAlloc(NULL, chunk_size + 2*page_size,
+                        MEM_RESERVE | MEM_COMMIT, PAGE_NOACCESS);
+    if (base == NULL)
+    {
+        return NULL;
+    }
+    if (!VirtualProtect(base + page_size, chunk_size,
+                        PAGE_READWRITE, &old_protect) ||
+        !VirtualLock(base + page_size, chunk_size))
+    {
+        (void)VirtualFree(base, 0, MEM_RELEASE);
+        return NULL;
+    }
+#else
+    (void)page_size;
+    (void)chunk_size;
+    (void)base;
+    return NULL;
+#endif
+
+#if defined(CRYPTO_SECURE_POSIX) || defined(_WIN32)
+    return base + page_size;
+#endif
+}
+
+/**
+ * @brief Adds a chunk to the secure arena, with the arena lock held.
+ * The chunks are kept for the lifetime of the process.
+ * 
+ * @return true if the arena has grown
+ * @return false otherwise
+ */
+static bool crypto_secure_arena_grow(void)
+{
+    size_t idx;
+    uint8_t* chunk;
+
+    if (_arena.num_chunks == CRYPTO_SECURE_MAX_CHUNKS)
+    {
+        return false;
+    }
+    chunk = crypto_secure_chunk_map();
+    if (chunk == NULL)
+    {
+        return false;
+    }
+
+    _arena.chunks[_arena.num_chunks] = chunk;
+    for (idx = CRYPTO_SECURE_CHUNK_SLOTS; idx > 0; --idx)
+    {
+        _arena.free_slots[_arena.num_free++] = (uint16_t)(
+            _arena.num_chunks * CRYPTO_SECURE_CHUNK_SLOTS + idx - 1);
+    }
+    _arena.num_chunks++;
+
+    return true;
+}
+
+/**
+ * @brief Maps the first chunk of the secure arena, once per process.
+ */
+static void crypto_secure_arena_create(void)
+{
+    _arena.available = crypto_secure_arena_grow();
+}
+
+#if defined(_WIN32)
+static BOOL CALLBACK crypto_secure_arena_create_once(PINIT_ONCE once,
+                                                     PVOID param,
+                                                     PVOID* context)
+{
+    (void)once;
+    (void)param;
+    (void)context;
+    crypto_secure_arena_create();
+    return TRUE;
+}
+#endif
+
+/**
+ * @brief Sets up the secure arena.
+ * 
+ * @return true if the arena is available
+ * @return false otherwise
+ */
+bool crypto_secure_init(void)
+{
+#if defined(CRYPTO_SECURE_POSIX)
+    (void)pthread_once(&_arena_once, crypto_secure_arena_create);
+#elif defined(_WIN32)
+    (void)InitOnceExecuteOnce(&_arena_once,
+                              crypto_secure_arena_create_once,
+                              NULL,
+                              NULL);
+#endif
+    return _arena.available;
+}
+
+/**
+ * @brief Takes a slot of CRYPTO_SECURE_SLOT_SIZE bytes from the
+ * secure arena.
+ * 
+ * @return the slot, or NULL if none is available
+ */
+void* crypto_secure_alloc(void)
+{
+    void* slot = NULL;
+    size_t idx;
+
+    if (true != crypto_secure_init())
+    {
+        return NULL;
+    }
+
+#if defined(CRYPTO_SECURE_POSIX) || defined(_WIN32)
+    ARENA_LOCK();
+    if (_arena.num_free > 0 || crypto_secure_arena_grow())
+    {
+        idx = _arena.free_slots[--_arena.num_free];
+        slot = _arena.chunks[idx / CRYPTO_SECURE_CHUNK_SLOTS] +
+               (idx % CRYPTO_SECURE_CHUNK_SLOTS) * CRYPTO_SECURE_SLOT_SIZE;
+    }
+    ARENA_UNLOCK();
+#else
+    (void)idx;
+#endif
+
+    return slot;
+}
+
+/**
+ * @brief Wipes a slot of the secure arena and gives it back.
+ * 
+ * @param slot the slot returned by crypto_secure_alloc(), or NULL
+ */
+void crypto_secure_free(void* slot)
+{
+    size_t chunk, offset;
+
+    if (slot == NULL)
+    {
+        return;
+    }
+
+    crypto_memzero_aligned(slot, CRYPTO_SECURE_SLOT_SIZE);
+
+#if defined(CRYPTO_SECURE_POSIX) || defined(_WIN32)
+    ARENA_LOCK();
+    for (chunk = 0; chunk < _arena.num_chunks; ++chunk)
+    {
+        offset = (size_t)((uintptr_t)slot - (uintptr_t)_arena.chunks[chunk]);
+        if (offset < CRYPTO_SECURE_CHUNK_SIZE)
+        {
+            _arena.free_slots[_arena.num_free++] = (uint16_t)(
+                chunk * CRYPTO_SECURE_CHUNK_SLOTS + offset / CRYPTO_SECURE_SLOT_SIZE);
+            break;
+        }
+    }
+    ARENA_UNLOCK();
+#else
+    (void)chunk;
+    (void)offset;
+#endif
+}
+
 /**
  * @brief A constant-time method to check whether or not
  * two memory blocks are equal.
@@ -76,3 +76,107 @@ bool random_aes_test_vectors(int iterations)
 
     return status;
 }
+
+bool aes256_context_test(int iterations)
+{
+    int32_t it;
+    size_t idx, num_blocks;
+    bool status = true;
+    aes256_ctx ctx;
+    uint8_t plaintext[16 * AES256_BLOCK_SIZE];
+    uint8_t ciphertext[16 * AES256_BLOCK_SIZE];
+    uint8_t expected[16 * AES256_BLOCK_SIZE];
+    uint8_t key[AES256_KEY_SIZE];
+    uint8_t seed[] = {
+        0x0c, 0x3e, 0x52, 0x9d, 0x41, 0x77, 0xf0, 0x28,
+        0x95, 0x6b, 0xe4, 0x13, 0xa2, 0x5f, 0xc8, 0x3a,
+        0x6e, 0x01, 0xbb, 0x74, 0x2d, 0x99, 0x56, 0xe7
+    };
+
+    bdap_randominit(seed, sizeof(seed));
+
+    for (it=0; it<iterations && status; it++)
+    {
+        bdap_randombytes(plaintext, sizeof(plaintext));
+        bdap_randombytes(key, sizeof(key));
+        bdap_randombytes((uint8_t *)&num_blocks, sizeof(num_blocks));
+        num_blocks = 1 + (num_blocks % 16);
+
+        for (idx = 0; idx < num_blocks; idx++)
+        {
+            aes256_bitslice_encrypt(&expected[idx * AES256_BLOCK_SIZE],
+                                    &plaintext[idx * AES256_BLOCK_SIZE],
+                                    key);
+        }
+
+        aes256_init(&ctx, key);
+        crypto_memzero(ciphertext, sizeof(ciphertext));
+        aes256_encrypt_blocks(ciphertext, plaintext, num_blocks, &ctx);
+        status = (memcmp(ciphertext, expected, num_blocks * AES256_BLOCK_SIZE) == 0);
+
+        /* In-place encryption must yield the same result */
+        aes256_encrypt_blocks(plaintext, plaintext, num_blocks, &ctx);
+        status = status &&
+            (memcmp(plaintext, expected, num_blocks * AES256_BLOCK_SIZE) == 0);
+
+        aes256_encrypt_block(ciphertext, &plaintext[0], &ctx);
+        aes256_bitslice_encrypt(expected, &plaintext[0], key);
+        status = status && (memcmp(ciphertext, expected, AES256_BLOCK_SIZE) == 0);
+        aes256_wipe(&ctx);
+    }
+
+    return status;
+}
+
+bool aes256_engine_cross_check_test(int iterations)
+{
+    int32_t it, engine;
+    size_t idx, num_blocks;
+    bool status = true;
+    bool hardware = aes256_hardware_enabled();
+    aes256_ctx ctx;
+    uint8_t plaintext[16 * AES256_BLOCK_SIZE];
+    uint8_t ciphertext[2][16 * AES256_BLOCK_SIZE];
+    uint8_t decrypted[AES256_BLOCK_SIZE];
+    uint8_t key[AES256_KEY_SIZE];
+    uint8_t seed[] = {
+        0x71, 0xd2, 0x0e, 0x5b, 0xa8, 0x33, 0xc6, 0x9f,
+        0x14, 0xe0, 0x4d, 0x87, 0x2a, 0xbf, 0x63, 0x05,
+        0xd9, 0x38, 0x96, 0x4e, 0xf1, 0x1c, 0x7a, 0xb5
+    };
+
+    bdap_randominit(seed, sizeof(seed));
+
+    for (it=0; it<iterations && status; it++)
+    {
+        bdap_randombytes(plaintext, sizeof(plaintext));
+        bdap_randombytes(key, sizeof(key));
+        bdap_randombytes((uint8_t *)&num_blocks, sizeof(num_blocks));
+        num_blocks = 1 + (num_blocks % 16);
+
+        /* The bit-sliced engine, four blocks at a time, and AES-NI if any */
+        for (engine = 0; engine < 2; engine++)
+        {
+            (void)aes256_use_hardware(engine == 1);
+            aes256_init(&ctx, key);
+            aes256_encrypt_blocks(ciphertext[engine], plaintext, num_blocks, &ctx);
+            aes256_wipe(&ctx);
+        }
+        status = (memcmp(ciphertext[0], ciphertext[1],
+                         num_blocks * AES256_BLOCK_SIZE) == 0);
+
+        /* The byte-oriented decryption inverts the bit-sliced encryption */
+        for (idx = 0; idx < num_blocks && status; idx++)
+        {
+            aes256_bitslice_decrypt(decrypted,
+                                    &ciphertext[0][idx * AES256_BLOCK_SIZE],
+                                    key);
+            status = (memcmp(decrypted, &plaintext[idx * AES256_BLOCK_SIZE],
+                             AES256_BLOCK_SIZE) == 0);
+        }
+    }
+
+    (void)aes256_use_hardware(hardware);
+
+    return status;
+}
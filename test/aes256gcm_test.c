@@ -10,7 +10,11 @@
 #include <stdbool.h>
 #include <string.h>
 #include <openssl/evp.h>
+#include "aes256.h"
+#include "aes256ctr.h"
 #include "aes256gcm.h"
+#include "rand.h"
+#include "thread_pool.h"
 #include "utils.h"
 
 typedef struct
@@ -472,3 +476,436 @@ bail_test:
 
     return result;
 }
+
+bool aes256gcm_portable_nist_positive_test()
+{
+    bool result;
+    bool hardware = aes256_hardware_enabled();
+
+    (void)aes256_use_hardware(false);
+    result = aes256gcm_nist_positive_test() &&
+             openssl_aes256gcm_nist_positive_test();
+    (void)aes256_use_hardware(hardware);
+
+    return result;
+}
+
+bool aes256_hardware_cross_check_test(int iterations)
+{
+    int32_t it;
+    bool result = true;
+    bool hardware = aes256_hardware_enabled();
+    size_t msg_len, aad_len, c_len, m_len;
+    uint8_t key[AES256GCM_KEY_SIZE];
+    uint8_t iv[AES256CTR_IV_SIZE];
+    uint8_t msg[1024];
+    uint8_t aad[64];
+    uint8_t c_portable[sizeof(msg) + AES256GCM_TAG_SIZE];
+    uint8_t c_hardware[sizeof(msg) + AES256GCM_TAG_SIZE];
+    uint8_t decrypted[sizeof(msg)];
+    uint8_t seed[] = {
+        0x5a, 0x0b, 0xe1, 0x37, 0x92, 0xc4, 0x6d, 0x18,
+        0xf3, 0x2e, 0x80, 0x4b, 0xa9, 0x71, 0x06, 0xdc,
+        0x3f, 0x65, 0xb2, 0x9e, 0x14, 0xc7, 0x58, 0xea
+    };
+
+    if (false == aes256_use_hardware(true))
+    {
+        /* Nothing to cross-check against */
+        (void)aes256_use_hardware(hardware);
+        return true;
+    }
+
+    bdap_randominit(seed, sizeof(seed));
+
+    for (it = 0; result && it < iterations; it++)
+    {
+        bdap_randombytes(key, sizeof(key));
+        bdap_randombytes(iv, sizeof(iv));
+        bdap_randombytes(msg, sizeof(msg));
+        bdap_randombytes(aad, sizeof(aad));
+        bdap_randombytes((uint8_t *)&msg_len, sizeof(msg_len));
+        bdap_randombytes((uint8_t *)&aad_len, sizeof(aad_len));
+        msg_len %= sizeof(msg) + 1;
+        aad_len %= sizeof(aad) + 1;
+
+        /* AES256-GCM */
+        (void)aes256_use_hardware(false);
+        aes256gcm_encrypt(c_portable, &c_len, msg, msg_len,
+                          aad, aad_len, iv, key);
+        (void)aes256_use_hardware(true);
+        aes256gcm_encrypt(c_hardware, &c_len, msg, msg_len,
+                          aad, aad_len, iv, key);
+        result = (memcmp(c_portable, c_hardware, c_len) == 0);
+
+        (void)aes256_use_hardware(false);
+        result = result && (0 == aes256gcm_decrypt(decrypted, &m_len,
+                                                   c_hardware, c_len,
+                                                   aad, aad_len, iv, key));
+        result = result && (m_len == msg_len) &&
+                 (memcmp(decrypted, msg, m_len) == 0);
+
+        /* AES256-CTR */
+        aes256ctr_encrypt(c_portable, &c_len, msg, msg_len, iv, key);
+        (void)aes256_use_hardware(true);
+        aes256ctr_encrypt(c_hardware, &c_len, msg, msg_len, iv, key);
+        result = result && (memcmp(c_portable, c_hardware, c_len) == 0);
+    }
+
+    (void)aes256_use_hardware(hardware);
+
+    return result;
+}
+
+/**
+ * @brief Multiplies x by y in GF(2^128), bit by bit as in Algorithm 1
+ * of NIST SP 800-38D.
+ */
+static void gf128_mul_reference(uint8_t *x, const uint8_t *y)
+{
+    uint8_t z[16] = {0};
+    uint8_t v[16];
+    uint8_t lsb;
+    int32_t i, j;
+
+    memcpy(v, y, sizeof(v));
+    for (i = 0; i < 128; i++)
+    {
+        if (x[i >> 3] & (0x80 >> (i & 7)))
+        {
+            for (j = 0; j < 16; j++)
+            {
+                z[j] ^= v[j];
+            }
+        }
+        lsb = v[15] & 1;
+        for (j = 15; j > 0; j--)
+        {
+            v[j] = (uint8_t)((v[j] >> 1) | (v[j - 1] << 7));
+        }
+        v[0] >>= 1;
+        if (lsb)
+        {
+            v[0] ^= 0xe1;
+        }
+    }
+    memcpy(x, z, sizeof(z));
+}
+
+/**
+ * @brief Absorbs data, zero-padded to whole blocks, into a reference
+ * GHASH accumulator.
+ */
+static void ghash_reference(uint8_t *accum,
+                            const uint8_t *H,
+                            const uint8_t *x,
+                            size_t len)
+{
+    size_t i, n;
+
+    for (; len > 0; x += n, len -= n)
+    {
+        n = (len < 16) ? len : 16;
+        for (i = 0; i < n; i++)
+        {
+            accum[i] ^= x[i];
+        }
+        gf128_mul_reference(accum, H);
+    }
+}
+
+bool aes256gcm_ghash_engines_test(int iterations)
+{
+    int32_t it, engine;
+    bool result = true;
+    bool hardware = aes256_hardware_enabled();
+    size_t c_len, aad_len, offset, chunk;
+    uint8_t key[AES256GCM_KEY_SIZE];
+    uint8_t nonce[AES256GCM_NONCE_SIZE];
+    uint8_t c[1024];
+    uint8_t aad[80];
+    uint8_t H[16], J0[16], S[16], lengths[16], tag[AES256GCM_TAG_SIZE];
+    aes256gcm_ctx gcm;
+    uint8_t seed[] = {
+        0xb4, 0x27, 0x6a, 0xf9, 0x13, 0xce, 0x58, 0x82,
+        0x3d, 0xe5, 0x90, 0x0c, 0x77, 0xa1, 0x4f, 0xd6,
+        0x29, 0x8b, 0xf4, 0x60, 0x1e, 0xc3, 0x95, 0x5a
+    };
+
+    bdap_randominit(seed, sizeof(seed));
+
+    for (it = 0; result && it < iterations; it++)
+    {
+        bdap_randombytes(key, sizeof(key));
+        bdap_randombytes(nonce, sizeof(nonce));
+        bdap_randombytes(c, sizeof(c));
+        bdap_randombytes(aad, sizeof(aad));
+        bdap_randombytes((uint8_t *)&c_len, sizeof(c_len));
+        bdap_randombytes((uint8_t *)&aad_len, sizeof(aad_len));
+        c_len %= sizeof(c) + 1;
+        aad_len %= sizeof(aad) + 1;
+
+        /* The expected tag, E(K, J0) ^ GHASH(H, A, C) */
+        memset(H, 0, sizeof(H));
+        aes256_bitslice_encrypt(H, H, key);
+        memcpy(J0, nonce, AES256GCM_NONCE_SIZE);
+        J0[12] = 0; J0[13] = 0; J0[14] = 0; J0[15] = 1;
+        memset(lengths, 0, sizeof(lengths));
+        for (offset = 0; offset < 8; offset++)
+        {
+            lengths[7 - offset] = (uint8_t)((8 * (uint64_t)aad_len) >> (8 * offset));
+            lengths[15 - offset] = (uint8_t)((8 * (uint64_t)c_len) >> (8 * offset));
+        }
+        memset(S, 0, sizeof(S));
+        ghash_reference(S, H, aad, aad_len);
+        ghash_reference(S, H, c, c_len);
+        ghash_reference(S, H, lengths, sizeof(lengths));
+        aes256_bitslice_encrypt(tag, J0, key);
+        for (offset = 0; offset < sizeof(tag); offset++)
+        {
+            tag[offset] ^= S[offset];
+        }
+
+        /* The ctmul64 engine, and the CLMUL one if any, absorbing the
+         * ciphertext in random pieces */
+        for (engine = 0; result && engine < 2; engine++)
+        {
+            (void)aes256_use_hardware(engine == 1);
+            aes256gcm_init(&gcm, aad, aad_len, nonce, key);
+            for (offset = 0; offset < c_len; offset += chunk)
+            {
+                bdap_randombytes((uint8_t *)&chunk, sizeof(chunk));
+                chunk = 1 + chunk % (c_len - offset);
+                aes256gcm_authenticate(&gcm, c + offset, chunk);
+            }
+            result = (0 == aes256gcm_verify(&gcm, tag));
+            aes256gcm_wipe(&gcm);
+        }
+    }
+
+    (void)aes256_use_hardware(hardware);
+
+    return result;
+}
+
+bool aes256gcm_parallel_test(int iterations)
+{
+    static uint8_t msg[5 * 1024 * 1024 + 13];
+    static uint8_t c_serial[sizeof(msg) + AES256GCM_TAG_SIZE];
+    static uint8_t c_parallel[sizeof(msg) + AES256GCM_TAG_SIZE];
+    static uint8_t decrypted[sizeof(msg)];
+    int32_t it, engine;
+    bool result = true;
+    bool hardware = aes256_hardware_enabled();
+    size_t msg_len, aad_len, c_len, m_len;
+    uint8_t key[AES256GCM_KEY_SIZE];
+    uint8_t iv[AES256GCM_NONCE_SIZE];
+    uint8_t aad[64];
+    bdap_thread_pool pool;
+    uint8_t seed[] = {
+        0x2c, 0x91, 0x4e, 0xd7, 0x08, 0x6b, 0xf5, 0x33,
+        0xa0, 0x1d, 0xc8, 0x72, 0x5e, 0xb9, 0x46, 0x0f,
+        0xe3, 0x87, 0x1a, 0x6c, 0xd4, 0x39, 0x95, 0x50
+    };
+
+    if (false == bdap_thread_pool_init(&pool, 3))
+    {
+        return false;
+    }
+
+    bdap_randominit(seed, sizeof(seed));
+    bdap_randombytes(msg, sizeof(msg));
+
+    for (engine = 0; result && engine < 2; engine++)
+    {
+        (void)aes256_use_hardware(engine == 1);
+
+        /* The last iteration uses more than the maximum number of segments */
+        for (it = 0; result && it <= iterations; it++)
+        {
+            bdap_randombytes(key, sizeof(key));
+            bdap_randombytes(iv, sizeof(iv));
+            bdap_randombytes(aad, sizeof(aad));
+            bdap_randombytes((uint8_t *)&msg_len, sizeof(msg_len));
+            bdap_randombytes((uint8_t *)&aad_len, sizeof(aad_len));
+            msg_len = (it < iterations) ? msg_len % (80 * 1024) : sizeof(msg);
+            aad_len %= sizeof(aad) + 1;
+
+            aes256gcm_encrypt(c_serial, &c_len, msg, msg_len,
+                              aad, aad_len, iv, key);
+            aes256gcm_encrypt_parallel(c_parallel, &c_len, msg, msg_len,
+                                       aad, aad_len, iv, key, &pool);
+            result = (memcmp(c_serial, c_parallel, c_len) == 0);
+            aes256gcm_encrypt_parallel(c_parallel, &c_len, msg, msg_len,
+                                       aad, aad_len, iv, key, NULL);
+            result = result && (memcmp(c_serial, c_parallel, c_len) == 0);
+
+            result = result && (0 == aes256gcm_decrypt_parallel(decrypted, &m_len,
+                                                                c_serial, c_len,
+                                                                aad, aad_len,
+                                                                iv, key, &pool));
+            result = result && (m_len == msg_len) &&
+                     (memcmp(decrypted, msg, m_len) == 0);
+
+            /* A forged ciphertext must be rejected */
+            c_parallel[(it * 7919) % c_len] ^= 0x01;
+            result = result && (0 != aes256gcm_decrypt_parallel(decrypted, &m_len,
+                                                                c_parallel, c_len,
+                                                                aad, aad_len,
+                                                                iv, key, &pool));
+        }
+    }
+
+    (void)aes256_use_hardware(hardware);
+    bdap_thread_pool_destroy(&pool);
+
+    return result;
+}
+
+bool aes256gcm_incremental_test(int iterations)
+{
+    int32_t it;
+    bool result = true;
+    size_t msg_len, aad_len, c_len, m_len, offset, chunk;
+    uint8_t key[AES256GCM_KEY_SIZE];
+    uint8_t iv[AES256GCM_NONCE_SIZE];
+    uint8_t msg[1024];
+    uint8_t aad[64];
+    uint8_t c_oneshot[sizeof(msg) + AES256GCM_TAG_SIZE];
+    uint8_t c_incremental[sizeof(msg) + AES256GCM_TAG_SIZE];
+    uint8_t decrypted[sizeof(msg)];
+    aes256gcm_ctx gcm;
+    uint8_t seed[] = {
+        0x71, 0xe2, 0x0c, 0x5d, 0xb8, 0x43, 0x9f, 0x26,
+        0xd1, 0x6a, 0x34, 0xc5, 0x0e, 0x87, 0xfb, 0x12,
+        0x58, 0xa9, 0x3d, 0xe6, 0x90, 0x27, 0x4b, 0xcc
+    };
+
+    bdap_randominit(seed, sizeof(seed));
+
+    for (it = 0; result && it < iterations; it++)
+    {
+        bdap_randombytes(key, sizeof(key));
+        bdap_randombytes(iv, sizeof(iv));
+        bdap_randombytes(msg, sizeof(msg));
+        bdap_randombytes(aad, sizeof(aad));
+        bdap_randombytes((uint8_t *)&msg_len, sizeof(msg_len));
+        bdap_randombytes((uint8_t *)&aad_len, sizeof(aad_len));
+        msg_len %= sizeof(msg) + 1;
+        aad_len %= sizeof(aad) + 1;
+
+        aes256gcm_encrypt(c_oneshot, &c_len, msg, msg_len,
+                          aad, aad_len, iv, key);
+
+        /* Encrypt in chunks of random sizes */
+        aes256gcm_init(&gcm, aad, aad_len, iv, key);
+        for (offset = 0; offset < msg_len; offset += chunk)
+        {
+            bdap_randombytes((uint8_t *)&chunk, sizeof(chunk));
+            chunk %= 70;
+            if (chunk > msg_len - offset)
+            {
+                chunk = msg_len - offset;
+            }
+            aes256gcm_encrypt_update(&gcm, c_incremental + offset,
+                                     msg + offset, chunk);
+        }
+        aes256gcm_encrypt_final(&gcm, c_incremental + msg_len);
+        result = (memcmp(c_oneshot, c_incremental, c_len) == 0);
+
+        /* Nothing is decrypted before the tag is verified */
+        aes256gcm_init(&gcm, aad, aad_len, iv, key);
+        result = result && (0 != aes256gcm_decrypt_update(&gcm, decrypted,
+                                                          c_oneshot, msg_len));
+        for (offset = 0; offset < msg_len; offset += chunk)
+        {
+            chunk = (msg_len - offset < 33) ? msg_len - offset : 33;
+            aes256gcm_authenticate(&gcm, c_oneshot + offset, chunk);
+        }
+        result = result && (0 == aes256gcm_verify(&gcm, c_oneshot + msg_len));
+        for (offset = 0, m_len = 0; offset < msg_len; offset += chunk)
+        {
+            chunk = (msg_len - offset < 47) ? msg_len - offset : 47;
+            result = result && (0 == aes256gcm_decrypt_update(&gcm,
+                                                              decrypted + offset,
+                                                              c_oneshot + offset,
+                                                              chunk));
+            m_len += chunk;
+        }
+        aes256gcm_wipe(&gcm);
+        result = result && (m_len == msg_len) &&
+                 (memcmp(decrypted, msg, m_len) == 0);
+
+        /* A forged tag must be rejected */
+        c_oneshot[msg_len] ^= 0x80;
+        aes256gcm_init(&gcm, aad, aad_len, iv, key);
+        aes256gcm_authenticate(&gcm, c_oneshot, msg_len);
+        result = result && (0 != aes256gcm_verify(&gcm, c_oneshot + msg_len));
+        result = result && (0 != aes256gcm_decrypt_update(&gcm, decrypted,
+                                                          c_oneshot, msg_len));
+        aes256gcm_wipe(&gcm);
+    }
+
+    return result;
+}
+
+/**
+ * The incremental context refuses to run its 32-bit counter past
+ * AES256GCM_MAX_MSG_SIZE bytes, and so do the one-shot methods.
+ */
+bool aes256gcm_length_limit_test(void)
+{
+    uint8_t key[AES256GCM_KEY_SIZE] = {0};
+    uint8_t iv[AES256GCM_NONCE_SIZE] = {0};
+    uint8_t msg[32] = {0};
+    uint8_t c[sizeof(msg)];
+    size_t c_len;
+    aes256gcm_ctx gcm;
+    bool result = true;
+
+    /* Encryption stops 16 bytes short of the limit */
+    aes256gcm_init(&gcm, NULL, 0, iv, key);
+    gcm.msg_len = AES256GCM_MAX_MSG_SIZE - 16;
+    gcm.index = (uint32_t)(AES256GCM_MAX_MSG_SIZE / 16);
+    result = result && (0 != aes256gcm_encrypt_update(&gcm, c, msg, 17));
+    result = result && (gcm.msg_len == AES256GCM_MAX_MSG_SIZE - 16);
+    result = result && (0 == aes256gcm_encrypt_update(&gcm, c, msg, 15));
+    result = result && (0 == aes256gcm_encrypt_update(&gcm, c, msg, 1));
+    result = result && (gcm.index == UINT32_MAX);
+    result = result && (0 != aes256gcm_encrypt_update(&gcm, c, msg, 1));
+    aes256gcm_wipe(&gcm);
+
+    /* So do both passes of a decryption */
+    aes256gcm_init(&gcm, NULL, 0, iv, key);
+    gcm.msg_len = AES256GCM_MAX_MSG_SIZE - 16;
+    result = result && (0 != aes256gcm_authenticate(&gcm, c, 17));
+    result = result && (0 == aes256gcm_authenticate(&gcm, c, 16));
+    gcm.verified = true;
+    gcm.index = (uint32_t)(AES256GCM_MAX_MSG_SIZE / 16);
+    result = result && (0 != aes256gcm_decrypt_update(&gcm, msg, c, 17));
+    result = result && (0 != aes256gcm_decrypt_skip(&gcm, 17));
+    result = result && (0 == aes256gcm_decrypt_skip(&gcm, 8));
+    result = result && (0 == aes256gcm_decrypt_update(&gcm, msg, c, 8));
+    result = result && (0 != aes256gcm_decrypt_update(&gcm, msg, c, 1));
+    aes256gcm_wipe(&gcm);
+
+    /* Messages too long to be read at all */
+    if ((uint64_t)SIZE_MAX > AES256GCM_MAX_MSG_SIZE)
+    {
+        result = result &&
+            (0 != aes256gcm_encrypt(c, &c_len, msg,
+                                    (size_t)AES256GCM_MAX_MSG_SIZE + 1,
+                                    NULL, 0, iv, key)) &&
+            (0 != aes256gcm_decrypt(msg, &c_len, c,
+                                    (size_t)AES256GCM_MAX_MSG_SIZE + 17,
+                                    NULL, 0, iv, key)) &&
+            (0 != aes256gcm_encrypt_parallel(c, &c_len, msg,
+                                             (size_t)AES256GCM_MAX_MSG_SIZE + 1,
+                                             NULL, 0, iv, key, NULL)) &&
+            (0 != aes256gcm_decrypt_parallel(msg, &c_len, c,
+                                             (size_t)AES256GCM_MAX_MSG_SIZE + 17,
+                                             NULL, 0, iv, key, NULL));
+    }
+
+    return result;
+}
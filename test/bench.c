@@ -0,0 +1,603 @@
+// Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
+// See LICENSE.md file for license, copying and use information.
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+# define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+#include "encryption_core.h"
+#include "encryption_error.h"
+#include "aes256gcm.h"
+#include "ed25519.h"
+#include "fingerprint.h"
+#include "rand.h"
+#include "shake256.h"
+#include "thread_pool.h"
+
+#define NUM_MESSAGES        512
+#define NUM_RECIPIENTS      4
+#define PAYLOAD_SIZE        1024
+#define NUM_BROADCAST       10000
+#define LARGE_PAYLOAD_SIZE  (16 * 1024 * 1024)
+#define NUM_SLOTS           65535
+#define NUM_SCANS           200
+#define NUM_SENDS           256
+#define NUM_HOT_RECIPIENTS  64
+#define NUM_KDF_CALLS       200000
+#define NUM_REFILLS         2000
+#define REFILL_SIZE         4096
+
+static double now(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter, frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+#endif
+}
+
+/**
+ * Measures the throughput of bdap_decrypt_batch in messages per second
+ * for 1 to N threads, N being the number of processors unless given as
+ * the first argument.
+ */
+static bool bench_decrypt_batch(uint32_t max_threads)
+{
+    static uint8_t ciphertexts[NUM_MESSAGES][
+        2 + 32 + NUM_RECIPIENTS*(BDAP_FINGERPRINT_SIZE + 32) + PAYLOAD_SIZE + 16];
+    static uint8_t plaintexts[NUM_MESSAGES][PAYLOAD_SIZE];
+    uint8_t *plaintext_ptrs[NUM_MESSAGES];
+    const uint8_t *ciphertext_ptrs[NUM_MESSAGES];
+    size_t ciphertext_sizes[NUM_MESSAGES];
+    uint16_t status[NUM_MESSAGES];
+    uint8_t seeds[NUM_RECIPIENTS][ED25519_PRIVATE_KEY_SEED_SIZE];
+    uint8_t pks[NUM_RECIPIENTS][ED25519_PUBLIC_KEY_SIZE];
+    const uint8_t *pk_ptrs[NUM_RECIPIENTS];
+    uint8_t payload[PAYLOAD_SIZE];
+    bdap_decrypt_key key;
+    bdap_thread_pool pool;
+    const char *error_message;
+    double start, elapsed, single = 0.0;
+    uint32_t i, threads;
+    bool result = false;
+
+    for (i = 0; i < NUM_RECIPIENTS; ++i)
+    {
+        bdap_randombytes(seeds[i], sizeof(seeds[i]));
+        ed25519_public_key_from_private_key_seed(pks[i], seeds[i]);
+        pk_ptrs[i] = pks[i];
+    }
+
+    for (i = 0; i < NUM_MESSAGES; ++i)
+    {
+        bdap_randombytes(payload, sizeof(payload));
+        if (!bdap_encrypt(ciphertexts[i], NUM_RECIPIENTS, pk_ptrs,
+                          payload, sizeof(payload), &error_message))
+        {
+            printf("Encryption failed: %s\n", error_message);
+            return false;
+        }
+        plaintext_ptrs[i] = plaintexts[i];
+        ciphertext_ptrs[i] = ciphertexts[i];
+        ciphertext_sizes[i] = sizeof(ciphertexts[i]);
+    }
+
+    if (!bdap_decrypt_key_init(&key, seeds[NUM_RECIPIENTS - 1], &error_message))
+    {
+        printf("Key derivation failed: %s\n", error_message);
+        goto bench_decrypt_batch_bail;
+    }
+
+    printf("bdap_decrypt_batch, %d messages of %d bytes, %d recipients\n",
+           NUM_MESSAGES, PAYLOAD_SIZE, NUM_RECIPIENTS);
+    for (threads = 1; threads <= max_threads; ++threads)
+    {
+        if (!bdap_thread_pool_init(&pool, threads))
+        {
+            printf("Thread pool creation failed\n");
+            goto bench_decrypt_batch_bail;
+        }
+
+        start = now();
+        result = bdap_decrypt_batch(plaintext_ptrs, status, &key,
+                                    ciphertext_ptrs, ciphertext_sizes,
+                                    NUM_MESSAGES, &pool);
+        elapsed = now() - start;
+        bdap_thread_pool_destroy(&pool);
+
+        if (!result)
+        {
+            printf("Decryption failed: %s\n", bdap_error_message[status[0]]);
+            goto bench_decrypt_batch_bail;
+        }
+        if (threads == 1)
+        {
+            single = elapsed;
+        }
+        printf("  %2u thread(s): %10.0f messages/s, speed-up %.2f\n",
+               threads, NUM_MESSAGES / elapsed, single / elapsed);
+    }
+
+bench_decrypt_batch_bail:
+    bdap_decrypt_key_wipe(&key);
+
+    return result;
+}
+
+/**
+ * Measures the latency of bdap_encrypt_parallel for a broadcast to
+ * NUM_BROADCAST recipients, for 1 to N threads.
+ */
+static bool bench_encrypt_parallel(uint32_t max_threads)
+{
+    static uint8_t ciphertext[
+        2 + 32 + NUM_BROADCAST*(BDAP_FINGERPRINT_SIZE + 32) + PAYLOAD_SIZE + 16];
+    static uint8_t pks[NUM_BROADCAST][ED25519_PUBLIC_KEY_SIZE];
+    static const uint8_t *pk_ptrs[NUM_BROADCAST];
+    uint8_t seed[ED25519_PRIVATE_KEY_SEED_SIZE];
+    uint8_t payload[PAYLOAD_SIZE];
+    bdap_thread_pool pool;
+    const char *error_message;
+    double start, elapsed, single = 0.0;
+    uint32_t i, threads;
+    bool result;
+
+    for (i = 0; i < NUM_BROADCAST; ++i)
+    {
+        bdap_randombytes(seed, sizeof(seed));
+        ed25519_public_key_from_private_key_seed(pks[i], seed);
+        pk_ptrs[i] = pks[i];
+    }
+    bdap_randombytes(payload, sizeof(payload));
+
+    printf("bdap_encrypt_parallel, %d bytes to %d recipients\n",
+           PAYLOAD_SIZE, NUM_BROADCAST);
+    for (threads = 1; threads <= max_threads; ++threads)
+    {
+        if (!bdap_thread_pool_init(&pool, threads))
+        {
+            printf("Thread pool creation failed\n");
+            return false;
+        }
+
+        start = now();
+        result = bdap_encrypt_parallel(ciphertext, NUM_BROADCAST, pk_ptrs,
+                                       payload, sizeof(payload), &pool,
+                                       &error_message);
+        elapsed = now() - start;
+        bdap_thread_pool_destroy(&pool);
+
+        if (!result)
+        {
+            printf("Encryption failed: %s\n", error_message);
+            return false;
+        }
+        if (threads == 1)
+        {
+            single = elapsed;
+        }
+        printf("  %2u thread(s): %10.2f ms, speed-up %.2f\n",
+               threads, 1e3 * elapsed, single / elapsed);
+    }
+
+    return true;
+}
+
+/**
+ * Measures the throughput of aes256gcm_encrypt_parallel on a
+ * LARGE_PAYLOAD_SIZE bytes message, for 1 to N threads.
+ */
+static bool bench_gcm_parallel(uint32_t max_threads)
+{
+    static uint8_t msg[LARGE_PAYLOAD_SIZE];
+    static uint8_t c[LARGE_PAYLOAD_SIZE + AES256GCM_TAG_SIZE];
+    uint8_t key[AES256GCM_KEY_SIZE];
+    uint8_t nonce[AES256GCM_NONCE_SIZE];
+    bdap_thread_pool pool;
+    double start, elapsed, single = 0.0;
+    uint32_t threads;
+    size_t c_len;
+
+    bdap_randombytes(msg, sizeof(msg));
+    bdap_randombytes(key, sizeof(key));
+    bdap_randombytes(nonce, sizeof(nonce));
+
+    printf("aes256gcm_encrypt_parallel, %d bytes\n", LARGE_PAYLOAD_SIZE);
+    for (threads = 1; threads <= max_threads; ++threads)
+    {
+        if (!bdap_thread_pool_init(&pool, threads))
+        {
+            printf("Thread pool creation failed\n");
+            return false;
+        }
+
+        start = now();
+        (void)aes256gcm_encrypt_parallel(c, &c_len, msg, sizeof(msg),
+                                         NULL, 0, nonce, key, &pool);
+        elapsed = now() - start;
+        bdap_thread_pool_destroy(&pool);
+
+        if (threads == 1)
+        {
+            single = elapsed;
+        }
+        printf("  %2u thread(s): %10.1f MB/s, speed-up %.2f\n",
+               threads, sizeof(msg) / elapsed / 1e6, single / elapsed);
+    }
+
+    return true;
+}
+
+/**
+ * Measures the throughput of fingerprint_find on a NUM_SLOTS slots
+ * table without a match, for each engine, with and without the
+ * constant-time option.
+ */
+static bool bench_fingerprint_scan(void)
+{
+    static uint8_t slots[NUM_SLOTS * (BDAP_FINGERPRINT_SIZE + 32)];
+    const size_t stride = BDAP_FINGERPRINT_SIZE + 32;
+    const bool hardware = fingerprint_hardware_enabled();
+    uint8_t fingerprint[BDAP_FINGERPRINT_SIZE] = {0};
+    double start, elapsed;
+    size_t found = 0;
+    uint32_t i, engine, constant_time;
+
+    bdap_randombytes(slots, sizeof(slots));
+    for (i = 0; i < NUM_SLOTS; ++i)
+    {
+        slots[i * stride] |= 1;
+    }
+
+    printf("fingerprint_find, %d slots\n", NUM_SLOTS);
+    for (engine = 0; engine < 2; ++engine)
+    {
+        (void)fingerprint_use_hardware(engine == 0);
+        for (constant_time = 0; constant_time < 2; ++constant_time)
+        {
+            start = now();
+            for (i = 0; i < NUM_SCANS; ++i)
+            {
+                found += fingerprint_find(slots, NUM_SLOTS, stride,
+                                          fingerprint, constant_time == 1);
+            }
+            elapsed = now() - start;
+            printf("  %-8s %-13s: %10.1f M slots/s\n",
+                   engine == 0 ? "simd" : "portable",
+                   constant_time ? "constant-time" : "early-exit",
+                   (double)NUM_SCANS * NUM_SLOTS / elapsed / 1e6);
+        }
+    }
+    (void)fingerprint_use_hardware(hardware);
+
+    return found == (size_t)4 * NUM_SCANS * NUM_SLOTS;
+}
+
+/*** The keccak-tiny SHAKE256 that src/shake256.c replaced, kept as
+ *** the baseline of bench_shake256. ***/
+static const uint8_t tiny_rho[24] =
+{    1,  3,  6, 10, 15, 21, 28, 36, 45, 55,  2, 14,
+    27, 41, 56,  8, 25, 43, 62, 18, 39, 61, 20, 44
+};
+static const uint8_t tiny_pi[24] =
+{   10,  7, 11, 17, 18,  3,  5, 16,  8, 21, 24,  4,
+    15, 23, 19, 13, 12,  2, 20, 14, 22,  9,  6,  1
+};
+static const uint64_t tiny_RC[24] =
+{   1ULL, 0x8082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x808bULL, 0x80000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x8aULL, 0x88ULL, 0x80008009ULL, 0x8000000aULL,
+    0x8000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x80000001ULL, 0x8000000080008008ULL
+};
+
+#define tiny_rol(x, s) (((x) << s) | ((x) >> (64 - s)))
+#define TINY_REPEAT6(e) e e e e e e
+#define TINY_REPEAT24(e) TINY_REPEAT6(e e e e)
+#define TINY_REPEAT5(e) e e e e e
+#define TINY_FOR5(v, s, e) \
+    v = 0;                 \
+    TINY_REPEAT5(e; v += s;)
+
+static void tiny_keccakf(void* state)
+{
+    uint64_t* a = (uint64_t*)state;
+    uint64_t b[5] = {0};
+    uint64_t t = 0;
+    uint8_t x, y, i = 0;
+
+    TINY_REPEAT24(
+        TINY_FOR5(x, 1,
+             b[x] = 0;
+             TINY_FOR5(y, 5,
+                  b[x] ^= a[x + y]; ))
+        TINY_FOR5(x, 1,
+             TINY_FOR5(y, 5,
+                  a[y + x] ^= b[(x + 4) % 5] ^ tiny_rol(b[(x + 1) % 5], 1); ))
+        t = a[1];
+        x = 0;
+        TINY_REPEAT24(b[0] = a[tiny_pi[x]];
+                      a[tiny_pi[x]] = tiny_rol(t, tiny_rho[x]);
+                      t = b[0];
+                      x++;)
+        TINY_FOR5(y, 5,
+             TINY_FOR5(x, 1,
+                  b[x] = a[y + x];)
+             TINY_FOR5(x, 1,
+                  a[y + x] = b[x] ^ ((~b[(x + 1) % 5]) & b[(x + 2) % 5]); ))
+        a[0] ^= tiny_RC[i];
+        i++; )
+}
+
+static void tiny_shake256(uint8_t* out, size_t out_len,
+                          const uint8_t* in, size_t in_len)
+{
+    uint64_t lanes[25] = {0};
+    uint8_t* a = (uint8_t*)lanes;
+    size_t i;
+
+    for (; in_len >= SHAKE256_RATE; in_len -= SHAKE256_RATE, in += SHAKE256_RATE)
+    {
+        for (i = 0; i < SHAKE256_RATE; ++i)
+        {
+            a[i] ^= in[i];
+        }
+        tiny_keccakf(a);
+    }
+    a[in_len] ^= 0x1f;
+    a[SHAKE256_RATE - 1] ^= 0x80;
+    for (i = 0; i < in_len; ++i)
+    {
+        a[i] ^= in[i];
+    }
+    tiny_keccakf(a);
+    for (; out_len >= SHAKE256_RATE; out_len -= SHAKE256_RATE, out += SHAKE256_RATE)
+    {
+        memcpy(out, a, SHAKE256_RATE);
+        tiny_keccakf(a);
+    }
+    memcpy(out, a, out_len);
+}
+
+/**
+ * Measures SHAKE256 with the keccak-tiny permutation and with the
+ * unrolled, lane-complemented one: the per-recipient key derivation,
+ * 96 bytes in and 48 out, both from a concatenation buffer and
+ * absorbed piece by piece, and the refill of the SHAKE256-based
+ * generator, 4 KiB in and out.
+ */
+static bool bench_shake256(void)
+{
+    static uint8_t refill[3][REFILL_SIZE];
+    uint8_t in[96], out[2][48];
+    shake256_ctx xof;
+    double start, elapsed;
+    uint32_t i;
+    bool result;
+
+    bdap_randombytes(in, sizeof(in));
+    bdap_randombytes(refill[2], sizeof(refill[2]));
+
+    printf("shake256, key derivation (96 bytes in, 48 out)\n");
+    start = now();
+    for (i = 0; i < NUM_KDF_CALLS; ++i)
+    {
+        tiny_shake256(out[0], sizeof(out[0]), in, sizeof(in));
+        in[0] ^= out[0][0];
+    }
+    elapsed = now() - start;
+    printf("  keccak-tiny  : %10.2f M calls/s\n", NUM_KDF_CALLS / elapsed / 1e6);
+
+    bdap_randombytes(in, sizeof(in));
+    start = now();
+    for (i = 0; i < NUM_KDF_CALLS; ++i)
+    {
+        (void)shake256(out[1], sizeof(out[1]), in, sizeof(in));
+        in[0] ^= out[1][0];
+    }
+    elapsed = now() - start;
+    printf("  unrolled     : %10.2f M calls/s\n", NUM_KDF_CALLS / elapsed / 1e6);
+
+    start = now();
+    for (i = 0; i < NUM_KDF_CALLS; ++i)
+    {
+        shake256_init(&xof);
+        (void)shake256_absorb(&xof, in, 32);
+        (void)shake256_absorb(&xof, in + 32, 32);
+        (void)shake256_absorb(&xof, in + 64, 32);
+        (void)shake256_finalize(&xof);
+        (void)shake256_squeeze(&xof, out[1], sizeof(out[1]));
+        in[0] ^= out[1][0];
+    }
+    elapsed = now() - start;
+    printf("  incremental  : %10.2f M calls/s\n", NUM_KDF_CALLS / elapsed / 1e6);
+
+    printf("shake256, generator refill (%d bytes in and out)\n", REFILL_SIZE);
+    memcpy(refill[0], refill[2], sizeof(refill[0]));
+    start = now();
+    for (i = 0; i < NUM_REFILLS; ++i)
+    {
+        memcpy(refill[1], refill[0], sizeof(refill[0]));
+        tiny_shake256(refill[0], sizeof(refill[0]), refill[1], sizeof(refill[1]));
+    }
+    elapsed = now() - start;
+    printf("  keccak-tiny  : %10.1f MB/s\n",
+           (double)NUM_REFILLS * REFILL_SIZE / elapsed / 1e6);
+
+    memcpy(refill[1], refill[2], sizeof(refill[1]));
+    start = now();
+    for (i = 0; i < NUM_REFILLS; ++i)
+    {
+        shake256_init(&xof);
+        (void)shake256_absorb(&xof, refill[1], sizeof(refill[1]));
+        (void)shake256_finalize(&xof);
+        (void)shake256_squeeze(&xof, refill[1], sizeof(refill[1]));
+    }
+    elapsed = now() - start;
+    printf("  unrolled     : %10.1f MB/s\n",
+           (double)NUM_REFILLS * REFILL_SIZE / elapsed / 1e6);
+    shake256_wipe(&xof);
+
+    /* Both chains of outputs, started from the same seed, agree */
+    result = memcmp(refill[0], refill[1], sizeof(refill[0])) == 0;
+    tiny_shake256(out[0], sizeof(out[0]), in, sizeof(in));
+    (void)shake256(out[1], sizeof(out[1]), in, sizeof(in));
+
+    return result && memcmp(out[0], out[1], sizeof(out[0])) == 0;
+}
+
+/**
+ * Sorts latencies in ascending order.
+ */
+static int compare_latency(const void* a, const void* b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Measures the median and 99th percentile latencies of sending
+ * NUM_SENDS messages to a set of NUM_HOT_RECIPIENTS recipients, with
+ * headers computed on the spot by bdap_encrypt_to_set and taken from
+ * a full header pool by bdap_encrypt_with_pool.
+ */
+static bool bench_header_pool(void)
+{
+    static uint8_t ciphertext[
+        2 + 32 + NUM_HOT_RECIPIENTS*(BDAP_FINGERPRINT_SIZE + 32) + PAYLOAD_SIZE + 16];
+    static uint8_t storage[NUM_SENDS * (
+        AES256GCM_KEY_SIZE + AES256GCM_NONCE_SIZE + 2 + 32
+        + NUM_HOT_RECIPIENTS*(BDAP_FINGERPRINT_SIZE + 32))];
+    static double latencies[NUM_SENDS];
+    uint8_t pks[NUM_HOT_RECIPIENTS][ED25519_PUBLIC_KEY_SIZE];
+    const uint8_t *pk_ptrs[NUM_HOT_RECIPIENTS];
+    uint8_t seed[ED25519_PRIVATE_KEY_SEED_SIZE];
+    uint8_t payload[PAYLOAD_SIZE];
+    bdap_recipient recipients[NUM_HOT_RECIPIENTS];
+    bdap_recipient_set set;
+    bdap_header_producer producer;
+    bdap_header_pool pool;
+    const char *error_message;
+    double start;
+    uint32_t i, pooled;
+    bool result = true;
+
+    for (i = 0; i < NUM_HOT_RECIPIENTS; ++i)
+    {
+        bdap_randombytes(seed, sizeof(seed));
+        ed25519_public_key_from_private_key_seed(pks[i], seed);
+        pk_ptrs[i] = pks[i];
+    }
+    bdap_randombytes(payload, sizeof(payload));
+    if (!bdap_recipient_set_init(&set, recipients, NUM_HOT_RECIPIENTS,
+                                 pk_ptrs, &error_message))
+    {
+        printf("Recipient set preparation failed: %s\n", error_message);
+        return false;
+    }
+    if (!bdap_header_producer_init(&producer))
+    {
+        printf("Header producer creation failed\n");
+        return false;
+    }
+    if (!bdap_header_pool_init(&pool, &producer, &set, storage, NUM_SENDS,
+                               &error_message))
+    {
+        printf("Header pool creation failed: %s\n", error_message);
+        result = false;
+        goto bench_header_pool_bail;
+    }
+
+    printf("Send latency, %d bytes to %d recipients\n",
+           PAYLOAD_SIZE, NUM_HOT_RECIPIENTS);
+    for (pooled = 0; result && pooled < 2; ++pooled)
+    {
+        while (pooled && bdap_header_pool_available(&pool) < NUM_SENDS)
+        {
+        }
+        for (i = 0; result && i < NUM_SENDS; ++i)
+        {
+            start = now();
+            result = pooled ?
+                bdap_encrypt_with_pool(ciphertext, &pool, payload,
+                                       sizeof(payload), &error_message) :
+                bdap_encrypt_to_set(ciphertext, &set, payload,
+                                    sizeof(payload), &error_message);
+            latencies[i] = now() - start;
+        }
+        if (!result)
+        {
+            printf("Encryption failed: %s\n", error_message);
+            break;
+        }
+        qsort(latencies, NUM_SENDS, sizeof(double), compare_latency);
+        printf("  %-22s: p50 %8.1f us, p99 %8.1f us\n",
+               pooled ? "bdap_encrypt_with_pool" : "bdap_encrypt_to_set",
+               1e6 * latencies[NUM_SENDS / 2],
+               1e6 * latencies[NUM_SENDS * 99 / 100]);
+    }
+
+bench_header_pool_bail:
+    bdap_header_pool_wipe(&pool);
+    bdap_header_producer_destroy(&producer);
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t max_threads = bdap_num_cpus();
+
+    if (argc > 1)
+    {
+        max_threads = (uint32_t)atoi(argv[1]);
+    }
+    if (max_threads < 1)
+    {
+        max_threads = 1;
+    }
+
+    if (!bench_decrypt_batch(max_threads))
+    {
+        return 1;
+    }
+
+    if (!bench_encrypt_parallel(max_threads))
+    {
+        return 1;
+    }
+
+    if (!bench_gcm_parallel(max_threads))
+    {
+        return 1;
+    }
+
+    if (!bench_header_pool())
+    {
+        return 1;
+    }
+
+    if (!bench_shake256())
+    {
+        return 1;
+    }
+
+    return bench_fingerprint_scan() ? 0 : 1;
+}
@@ -303,3 +303,114 @@ bool curve25519_random_keypair_test()
 
     return result;
 }
+
+bool fe_batch_inv_test(int iterations)
+{
+    int32_t it;
+    size_t i, n;
+    bool result = true;
+    uint8_t bytes[CURVE25519_POINT_SIZE];
+    uint8_t expected[CURVE25519_POINT_SIZE];
+    uint8_t computed[CURVE25519_POINT_SIZE];
+    fe z[33], x[33], t;
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        bdap_randombytes((uint8_t *)&n, sizeof(n));
+        n = 1 + (n % 33);
+
+        for (i = 0; i < n; ++i)
+        {
+            bdap_randombytes(bytes, sizeof(bytes));
+            fe_frombytes(z[i], bytes);
+        }
+        /* A zero element must not disturb the others */
+        if (it & 1)
+        {
+            bdap_randombytes((uint8_t *)&i, sizeof(i));
+            fe_zero(z[i % n]);
+        }
+
+        fe_batch_inv(x, (const fe *)z, n);
+
+        for (i = 0; result && i < n; ++i)
+        {
+            fe_inv(t, z[i]);
+            fe_tobytes(expected, t);
+            fe_tobytes(computed, x[i]);
+            result = (memcmp(expected, computed, sizeof(expected)) == 0);
+        }
+    }
+
+    return result;
+}
+
+bool curve25519_dh_batch_test(int iterations)
+{
+    int32_t it;
+    size_t i, n;
+    bool result = true;
+    bool hardware = curve25519_hardware_enabled();
+    uint8_t scalar[CURVE25519_SCALAR_SIZE];
+    uint8_t points[11][CURVE25519_POINT_SIZE];
+    const uint8_t *p[11];
+    uint8_t expected[CURVE25519_POINT_SIZE];
+    uint8_t computed[CURVE25519_POINT_SIZE];
+    fe x[11], z[11], t;
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        bdap_randombytes((uint8_t *)&n, sizeof(n));
+        n = 1 + (n % 11);
+
+        bdap_randombytes(scalar, sizeof(scalar));
+        for (i = 0; i < n; ++i)
+        {
+            /* Points on the twist must also agree */
+            bdap_randombytes(points[i], sizeof(points[i]));
+            if (fe_has_small_order(points[i]))
+            {
+                points[i][0] = 9;
+            }
+            p[i] = points[i];
+        }
+
+        result = curve25519_dh_batch(x, z, scalar, p, n);
+
+        for (i = 0; result && i < n; ++i)
+        {
+            curve25519_use_hardware(false);
+            result = curve25519_dh(expected, scalar, p[i]);
+            curve25519_use_hardware(hardware);
+
+            fe_inv(t, z[i]);
+            fe_mul(t, x[i], t);
+            fe_tobytes(computed, t);
+            result = result &&
+                     (memcmp(expected, computed, sizeof(expected)) == 0);
+        }
+    }
+
+    return result;
+}
+
+bool curve25519_fixed_base_test(int iterations)
+{
+    static const uint8_t basepoint[CURVE25519_POINT_SIZE] = {9};
+    int32_t it;
+    bool result = true;
+    uint8_t scalar[CURVE25519_SCALAR_SIZE];
+    uint8_t expected[CURVE25519_POINT_SIZE];
+    uint8_t computed[CURVE25519_POINT_SIZE];
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        bdap_randombytes(scalar, sizeof(scalar));
+
+        result = curve25519_dh(expected, scalar, basepoint) &&
+                 curve25519_public_key_from_private_key(computed, scalar) &&
+                 (memcmp(expected, computed, sizeof(expected)) == 0);
+    }
+
+    return result;
+}
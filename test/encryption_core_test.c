@@ -2,12 +2,15 @@
 // See LICENSE.md file for license, copying and use information.
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "rand.h"
+#include "shake256_rand.h"
 #include "encryption_core.h"
 #include "ed25519.h"
 #include "curve25519.h"
+#include "fingerprint.h"
 #include "utils.h"
 
 const char *seed_pool[] = {
@@ -184,3 +187,721 @@ bool bdap_random_test()
 
     return result;
 }
+
+bool fingerprint_find_test(int iterations)
+{
+    static uint8_t slots[300 * 39];
+    const size_t stride = BDAP_FINGERPRINT_SIZE + 32;
+    const bool hardware = fingerprint_hardware_enabled();
+    uint8_t fingerprint[BDAP_FINGERPRINT_SIZE];
+    uint32_t r[4];
+    size_t num_slots, expected, i, engine, constant_time;
+    int32_t it;
+    bool result = true;
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        bdap_randombytes((uint8_t *)r, sizeof(r));
+        bdap_randombytes(slots, sizeof(slots));
+        bdap_randombytes(fingerprint, sizeof(fingerprint));
+        num_slots = r[0] % 301;
+
+        /* Plant near misses, differing in the last fingerprint byte,
+         * and up to two matches whose eighth byte differs */
+        for (i = 0; i < num_slots; i += 1 + r[1] % 7)
+        {
+            memcpy(slots + i * stride, fingerprint, BDAP_FINGERPRINT_SIZE);
+            slots[i * stride + BDAP_FINGERPRINT_SIZE - 1] ^= 0x80;
+        }
+        if (num_slots > 0 && (r[2] & 3) != 0)
+        {
+            memcpy(slots + (r[2] % num_slots) * stride, fingerprint, BDAP_FINGERPRINT_SIZE);
+            memcpy(slots + (r[3] % num_slots) * stride, fingerprint, BDAP_FINGERPRINT_SIZE);
+        }
+
+        for (expected = 0; expected < num_slots; ++expected)
+        {
+            if (memcmp(slots + expected * stride, fingerprint, BDAP_FINGERPRINT_SIZE) == 0)
+            {
+                break;
+            }
+        }
+
+        for (engine = 0; engine < 2; ++engine)
+        {
+            (void)fingerprint_use_hardware(engine == 0);
+            for (constant_time = 0; constant_time < 2; ++constant_time)
+            {
+                result = result && (expected == fingerprint_find(slots,
+                                                                 num_slots,
+                                                                 stride,
+                                                                 fingerprint,
+                                                                 constant_time == 1));
+            }
+        }
+    }
+    (void)fingerprint_use_hardware(hardware);
+
+    return result;
+}
+
+bool bdap_header_view_test(int iterations)
+{
+    static uint8_t ciphertext[8192];
+    static uint8_t plaintext[3000];
+    uint8_t ed25519_pk[40][ED25519_PUBLIC_KEY_SIZE];
+    uint8_t ed25519_sk[ED25519_PRIVATE_KEY_SIZE];
+    uint8_t fingerprint[BDAP_FINGERPRINT_SIZE];
+    const uint8_t *ed25519_pk_ptr[40];
+    const uint8_t *f;
+    const char *error_message = NULL;
+    bdap_header_view view;
+    uint32_t r[2];
+    uint16_t i, num_recipients;
+    size_t plaintext_size, ciphertext_size, preamble_size;
+    int32_t it;
+    bool result = true;
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        bdap_randombytes((uint8_t *)r, sizeof(r));
+        num_recipients = (uint16_t)(1 + r[0] % 40);
+        plaintext_size = r[1] % (sizeof(plaintext) + 1);
+        preamble_size = (it % 2) ? BDAP_V2_PREAMBLE_SIZE : 0;
+        for (i = 0; i < num_recipients; ++i)
+        {
+            ed25519_keypair(ed25519_pk[i], ed25519_sk);
+            ed25519_pk_ptr[i] = ed25519_pk[i];
+        }
+        bdap_randombytes(plaintext, plaintext_size);
+
+        if (it % 2)
+        {
+            ciphertext_size = bdap_ciphertext_size_v2(num_recipients,
+                                                      plaintext_size,
+                                                      BDAP_V2_MIN_SEGMENT_SIZE);
+            result = bdap_encrypt_v2(ciphertext, num_recipients, ed25519_pk_ptr,
+                                     plaintext, plaintext_size,
+                                     BDAP_V2_MIN_SEGMENT_SIZE, NULL, &error_message);
+        }
+        else
+        {
+            ciphertext_size = bdap_ciphertext_size(num_recipients, plaintext_size);
+            result = bdap_encrypt(ciphertext, num_recipients, ed25519_pk_ptr,
+                                  plaintext, plaintext_size, &error_message);
+        }
+
+        /* The view points into the ciphertext and spans all of it */
+        result = result && bdap_header_view_init(&view, ciphertext,
+                                                 ciphertext_size, &error_message);
+        result = result &&
+            view.version == ((it % 2) ? 2 : 1) &&
+            view.num_recipients == num_recipients &&
+            view.ephemeral_public_key == ciphertext + preamble_size + 2 &&
+            view.sorted &&
+            view.payload_offset == preamble_size + bdap_header_size(ciphertext + preamble_size) &&
+            view.payload_offset + view.payload_size == ciphertext_size &&
+            bdap_header_view_fingerprint(&view, num_recipients) == NULL;
+
+        /* Every recipient is found, sorted or not, and nobody else */
+        for (i = 0; result && i < 2 * num_recipients; ++i)
+        {
+            if (i == num_recipients)
+            {
+                ciphertext[preamble_size + 2 + CURVE25519_PUBLIC_KEY_SIZE - 1] ^= 0x80;
+                result = bdap_header_view_init(&view, ciphertext,
+                                               ciphertext_size, &error_message) &&
+                    !view.sorted;
+            }
+            f = bdap_header_view_fingerprint(&view, i % num_recipients);
+            result = result && f != NULL &&
+                bdap_has_recipient(&view, ed25519_pk[i % num_recipients]) &&
+                bdap_has_recipient(&view, f);
+        }
+        bdap_randombytes(fingerprint, sizeof(fingerprint));
+        result = result && !bdap_has_recipient(&view, fingerprint);
+
+        /* A malformed ciphertext has no view */
+        result = result && !bdap_header_view_init(&view, ciphertext, 1, &error_message);
+    }
+
+    return result;
+}
+
+bool bdap_add_recipients_test(int iterations)
+{
+    static uint8_t ciphertext[16384];
+    static uint8_t extended[16384];
+    static uint8_t plaintext[3000];
+    static uint8_t decrypted[3000];
+    uint8_t ed25519_pk[60][ED25519_PUBLIC_KEY_SIZE];
+    uint8_t ed25519_sk[60][ED25519_PRIVATE_KEY_SIZE];
+    const uint8_t *ed25519_pk_ptr[60];
+    const char *error_message = NULL;
+    bdap_sealed_message sealed, other;
+    bdap_header_view view, extended_view;
+    uint32_t r[3];
+    uint16_t i, num_recipients, num_added;
+    size_t plaintext_size, ciphertext_size, header_size, extended_size;
+    int32_t it;
+    bool result = true;
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        memset(&sealed, 0, sizeof(sealed));
+        memset(&other, 0, sizeof(other));
+        bdap_randombytes((uint8_t *)r, sizeof(r));
+        num_recipients = (uint16_t)(1 + r[0] % 30);
+        num_added = (uint16_t)(r[1] % 31);
+        plaintext_size = r[2] % (sizeof(plaintext) + 1);
+        for (i = 0; i < num_recipients + num_added; ++i)
+        {
+            ed25519_keypair(ed25519_pk[i], ed25519_sk[i]);
+            ed25519_pk_ptr[i] = ed25519_pk[i];
+        }
+        bdap_randombytes(plaintext, plaintext_size);
+
+        if (it % 2)
+        {
+            ciphertext_size = bdap_ciphertext_size_v2(num_recipients,
+                                                      plaintext_size,
+                                                      BDAP_V2_MIN_SEGMENT_SIZE);
+            result = bdap_encrypt_v2_sealed(ciphertext, &sealed, num_recipients,
+                                            ed25519_pk_ptr, plaintext, plaintext_size,
+                                            BDAP_V2_MIN_SEGMENT_SIZE, NULL,
+                                            &error_message);
+        }
+        else
+        {
+            ciphertext_size = bdap_ciphertext_size(num_recipients, plaintext_size);
+            result = bdap_encrypt_sealed(ciphertext, &sealed, num_recipients,
+                                         ed25519_pk_ptr, plaintext, plaintext_size,
+                                         &error_message);
+        }
+        result = result && bdap_header_view_init(&view, ciphertext,
+                                                 ciphertext_size, &error_message);
+
+        /* The new header followed by the unchanged payload */
+        header_size = bdap_added_header_size(&view, num_added);
+        extended_size = header_size + view.payload_size;
+        result = result && bdap_add_recipients(extended, &sealed, &view, num_added,
+                                               ed25519_pk_ptr + num_recipients,
+                                               &error_message);
+        if (result)
+        {
+            memcpy(extended + header_size,
+                   ciphertext + view.payload_offset,
+                   view.payload_size);
+        }
+        result = result && bdap_header_view_init(&extended_view, extended,
+                                                 extended_size, &error_message) &&
+            extended_view.num_recipients == num_recipients + num_added &&
+            extended_view.payload_offset == header_size &&
+            extended_view.sorted;
+        for (i = 1; result && i < extended_view.num_recipients; ++i)
+        {
+            result = memcmp(bdap_header_view_fingerprint(&extended_view, i - 1),
+                            bdap_header_view_fingerprint(&extended_view, i),
+                            BDAP_FINGERPRINT_SIZE) <= 0;
+        }
+
+        /* Old and new recipients all read the same plaintext */
+        for (i = 0; result && i < num_recipients + num_added; ++i)
+        {
+            result = bdap_decrypt(decrypted, ed25519_sk[i], extended,
+                                  extended_size, &error_message) &&
+                memcmp(decrypted, plaintext, plaintext_size) == 0;
+        }
+
+        /* Another message's secrets are refused */
+        result = result && bdap_encrypt_sealed(decrypted, &other, 1,
+                                               ed25519_pk_ptr, plaintext, 0,
+                                               &error_message) &&
+            !bdap_add_recipients(extended, &other, &view, 1, ed25519_pk_ptr,
+                                 &error_message);
+
+        bdap_sealed_message_wipe(&sealed);
+        bdap_sealed_message_wipe(&other);
+    }
+
+    return result;
+}
+
+bool bdap_header_pool_test(int iterations)
+{
+    static uint8_t ciphertexts[12][2048];
+    static uint8_t storage[4 * 1024];
+    uint8_t ed25519_pk[8][ED25519_PUBLIC_KEY_SIZE];
+    uint8_t ed25519_sk[8][ED25519_PRIVATE_KEY_SIZE];
+    const uint8_t *ed25519_pk_ptr[8];
+    bdap_recipient recipients[8];
+    bdap_recipient_set set;
+    bdap_header_producer producer;
+    bdap_header_pool pool;
+    uint8_t plaintext[256], decrypted[256];
+    const char *error_message = NULL;
+    uint16_t i, j, num_recipients;
+    size_t ciphertext_size;
+    shake256_rng producer_state;
+    bdap_rng rng;
+    int32_t it;
+    bool started, result;
+
+    /* The producer draws from its own generator, from its own thread */
+    bdap_randombytes(plaintext, 32);
+    shake256_rng_init(&producer_state, plaintext, 32);
+    rng.randombytes = shake256_rng_randombytes;
+    rng.ctx = &producer_state;
+    started = bdap_header_producer_init_with_rng(&producer, &rng);
+    result = started;
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        num_recipients = (uint16_t)(1 + it % 8);
+        for (i = 0; i < num_recipients; ++i)
+        {
+            ed25519_keypair(ed25519_pk[i], ed25519_sk[i]);
+            ed25519_pk_ptr[i] = ed25519_pk[i];
+        }
+        ciphertext_size = bdap_ciphertext_size(num_recipients, sizeof(plaintext));
+        result = bdap_recipient_set_init(&set, recipients, num_recipients,
+                                         ed25519_pk_ptr, &error_message) &&
+            bdap_header_pool_storage_size(num_recipients, 4) <= sizeof(storage);
+
+        /* An empty pool is refused */
+        result = result && !bdap_header_pool_init(&pool, &producer, &set, storage,
+                                                  0, &error_message);
+        bdap_header_pool_wipe(&pool);
+
+        /* Wait for the pool to fill up, then drain it and go on
+         * with headers computed on the spot */
+        result = result && bdap_header_pool_init(&pool, &producer, &set, storage,
+                                                 4, &error_message);
+        while (result && bdap_header_pool_available(&pool) < 4)
+        {
+        }
+        for (i = 0; result && i < 12; ++i)
+        {
+            bdap_randombytes(plaintext, sizeof(plaintext));
+            result = bdap_encrypt_with_pool(ciphertexts[i], &pool, plaintext,
+                                            sizeof(plaintext), &error_message);
+            for (j = 0; result && j < num_recipients; ++j)
+            {
+                result = bdap_decrypt(decrypted, ed25519_sk[j], ciphertexts[i],
+                                      ciphertext_size, &error_message) &&
+                    memcmp(decrypted, plaintext, sizeof(plaintext)) == 0;
+            }
+        }
+
+        /* Every header is used once */
+        for (i = 0; result && i < 12; ++i)
+        {
+            for (j = 0; result && j < i; ++j)
+            {
+                result = memcmp(ciphertexts[i] + 2, ciphertexts[j] + 2,
+                                CURVE25519_PUBLIC_KEY_SIZE) != 0;
+            }
+        }
+        bdap_header_pool_wipe(&pool);
+    }
+
+    if (started)
+    {
+        bdap_header_producer_destroy(&producer);
+    }
+    shake256_rng_wipe(&producer_state);
+
+    return result;
+}
+
+/**
+ * The state of a thread of bdap_rng_test, encrypting with its own
+ * generator.
+ */
+typedef struct
+{
+    bdap_thread thread;
+    shake256_rng state;
+    bdap_rng rng;
+    const uint8_t **ed25519_pk_ptr;
+    uint16_t num_recipients;
+    const uint8_t *plaintext;
+    size_t plaintext_size;
+    uint8_t ciphertext[1024];
+    uint8_t ed25519_pk[ED25519_PUBLIC_KEY_SIZE];
+    uint8_t ed25519_sk[ED25519_PRIVATE_KEY_SIZE];
+    bool result;
+} bdap_rng_test_thread;
+
+static void bdap_rng_test_main(void *arg)
+{
+    bdap_rng_test_thread *t = (bdap_rng_test_thread *)arg;
+    int i;
+
+    for (i = 0; i < 4; ++i)
+    {
+        ed25519_keypair_with_rng(t->ed25519_pk, t->ed25519_sk, &t->rng);
+        t->result = bdap_encrypt_with_rng(t->ciphertext, t->num_recipients,
+                                          t->ed25519_pk_ptr, t->plaintext,
+                                          t->plaintext_size, &t->rng, NULL);
+    }
+}
+
+bool bdap_rng_test(int iterations)
+{
+    static bdap_rng_test_thread threads[4], serial;
+    uint8_t ed25519_pk[4][ED25519_PUBLIC_KEY_SIZE];
+    uint8_t ed25519_sk[ED25519_PRIVATE_KEY_SIZE];
+    const uint8_t *ed25519_pk_ptr[4];
+    uint8_t plaintext[256];
+    uint8_t seeds[4][32];
+    size_t ciphertext_size;
+    uint16_t i, started;
+    int32_t it;
+    bool result = true;
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        for (i = 0; i < 4; ++i)
+        {
+            ed25519_keypair(ed25519_pk[i], ed25519_sk);
+            ed25519_pk_ptr[i] = ed25519_pk[i];
+        }
+        bdap_randombytes(plaintext, sizeof(plaintext));
+        bdap_randombytes((uint8_t *)seeds, sizeof(seeds));
+        ciphertext_size = bdap_ciphertext_size(4, sizeof(plaintext));
+
+        /* Every thread draws from its own generator, without locks */
+        for (i = 0; i < 4; ++i)
+        {
+            shake256_rng_init(&threads[i].state, seeds[i], sizeof(seeds[i]));
+            threads[i].rng.randombytes = shake256_rng_randombytes;
+            threads[i].rng.ctx = &threads[i].state;
+            threads[i].ed25519_pk_ptr = ed25519_pk_ptr;
+            threads[i].num_recipients = 4;
+            threads[i].plaintext = plaintext;
+            threads[i].plaintext_size = sizeof(plaintext);
+            threads[i].result = false;
+        }
+        for (started = 0; started < 4; ++started)
+        {
+            if (!bdap_thread_create(&threads[started].thread,
+                                    bdap_rng_test_main,
+                                    &threads[started]))
+            {
+                result = false;
+                break;
+            }
+        }
+        for (i = 0; i < started; ++i)
+        {
+            bdap_thread_join(&threads[i].thread);
+        }
+
+        /* The same seeds give the same keys and ciphertexts on a
+         * single thread */
+        serial = threads[0];
+        for (i = 0; result && i < 4; ++i)
+        {
+            shake256_rng_init(&serial.state, seeds[i], sizeof(seeds[i]));
+            serial.rng.ctx = &serial.state;
+            bdap_rng_test_main(&serial);
+            result = threads[i].result && serial.result &&
+                memcmp(serial.ciphertext, threads[i].ciphertext, ciphertext_size) == 0 &&
+                memcmp(serial.ed25519_sk, threads[i].ed25519_sk, sizeof(ed25519_sk)) == 0;
+        }
+
+        /* A NULL context falls back to bdap_randombytes */
+        result = result && bdap_encrypt_with_rng(serial.ciphertext, 4, ed25519_pk_ptr,
+                                                 plaintext, sizeof(plaintext),
+                                                 NULL, NULL);
+        for (i = 0; i < 4; ++i)
+        {
+            shake256_rng_wipe(&threads[i].state);
+        }
+        shake256_rng_wipe(&serial.state);
+    }
+
+    return result;
+}
+
+static bool bdap_secure_memory_round_trip(void)
+{
+    uint8_t ed25519_pk[ED25519_PUBLIC_KEY_SIZE];
+    uint8_t ed25519_sk[ED25519_PRIVATE_KEY_SIZE];
+    const uint8_t *ed25519_pk_ptr[1] = {ed25519_pk};
+    uint8_t plaintext[100];
+    uint8_t ciphertext[256];
+    uint8_t decrypted[sizeof(plaintext)];
+    size_t ciphertext_size = bdap_ciphertext_size(1, sizeof(plaintext));
+    bool result;
+
+    ed25519_keypair(ed25519_pk, ed25519_sk);
+    bdap_randombytes(plaintext, sizeof(plaintext));
+
+    result = bdap_encrypt(ciphertext, 1, ed25519_pk_ptr,
+                          plaintext, sizeof(plaintext), NULL) &&
+             bdap_decrypt(decrypted, ed25519_sk,
+                          ciphertext, ciphertext_size, NULL) &&
+             memcmp(plaintext, decrypted, sizeof(plaintext)) == 0;
+
+    crypto_memzero(ed25519_sk, sizeof(ed25519_sk));
+
+    return result;
+}
+
+bool bdap_secure_memory_test(int iterations)
+{
+    static uint8_t* slots[CRYPTO_SECURE_MAX_SLOTS];
+    uint64_t words[5];
+    size_t i, j;
+    int32_t it;
+    bool result = true;
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        /* Word-sized wipes, with a tail that is not a whole word */
+        memset(words, 0xa5, sizeof(words));
+        crypto_memzero_aligned(words, sizeof(words) - 3);
+        for (i = 0; i < sizeof(words) - 3; ++i)
+        {
+            result = result && ((uint8_t *)words)[i] == 0;
+        }
+        for (; i < sizeof(words); ++i)
+        {
+            result = result && ((uint8_t *)words)[i] == 0xa5;
+        }
+
+        result = result && bdap_secure_memory_round_trip();
+        if (true != crypto_secure_init())
+        {
+            /* Locked memory is too scarce for the arena */
+            result = result && crypto_secure_alloc() == NULL;
+            continue;
+        }
+
+        /* Every slot is zeroed, aligned and distinct, the arena
+         * growing past its first chunk as long as memory can be locked */
+        for (i = 0; result && i < CRYPTO_SECURE_MAX_SLOTS; ++i)
+        {
+            slots[i] = crypto_secure_alloc();
+            if (slots[i] == NULL)
+            {
+                result = i >= CRYPTO_SECURE_CHUNK_SLOTS;
+                break;
+            }
+            result = ((uintptr_t)slots[i] & 7) == 0;
+            for (j = 0; result && j < CRYPTO_SECURE_SLOT_SIZE; ++j)
+            {
+                result = slots[i][j] == 0;
+            }
+            if (result)
+            {
+                memset(slots[i], (int)(i + 1), CRYPTO_SECURE_SLOT_SIZE);
+            }
+        }
+        for (j = 0; result && j < i; ++j)
+        {
+            result = slots[j][0] == (uint8_t)(j + 1) &&
+                     slots[j][CRYPTO_SECURE_SLOT_SIZE - 1] == (uint8_t)(j + 1);
+        }
+
+        /* An exhausted arena fails decryptions rather than locking the
+         * private-key in place */
+        result = result && crypto_secure_alloc() == NULL;
+        result = result && !bdap_secure_memory_round_trip();
+
+        for (j = 0; j < i; ++j)
+        {
+            crypto_secure_free(slots[j]);
+        }
+        crypto_secure_free(NULL);
+
+        /* Released slots come back wiped */
+        slots[0] = crypto_secure_alloc();
+        result = result && slots[0] != NULL;
+        for (j = 0; result && j < CRYPTO_SECURE_SLOT_SIZE; ++j)
+        {
+            result = slots[0][j] == 0;
+        }
+        crypto_secure_free(slots[0]);
+    }
+
+    return result;
+}
+
+/**
+ * Returns the amount of memory locked by the process in kB, or -1
+ * if it cannot be told.
+ */
+static long bdap_locked_kb(void)
+{
+    long kb = -1;
+#if defined(__linux__)
+    char line[128];
+    FILE* status = fopen("/proc/self/status", "r");
+
+    if (status == NULL)
+    {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), status) != NULL)
+    {
+        if (sscanf(line, "VmLck: %ld", &kb) == 1)
+        {
+            break;
+        }
+    }
+    fclose(status);
+#endif
+    return kb;
+}
+
+/**
+ * Seals two messages side by side at {@code storage}, the start of a
+ * page, and checks that wiping the first leaves the page locked.
+ */
+static bool bdap_nested_lock_sealed_test(uint8_t* storage, long before)
+{
+    static uint8_t ciphertext[256];
+    uint8_t ed25519_pk[ED25519_PUBLIC_KEY_SIZE];
+    uint8_t ed25519_sk[ED25519_PRIVATE_KEY_SIZE];
+    const uint8_t *ed25519_pk_ptr = ed25519_pk;
+    bdap_sealed_message *first, *second;
+    long locked;
+    bool result;
+
+    first = (bdap_sealed_message *)storage;
+    second = first + 1;
+    ed25519_keypair(ed25519_pk, ed25519_sk);
+
+    result = bdap_encrypt_sealed(ciphertext, first, 1, &ed25519_pk_ptr,
+                                 ed25519_pk, 0, NULL);
+    result = bdap_encrypt_sealed(ciphertext, second, 1, &ed25519_pk_ptr,
+                                 ed25519_pk, 0, NULL) && result;
+    locked = bdap_locked_kb();
+
+    bdap_sealed_message_wipe(first);
+    result = result && bdap_locked_kb() == locked;
+    bdap_sealed_message_wipe(second);
+    result = result && bdap_locked_kb() == before;
+    if (before >= 0)
+    {
+        result = result && locked > before;
+    }
+
+    crypto_memzero(ed25519_sk, sizeof(ed25519_sk));
+
+    return result;
+}
+
+/**
+ * Locks a key at {@code storage}, the start of a page, and a header
+ * pool whose storage starts on the same page and ends on the next,
+ * and checks that wiping the pool leaves the key's page locked.
+ */
+static bool bdap_nested_lock_pool_test(uint8_t* storage, long before)
+{
+    uint8_t seed[ED25519_PRIVATE_KEY_SEED_SIZE];
+    uint8_t ed25519_pk[ED25519_PUBLIC_KEY_SIZE];
+    const uint8_t *ed25519_pk_ptr = ed25519_pk;
+    bdap_recipient recipient;
+    bdap_recipient_set set;
+    bdap_header_producer producer;
+    bdap_header_pool pool;
+    bdap_decrypt_key *key;
+    long key_locked, locked;
+    bool result;
+
+    memset(&pool, 0, sizeof(pool));
+    key = (bdap_decrypt_key *)storage;
+    bdap_randombytes(seed, sizeof(seed));
+    ed25519_public_key_from_private_key_seed(ed25519_pk, seed);
+    result = bdap_decrypt_key_init(key, seed, NULL);
+    key_locked = bdap_locked_kb();
+
+    if (!bdap_header_producer_init(&producer))
+    {
+        bdap_decrypt_key_wipe(key);
+        return false;
+    }
+    result = result &&
+        bdap_recipient_set_init(&set, &recipient, 1, &ed25519_pk_ptr, NULL) &&
+        bdap_header_pool_init(&pool, &producer, &set,
+                              storage + 4096 - bdap_header_pool_storage_size(1, 1),
+                              2, NULL);
+    locked = bdap_locked_kb();
+    bdap_header_pool_wipe(&pool);
+    bdap_header_producer_destroy(&producer);
+
+    result = result && bdap_locked_kb() == key_locked;
+    bdap_decrypt_key_wipe(key);
+    result = result && bdap_locked_kb() == before;
+    if (before >= 0)
+    {
+        result = result && locked == key_locked + 4;
+    }
+
+    crypto_memzero(seed, sizeof(seed));
+
+    return result;
+}
+
+bool bdap_nested_lock_test(void)
+{
+    static uint8_t storage[5 * 4096];
+    uint8_t seed[ED25519_PRIVATE_KEY_SEED_SIZE];
+    bdap_decrypt_key *first, *second;
+    uint8_t *pages;
+    long before, locked;
+    bool result;
+
+    /* Two keys sharing a page */
+    pages = (uint8_t *)(((uintptr_t)storage + 4095) & ~(uintptr_t)4095);
+    first = (bdap_decrypt_key *)pages;
+    second = first + 1;
+
+    before = bdap_locked_kb();
+    bdap_randombytes(seed, sizeof(seed));
+    result = bdap_decrypt_key_init(first, seed, NULL);
+    bdap_randombytes(seed, sizeof(seed));
+    result = bdap_decrypt_key_init(second, seed, NULL) && result;
+    locked = bdap_locked_kb();
+
+    /* Wiping a key leaves its neighbour locked, wiping both unlocks
+     * their page */
+    bdap_decrypt_key_wipe(first);
+    result = result && bdap_locked_kb() == locked;
+    bdap_decrypt_key_wipe(second);
+    result = result && bdap_locked_kb() == before;
+    if (before >= 0)
+    {
+        result = result && locked > before;
+    }
+
+    /* Two sealed messages sharing a page */
+    result = result && bdap_nested_lock_sealed_test(pages, before);
+
+    /* A header pool sharing its first page with a key */
+    result = result && bdap_nested_lock_pool_test(pages, before);
+
+    /* Overlapping blocks across several pages */
+    result = result && crypto_mlock(pages + 100, 2 * 4096);
+    result = result && crypto_mlock(pages + 4096 + 10, 4096);
+    locked = bdap_locked_kb();
+    result = result && crypto_munlock(pages + 100, 2 * 4096);
+    if (before >= 0)
+    {
+        result = result && bdap_locked_kb() == before + 2 * 4;
+    }
+    result = result && crypto_munlock(pages + 4096 + 10, 4096);
+    result = result && bdap_locked_kb() == before;
+    if (before >= 0)
+    {
+        result = result && locked == before + 3 * 4;
+    }
+
+    crypto_memzero(seed, sizeof(seed));
+
+    return result;
+}
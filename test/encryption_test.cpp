@@ -6,6 +6,8 @@
 #include <cstdbool>
 #include <cstdint>
 #include <cstring>
+#include <memory>
+#include <sstream>
 #include "encryption.h"
 #include "rand.h"
 #include "ed25519.h"
@@ -14,6 +16,7 @@
 #include "aes256ctr.h"
 #include "aes256gcm.h"
 #include "utils.h"
+#include "thread_pool.h"
 #include "encryption_error.h"
 #include "vgp_assert.h"
 
@@ -704,7 +707,8 @@ bool zeroPayloadTest()
 bool randomStructuredInvalidCiphertextTest(int32_t maxNumberOfRecipients)
 {
     uint8_t seed[ 64 ];
-    int32_t index, num_recipients, target_key;
+    int32_t index, num_recipients;
+    uint32_t target_key;
     CharVector vchSeed(ED25519_PRIVATE_KEY_SEED_SIZE);
     CharVector vchPrivateKey(ED25519_PRIVATE_KEY_SIZE);
 
@@ -769,6 +773,13 @@ bool randomStructuredInvalidCiphertextTest(int32_t maxNumberOfRecipients)
             "The error status should be INVALID_CIPHERTEXT, AESGCM_DECRYPT_FAILED or NO_VALID_RECIPIENT",
             seed, sizeof(seed));
 
+        // The error is reported alike with and without a precomputed key
+        std::string strKeyErrorMessage("N/A");
+        BDAPDecryptor keyDecryptor(vchPrivKeySeeds[target_key]);
+        decryptStatus = keyDecryptor.Decrypt(vchCipherText, vchDecrypted, strKeyErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false && strKeyErrorMessage == strErrorMessage,
+            "Inconsistent error message", seed, sizeof(seed));
+
         // 2. Puncture a byte from the ciphertext
         for (index = 0; index < (int32_t)vchCipherTextBackup.size(); index++)
         {
@@ -896,6 +907,815 @@ bool randomUnstructuredInvalidCiphertextTest(int32_t maxNumberOfRounds)
     return true;
 }
 
+bool decryptorPositiveTest()
+{
+    int32_t index, message;
+    uint8_t seed[ 64 ];
+    const int32_t kNumberOfKeys = 4;
+    const int32_t kNumberOfMessages = 8;
+
+    // Generate random seed
+    use_os_rand();
+    bdap_randombytes(seed, sizeof(seed));
+    use_shake256_rand();
+    bdap_randominit(seed, sizeof(seed));
+
+    // a. Create random key seeds and the corresponding Ed25519 public keys.
+    vCharVector vchPubKeys(kNumberOfKeys, CharVector(ED25519_PUBLIC_KEY_SIZE));
+    vCharVector vchPrivKeySeeds(kNumberOfKeys, CharVector(ED25519_PRIVATE_KEY_SEED_SIZE));
+    for (index = 0; index < kNumberOfKeys; ++index)
+    {
+        bdap_randombytes(vchPrivKeySeeds[index].data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+        ed25519_public_key_from_private_key_seed(vchPubKeys[index].data(), vchPrivKeySeeds[index].data());
+    }
+
+    // b. Create one decryptor per recipient and one for an unrelated key seed.
+    std::string strErrorMessage("N/A");
+    std::vector<std::unique_ptr<BDAPDecryptor>> decryptors;
+    for (index = 0; index < kNumberOfKeys; ++index)
+    {
+        decryptors.emplace_back(new BDAPDecryptor(vchPrivKeySeeds[index]));
+        VGP_ASSERT_WITH_SEED(decryptors.back()->IsValid(strErrorMessage) == true,
+            "Decryptor initialisation failed", seed, sizeof(seed));
+    }
+    CharVector vchOtherSeed(ED25519_PRIVATE_KEY_SEED_SIZE);
+    bdap_randombytes(vchOtherSeed.data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+    BDAPDecryptor otherDecryptor(vchOtherSeed);
+
+    // c. Encrypt several random messages and check that every decryptor recovers them,
+    //    with the same result as DecryptBDAPData, and that the unrelated one does not.
+    for (message = 0; message < kNumberOfMessages; ++message)
+    {
+        uint16_t vchDataLength = 0;
+        bdap_randombytes(reinterpret_cast<uint8_t *>(&vchDataLength), sizeof(uint16_t));
+        vchDataLength = (vchDataLength & 0x0FFF);
+        CharVector vchData(vchDataLength);
+        bdap_randombytes(vchData.data(), vchDataLength);
+
+        CharVector vchCipherText;
+        bool encryptStatus = EncryptBDAPData(vchPubKeys, vchData, vchCipherText, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(encryptStatus == true, "Encryption failed", seed, sizeof(seed));
+
+        for (index = 0; index < kNumberOfKeys; ++index)
+        {
+            CharVector vchDecrypted, vchExpected;
+            bool decryptStatus = decryptors[index]->Decrypt(vchCipherText, vchDecrypted, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == true, "Decryption failed", seed, sizeof(seed));
+            VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_SUCCESS])),
+                "Incorrect error message", seed, sizeof(seed));
+            VGP_ASSERT_WITH_SEED(vchDecrypted == vchData, "Incorrect decryption output", seed, sizeof(seed));
+
+            decryptStatus = DecryptBDAPData(vchPrivKeySeeds[index], vchCipherText, vchExpected, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == true && vchExpected == vchDecrypted,
+                "Mismatch with DecryptBDAPData", seed, sizeof(seed));
+        }
+
+        CharVector vchDecrypted;
+        bool decryptStatus = otherDecryptor.Decrypt(vchCipherText, vchDecrypted, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_NO_VALID_RECIPIENT])),
+            "Incorrect error message", seed, sizeof(seed));
+    }
+
+    use_os_rand();
+
+    return true;
+}
+
+bool recipientSetTest()
+{
+    int32_t index, message;
+    uint8_t seed[ 64 ];
+    const int32_t kNumberOfKeys = 10;
+    const int32_t kNumberOfMessages = 4;
+
+    // Generate random seed
+    use_os_rand();
+    bdap_randombytes(seed, sizeof(seed));
+    use_shake256_rand();
+    bdap_randominit(seed, sizeof(seed));
+
+    // a. Create random key seeds and the corresponding Ed25519 public keys.
+    vCharVector vchPubKeys(kNumberOfKeys, CharVector(ED25519_PUBLIC_KEY_SIZE));
+    vCharVector vchPrivKeySeeds(kNumberOfKeys, CharVector(ED25519_PRIVATE_KEY_SEED_SIZE));
+    for (index = 0; index < kNumberOfKeys; ++index)
+    {
+        bdap_randombytes(vchPrivKeySeeds[index].data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+        ed25519_public_key_from_private_key_seed(vchPubKeys[index].data(), vchPrivKeySeeds[index].data());
+    }
+
+    // b. Prepare the recipient set once.
+    std::string strErrorMessage("N/A");
+    BDAPRecipientSet recipientSet(vchPubKeys);
+    VGP_ASSERT_WITH_SEED(recipientSet.IsValid(strErrorMessage) == true,
+        "Recipient set preparation failed", seed, sizeof(seed));
+    VGP_ASSERT_WITH_SEED(recipientSet.Size() == kNumberOfKeys, "Incorrect set size", seed, sizeof(seed));
+
+    // c. Encrypt several random messages to the set, every recipient must be able to decrypt
+    //    and the ciphertext size must match the one of EncryptBDAPData.
+    for (message = 0; message < kNumberOfMessages; ++message)
+    {
+        uint16_t vchDataLength = 0;
+        bdap_randombytes(reinterpret_cast<uint8_t *>(&vchDataLength), sizeof(uint16_t));
+        vchDataLength = (vchDataLength & 0x0FFF);
+        CharVector vchData(vchDataLength);
+        bdap_randombytes(vchData.data(), vchDataLength);
+
+        CharVector vchCipherText;
+        bool encryptStatus = EncryptBDAPData(recipientSet, vchData, vchCipherText, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(encryptStatus == true, "Encryption failed", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(vchCipherText.size() == BDAPCiphertextSize(kNumberOfKeys, vchDataLength),
+            "Incorrect ciphertext size", seed, sizeof(seed));
+
+        for (index = 0; index < kNumberOfKeys; ++index)
+        {
+            CharVector vchDecrypted;
+            bool decryptStatus = DecryptBDAPData(vchPrivKeySeeds[index], vchCipherText, vchDecrypted, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == true, "Decryption failed", seed, sizeof(seed));
+            VGP_ASSERT_WITH_SEED(vchDecrypted == vchData, "Incorrect decryption output", seed, sizeof(seed));
+        }
+    }
+
+    // d. A set containing a public key which is not a valid point must be rejected.
+    CharVector vchInvalidKey(ED25519_PUBLIC_KEY_SIZE);
+    CharVector vchUnused(CURVE25519_PUBLIC_KEY_SIZE);
+    do
+    {
+        bdap_randombytes(vchInvalidKey.data(), vchInvalidKey.size());
+    } while (0 == ed25519_to_curve25519_public_key(vchUnused.data(), vchInvalidKey.data()));
+    vchPubKeys.push_back(vchInvalidKey);
+
+    BDAPRecipientSet invalidSet(vchPubKeys);
+    VGP_ASSERT_WITH_SEED(invalidSet.IsValid(strErrorMessage) == false,
+        "Invalid recipient set is not expected to pass", seed, sizeof(seed));
+    VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(
+        std::string(bdap_error_message[BDAP_ED25519_TO_X25519_PUBLIC_KEY_FAILED])),
+        "Incorrect error message", seed, sizeof(seed));
+
+    CharVector vchCipherText;
+    bool encryptStatus = EncryptBDAPData(invalidSet, CharVector(16), vchCipherText, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(encryptStatus == false, "Encryption is not expected to pass", seed, sizeof(seed));
+
+    use_os_rand();
+
+    return true;
+}
+
+bool decryptBatchTest()
+{
+    int32_t message;
+    uint8_t seed[ 64 ];
+    const int32_t kNumberOfMessages = 37;
+
+    // Generate random seed
+    use_os_rand();
+    bdap_randombytes(seed, sizeof(seed));
+    use_shake256_rand();
+    bdap_randominit(seed, sizeof(seed));
+
+    // a. Create the identity key and an unrelated one.
+    CharVector vchPrivKeySeed(ED25519_PRIVATE_KEY_SEED_SIZE);
+    CharVector vchOtherSeed(ED25519_PRIVATE_KEY_SEED_SIZE);
+    vCharVector vchPubKeys(1, CharVector(ED25519_PUBLIC_KEY_SIZE));
+    vCharVector vchOtherPubKeys(1, CharVector(ED25519_PUBLIC_KEY_SIZE));
+    bdap_randombytes(vchPrivKeySeed.data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+    bdap_randombytes(vchOtherSeed.data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+    ed25519_public_key_from_private_key_seed(vchPubKeys[0].data(), vchPrivKeySeed.data());
+    ed25519_public_key_from_private_key_seed(vchOtherPubKeys[0].data(), vchOtherSeed.data());
+
+    // b. Encrypt random messages, every third one to the unrelated key, and
+    //    corrupt the tag of every fifth one.
+    std::string strErrorMessage("N/A");
+    vCharVector vchCipherTexts(kNumberOfMessages), vchExpected(kNumberOfMessages);
+    std::vector<uint16_t> vExpectedStatus(kNumberOfMessages, BDAP_SUCCESS);
+    for (message = 0; message < kNumberOfMessages; ++message)
+    {
+        uint16_t vchDataLength = 0;
+        bdap_randombytes(reinterpret_cast<uint8_t *>(&vchDataLength), sizeof(uint16_t));
+        vchDataLength = (vchDataLength & 0x0FFF);
+        vchExpected[message].resize(vchDataLength);
+        bdap_randombytes(vchExpected[message].data(), vchDataLength);
+
+        bool encryptStatus = EncryptBDAPData((message % 3 == 2) ? vchOtherPubKeys : vchPubKeys,
+                                             vchExpected[message], vchCipherTexts[message], strErrorMessage);
+        VGP_ASSERT_WITH_SEED(encryptStatus == true, "Encryption failed", seed, sizeof(seed));
+
+        if (message % 3 == 2)
+        {
+            vExpectedStatus[message] = BDAP_NO_VALID_RECIPIENT;
+        }
+        else if (message % 5 == 4)
+        {
+            vchCipherTexts[message].back() ^= 0x01;
+            vExpectedStatus[message] = BDAP_AESGCM_DECRYPT_FAILED;
+        }
+    }
+    vchCipherTexts.push_back(CharVector(3));
+    vchExpected.push_back(CharVector());
+    vExpectedStatus.push_back(BDAP_INVALID_CIPHERTEXT);
+
+    // c. Decrypt the batch with several thread counts, the outputs must match.
+    const uint32_t threadCounts[] = { 1, 2, 4, 0 };
+    for (uint32_t nThreads : threadCounts)
+    {
+        vCharVector vchData;
+        std::vector<uint16_t> vStatus;
+        bool decryptStatus = DecryptBDAPBatch(vchPrivKeySeed, vchCipherTexts, vchData, vStatus,
+                                              strErrorMessage, nThreads);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Batch is not expected to pass", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(vStatus == vExpectedStatus, "Incorrect status codes", seed, sizeof(seed));
+        for (size_t i = 0; i < vchCipherTexts.size(); ++i)
+        {
+            VGP_ASSERT_WITH_SEED(vchData[i] == ((vStatus[i] == BDAP_SUCCESS) ? vchExpected[i] : CharVector()),
+                "Incorrect decryption output", seed, sizeof(seed));
+        }
+    }
+
+    // d. A batch of valid ciphertexts only must pass.
+    vCharVector vchValid, vchData;
+    std::vector<uint16_t> vStatus;
+    for (message = 0; message < kNumberOfMessages; ++message)
+    {
+        if (vExpectedStatus[message] == BDAP_SUCCESS)
+        {
+            vchValid.push_back(vchCipherTexts[message]);
+        }
+    }
+    bool decryptStatus = DecryptBDAPBatch(vchPrivKeySeed, vchValid, vchData, vStatus, strErrorMessage, 3);
+    VGP_ASSERT_WITH_SEED(decryptStatus == true, "Batch decryption failed", seed, sizeof(seed));
+    VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_SUCCESS])),
+        "Incorrect error message", seed, sizeof(seed));
+
+    use_os_rand();
+
+    return true;
+}
+
+bool encryptParallelTest()
+{
+    int32_t index;
+    uint8_t seed[ 64 ];
+    const int32_t kNumberOfKeys = 300;
+    const int32_t kDecryptingKeys[] = { 0, 31, 32, 150, kNumberOfKeys - 1 };
+    const int32_t kInvalidKeys[] = { 250, 40 };
+
+    // Generate random seed
+    use_os_rand();
+    bdap_randombytes(seed, sizeof(seed));
+    use_shake256_rand();
+    bdap_randominit(seed, sizeof(seed));
+
+    // a. Create random key seeds and the corresponding Ed25519 public keys.
+    vCharVector vchPubKeys(kNumberOfKeys, CharVector(ED25519_PUBLIC_KEY_SIZE));
+    vCharVector vchPrivKeySeeds(kNumberOfKeys, CharVector(ED25519_PRIVATE_KEY_SEED_SIZE));
+    for (index = 0; index < kNumberOfKeys; ++index)
+    {
+        bdap_randombytes(vchPrivKeySeeds[index].data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+        ed25519_public_key_from_private_key_seed(vchPubKeys[index].data(), vchPrivKeySeeds[index].data());
+    }
+    BDAPRecipientSet recipientSet(vchPubKeys);
+
+    CharVector vchData(1000);
+    bdap_randombytes(vchData.data(), vchData.size());
+
+    // b. Encrypt with several thread counts, recipients on either side of the batch
+    //    boundaries must be able to decrypt.
+    std::string strErrorMessage("N/A");
+    const uint32_t threadCounts[] = { 1, 2, 4, 0 };
+    for (uint32_t nThreads : threadCounts)
+    {
+        CharVector vchCipherText, vchSetCipherText;
+        bool encryptStatus = EncryptBDAPData(vchPubKeys, vchData, vchCipherText, strErrorMessage, nThreads);
+        VGP_ASSERT_WITH_SEED(encryptStatus == true, "Encryption failed", seed, sizeof(seed));
+        encryptStatus = EncryptBDAPData(recipientSet, vchData, vchSetCipherText, strErrorMessage, nThreads);
+        VGP_ASSERT_WITH_SEED(encryptStatus == true, "Encryption to set failed", seed, sizeof(seed));
+
+        for (int32_t key : kDecryptingKeys)
+        {
+            CharVector vchDecrypted;
+            bool decryptStatus = DecryptBDAPData(vchPrivKeySeeds[key], vchCipherText, vchDecrypted, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == true, "Decryption failed", seed, sizeof(seed));
+            VGP_ASSERT_WITH_SEED(vchDecrypted == vchData, "Incorrect decryption output", seed, sizeof(seed));
+
+            decryptStatus = DecryptBDAPData(vchPrivKeySeeds[key], vchSetCipherText, vchDecrypted, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == true, "Decryption failed", seed, sizeof(seed));
+            VGP_ASSERT_WITH_SEED(vchDecrypted == vchData, "Incorrect decryption output", seed, sizeof(seed));
+        }
+    }
+
+    // c. Payloads above the threshold are also split across the threads, on both sides.
+    const size_t threshold = bdap_get_parallel_gcm_threshold();
+    bdap_set_parallel_gcm_threshold(16 * 1024);
+    CharVector vchLargeData(300 * 1024 + 5);
+    bdap_randombytes(vchLargeData.data(), vchLargeData.size());
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i)
+    {
+        // Decrypt with a different thread count than the one used to encrypt
+        uint32_t nEncryptThreads = threadCounts[i];
+        uint32_t nDecryptThreads = threadCounts[(i + 1) % (sizeof(threadCounts) / sizeof(threadCounts[0]))];
+        CharVector vchCipherText, vchDecrypted;
+        bool encryptStatus = EncryptBDAPData(recipientSet, vchLargeData, vchCipherText, strErrorMessage,
+                                             nEncryptThreads);
+        VGP_ASSERT_WITH_SEED(encryptStatus == true, "Encryption failed", seed, sizeof(seed));
+        bool decryptStatus = DecryptBDAPData(vchPrivKeySeeds[7], vchCipherText, vchDecrypted, strErrorMessage,
+                                             nDecryptThreads);
+        VGP_ASSERT_WITH_SEED(decryptStatus == true, "Decryption failed", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(vchDecrypted == vchLargeData, "Incorrect decryption output", seed, sizeof(seed));
+
+        vchCipherText.back() ^= 0x01;
+        decryptStatus = DecryptBDAPData(vchPrivKeySeeds[7], vchCipherText, vchDecrypted, strErrorMessage,
+                                        nDecryptThreads);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+    }
+    bdap_set_parallel_gcm_threshold(threshold);
+
+    // d. Public keys which are not valid points must make every thread count fail
+    //    with the same error, leaving nothing of the ciphertext.
+    CharVector vchUnused(CURVE25519_PUBLIC_KEY_SIZE);
+    for (int32_t key : kInvalidKeys)
+    {
+        do
+        {
+            bdap_randombytes(vchPubKeys[key].data(), vchPubKeys[key].size());
+        } while (0 == ed25519_to_curve25519_public_key(vchUnused.data(), vchPubKeys[key].data()));
+    }
+    for (uint32_t nThreads : threadCounts)
+    {
+        CharVector vchCipherText;
+        bool encryptStatus = EncryptBDAPData(vchPubKeys, vchData, vchCipherText, strErrorMessage, nThreads);
+        VGP_ASSERT_WITH_SEED(encryptStatus == false, "Encryption is not expected to pass", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(
+            std::string(bdap_error_message[BDAP_ED25519_TO_X25519_PUBLIC_KEY_FAILED])),
+            "Incorrect error message", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(vchCipherText == CharVector(vchCipherText.size()),
+            "Ciphertext is not wiped", seed, sizeof(seed));
+    }
+
+    use_os_rand();
+
+    return true;
+}
+
+bool streamTest()
+{
+    int32_t index, message;
+    uint8_t seed[ 64 ];
+    const int32_t kNumberOfKeys = 5;
+    const size_t kChunkSizes[] = { 1, 16, 1000, 65536 };
+
+    // Generate random seed
+    use_os_rand();
+    bdap_randombytes(seed, sizeof(seed));
+    use_shake256_rand();
+    bdap_randominit(seed, sizeof(seed));
+
+    vCharVector vchPubKeys(kNumberOfKeys, CharVector(ED25519_PUBLIC_KEY_SIZE));
+    vCharVector vchPrivKeySeeds(kNumberOfKeys, CharVector(ED25519_PRIVATE_KEY_SEED_SIZE));
+    for (index = 0; index < kNumberOfKeys; ++index)
+    {
+        bdap_randombytes(vchPrivKeySeeds[index].data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+        ed25519_public_key_from_private_key_seed(vchPubKeys[index].data(), vchPrivKeySeeds[index].data());
+    }
+
+    std::string strErrorMessage("N/A");
+    for (message = 0; message < 4; ++message)
+    {
+        uint16_t vchDataLength = 0;
+        bdap_randombytes(reinterpret_cast<uint8_t *>(&vchDataLength), sizeof(uint16_t));
+        vchDataLength = (message == 0) ? 0 : (vchDataLength & 0x3FFF);
+        CharVector vchData(vchDataLength);
+        bdap_randombytes(vchData.data(), vchDataLength);
+        std::string strData(vchData.begin(), vchData.end());
+        size_t nChunkSize = kChunkSizes[message];
+
+        // a. A streamed ciphertext decrypts with DecryptBDAPData.
+        std::istringstream input(strData);
+        std::ostringstream output;
+        bool encryptStatus = EncryptBDAPStream(vchPubKeys, input, output, strErrorMessage, nChunkSize);
+        VGP_ASSERT_WITH_SEED(encryptStatus == true, "Stream encryption failed", seed, sizeof(seed));
+        std::string strCipherText = output.str();
+        CharVector vchCipherText(strCipherText.begin(), strCipherText.end());
+        VGP_ASSERT_WITH_SEED(vchCipherText.size() == BDAPCiphertextSize(kNumberOfKeys, vchDataLength),
+            "Incorrect ciphertext size", seed, sizeof(seed));
+
+        CharVector vchDecrypted;
+        bool decryptStatus = DecryptBDAPData(vchPrivKeySeeds[message], vchCipherText, vchDecrypted, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == true, "Decryption failed", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(vchDecrypted == vchData, "Incorrect decryption output", seed, sizeof(seed));
+
+        // b. A ciphertext of EncryptBDAPData decrypts as a stream, from a non-zero offset.
+        encryptStatus = EncryptBDAPData(vchPubKeys, vchData, vchCipherText, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(encryptStatus == true, "Encryption failed", seed, sizeof(seed));
+        std::istringstream cipherInput("xyz" + std::string(vchCipherText.begin(), vchCipherText.end()));
+        cipherInput.seekg(3);
+        std::ostringstream plainOutput;
+        decryptStatus = DecryptBDAPStream(vchPrivKeySeeds[kNumberOfKeys - 1], cipherInput, plainOutput,
+                                          strErrorMessage, nChunkSize);
+        VGP_ASSERT_WITH_SEED(decryptStatus == true, "Stream decryption failed", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(plainOutput.str() == strData, "Incorrect stream decryption output", seed, sizeof(seed));
+
+        // c. A corrupted payload must not release any plaintext.
+        vchCipherText[vchCipherText.size() - AES256GCM_TAG_SIZE - (vchDataLength > 0 ? 1 : 0)] ^= 0x04;
+        std::istringstream badInput(std::string(vchCipherText.begin(), vchCipherText.end()));
+        std::ostringstream badOutput;
+        decryptStatus = DecryptBDAPStream(vchPrivKeySeeds[0], badInput, badOutput, strErrorMessage, nChunkSize);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(badOutput.str().empty(), "Unauthenticated plaintext released", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_AESGCM_DECRYPT_FAILED])),
+            "Incorrect error message", seed, sizeof(seed));
+    }
+
+    // d. A truncated stream is rejected.
+    std::istringstream shortInput(std::string(10, '\x01'));
+    std::ostringstream shortOutput;
+    bool decryptStatus = DecryptBDAPStream(vchPrivKeySeeds[0], shortInput, shortOutput, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+    VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_INVALID_CIPHERTEXT])),
+        "Incorrect error message", seed, sizeof(seed));
+
+    use_os_rand();
+
+    return true;
+}
+
+bool segmentedFormatTest()
+{
+    int32_t index, message, round;
+    uint8_t seed[ 64 ];
+    const int32_t kNumberOfKeys = 3;
+    const size_t kSegmentSize = BDAP_V2_MIN_SEGMENT_SIZE;
+    const size_t kStride = kSegmentSize + AES256GCM_TAG_SIZE;
+
+    // Generate random seed
+    use_os_rand();
+    bdap_randombytes(seed, sizeof(seed));
+    use_shake256_rand();
+    bdap_randominit(seed, sizeof(seed));
+
+    vCharVector vchPubKeys(kNumberOfKeys, CharVector(ED25519_PUBLIC_KEY_SIZE));
+    vCharVector vchPrivKeySeeds(kNumberOfKeys, CharVector(ED25519_PRIVATE_KEY_SEED_SIZE));
+    for (index = 0; index < kNumberOfKeys; ++index)
+    {
+        bdap_randombytes(vchPrivKeySeeds[index].data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+        ed25519_public_key_from_private_key_seed(vchPubKeys[index].data(), vchPrivKeySeeds[index].data());
+    }
+    std::string strErrorMessage("N/A");
+    BDAPDecryptor decryptor(vchPrivKeySeeds[kNumberOfKeys - 1]);
+    BDAPKeyring keyring(1);
+    VGP_ASSERT_WITH_SEED(keyring.AddKey(vchPrivKeySeeds[0], strErrorMessage) == true,
+        "Adding a key failed", seed, sizeof(seed));
+
+    bdap_thread_pool pool;
+    VGP_ASSERT_WITH_SEED(bdap_thread_pool_init(&pool, 3) == true,
+        "Thread pool creation failed", seed, sizeof(seed));
+
+    for (message = 0; message < 5; ++message)
+    {
+        uint16_t vchDataLength = 0;
+        bdap_randombytes(reinterpret_cast<uint8_t *>(&vchDataLength), sizeof(uint16_t));
+        const size_t kLengths[] = { 0, kSegmentSize, 3 * kSegmentSize + 1, 17 };
+        size_t nDataLength = (message < 4) ? kLengths[message] : (vchDataLength & 0x3FFF);
+        CharVector vchData(nDataLength);
+        bdap_randombytes(vchData.data(), nDataLength);
+
+        // a. The v2 ciphertext has the expected size and decrypts as a whole.
+        CharVector vchCipherText;
+        bool encryptStatus = EncryptBDAPDataV2(vchPubKeys, vchData, vchCipherText, strErrorMessage,
+                                               kSegmentSize, message % 2 ? 0 : 1);
+        VGP_ASSERT_WITH_SEED(encryptStatus == true, "Encryption failed", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(vchCipherText.size() == bdap_ciphertext_size_v2(kNumberOfKeys, nDataLength, kSegmentSize),
+            "Incorrect ciphertext size", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(BDAPExpectedDecryptedSize(vchCipherText) == nDataLength,
+            "Incorrect decrypted size", seed, sizeof(seed));
+
+        for (index = 0; index < kNumberOfKeys; ++index)
+        {
+            CharVector vchDecrypted;
+            bool decryptStatus = DecryptBDAPData(vchPrivKeySeeds[index], vchCipherText, vchDecrypted, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == true, "Decryption failed", seed, sizeof(seed));
+            VGP_ASSERT_WITH_SEED(vchDecrypted == vchData, "Incorrect decryption output", seed, sizeof(seed));
+        }
+
+        // b. Random ranges decrypt to the matching slices, with and without a pool.
+        for (round = 0; round < 16; ++round)
+        {
+            uint32_t r[2];
+            bdap_randombytes(reinterpret_cast<uint8_t *>(r), sizeof(r));
+            size_t nOffset = (round == 0) ? 0 : r[0] % (nDataLength + 1);
+            size_t nLength = (round == 0) ? nDataLength : r[1] % (nDataLength - nOffset + 1);
+            CharVector vchExpected(vchData.begin() + nOffset, vchData.begin() + nOffset + nLength);
+
+            CharVector vchRange;
+            bool decryptStatus = decryptor.DecryptRange(vchCipherText, nOffset, nLength, vchRange, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == true, "Range decryption failed", seed, sizeof(seed));
+            VGP_ASSERT_WITH_SEED(vchRange == vchExpected, "Incorrect range decryption output", seed, sizeof(seed));
+
+            bdap_decrypt_key key;
+            const char *error_message;
+            CharVector vchParallel(nLength + 1);
+            decryptStatus = bdap_decrypt_key_init(&key, vchPrivKeySeeds[0].data(), &error_message) &&
+                bdap_decrypt_range(vchParallel.data(), &key, vchCipherText.data(), vchCipherText.size(),
+                                   nOffset, nLength, &pool, &error_message);
+            bdap_decrypt_key_wipe(&key);
+            vchParallel.resize(nLength);
+            VGP_ASSERT_WITH_SEED(decryptStatus == true && vchParallel == vchExpected,
+                "Incorrect parallel range decryption output", seed, sizeof(seed));
+        }
+
+        CharVector vchRange;
+        bool decryptStatus = decryptor.DecryptRange(vchCipherText, nDataLength, 1, vchRange, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_INVALID_RANGE])),
+            "Incorrect error message", seed, sizeof(seed));
+
+        size_t nNumSegments = (nDataLength == 0) ? 1 : (nDataLength + kSegmentSize - 1) / kSegmentSize;
+        size_t nHeaderSize = vchCipherText.size() - nDataLength - nNumSegments * AES256GCM_TAG_SIZE;
+        size_t nIdentity;
+
+        // A payload cut down to a single empty segment is rejected by every path, even for
+        // empty ranges: its 16 bytes are not the tag of an empty last segment.
+        for (round = 0; round < 2; ++round)
+        {
+            CharVector vchForged(vchCipherText.begin(), vchCipherText.begin() + nHeaderSize + AES256GCM_TAG_SIZE);
+            if (round == 1)
+            {
+                bdap_randombytes(vchForged.data() + nHeaderSize, AES256GCM_TAG_SIZE);
+            }
+            else if (nDataLength == 0)
+            {
+                continue;
+            }
+            VGP_ASSERT_WITH_SEED(BDAPExpectedDecryptedSize(vchForged) == 0,
+                "Incorrect decrypted size", seed, sizeof(seed));
+            decryptStatus = DecryptBDAPData(vchPrivKeySeeds[0], vchForged, vchRange, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+            VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_AESGCM_DECRYPT_FAILED])),
+                "Incorrect error message", seed, sizeof(seed));
+            decryptStatus = decryptor.DecryptRange(vchForged, 0, 0, vchRange, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+            decryptStatus = keyring.Decrypt(vchForged, vchRange, nIdentity, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+        }
+        decryptStatus = keyring.Decrypt(vchCipherText, vchRange, nIdentity, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == true && vchRange == vchData && nIdentity == 0,
+            "Keyring decryption failed", seed, sizeof(seed));
+        decryptStatus = decryptor.DecryptRange(vchCipherText, 0, 0, vchRange, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == true && vchRange.empty(),
+            "Empty range decryption failed", seed, sizeof(seed));
+
+        if (nDataLength <= kSegmentSize)
+        {
+            continue;
+        }
+
+        // c. A corrupted segment only fails the ranges that overlap it, unless it is the last
+        //    one, which every range authenticates.
+        CharVector vchCorrupted(vchCipherText);
+        vchCorrupted[nHeaderSize + kStride + 5] ^= 0x10;
+        decryptStatus = decryptor.DecryptRange(vchCorrupted, 0, kSegmentSize, vchRange, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == (nNumSegments > 2),
+            "Incorrect range decryption status", seed, sizeof(seed));
+        decryptStatus = decryptor.DecryptRange(vchCorrupted, kSegmentSize - 1, 2, vchRange, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false && vchRange.empty(),
+            "Decryption is not expected to pass", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_AESGCM_DECRYPT_FAILED])),
+            "Incorrect error message", seed, sizeof(seed));
+
+        // d. Swapped segments and a ciphertext truncated at a segment boundary are rejected,
+        //    also by the ranges that only overlap the segments left in place.
+        if (nDataLength >= 2 * kSegmentSize)
+        {
+            CharVector vchSwapped(vchCipherText);
+            std::swap_ranges(vchSwapped.begin() + nHeaderSize, vchSwapped.begin() + nHeaderSize + kStride,
+                             vchSwapped.begin() + nHeaderSize + kStride);
+            decryptStatus = decryptor.Decrypt(vchSwapped, vchRange, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+            decryptStatus = keyring.Decrypt(vchSwapped, vchRange, nIdentity, strErrorMessage);
+            VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+
+            // The last two segments swapped, when both are full
+            if (nDataLength % kSegmentSize == 0)
+            {
+                CharVector vchReordered(vchCipherText);
+                size_t nLast = nHeaderSize + (nNumSegments - 1) * kStride;
+                std::swap_ranges(vchReordered.begin() + nLast - kStride, vchReordered.begin() + nLast,
+                                 vchReordered.begin() + nLast);
+                decryptStatus = decryptor.DecryptRange(vchReordered, 0, 1, vchRange, strErrorMessage);
+                VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+            }
+        }
+
+        CharVector vchTruncated(vchCipherText.begin(), vchCipherText.begin() + nHeaderSize + kStride);
+        decryptStatus = decryptor.Decrypt(vchTruncated, vchRange, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_AESGCM_DECRYPT_FAILED])),
+            "Incorrect error message", seed, sizeof(seed));
+        decryptStatus = decryptor.DecryptRange(vchTruncated, 0, 1, vchRange, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false && vchRange.empty(),
+            "Decryption is not expected to pass", seed, sizeof(seed));
+        decryptStatus = keyring.Decrypt(vchTruncated, vchRange, nIdentity, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+
+        // The last segment dropped
+        CharVector vchDropped(vchCipherText.begin(),
+                              vchCipherText.begin() + nHeaderSize + (nNumSegments - 1) * kStride);
+        decryptStatus = decryptor.Decrypt(vchDropped, vchRange, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+        decryptStatus = decryptor.DecryptRange(vchDropped, 0, 1, vchRange, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+        decryptStatus = keyring.Decrypt(vchDropped, vchRange, nIdentity, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(decryptStatus == false, "Decryption is not expected to pass", seed, sizeof(seed));
+    }
+    bdap_thread_pool_destroy(&pool);
+
+    // e. Invalid segment sizes, v1 ciphertexts for ranges and v2 ciphertexts for streams are rejected.
+    CharVector vchData(100), vchCipherText, vchRange;
+    bool status = EncryptBDAPDataV2(vchPubKeys, vchData, vchCipherText, strErrorMessage, 1000);
+    VGP_ASSERT_WITH_SEED(status == false, "Encryption is not expected to pass", seed, sizeof(seed));
+    VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_INVALID_SEGMENT_SIZE])),
+        "Incorrect error message", seed, sizeof(seed));
+
+    status = EncryptBDAPData(vchPubKeys, vchData, vchCipherText, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == true, "Encryption failed", seed, sizeof(seed));
+    status = decryptor.DecryptRange(vchCipherText, 0, 10, vchRange, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == false, "Decryption is not expected to pass", seed, sizeof(seed));
+    VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_INVALID_CIPHERTEXT])),
+        "Incorrect error message", seed, sizeof(seed));
+
+    status = EncryptBDAPDataV2(vchPubKeys, vchData, vchCipherText, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == true, "Encryption failed", seed, sizeof(seed));
+    std::istringstream input(std::string(vchCipherText.begin(), vchCipherText.end()));
+    std::ostringstream output;
+    status = DecryptBDAPStream(vchPrivKeySeeds[0], input, output, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == false && output.str().empty(),
+        "Stream decryption is not expected to pass", seed, sizeof(seed));
+
+    use_os_rand();
+
+    return true;
+}
+
+bool sortedHeaderTest()
+{
+    int32_t index;
+    uint8_t seed[ 64 ];
+    const int32_t kNumberOfKeys = 200;
+    const size_t kSlotSize = BDAP_FINGERPRINT_SIZE + CURVE25519_PUBLIC_KEY_SIZE;
+    const size_t kSlotOffset = 2 + CURVE25519_PUBLIC_KEY_SIZE;
+
+    // Generate random seed
+    use_os_rand();
+    bdap_randombytes(seed, sizeof(seed));
+    use_shake256_rand();
+    bdap_randominit(seed, sizeof(seed));
+
+    // a. Random keys, the last one listed twice.
+    vCharVector vchPubKeys(kNumberOfKeys, CharVector(ED25519_PUBLIC_KEY_SIZE));
+    vCharVector vchPrivKeySeeds(kNumberOfKeys, CharVector(ED25519_PRIVATE_KEY_SEED_SIZE));
+    for (index = 0; index < kNumberOfKeys; ++index)
+    {
+        bdap_randombytes(vchPrivKeySeeds[index].data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+        ed25519_public_key_from_private_key_seed(vchPubKeys[index].data(), vchPrivKeySeeds[index].data());
+    }
+    vchPubKeys.push_back(vchPubKeys.back());
+
+    std::string strErrorMessage("N/A");
+    CharVector vchData(100), vchCipherText;
+    bdap_randombytes(vchData.data(), vchData.size());
+    bool status = EncryptBDAPData(vchPubKeys, vchData, vchCipherText, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == true, "Encryption failed", seed, sizeof(seed));
+
+    // b. The header is flagged and its fingerprints are in order.
+    VGP_ASSERT_WITH_SEED((vchCipherText[kSlotOffset - 1] & 0x80) != 0,
+        "Sorted header is not flagged", seed, sizeof(seed));
+    for (index = 1; index < int32_t(vchPubKeys.size()); ++index)
+    {
+        VGP_ASSERT_WITH_SEED(memcmp(&vchCipherText[kSlotOffset + (index - 1) * kSlotSize],
+                                    &vchCipherText[kSlotOffset + index * kSlotSize],
+                                    BDAP_FINGERPRINT_SIZE) <= 0,
+            "Fingerprints are not sorted", seed, sizeof(seed));
+    }
+
+    // c. Every recipient finds their pair, by binary search or in constant time,
+    //    and an unrelated key does not.
+    for (index = 0; index < kNumberOfKeys; ++index)
+    {
+        BDAPDecryptor decryptor(vchPrivKeySeeds[index]);
+        CharVector vchDecrypted;
+        bdap_set_constant_time_lookup(index % 2 == 1);
+        status = decryptor.Decrypt(vchCipherText, vchDecrypted, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(status == true && vchDecrypted == vchData,
+            "Decryption failed", seed, sizeof(seed));
+    }
+    bdap_set_constant_time_lookup(false);
+
+    CharVector vchOtherSeed(ED25519_PRIVATE_KEY_SEED_SIZE), vchDecrypted;
+    bdap_randombytes(vchOtherSeed.data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+    status = DecryptBDAPData(vchOtherSeed, vchCipherText, vchDecrypted, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == false, "Decryption is not expected to pass", seed, sizeof(seed));
+    VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_NO_VALID_RECIPIENT])),
+        "Incorrect error message", seed, sizeof(seed));
+
+    // d. The flag is bound to the key derivation, clearing it breaks the ciphertext.
+    vchCipherText[kSlotOffset - 1] &= 0x7f;
+    status = DecryptBDAPData(vchPrivKeySeeds[0], vchCipherText, vchDecrypted, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == false, "Decryption is not expected to pass", seed, sizeof(seed));
+
+    use_os_rand();
+
+    return true;
+}
+
+bool keyringTest()
+{
+    int32_t index, message;
+    uint8_t seed[ 64 ];
+    const int32_t kNumberOfKeys = 300;
+    const int32_t kNumberOfOutsiders = 4;
+
+    // Generate random seed
+    use_os_rand();
+    bdap_randombytes(seed, sizeof(seed));
+    use_shake256_rand();
+    bdap_randominit(seed, sizeof(seed));
+
+    // a. A keyring of random identities, and a few identities outside of it.
+    std::string strErrorMessage("N/A");
+    vCharVector vchPubKeys(kNumberOfKeys + kNumberOfOutsiders, CharVector(ED25519_PUBLIC_KEY_SIZE));
+    vCharVector vchPrivKeySeeds(kNumberOfKeys + kNumberOfOutsiders, CharVector(ED25519_PRIVATE_KEY_SEED_SIZE));
+    BDAPKeyring keyring(kNumberOfKeys);
+    for (index = 0; index < kNumberOfKeys + kNumberOfOutsiders; ++index)
+    {
+        bdap_randombytes(vchPrivKeySeeds[index].data(), ED25519_PRIVATE_KEY_SEED_SIZE);
+        ed25519_public_key_from_private_key_seed(vchPubKeys[index].data(), vchPrivKeySeeds[index].data());
+        if (index < kNumberOfKeys)
+        {
+            bool status = keyring.AddKey(vchPrivKeySeeds[index], strErrorMessage);
+            VGP_ASSERT_WITH_SEED(status == true, "Adding a key failed", seed, sizeof(seed));
+        }
+    }
+    VGP_ASSERT_WITH_SEED(keyring.Size() == size_t(kNumberOfKeys), "Incorrect keyring size", seed, sizeof(seed));
+
+    // b. Messages to one keyring identity among outsiders, in both layouts, are
+    //    decrypted by that identity.
+    for (message = 0; message < 16; ++message)
+    {
+        uint32_t r;
+        bdap_randombytes(reinterpret_cast<uint8_t *>(&r), sizeof(r));
+        size_t nIdentity, nTarget = r % kNumberOfKeys;
+
+        vCharVector vchRecipients(vchPubKeys.begin() + kNumberOfKeys, vchPubKeys.end());
+        vchRecipients.insert(vchRecipients.begin() + (r >> 16) % (kNumberOfOutsiders + 1), vchPubKeys[nTarget]);
+
+        CharVector vchData(r >> 20), vchCipherText, vchDecrypted;
+        bdap_randombytes(vchData.data(), vchData.size());
+        bool status = (message % 2) ?
+            EncryptBDAPDataV2(vchRecipients, vchData, vchCipherText, strErrorMessage, BDAP_V2_MIN_SEGMENT_SIZE) :
+            EncryptBDAPData(vchRecipients, vchData, vchCipherText, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(status == true, "Encryption failed", seed, sizeof(seed));
+
+        status = keyring.Decrypt(vchCipherText, vchDecrypted, nIdentity, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(status == true && vchDecrypted == vchData,
+            "Keyring decryption failed", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(nIdentity == nTarget, "Incorrect identity", seed, sizeof(seed));
+
+        // c. A corrupted payload is rejected.
+        vchCipherText.back() ^= 0x01;
+        status = keyring.Decrypt(vchCipherText, vchDecrypted, nIdentity, strErrorMessage);
+        VGP_ASSERT_WITH_SEED(status == false && nIdentity == nTarget,
+            "Decryption is not expected to pass", seed, sizeof(seed));
+        VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_AESGCM_DECRYPT_FAILED])),
+            "Incorrect error message", seed, sizeof(seed));
+    }
+
+    // d. A message to outsiders only is not addressed to the keyring.
+    CharVector vchData(100), vchCipherText, vchDecrypted;
+    size_t nIdentity;
+    vCharVector vchOutsiders(vchPubKeys.begin() + kNumberOfKeys, vchPubKeys.end());
+    bool status = EncryptBDAPData(vchOutsiders, vchData, vchCipherText, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == true, "Encryption failed", seed, sizeof(seed));
+    status = keyring.Decrypt(vchCipherText, vchDecrypted, nIdentity, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == false && nIdentity == keyring.Size(),
+        "Decryption is not expected to pass", seed, sizeof(seed));
+    VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_NO_VALID_RECIPIENT])),
+        "Incorrect error message", seed, sizeof(seed));
+
+    // e. A full keyring refuses more keys, and an empty one decrypts nothing.
+    status = keyring.AddKey(vchPrivKeySeeds[kNumberOfKeys], strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == false, "Adding a key is not expected to pass", seed, sizeof(seed));
+    VGP_ASSERT_WITH_SEED(0 == strErrorMessage.compare(std::string(bdap_error_message[BDAP_KEYRING_FULL])),
+        "Incorrect error message", seed, sizeof(seed));
+
+    BDAPKeyring emptyKeyring(0);
+    status = emptyKeyring.Decrypt(vchCipherText, vchDecrypted, nIdentity, strErrorMessage);
+    VGP_ASSERT_WITH_SEED(status == false && nIdentity == 0,
+        "Decryption is not expected to pass", seed, sizeof(seed));
+
+    use_os_rand();
+
+    return true;
+}
+
 int main(void)
 {
     DO_TEST("Random positive test: ", randomPositiveTest())
@@ -914,6 +1734,22 @@ int main(void)
 
     DO_TEST("Empty payload test: ", zeroPayloadTest())
 
+    DO_TEST("Cached decryptor test: ", decryptorPositiveTest())
+
+    DO_TEST("Prepared recipient set test: ", recipientSetTest())
+
+    DO_TEST("Batch decryption test: ", decryptBatchTest())
+
+    DO_TEST("Parallel encryption test: ", encryptParallelTest())
+
+    DO_TEST("Streaming encryption test: ", streamTest())
+
+    DO_TEST("Segmented v2 format test: ", segmentedFormatTest())
+
+    DO_TEST("Sorted header test: ", sortedHeaderTest())
+
+    DO_TEST("Keyring decryption test: ", keyringTest())
+
     DO_TEST("Structured random ciphertext test: ", randomStructuredInvalidCiphertextTest(8))
 
     DO_TEST("Unstructured random ciphertext test: ", randomUnstructuredInvalidCiphertextTest(100000))
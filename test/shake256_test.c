@@ -1,9 +1,19 @@
 // Copyright (c) 2018-2019 Duality Blockchain Solutions Developers
 // See LICENSE.md file for license, copying and use information.
 
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+# define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#if !defined(_WIN32)
+# include <unistd.h>
+# include <sys/wait.h>
+#endif
+#include "drbg_rand.h"
+#include "shake256.h"
 #include "shake256_rand.h"
 #include "utils.h"
 
@@ -103,7 +113,6 @@ bool shake256_random_test()
          count < (int)(sizeof(test_vectors) / sizeof(shake256random_test_vector));
          count++)
     {
-        result = false;
         ptr = &test_vectors[count];
 
         seed = hex_to_array(ptr->seed_hex, &size);
@@ -125,7 +134,7 @@ bool shake256_random_test()
             rnd_buf = calloc(size, sizeof(uint8_t));
             shake256_randombytes(rnd_buf, size);
 
-            result = (memcmp(rnd_buf, buffer, size) == 0);
+            result = result && (memcmp(rnd_buf, buffer, size) == 0);
 
             free(rnd_buf);
             free(buffer);
@@ -134,5 +143,180 @@ bool shake256_random_test()
         }
     }
 
-    return true;
+    return result;
+}
+
+typedef struct
+{
+    const char *message_hex;
+    size_t message_repeat;
+    const char *output_hex;
+} shake256_test_vector;
+
+/* FIPS 202 examples, and multi-block inputs and outputs */
+static shake256_test_vector kat_vectors[] =
+{
+    {
+        "",
+        1,
+        "46b9dd2b0ba88d13233b3feb743eeb243fcd52ea62b81b82b50c27646ed5762f"
+    },
+    {
+        "616263",
+        1,
+        "483366601360a8771c6863080cc4114d8db44530f8f1e1ee4f94ea37e78b5739"
+        "d5a15bef186a5386c75744c0527e1faa9f8726e462a12a4feb06bd8801e751e4"
+    },
+    {
+        "a3",
+        200,
+        "cd8a920ed141aa0407a22d59288652e9d9f1a7ee0c1e7c1ca699424da84a904d"
+    }
+};
+
+bool shake256_kat_test()
+{
+    uint8_t message[300], output[300];
+    uint8_t *piece, *expected;
+    size_t idx, size, piece_size = 0, expected_size = 0;
+    bool result = true;
+
+    for (idx = 0;
+         result && idx < sizeof(kat_vectors) / sizeof(shake256_test_vector);
+         ++idx)
+    {
+        piece = hex_to_array(kat_vectors[idx].message_hex, &piece_size);
+        expected = hex_to_array(kat_vectors[idx].output_hex, &expected_size);
+        for (size = 0; size < kat_vectors[idx].message_repeat * piece_size; ++size)
+        {
+            message[size] = piece[size % piece_size];
+        }
+
+        result = (0 == shake256(output, expected_size, message, size)) &&
+            (memcmp(output, expected, expected_size) == 0);
+
+        free(piece);
+        free(expected);
+    }
+
+    /* Two blocks in, three blocks out */
+    for (size = 0; size < 272; ++size)
+    {
+        message[size] = (uint8_t)size;
+    }
+    expected = hex_to_array(
+        "25ac437127b9b2f8a888d604a13f60361fa9840aa044152a64548023c0d0d0dc",
+        &expected_size);
+    result = result &&
+        (0 == shake256(output, sizeof(output), message, 272)) &&
+        (memcmp(output + sizeof(output) - expected_size,
+                expected,
+                expected_size) == 0);
+    free(expected);
+
+    return result;
+}
+
+bool shake256_incremental_test(int iterations)
+{
+    uint8_t message[700], expected[600], output[600];
+    size_t in_len, out_len, done, size;
+    shake256_ctx ctx;
+    int32_t it;
+    bool result = true;
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        drbg_randombytes(message, sizeof(message));
+        in_len = (size_t)message[0] * 3 % sizeof(message);
+        out_len = 1 + (size_t)message[1] * 3 % sizeof(output);
+        result = (0 == shake256(expected, out_len, message, in_len));
+
+        /* Absorb and squeeze in random pieces, across block edges */
+        shake256_init(&ctx);
+        for (done = 0; result && done < in_len; done += size)
+        {
+            size = 1 + (size_t)message[2 + done % 64] % 200;
+            if (size > in_len - done)
+            {
+                size = in_len - done;
+            }
+            result = (0 == shake256_absorb(&ctx, message + done, size));
+        }
+        result = result && (0 == shake256_finalize(&ctx));
+        for (done = 0; result && done < out_len; done += size)
+        {
+            size = 1 + (size_t)message[3 + done % 64] % 300;
+            if (size > out_len - done)
+            {
+                size = out_len - done;
+            }
+            result = (0 == shake256_squeeze(&ctx, output + done, size));
+        }
+        result = result && (memcmp(output, expected, out_len) == 0);
+
+        /* The phases are enforced */
+        result = result &&
+            (0 != shake256_absorb(&ctx, message, 1)) &&
+            (0 != shake256_finalize(&ctx));
+        shake256_init(&ctx);
+        result = result && (0 != shake256_squeeze(&ctx, output, 1));
+        shake256_wipe(&ctx);
+    }
+
+    return result;
+}
+
+bool drbg_random_test(int iterations)
+{
+    uint8_t a[3 * DRBG_BUFFER_SIZE], b[3 * DRBG_BUFFER_SIZE];
+    uint8_t zeros[3 * DRBG_BUFFER_SIZE] = {0};
+    size_t size;
+    int32_t it;
+    bool result = true;
+#if !defined(_WIN32)
+    int fds[2];
+    pid_t pid;
+#endif
+
+    for (it = 0; result && it < iterations; ++it)
+    {
+        /* Requests across refills never repeat nor come out blank */
+        size = 1 + (size_t)it * 37 % sizeof(a);
+        drbg_randombytes(a, size);
+        drbg_randombytes(b, size);
+        result = (size < 16 || memcmp(a, b, size) != 0) &&
+            (size < 16 || memcmp(a, zeros, size) != 0);
+
+        if (it % 50 == 0)
+        {
+            drbg_reseed();
+        }
+    }
+
+#if !defined(_WIN32)
+    /* A forked child does not replay its parent's stream */
+    if (result && pipe(fds) == 0)
+    {
+        pid = fork();
+        if (pid == 0)
+        {
+            drbg_randombytes(a, 32);
+            result = (write(fds[1], a, 32) == 32);
+            _exit(result ? 0 : 1);
+        }
+        drbg_randombytes(b, 32);
+        result = pid > 0 &&
+            read(fds[0], a, 32) == 32 &&
+            memcmp(a, b, 32) != 0;
+        if (pid > 0)
+        {
+            (void)waitpid(pid, NULL, 0);
+        }
+        close(fds[0]);
+        close(fds[1]);
+    }
+#endif
+
+    return result;
 }
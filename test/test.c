@@ -28,15 +28,36 @@
 	}
 
 extern bool shake256_random_test();
+extern bool shake256_kat_test();
+extern bool shake256_incremental_test(int iterations);
+extern bool drbg_random_test(int iterations);
 extern bool nist_aes_test_vector();
 extern bool random_aes_test_vectors(int iterations);
+extern bool aes256_context_test(int iterations);
+extern bool aes256_engine_cross_check_test(int iterations);
 extern bool aes256ctr_nist_positive_test();
 extern bool aes256ctr_random_test(int iterations);
 extern bool openssl_aes256ctr_random_test(int iterations);
 extern bool aes256gcm_nist_positive_test();
 extern bool openssl_aes256gcm_nist_positive_test();
+extern bool aes256gcm_portable_nist_positive_test();
+extern bool aes256_hardware_cross_check_test(int iterations);
+extern bool aes256gcm_ghash_engines_test(int iterations);
+extern bool aes256gcm_parallel_test(int iterations);
+extern bool aes256gcm_incremental_test(int iterations);
+extern bool aes256gcm_length_limit_test(void);
 extern bool curve25519_random_keypair_test();
+extern bool fe_batch_inv_test(int iterations);
+extern bool curve25519_dh_batch_test(int iterations);
+extern bool curve25519_fixed_base_test(int iterations);
 extern bool bdap_random_test();
+extern bool fingerprint_find_test(int iterations);
+extern bool bdap_header_view_test(int iterations);
+extern bool bdap_add_recipients_test(int iterations);
+extern bool bdap_header_pool_test(int iterations);
+extern bool bdap_rng_test(int iterations);
+extern bool bdap_secure_memory_test(int iterations);
+extern bool bdap_nested_lock_test(void);
 extern bool ed25519_to_curve25519_conversion_test();
 extern bool ed25519_to_curve25519_random_conversion_test(int iterations);
 
@@ -48,17 +69,32 @@ int main(int argc, char *argv[])
         num_iterations = atoi(argv[1]);
     }
 
+    DO_ITER_TEST("Buffered random generator test (%d iterations): ",
+        num_iterations, drbg_random_test(num_iterations));
+
     use_shake256_rand();
 
     DO_TEST("SHAKE256 random test vectors: ",
         shake256_random_test());
 
+    DO_TEST("SHAKE256 test vectors: ",
+        shake256_kat_test());
+
+    DO_ITER_TEST("SHAKE256 incremental test (%d iterations): ",
+        num_iterations, shake256_incremental_test(num_iterations));
+
     DO_TEST("NIST AES test vectors: ",
         nist_aes_test_vector());
 
     DO_ITER_TEST("Random AES test (%d iterations): ",
         num_iterations, random_aes_test_vectors(num_iterations));
 
+    DO_ITER_TEST("AES context test (%d iterations): ",
+        num_iterations, aes256_context_test(num_iterations));
+
+    DO_ITER_TEST("AES engine cross-check test (%d iterations): ",
+        num_iterations, aes256_engine_cross_check_test(num_iterations));
+
     DO_TEST("AES256-CTR NIST positive test: ",
         aes256ctr_nist_positive_test());
 
@@ -74,9 +110,36 @@ int main(int argc, char *argv[])
     DO_TEST("OpenSSL AES256-GCM NIST positive test: ",
         openssl_aes256gcm_nist_positive_test());
 
+    DO_TEST("Portable AES256-GCM NIST positive test: ",
+        aes256gcm_portable_nist_positive_test());
+
+    DO_ITER_TEST("AES-NI versus portable AES256 cross-check test (%d iterations): ",
+        num_iterations, aes256_hardware_cross_check_test(num_iterations));
+
+    DO_ITER_TEST("GHASH engines versus reference test (%d iterations): ",
+        num_iterations, aes256gcm_ghash_engines_test(num_iterations));
+
+    DO_ITER_TEST("Parallel AES256-GCM test (%d iterations): ",
+        num_iterations, aes256gcm_parallel_test(num_iterations));
+
+    DO_ITER_TEST("Incremental AES256-GCM test (%d iterations): ",
+        num_iterations, aes256gcm_incremental_test(num_iterations));
+
+    DO_TEST("AES256-GCM length limit test: ",
+        aes256gcm_length_limit_test());
+
     DO_TEST("Curve25519 random keypair test: ",
         curve25519_random_keypair_test());
 
+    DO_ITER_TEST("Field element batch inversion test (%d iterations): ",
+        num_iterations, fe_batch_inv_test(num_iterations));
+
+    DO_ITER_TEST("Batched Curve25519 Diffie-Hellman test (%d iterations): ",
+        num_iterations, curve25519_dh_batch_test(num_iterations));
+
+    DO_ITER_TEST("Fixed-base Curve25519 public-key test (%d iterations): ",
+        num_iterations, curve25519_fixed_base_test(num_iterations));
+
     DO_TEST("Ed25519 to Curve25519 conversion test: ",
         ed25519_to_curve25519_conversion_test());
 
@@ -86,5 +149,26 @@ int main(int argc, char *argv[])
     DO_TEST("BDAP E2E random test: ",
         bdap_random_test());
 
+    DO_ITER_TEST("Fingerprint scan test (%d iterations): ",
+        num_iterations, fingerprint_find_test(num_iterations));
+
+    DO_ITER_TEST("BDAP header view test (%d iterations): ",
+        num_iterations, bdap_header_view_test(num_iterations));
+
+    DO_ITER_TEST("BDAP add recipients test (%d iterations): ",
+        num_iterations, bdap_add_recipients_test(num_iterations));
+
+    DO_ITER_TEST("BDAP header pool test (%d iterations): ",
+        num_iterations, bdap_header_pool_test(num_iterations));
+
+    DO_ITER_TEST("BDAP random number generator context test (%d iterations): ",
+        num_iterations, bdap_rng_test(num_iterations));
+
+    DO_ITER_TEST("BDAP secure memory test (%d iterations): ",
+        num_iterations, bdap_secure_memory_test(num_iterations));
+
+    DO_TEST("BDAP nested memory lock test: ",
+        bdap_nested_lock_test());
+
     return 0;
 }